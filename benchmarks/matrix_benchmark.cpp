@@ -1,6 +1,12 @@
 #include <benchmark/benchmark.h>
+#include "../matrix/chain.h"
+#include "../matrix/factorizations.h"
 #include "../matrix/functions.h"
+#include "../matrix/low_precision.h"
+#include "../matrix/powers.h"
+#include "../matrix/reductions.h"
 #include "../matrix/sequential_functions.h"
+#include "../matrix/structured.h"
 
 static void BM_Multiplication(benchmark::State& state) {
   Matrix<double> matrix = random_matrix(100, 100);
@@ -40,6 +46,15 @@ static void BM_SequentialDeterminant(benchmark::State& state) {
 BENCHMARK(BM_SequentialDeterminant);
 // Run the benchmark
 
+static void BM_IntegerRank(benchmark::State& state) {
+  Matrix<long long> matrix = matrix_cast<long long>(random_matrix(100, 100, -1000.0, 1000.0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(rank(matrix));
+  }
+}
+
+BENCHMARK(BM_IntegerRank);
+
 static void BM_Inverse(benchmark::State& state) {
   Matrix<double> matrix = random_matrix(100, 100);
   for (auto _ : state) {
@@ -105,6 +120,97 @@ static void BM_SequentialSLE(benchmark::State& state) {
 BENCHMARK(BM_SequentialSLE);
 // Run the benchmark
 
+// well-conditioned random systems, the same for all the solvers below
+static Matrix<double> random_system(size_t size) {
+  return random_matrix(size, size, -1.0, 1.0) + diag(static_cast<double>(size), size);
+}
+
+static void BM_SLERandom(benchmark::State& state) {
+  Matrix<double> matrix = random_system(100);
+  Matrix<double> result = random_matrix(100, 1);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(sle_solution(matrix, result));
+  }
+}
+
+BENCHMARK(BM_SLERandom);
+
+static void BM_FastSLERandom(benchmark::State& state) {
+  Matrix<double> matrix = random_system(100);
+  Matrix<double> result = random_matrix(100, 1);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fast_sle_solution(matrix, result));
+  }
+}
+
+BENCHMARK(BM_FastSLERandom);
+
+static void BM_LUSolve(benchmark::State& state) {
+  Matrix<double> matrix = random_system(100);
+  Matrix<double> result = random_matrix(100, 1);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(LUDecomposition<double>(matrix).solve(result));
+  }
+}
+
+BENCHMARK(BM_LUSolve);
+
+static void BM_MixedPrecisionSLE(benchmark::State& state) {
+  Matrix<double> matrix = random_system(100);
+  Matrix<double> result = random_matrix(100, 1);
+  MixedPrecisionInfo info;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(mixed_sle_solution(matrix, result, &info));
+  }
+  state.counters["refinement_iterations"] = static_cast<double>(info.iterations);
+}
+
+BENCHMARK(BM_MixedPrecisionSLE);
+
+static void BM_TriangularSolve(benchmark::State& state) {
+  size_t size = 300;
+  Matrix<double> triangular = random_matrix(size, size, -1.0, 1.0) + diag(static_cast<double>(size), size);
+  Matrix<double> right = random_matrix(size, size);
+  for (auto _ : state) {
+    Matrix<double> x = right;
+    trsm<double>(Side::Left, Triangle::Upper, Diagonal::NonUnit, triangular, x);
+    benchmark::DoNotOptimize(x);
+  }
+}
+
+BENCHMARK(BM_TriangularSolve);
+
+static void BM_GemmSameSize(benchmark::State& state) {
+  size_t size = 300;
+  Matrix<double> left = random_matrix(size, size);
+  Matrix<double> right = random_matrix(size, size);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(dot(left, right));
+  }
+}
+
+BENCHMARK(BM_GemmSameSize);
+
+static void BM_MatrixVector(benchmark::State& state) {
+  Matrix<double> matrix = random_matrix(1000, 1000);
+  Matrix<double> vector = random_matrix(1000, 1);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(dot(matrix, vector));
+  }
+}
+
+BENCHMARK(BM_MatrixVector);
+
+static void BM_SequentialMatrixVector(benchmark::State& state) {
+  Matrix<double> matrix = random_matrix(1000, 1000);
+  Matrix<double> vector = random_matrix(1000, 1);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(seq_dot(matrix, vector));
+  }
+}
+
+BENCHMARK(BM_SequentialMatrixVector);
+
 static void BM_Rank(benchmark::State& state) {
   Matrix<double> matrix = diag(1.0, 100);
   // TODO: replace diag(1, 100) with a randomly generated matrix
@@ -139,6 +245,30 @@ BENCHMARK(BM_SequentialRank);
 // Run the benchmark
 
 
+static void BM_AppendRows(benchmark::State& state) {
+  Matrix<double> batch = random_matrix(16, 64);
+  for (auto _ : state) {
+    Matrix<double> matrix = batch;
+    for (int i = 0; i < 256; ++i) {
+      matrix.concatenate(batch);
+    }
+    benchmark::DoNotOptimize(matrix);
+  }
+}
+
+BENCHMARK(BM_AppendRows);
+
+static void BM_ConcatenateColumns(benchmark::State& state) {
+  Matrix<double> left = random_matrix(500, 500);
+  Matrix<double> right = random_matrix(500, 20);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(concatenate(left, right, 1));
+  }
+}
+
+BENCHMARK(BM_ConcatenateColumns);
+
+
 static void BM_TransposeSquare(benchmark::State& state) {
   Matrix<double> matrix = random_matrix(100, 100);
   for (auto _ : state) {
@@ -175,4 +305,268 @@ static void BM_SequentialTransposeRectangle(benchmark::State& state) {
 
 BENCHMARK(BM_SequentialTransposeRectangle);
 
+static void BM_LargeAddition(benchmark::State& state) {
+  Matrix<double> a = random_matrix(2000, 2000);
+  Matrix<double> b = random_matrix(2000, 2000);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize((a + b).data());
+  }
+}
+
+BENCHMARK(BM_LargeAddition);
+
+static void BM_LargeTranspose(benchmark::State& state) {
+  Matrix<double> matrix = random_matrix(2000, 1500);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(transposed(matrix).data());
+  }
+}
+
+BENCHMARK(BM_LargeTranspose);
+
+static void BM_ChainLeftToRight(benchmark::State& state) {
+  Matrix<double> a = random_matrix(200, 10);
+  Matrix<double> b = random_matrix(10, 200);
+  Matrix<double> c = random_matrix(200, 200);
+  Matrix<double> d = random_matrix(200, 5);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a ^ b ^ c ^ d);
+  }
+}
+
+BENCHMARK(BM_ChainLeftToRight);
+
+static void BM_MultiDot(benchmark::State& state) {
+  Matrix<double> a = random_matrix(200, 10);
+  Matrix<double> b = random_matrix(10, 200);
+  Matrix<double> c = random_matrix(200, 200);
+  Matrix<double> d = random_matrix(200, 5);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(multi_dot(a, b, c, d));
+  }
+}
+
+BENCHMARK(BM_MultiDot);
+
+static void BM_TransposeDot(benchmark::State& state) {
+  Matrix<double> matrix = random_matrix(300, 200);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(dot(transposed(matrix), matrix));
+  }
+}
+
+BENCHMARK(BM_TransposeDot);
+
+static void BM_Gram(benchmark::State& state) {
+  Matrix<double> matrix = random_matrix(300, 200);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(gram(matrix));
+  }
+}
+
+BENCHMARK(BM_Gram);
+
+static BandMatrix<double> random_band(size_t n, size_t lower, size_t upper) {
+  BandMatrix<double> band(n, lower, upper);
+  band.band().fill_random(-1.0, 1.0);
+  for (size_t i = 0; i < n; ++i) {
+    band(i, i) += static_cast<double>(lower + upper + 1);
+  }
+  return band;
+}
+
+static void BM_DenseBandSolution(benchmark::State& state) {
+  BandMatrix<double> band = random_band(400, 5, 5);
+  Matrix<double> dense = band.to_dense();
+  Matrix<double> right = random_matrix(400, 1);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(sle_solution(dense, right));
+  }
+}
+
+BENCHMARK(BM_DenseBandSolution);
+
+static void BM_BandSolution(benchmark::State& state) {
+  BandMatrix<double> band = random_band(400, 5, 5);
+  Matrix<double> right = random_matrix(400, 1);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(sle_solution(band, right));
+  }
+}
+
+BENCHMARK(BM_BandSolution);
+
+static void column_operations(benchmark::State& state, Layout layout) {
+  Matrix<double> matrix = random_matrix(1000, 1000);
+  matrix.set_layout(layout);
+  for (auto _ : state) {
+    for (size_t i = 1; i < 1000; ++i) {
+      matrix.column_addition(i, i - 1, 0.5);
+    }
+    benchmark::DoNotOptimize(matrix.data());
+  }
+}
+
+static void BM_RowMajorColumnAddition(benchmark::State& state) {
+  column_operations(state, Layout::RowMajor);
+}
+
+BENCHMARK(BM_RowMajorColumnAddition);
+
+static void BM_ColumnMajorColumnAddition(benchmark::State& state) {
+  column_operations(state, Layout::ColumnMajor);
+}
+
+BENCHMARK(BM_ColumnMajorColumnAddition);
+
+static void BM_Equality(benchmark::State& state) {
+  Matrix<double> matrix = random_matrix(1000, 1000);
+  Matrix<double> copy = matrix;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(matrix == copy);
+  }
+}
+
+BENCHMARK(BM_Equality);
+
+static void BM_Allclose(benchmark::State& state) {
+  Matrix<double> matrix = random_matrix(1000, 1000);
+  Matrix<double> copy = matrix;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(allclose(matrix, copy));
+  }
+}
+
+BENCHMARK(BM_Allclose);
+
+static void BM_Sum(benchmark::State& state) {
+  Matrix<double> matrix = random_matrix(1000, 1000);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(sum(matrix));
+  }
+}
+
+BENCHMARK(BM_Sum);
+
+static void BM_CondByInverse(benchmark::State& state) {
+  Matrix<double> matrix = random_matrix(200, 200) + diag(10.0, 200);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(norm(matrix, Norm::One) * norm(inverse(matrix), Norm::One));
+  }
+}
+
+BENCHMARK(BM_CondByInverse);
+
+static void BM_CondEstimate(benchmark::State& state) {
+  Matrix<double> matrix = random_matrix(200, 200) + diag(10.0, 200);
+  LUDecomposition<double> lu(matrix);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(lu.cond_estimate());
+  }
+}
+
+BENCHMARK(BM_CondEstimate);
+
+static void BM_RefactorAfterUpdate(benchmark::State& state) {
+  Matrix<double> a = random_matrix(200, 200);
+  Matrix<double> spd = dot(a, transposed(a)) + diag(1.0, 200);
+  Matrix<double> x = random_matrix(200, 2);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(CholeskyDecomposition<double>(spd + dot(x, transposed(x))));
+  }
+}
+
+BENCHMARK(BM_RefactorAfterUpdate);
+
+static void BM_CholeskyUpdate(benchmark::State& state) {
+  Matrix<double> a = random_matrix(200, 200);
+  CholeskyDecomposition<double> cholesky(dot(a, transposed(a)) + diag(1.0, 200));
+  Matrix<double> x = random_matrix(200, 2);
+  for (auto _ : state) {
+    cholesky.update(x);
+  }
+}
+
+BENCHMARK(BM_CholeskyUpdate);
+
+static void BM_AllocateAndAdd(benchmark::State& state) {
+  Matrix<double> a = random_matrix(2000, 2000);
+  Matrix<double> b = random_matrix(2000, 2000);
+  set_numa_affinity(state.range(0) != 0);
+  for (auto _ : state) {
+    Matrix<double> copy = a;
+    benchmark::DoNotOptimize((copy + b).data());
+  }
+  set_numa_affinity(false);
+}
+
+BENCHMARK(BM_AllocateAndAdd)->Arg(0)->Arg(1);
+
+static void BM_PowerByLoop(benchmark::State& state) {
+  Matrix<double> matrix = random_matrix(200, 200, 0.0, 0.01);
+  for (auto _ : state) {
+    Matrix<double> res = matrix;
+    for (size_t i = 1; i < 64; ++i) {
+      res = res ^ matrix;
+    }
+    benchmark::DoNotOptimize(res.data());
+  }
+}
+
+BENCHMARK(BM_PowerByLoop);
+
+static void BM_MatrixPower(benchmark::State& state) {
+  Matrix<double> matrix = random_matrix(200, 200, 0.0, 0.01);
+  PowerWorkspace<double> workspace;
+  Matrix<double> res;
+  for (auto _ : state) {
+    matrix_power(matrix, 64, res, workspace);
+    benchmark::DoNotOptimize(res.data());
+  }
+}
+
+BENCHMARK(BM_MatrixPower);
+
+static void BM_Expm(benchmark::State& state) {
+  Matrix<double> matrix = random_matrix(200, 200, -0.1, 0.1);
+  PowerWorkspace<double> workspace;
+  Matrix<double> res;
+  for (auto _ : state) {
+    expm(matrix, res, workspace);
+    benchmark::DoNotOptimize(res.data());
+  }
+}
+
+BENCHMARK(BM_Expm);
+
+static void BM_FloatDot(benchmark::State& state) {
+  Matrix<float> a = random_matrix<float>(512, 512, -1.0f, 1.0f);
+  Matrix<float> b = random_matrix<float>(512, 512, -1.0f, 1.0f);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(dot(a, b).data());
+  }
+}
+
+BENCHMARK(BM_FloatDot);
+
+static void BM_HalfDot(benchmark::State& state) {
+  Matrix<half> a = matrix_cast<half>(random_matrix<float>(512, 512, -1.0f, 1.0f));
+  Matrix<half> b = matrix_cast<half>(random_matrix<float>(512, 512, -1.0f, 1.0f));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(widened_dot(a, b).data());
+  }
+}
+
+BENCHMARK(BM_HalfDot);
+
+static void BM_QuantizedDot(benchmark::State& state) {
+  QuantizedMatrix a = quantize(random_matrix<float>(512, 512, -1.0f, 1.0f));
+  QuantizedMatrix b = quantize(random_matrix<float>(512, 512, -1.0f, 1.0f), false);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(quantized_dot(a, b).data());
+  }
+}
+
+BENCHMARK(BM_QuantizedDot);
+
 BENCHMARK_MAIN();
@@ -0,0 +1,434 @@
+#pragma once
+
+#include<algorithm>
+#include<atomic>
+#include<condition_variable>
+#include<deque>
+#include<exception>
+#include<functional>
+#include<memory>
+#include<mutex>
+#include<optional>
+#include<stdexcept>
+#include<thread>
+#include<tuple>
+#include<type_traits>
+#include<vector>
+
+#include "functions.h"
+
+#if defined(LINALG_COROUTINES) && defined(__cpp_impl_coroutine)
+#include<coroutine>
+#define LINALG_HAS_COROUTINES 1
+#endif
+
+// Asynchronous operations: submit() and the async_* functions return at once with a
+// Future, the work runs on a ThreadPool. Futures chain with then() and when_all(), so a
+// graph of operations runs as soon as its inputs are ready and independent branches overlap.
+// The kernels still start their own threads inside a task.
+//
+// With -DLINALG_COROUTINES under C++20 a Future can also be co_await'ed, and a coroutine
+// can return a Future.
+
+class ThreadPool {
+public:
+  // pinned: worker k stays on the cpus of NUMA node k % numa_nodes()
+  explicit ThreadPool(size_t n_threads, bool pinned = false) {
+    if (n_threads == 0) {
+      throw std::invalid_argument("A pool needs at least one thread");
+    }
+    workers_.reserve(n_threads);
+    for (size_t k = 0; k < n_threads; ++k) {
+      workers_.emplace_back([this, k, pinned] {
+        if (pinned) {
+          detail::pin_to_node(k % numa_nodes());
+        }
+        work();
+      });
+    }
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // runs the queued tasks, then joins the workers
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    ready_.notify_all();
+    for (auto& t : workers_) {
+      t.join();
+    }
+  }
+
+  // one worker per hardware thread
+  static ThreadPool& global() {
+    static ThreadPool pool(std::max(2u, std::thread::hardware_concurrency()));
+    return pool;
+  }
+
+  void submit(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.push_back(std::move(task));
+    }
+    ready_.notify_one();
+  }
+
+  size_t size() const {
+    return workers_.size();
+  }
+
+private:
+  void work() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ready_.wait(lock, [this] {
+          return stopping_ || !tasks_.empty();
+        });
+        if (tasks_.empty()) {
+          return;
+        }
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      task();
+    }
+  }
+
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  bool stopping_ = false;
+};
+
+
+namespace detail {
+
+template<typename T>
+struct FutureState {
+  explicit FutureState(ThreadPool* pool) : pool(pool) {}
+
+  void set_value(T result) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      value.emplace(std::move(result));
+    }
+    complete();
+  }
+
+  void set_error(std::exception_ptr exception) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      error = exception;
+    }
+    complete();
+  }
+
+  // runs f once the result is set, at once if it already is
+  void on_ready(std::function<void()> f) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!done) {
+        continuations.push_back(std::move(f));
+        return;
+      }
+    }
+    f();
+  }
+
+  bool ready() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return done;
+  }
+
+  const T& get() {
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] {
+      return done;
+    });
+    if (error) {
+      std::rethrow_exception(error);
+    }
+    return *value;
+  }
+
+  void complete() {
+    std::vector<std::function<void()>> pending;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      done = true;
+      pending.swap(continuations);
+    }
+    finished.notify_all();
+    for (auto& f : pending) {
+      f();
+    }
+  }
+
+  ThreadPool* pool;
+  std::mutex mutex;
+  std::condition_variable finished;
+  bool done = false;
+  std::optional<T> value;
+  std::exception_ptr error;
+  std::vector<std::function<void()>> continuations;
+};
+
+// runs f() on the pool and stores its result or exception in `state`
+template<typename T, typename F>
+void run_into(const std::shared_ptr<FutureState<T>>& state, F f) {
+  state->pool->submit([state, f = std::move(f)] () mutable {
+    try {
+      state->set_value(f());
+    } catch (...) {
+      state->set_error(std::current_exception());
+    }
+  });
+}
+
+}  // namespace detail
+
+
+template<typename T>
+class Future {
+  static_assert(!std::is_void_v<T>, "Tasks must return a value");
+
+public:
+  using value_type = T;
+
+  Future() = default;
+
+  explicit Future(std::shared_ptr<detail::FutureState<T>> state) : state_(std::move(state)) {}
+
+  bool valid() const {
+    return state_ != nullptr;
+  }
+
+  bool ready() const {
+    return state_->ready();
+  }
+
+  void wait() const {
+    try {
+      state_->get();
+    } catch (...) {
+    }
+  }
+
+  // blocks until the result is set and rethrows the task's exception. The reference lives
+  // as long as some Future to it does. Don't block in pool tasks, chain with then() instead
+  const T& get() const {
+    return state_->get();
+  }
+
+  // Future of f(result), run on the same pool once the result is ready. An exception
+  // in this task is passed on to the new Future without calling f
+  template<typename F>
+  auto then(F f) const -> Future<std::decay_t<std::invoke_result_t<F, const T&>>> {
+    using R = std::decay_t<std::invoke_result_t<F, const T&>>;
+    auto next = std::make_shared<detail::FutureState<R>>(state_->pool);
+    auto source = state_;
+    auto task = std::make_shared<F>(std::move(f));
+    source->on_ready([source, next, task] {
+      if (source->error) {
+        next->set_error(source->error);
+        return;
+      }
+      detail::run_into(next, [source, task] {
+        return (*task)(*source->value);
+      });
+    });
+    return Future<R>(next);
+  }
+
+  std::shared_ptr<detail::FutureState<T>> state() const {
+    return state_;
+  }
+
+#ifdef LINALG_HAS_COROUTINES
+  struct promise_type {
+    std::shared_ptr<detail::FutureState<T>> state = std::make_shared<detail::FutureState<T>>(&ThreadPool::global());
+
+    Future get_return_object() {
+      return Future(state);
+    }
+
+    std::suspend_never initial_suspend() noexcept {
+      return {};
+    }
+
+    std::suspend_never final_suspend() noexcept {
+      return {};
+    }
+
+    void return_value(T result) {
+      state->set_value(std::move(result));
+    }
+
+    void unhandled_exception() {
+      state->set_error(std::current_exception());
+    }
+  };
+
+  // the coroutine goes on on a pool thread once the result is ready
+  auto operator co_await() const {
+    struct Awaiter {
+      std::shared_ptr<detail::FutureState<T>> state;
+
+      bool await_ready() const {
+        return state->ready();
+      }
+
+      void await_suspend(std::coroutine_handle<> handle) const {
+        auto source = state;
+        source->on_ready([source, handle] {
+          source->pool->submit([handle] {
+            handle.resume();
+          });
+        });
+      }
+
+      // a copy: the awaited Future is usually a temporary
+      T await_resume() const {
+        return state->get();
+      }
+    };
+    return Awaiter{ state_ };
+  }
+#endif
+
+private:
+  std::shared_ptr<detail::FutureState<T>> state_;
+};
+
+
+// Runs f(args...) on the pool. The arguments are copied (or moved) into the task
+template<typename F, typename... Args>
+auto submit(ThreadPool& pool, F f, Args... args) -> Future<std::decay_t<std::invoke_result_t<F, Args...>>> {
+  using R = std::decay_t<std::invoke_result_t<F, Args...>>;
+  auto state = std::make_shared<detail::FutureState<R>>(&pool);
+  detail::run_into(state, [f = std::move(f), arguments = std::make_tuple(std::move(args)...)] () mutable {
+    return std::apply(f, std::move(arguments));
+  });
+  return Future<R>(state);
+}
+
+// A ready Future, e.g. to start a chain from a value
+template<typename T>
+Future<T> make_ready_future(T value, ThreadPool& pool = ThreadPool::global()) {
+  auto state = std::make_shared<detail::FutureState<T>>(&pool);
+  state->set_value(std::move(value));
+  return Future<T>(state);
+}
+
+// Future of all the results, or of the first exception among them in argument order
+template<typename... Ts>
+Future<std::tuple<Ts...>> when_all(const Future<Ts>&... futures) {
+  static_assert(sizeof...(Ts) > 0, "Nothing to wait for");
+  auto states = std::make_tuple(futures.state()...);
+  ThreadPool* pool = std::get<0>(states)->pool;
+  auto result = std::make_shared<detail::FutureState<std::tuple<Ts...>>>(pool);
+  auto remaining = std::make_shared<std::atomic<size_t>>(sizeof...(Ts));
+  auto collect = [states, result, remaining] {
+    if (remaining->fetch_sub(1) != 1) {
+      return;
+    }
+    std::exception_ptr error;
+    std::apply([&error] (const auto&... state) {
+      ((error = error ? error : state->error), ...);
+    }, states);
+    if (error) {
+      result->set_error(error);
+      return;
+    }
+    result->set_value(std::apply([] (const auto&... state) {
+      return std::tuple<Ts...>(*state->value...);
+    }, states));
+  };
+  std::apply([&collect] (const auto&... state) {
+    (state->on_ready(collect), ...);
+  }, states);
+  return Future<std::tuple<Ts...>>(result);
+}
+
+template<typename T>
+Future<std::vector<T>> when_all(const std::vector<Future<T>>& futures, ThreadPool& pool = ThreadPool::global()) {
+  auto result = std::make_shared<detail::FutureState<std::vector<T>>>(&pool);
+  if (futures.empty()) {
+    result->set_value({});
+    return Future<std::vector<T>>(result);
+  }
+  auto remaining = std::make_shared<std::atomic<size_t>>(futures.size());
+  auto states = std::make_shared<std::vector<std::shared_ptr<detail::FutureState<T>>>>();
+  for (const auto& future : futures) {
+    states->push_back(future.state());
+  }
+  auto collect = [states, result, remaining] {
+    if (remaining->fetch_sub(1) != 1) {
+      return;
+    }
+    std::vector<T> values;
+    values.reserve(states->size());
+    for (const auto& state : *states) {
+      if (state->error) {
+        result->set_error(state->error);
+        return;
+      }
+      values.push_back(*state->value);
+    }
+    result->set_value(std::move(values));
+  };
+  for (const auto& state : *states) {
+    state->on_ready(collect);
+  }
+  return Future<std::vector<T>>(result);
+}
+
+
+template<typename T>
+Future<Matrix<T>> async_dot(Matrix<T> left, Matrix<T> right, ThreadPool& pool = ThreadPool::global()) {
+  return submit(pool, [] (const Matrix<T>& a, const Matrix<T>& b) {
+    return dot(a, b);
+  }, std::move(left), std::move(right));
+}
+
+template<typename T>
+Future<Matrix<T>> async_dot(const Future<Matrix<T>>& left, const Future<Matrix<T>>& right) {
+  return when_all(left, right).then([] (const std::tuple<Matrix<T>, Matrix<T>>& operands) {
+    return dot(std::get<0>(operands), std::get<1>(operands));
+  });
+}
+
+template<typename T>
+Future<Matrix<T>> async_inverse(Matrix<T> matrix, ThreadPool& pool = ThreadPool::global()) {
+  return submit(pool, [] (const Matrix<T>& a) {
+    return inverse(a);
+  }, std::move(matrix));
+}
+
+template<typename T>
+Future<T> async_det(Matrix<T> matrix, ThreadPool& pool = ThreadPool::global()) {
+  return submit(pool, [] (Matrix<T> a) {
+    return det_in_place(a);
+  }, std::move(matrix));
+}
+
+template<typename T>
+Future<Matrix<T>> async_sle_solution(Matrix<T> left_part, Matrix<T> right_part, ThreadPool& pool = ThreadPool::global()) {
+  return submit(pool, [] (const Matrix<T>& a, const Matrix<T>& b) {
+    return sle_solution(a, b);
+  }, std::move(left_part), std::move(right_part));
+}
+
+template<typename T>
+Future<Matrix<T>> async_sle_solution(const Future<Matrix<T>>& left_part, const Future<Matrix<T>>& right_part) {
+  return when_all(left_part, right_part).then([] (const std::tuple<Matrix<T>, Matrix<T>>& operands) {
+    return sle_solution(std::get<0>(operands), std::get<1>(operands));
+  });
+}
@@ -0,0 +1,390 @@
+#pragma once
+
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<cstdlib>
+#include<fstream>
+#include<map>
+#include<mutex>
+#include<sstream>
+#include<stdexcept>
+#include<string>
+#include<thread>
+#include<vector>
+
+#include "functions.h"
+#include "sequential_functions.h"
+
+// Picks between the sequential, parallel and fast versions of an operation by shape.
+// The candidates are timed over a grid of sizes on this machine, and the sizes at which
+// the winner changes (the crossover table) are stored in a text file:
+//
+//   linalg-autotune 1
+//   threads 8
+//   det 0 sequential
+//   det 96 parallel
+//   ...
+//
+// "det 96 parallel" means that det of size 96 and larger uses the parallel kernel.
+// The size of a call is the cube root of its work, n for n x n operands. Kernels run on
+// a fixed number of threads, so a table is only valid for the hardware concurrency it
+// was measured with; a table from another machine is discarded.
+// Tuning is never implicit: without a table Autotuner::defaults() is used, unless
+// $LINALG_AUTOTUNE_FILE names the file to load (and to tune into if it is missing or stale).
+
+enum class Operation { Dot, Det, SleSolution, Rank };
+
+enum class Variant { Sequential, Parallel, Fast };
+
+namespace detail {
+
+inline const char* operation_name(Operation operation) {
+  switch (operation) {
+    case Operation::Dot: return "dot";
+    case Operation::Det: return "det";
+    case Operation::SleSolution: return "sle_solution";
+    case Operation::Rank: return "rank";
+  }
+  return "";
+}
+
+inline const char* variant_name(Variant variant) {
+  switch (variant) {
+    case Variant::Sequential: return "sequential";
+    case Variant::Parallel: return "parallel";
+    case Variant::Fast: return "fast";
+  }
+  return "";
+}
+
+inline Operation parse_operation(const std::string& name) {
+  for (Operation operation : {Operation::Dot, Operation::Det, Operation::SleSolution, Operation::Rank}) {
+    if (name == operation_name(operation)) {
+      return operation;
+    }
+  }
+  throw std::invalid_argument("Unknown operation: " + name);
+}
+
+inline Variant parse_variant(const std::string& name) {
+  for (Variant variant : {Variant::Sequential, Variant::Parallel, Variant::Fast}) {
+    if (name == variant_name(variant)) {
+      return variant;
+    }
+  }
+  throw std::invalid_argument("Unknown kernel: " + name);
+}
+
+inline std::vector<Variant> candidates(Operation operation) {
+  if (operation == Operation::Dot || operation == Operation::Det) {
+    return {Variant::Sequential, Variant::Parallel};
+  }
+  return {Variant::Sequential, Variant::Parallel, Variant::Fast};
+}
+
+inline size_t tuning_size(size_t m, size_t k, size_t n) {
+  return static_cast<size_t>(std::llround(std::cbrt(static_cast<double>(m) * k * n)));
+}
+
+inline size_t hardware_threads() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// best of `repeats` runs, in nanoseconds
+template<typename F>
+uint64_t best_time(size_t repeats, F f) {
+  uint64_t best = UINT64_MAX;
+  for (size_t r = 0; r < repeats; ++r) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    best = std::min(best, static_cast<uint64_t>(duration.count()));
+  }
+  return best;
+}
+
+}  // namespace detail
+
+
+class Autotuner {
+public:
+  struct Crossover {
+    size_t from;
+    Variant variant;
+  };
+
+  static const std::vector<size_t>& default_sizes() {
+    static const std::vector<size_t> sizes = {4, 8, 16, 32, 64, 128, 256};
+    return sizes;
+  }
+
+  // the table without tuning: the threads from the size at which they pay for spawning them
+  static std::map<Operation, std::vector<Crossover>> defaults() {
+    return {{Operation::Dot, {{0, Variant::Sequential}, {48, Variant::Parallel}}},
+            {Operation::Det, {{0, Variant::Sequential}, {128, Variant::Parallel}}},
+            {Operation::SleSolution, {{0, Variant::Sequential}, {128, Variant::Parallel}}},
+            {Operation::Rank, {{0, Variant::Sequential}, {128, Variant::Parallel}}}};
+  }
+
+  // $LINALG_AUTOTUNE_FILE, empty if it isn't set
+  static std::string default_path() {
+    const char* path = std::getenv("LINALG_AUTOTUNE_FILE");
+    return path != nullptr ? path : "";
+  }
+
+  // the first call to choose() does load_default()
+  static Autotuner& instance() {
+    static Autotuner tuner;
+    return tuner;
+  }
+
+  Variant choose(Operation operation, size_t size) {
+    {
+      std::lock_guard<std::mutex> lock(tuning_mutex_);
+      if (empty()) {
+        load_default();
+      }
+    }
+    std::lock_guard<std::mutex> lock(table_mutex_);
+    const std::vector<Crossover>& crossovers = table_.at(operation);
+    Variant variant = crossovers.front().variant;
+    for (const Crossover& crossover : crossovers) {
+      if (crossover.from > size) {
+        break;
+      }
+      variant = crossover.variant;
+    }
+    return variant;
+  }
+
+  // times every candidate on n x n inputs for every n in `sizes` and keeps the fastest
+  void tune(const std::vector<size_t>& sizes = default_sizes(), size_t repeats = 3) {
+    if (sizes.empty()) {
+      throw std::invalid_argument("No sizes to tune on");
+    }
+    std::map<Operation, std::vector<Crossover>> table;
+    for (Operation operation : {Operation::Dot, Operation::Det, Operation::SleSolution, Operation::Rank}) {
+      std::vector<Crossover>& crossovers = table[operation];
+      for (size_t n : sizes) {
+        Matrix<double> left = random_matrix(n, n, -1.0, 1.0);
+        Matrix<double> right = random_matrix(n, 1, -1.0, 1.0);
+        Variant best = Variant::Sequential;
+        uint64_t best_time = UINT64_MAX;
+        for (Variant variant : detail::candidates(operation)) {
+          uint64_t time = detail::best_time(repeats, [&] {
+            run(operation, variant, left, right);
+          });
+          if (time < best_time) {
+            best_time = time;
+            best = variant;
+          }
+        }
+        if (crossovers.empty() || crossovers.back().variant != best) {
+          crossovers.push_back({crossovers.empty() ? 0 : n, best});
+        }
+      }
+    }
+    std::lock_guard<std::mutex> lock(table_mutex_);
+    table_ = std::move(table);
+    threads_ = detail::hardware_threads();
+  }
+
+  // returns false if the file is missing or was tuned for another number of threads,
+  // throws std::invalid_argument if it isn't a table
+  bool load(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+      return false;
+    }
+    std::string magic;
+    int version = 0;
+    if (!(in >> magic >> version) || magic != "linalg-autotune" || version != 1) {
+      throw std::invalid_argument("Not an autotune file: " + path);
+    }
+    std::string key;
+    size_t threads = 0;
+    if (!(in >> key >> threads) || key != "threads") {
+      throw std::invalid_argument("Malformed autotune file " + path);
+    }
+    if (threads != detail::hardware_threads()) {
+      return false;
+    }
+    std::map<Operation, std::vector<Crossover>> table;
+    std::string operation, variant;
+    size_t from;
+    while (in >> operation >> from >> variant) {
+      table[detail::parse_operation(operation)].push_back({from, detail::parse_variant(variant)});
+    }
+    if (!in.eof() || table.size() != 4) {
+      throw std::invalid_argument("Malformed autotune file " + path);
+    }
+    for (auto& [name, crossovers] : table) {
+      std::sort(crossovers.begin(), crossovers.end(), [] (const Crossover& a, const Crossover& b) {
+        return a.from < b.from;
+      });
+    }
+    std::lock_guard<std::mutex> lock(table_mutex_);
+    table_ = std::move(table);
+    threads_ = threads;
+    return true;
+  }
+
+  void save(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out || !(out << to_string())) {
+      throw std::runtime_error("Can't write " + path);
+    }
+  }
+
+  std::string to_string() const {
+    std::lock_guard<std::mutex> lock(table_mutex_);
+    std::ostringstream out;
+    out << "linalg-autotune 1\nthreads " << threads_ << "\n";
+    for (const auto& [operation, crossovers] : table_) {
+      for (const Crossover& crossover : crossovers) {
+        out << detail::operation_name(operation) << " " << crossover.from << " "
+            << detail::variant_name(crossover.variant) << "\n";
+      }
+    }
+    return out.str();
+  }
+
+  std::vector<Crossover> crossovers(Operation operation) const {
+    std::lock_guard<std::mutex> lock(table_mutex_);
+    auto it = table_.find(operation);
+    return it == table_.end() ? std::vector<Crossover>() : it->second;
+  }
+
+  // overrides the table for one operation, e.g. to pin a kernel
+  void set(Operation operation, std::vector<Crossover> crossovers) {
+    if (crossovers.empty()) {
+      throw std::invalid_argument("Empty crossover table");
+    }
+    std::lock_guard<std::mutex> lock(table_mutex_);
+    if (table_.empty()) {
+      set_defaults();
+    }
+    table_[operation] = std::move(crossovers);
+  }
+
+  // The table of default_path() if it is set: loaded, or tuned on default_sizes() and saved
+  // there if the file is missing or stale. A file that isn't a table is left alone. Without
+  // a path, or with a broken file, the static defaults
+  void load_default() {
+    std::string path = default_path();
+    if (!path.empty()) {
+      try {
+        if (!load(path)) {
+          tune();
+          try {
+            save(path);
+          } catch (const std::runtime_error&) {
+            // a read-only directory only costs tuning again next time
+          }
+        }
+        return;
+      } catch (const std::invalid_argument&) {
+      }
+    }
+    std::lock_guard<std::mutex> lock(table_mutex_);
+    set_defaults();
+  }
+
+private:
+  Autotuner() = default;
+
+  template<typename T>
+  static void run(Operation operation, Variant variant, const Matrix<T>& left, const Matrix<T>& right) {
+    volatile size_t sink = 0;
+    switch (operation) {
+      case Operation::Dot:
+        sink = (variant == Variant::Sequential ? seq_dot(left, left) : dot(left, left)).GetLength();
+        break;
+      case Operation::Det:
+        sink = (variant == Variant::Sequential ? seq_det(left) : det(left)) != T(0);
+        break;
+      case Operation::SleSolution:
+        sink = (variant == Variant::Sequential ? seq_sle_solution(left, right)
+                : variant == Variant::Parallel ? sle_solution(left, right)
+                : fast_sle_solution(left, right)).GetLength();
+        break;
+      case Operation::Rank:
+        sink = variant == Variant::Sequential ? seq_rank(left)
+               : variant == Variant::Parallel ? rank(left)
+               : fast_rank(left);
+        break;
+    }
+    (void)sink;
+  }
+
+  bool empty() const {
+    std::lock_guard<std::mutex> lock(table_mutex_);
+    return table_.empty();
+  }
+
+  // called with table_mutex_ held
+  void set_defaults() {
+    table_ = defaults();
+    threads_ = detail::hardware_threads();
+  }
+
+  std::mutex tuning_mutex_;           // serializes loading on first use
+  mutable std::mutex table_mutex_;
+  std::map<Operation, std::vector<Crossover>> table_;
+  size_t threads_ = 0;
+};
+
+
+// Single entry points that route to the kernel the table picks for the shape.
+// Exact (integer) determinants and ranks always take det/rank, the others would round.
+
+template<typename T>
+Matrix<T> auto_dot(const Matrix<T>& left, const Matrix<T>& right) {
+  size_t size = detail::tuning_size(left.GetLength(), left.GetWidth(), right.GetWidth());
+  if (Autotuner::instance().choose(Operation::Dot, size) == Variant::Sequential) {
+    return seq_dot(left, right);
+  }
+  return dot(left, right);
+}
+
+template<typename T>
+T auto_det(const Matrix<T>& matrix) {
+  if constexpr (!detail::is_exact_v<T>) {
+    if (Autotuner::instance().choose(Operation::Det, matrix.GetLength()) == Variant::Sequential) {
+      return seq_det(matrix);
+    }
+  }
+  return det(matrix);
+}
+
+template<typename T>
+Matrix<T> auto_sle_solution(const Matrix<T>& left_part, const Matrix<T>& right_part) {
+  size_t size = detail::tuning_size(left_part.GetLength(), left_part.GetWidth(),
+                                    left_part.GetWidth() + right_part.GetWidth());
+  switch (Autotuner::instance().choose(Operation::SleSolution, size)) {
+    case Variant::Sequential:
+      return seq_sle_solution(left_part, right_part);
+    case Variant::Fast:
+      return fast_sle_solution(left_part, right_part);
+    default:
+      return sle_solution(left_part, right_part);
+  }
+}
+
+template<typename T>
+size_t auto_rank(const Matrix<T>& matrix) {
+  if constexpr (!detail::is_exact_v<T>) {
+    size_t size = detail::tuning_size(matrix.GetLength(), matrix.GetWidth(),
+                                      std::min(matrix.GetLength(), matrix.GetWidth()));
+    switch (Autotuner::instance().choose(Operation::Rank, size)) {
+      case Variant::Sequential:
+        return seq_rank(matrix);
+      case Variant::Fast:
+        return fast_rank(matrix);
+      default:
+        break;
+    }
+  }
+  return rank(matrix);
+}
@@ -0,0 +1,803 @@
+#pragma once
+
+#include<algorithm>
+#include<cmath>
+#include<functional>
+#include<type_traits>
+
+#include "matrix.h"
+
+// A rectangular window into a row-major buffer: `stride` elements between the starts
+// of two consecutive rows. MatrixView<const T> is the read-only version. Only row-major
+// matrices convert to a view, storage_view() reads a column-major one as its transpose.
+template<typename T>
+class MatrixView {
+public:
+  using value_type = std::remove_const_t<T>;
+
+  MatrixView(T* data, size_t length, size_t width, size_t stride)
+      : data_(data), length_(length), width_(width), stride_(stride) {}
+
+  MatrixView(Matrix<value_type>& matrix)
+      : MatrixView(matrix.data(), matrix.GetLength(), matrix.GetWidth(), row_major_stride(matrix)) {}
+
+  template<typename U = T, typename = std::enable_if_t<std::is_const_v<U>>>
+  MatrixView(const Matrix<value_type>& matrix)
+      : MatrixView(matrix.data(), matrix.GetLength(), matrix.GetWidth(), row_major_stride(matrix)) {}
+
+  template<typename U = T, typename = std::enable_if_t<std::is_const_v<U>>>
+  MatrixView(const MatrixView<value_type>& other)
+      : MatrixView(other.data(), other.GetLength(), other.GetWidth(), other.stride()) {}
+
+  size_t GetLength() const {
+    return length_;
+  }
+
+  size_t GetWidth() const {
+    return width_;
+  }
+
+  std::pair<size_t, size_t> GetShape() const {
+    return std::make_pair(length_, width_);
+  }
+
+  size_t stride() const {
+    return stride_;
+  }
+
+  T* data() const {
+    return data_;
+  }
+
+  T* row(const size_t& row) const {
+    return data_ + row * stride_;
+  }
+
+  T& operator()(const size_t& row, const size_t& column) const {
+    return data_[row * stride_ + column];
+  }
+
+  // `length` x `width` block starting at (row, column)
+  MatrixView block(const size_t& row, const size_t& column, const size_t& length, const size_t& width) const {
+    if (row + length > length_ || column + width > width_) {
+      throw std::out_of_range("Specified block doesn't exist");
+    }
+    return MatrixView(data_ + row * stride_ + column, length, width, stride_);
+  }
+
+  Matrix<value_type> to_matrix() const {
+    Matrix<value_type> res(length_, width_);
+    for (size_t i = 0; i < length_; ++i) {
+      std::copy_n(row(i), width_, res.data() + i * width_);
+    }
+    return res;
+  }
+
+private:
+  static size_t row_major_stride(const Matrix<value_type>& matrix) {
+    if (matrix.layout() != Layout::RowMajor) {
+      throw std::invalid_argument("A column-major matrix can't be viewed by rows");
+    }
+    return matrix.GetWidth();
+  }
+
+  T* data_;
+  size_t length_;
+  size_t width_;
+  size_t stride_;
+};
+
+// the buffer of `matrix` read by rows: the matrix itself, or its transpose if it is column-major
+template<typename T>
+MatrixView<T> storage_view(Matrix<T>& matrix) {
+  bool rows = matrix.layout() == Layout::RowMajor;
+  size_t length = rows ? matrix.GetLength() : matrix.GetWidth();
+  size_t width = rows ? matrix.GetWidth() : matrix.GetLength();
+  return MatrixView<T>(matrix.data(), length, width, width);
+}
+
+template<typename T>
+MatrixView<const T> storage_view(const Matrix<T>& matrix) {
+  bool rows = matrix.layout() == Layout::RowMajor;
+  size_t length = rows ? matrix.GetLength() : matrix.GetWidth();
+  size_t width = rows ? matrix.GetWidth() : matrix.GetLength();
+  return MatrixView<const T>(matrix.data(), length, width, width);
+}
+
+
+enum class Side { Left, Right };
+enum class Triangle { Upper, Lower };
+enum class Diagonal { NonUnit, Unit };
+enum class Transpose { NoTrans, Trans };
+
+
+namespace detail {
+
+// keeps a parameter out of template argument deduction, so that
+// Matrix<T> and MatrixView<T> convert to MatrixView<const T> implicitly
+template<typename T>
+struct non_deduced {
+  using type = T;
+};
+
+template<typename T>
+using non_deduced_t = typename non_deduced<T>::type;
+
+// block sizes of the kernels: a gemm_depth x gemm_columns panel of B stays in cache
+// while the rows of C are updated, triangular solves go by triangular_block rows
+constexpr size_t gemm_depth = 128;
+constexpr size_t gemm_columns = 256;
+constexpr size_t triangular_block = 64;
+// below this number of multiply-adds a second thread costs more than it gives;
+// vector kernels do a single pass over memory, so they need much longer inputs
+constexpr size_t parallel_threshold = 1 << 15;
+constexpr size_t vector_parallel_threshold = 1 << 18;
+
+// runs f(first, last) on parts of [0, count), on two threads if `work` is large enough
+template<typename F>
+void split_range(size_t count, size_t work, F f, size_t threshold = parallel_threshold) {
+  size_t n_threads = work >= threshold && count > 1 ? 2 : 1;
+  if (n_threads == 1) {
+    f(size_t(0), count);
+    return;
+  }
+  std::vector<std::thread> threads;
+  ProfilePhase spawn(ProfilePhase::Spawn, n_threads);
+  for (size_t k = 0; k < n_threads; ++k) {
+    threads.emplace_back([&] (size_t id) {
+      pin_partition(id, n_threads);
+      f(id * count / n_threads, (id + 1) * count / n_threads);
+    }, k);
+  }
+  spawn.finish();
+  join_threads(threads);
+}
+
+// combines the results of f(first, last) over parts of [0, count) in order
+template<typename T, typename F, typename Combine>
+T split_reduce(size_t count, F f, Combine combine) {
+  size_t n_threads = count >= vector_parallel_threshold ? 2 : 1;
+  if (n_threads == 1) {
+    return f(size_t(0), count);
+  }
+  std::vector<T> partial(n_threads);
+  std::vector<std::thread> threads;
+  ProfilePhase spawn(ProfilePhase::Spawn, n_threads);
+  for (size_t k = 0; k < n_threads; ++k) {
+    threads.emplace_back([&] (size_t id) {
+      pin_partition(id, n_threads);
+      partial[id] = f(id * count / n_threads, (id + 1) * count / n_threads);
+    }, k);
+  }
+  spawn.finish();
+  join_threads(threads);
+  T res = partial[0];
+  for (size_t k = 1; k < n_threads; ++k) {
+    res = combine(res, partial[k]);
+  }
+  return res;
+}
+
+// C[first:last, first_column:last_column] += alpha * A[first:last, :] * B[:, first_column:last_column],
+// the inner loop runs along a row of B and C
+template<typename T>
+void gemm_kernel(size_t first, size_t last, size_t first_column, size_t last_column, const T& alpha,
+                 MatrixView<const T> a, MatrixView<const T> b, MatrixView<T> c) {
+  size_t depth = a.GetWidth();
+  for (size_t jj = first_column; jj < last_column; jj += gemm_columns) {
+    size_t j_end = std::min(last_column, jj + gemm_columns);
+    for (size_t pp = 0; pp < depth; pp += gemm_depth) {
+      size_t p_end = std::min(depth, pp + gemm_depth);
+      for (size_t i = first; i < last; ++i) {
+        T* c_row = c.row(i);
+        const T* a_row = a.row(i);
+        for (size_t p = pp; p < p_end; ++p) {
+          T factor = alpha * a_row[p];
+          if (factor == static_cast<T>(0)) {
+            continue;
+          }
+          const T* b_row = b.row(p);
+          for (size_t j = jj; j < j_end; ++j) {
+            c_row[j] += factor * b_row[j];
+          }
+        }
+      }
+    }
+  }
+}
+
+// a single row or column as a pointer and the distance between its elements
+template<typename T>
+struct StridedVector {
+  T* data;
+  size_t size;
+  size_t increment;
+
+  T& operator[](const size_t& i) const {
+    return data[i * increment];
+  }
+};
+
+template<typename T>
+StridedVector<T> as_vector(MatrixView<T> vector) {
+  if (vector.GetLength() != 1 && vector.GetWidth() != 1) {
+    throw std::length_error("Expected a single row or column");
+  }
+  if (vector.GetWidth() == 1) {
+    return {vector.data(), vector.GetLength(), vector.stride()};
+  }
+  return {vector.data(), vector.GetWidth(), 1};
+}
+
+// sum of x[i] * y[i] over [first, last); four independent sums
+// let the compiler keep them in SIMD registers for contiguous inputs
+template<typename T>
+T dot_kernel(size_t first, size_t last, StridedVector<const T> x, StridedVector<const T> y) {
+  T sum[4] = {};
+  size_t i = first;
+  if (x.increment == 1 && y.increment == 1) {
+    for (; i + 4 <= last; i += 4) {
+      sum[0] += x.data[i] * y.data[i];
+      sum[1] += x.data[i + 1] * y.data[i + 1];
+      sum[2] += x.data[i + 2] * y.data[i + 2];
+      sum[3] += x.data[i + 3] * y.data[i + 3];
+    }
+  }
+  for (; i < last; ++i) {
+    sum[0] += x[i] * y[i];
+  }
+  return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+}
+
+// y[first:last] += alpha * x[first:last]
+template<typename T>
+void axpy_kernel(size_t first, size_t last, const T& alpha, StridedVector<const T> x, StridedVector<T> y) {
+  if (x.increment == 1 && y.increment == 1) {
+    for (size_t i = first; i < last; ++i) {
+      y.data[i] += alpha * x.data[i];
+    }
+    return;
+  }
+  for (size_t i = first; i < last; ++i) {
+    y[i] += alpha * x[i];
+  }
+}
+
+template<typename T>
+void scale(MatrixView<T> matrix, const T& alpha) {
+  if (alpha == static_cast<T>(1)) {
+    return;
+  }
+  for (size_t i = 0; i < matrix.GetLength(); ++i) {
+    T* row = matrix.row(i);
+    for (size_t j = 0; j < matrix.GetWidth(); ++j) {
+      // beta = 0 overwrites, so that garbage in C (NaN included) is ignored
+      row[j] = alpha == static_cast<T>(0) ? static_cast<T>(0) : alpha * row[j];
+    }
+  }
+}
+
+template<typename T>
+void check_triangular(MatrixView<const T> a, size_t size) {
+  if (a.GetLength() != a.GetWidth()) {
+    throw std::length_error("The matrix isn't a square");
+  }
+  if (a.GetLength() != size) {
+    throw std::length_error("Shapes do not match");
+  }
+}
+
+// only the `triangle` half of a square C
+template<typename T>
+void scale_triangle(MatrixView<T> c, Triangle triangle, const T& beta) {
+  if (beta == static_cast<T>(1)) {
+    return;
+  }
+  size_t n = c.GetLength();
+  for (size_t i = 0; i < n; ++i) {
+    T* row = c.row(i);
+    for (size_t j = triangle == Triangle::Upper ? i : 0; j < (triangle == Triangle::Upper ? n : i + 1); ++j) {
+      row[j] = beta == static_cast<T>(0) ? static_cast<T>(0) : beta * row[j];
+    }
+  }
+}
+
+// copies the `triangle` half of a square matrix to the other one
+template<typename T>
+void mirror(MatrixView<T> c, Triangle triangle) {
+  for (size_t i = 0; i < c.GetLength(); ++i) {
+    for (size_t j = 0; j < i; ++j) {
+      if (triangle == Triangle::Upper) {
+        c(i, j) = c(j, i);
+      } else {
+        c(j, i) = c(i, j);
+      }
+    }
+  }
+}
+
+// C[i, j] += alpha * (op(A) op(B)^T)[i, j] for the (i, j) of the tile [i0, i1) x [j0, j1) in `triangle`.
+// With Transpose::Trans that is the sum of A[p, i] * B[p, j] over the rows p, so the inner loop
+// runs along a row of B and of C; otherwise it is a dot product of rows i of A and j of B
+template<typename T>
+void syrk_tile(Triangle triangle, Transpose trans, const T& alpha, MatrixView<const T> a, MatrixView<const T> b,
+               MatrixView<T> c, size_t i0, size_t i1, size_t j0, size_t j1) {
+  for (size_t i = i0; i < i1; ++i) {
+    size_t first = triangle == Triangle::Upper ? std::max(i, j0) : j0;
+    size_t last = triangle == Triangle::Upper ? j1 : std::min(i + 1, j1);
+    if (first >= last) {
+      continue;
+    }
+    T* c_row = c.row(i);
+    if (trans == Transpose::Trans) {
+      for (size_t p = 0; p < a.GetLength(); ++p) {
+        T factor = alpha * a.row(p)[i];
+        if (factor == static_cast<T>(0)) {
+          continue;
+        }
+        const T* b_row = b.row(p);
+        for (size_t j = first; j < last; ++j) {
+          c_row[j] += factor * b_row[j];
+        }
+      }
+    } else {
+      size_t depth = a.GetWidth();
+      for (size_t j = first; j < last; ++j) {
+        c_row[j] += alpha * dot_kernel<T>(0, depth, {a.row(i), depth, 1}, {b.row(j), depth, 1});
+      }
+    }
+  }
+}
+
+// C = alpha * (op(A) op(B)^T [+ op(B) op(A)^T]) + beta * C on the `triangle` half of C,
+// tile by tile; the tiles don't overlap, so they are split between the threads
+template<typename T>
+void symmetric_update(Triangle triangle, Transpose trans, const T& alpha, MatrixView<const T> a,
+                      MatrixView<const T> b, const T& beta, MatrixView<T> c, bool both) {
+  size_t n = trans == Transpose::Trans ? a.GetWidth() : a.GetLength();
+  size_t depth = trans == Transpose::Trans ? a.GetLength() : a.GetWidth();
+  if (c.GetLength() != n || c.GetWidth() != n || b.GetLength() != a.GetLength() || b.GetWidth() != a.GetWidth()) {
+    throw std::length_error("Shapes do not match");
+  }
+  scale_triangle(c, triangle, beta);
+  size_t nb = triangular_block;
+  std::vector<std::pair<size_t, size_t>> tiles;
+  for (size_t i = 0; i < n; i += nb) {
+    for (size_t j = triangle == Triangle::Upper ? i : 0; j < (triangle == Triangle::Upper ? n : i + 1); j += nb) {
+      tiles.emplace_back(i, j);
+    }
+  }
+  split_range(tiles.size(), n * n * depth / 2 * (both ? 2 : 1), [&] (size_t first, size_t last) {
+    for (size_t t = first; t < last; ++t) {
+      auto tile = tiles[t];
+      size_t i1 = std::min(n, tile.first + nb);
+      size_t j1 = std::min(n, tile.second + nb);
+      syrk_tile(triangle, trans, alpha, a, b, c, tile.first, i1, tile.second, j1);
+      if (both) {
+        syrk_tile(triangle, trans, alpha, b, a, c, tile.first, i1, tile.second, j1);
+      }
+    }
+  });
+}
+
+// unblocked solves of a diagonal block, B is split by columns (Left) or rows (Right) by the caller
+
+template<typename T>
+void trsm_left_block(Triangle triangle, Diagonal diagonal, MatrixView<const T> a, MatrixView<T> b,
+                     size_t first, size_t last) {
+  size_t n = a.GetLength();
+  for (size_t step = 0; step < n; ++step) {
+    size_t i = triangle == Triangle::Lower ? step : n - 1 - step;
+    T* row = b.row(i);
+    const T* a_row = a.row(i);
+    size_t p_begin = triangle == Triangle::Lower ? 0 : i + 1;
+    size_t p_end = triangle == Triangle::Lower ? i : n;
+    for (size_t p = p_begin; p < p_end; ++p) {
+      T factor = a_row[p];
+      const T* solved = b.row(p);
+      for (size_t j = first; j < last; ++j) {
+        row[j] -= factor * solved[j];
+      }
+    }
+    if (diagonal == Diagonal::NonUnit) {
+      T pivot = a_row[i];
+      for (size_t j = first; j < last; ++j) {
+        row[j] /= pivot;
+      }
+    }
+  }
+}
+
+template<typename T>
+void trsm_right_block(Triangle triangle, Diagonal diagonal, MatrixView<const T> a, MatrixView<T> b,
+                      size_t first, size_t last) {
+  size_t n = a.GetLength();
+  for (size_t i = first; i < last; ++i) {
+    T* row = b.row(i);
+    // x A = b: x_j is final once the columns before (Upper) or after (Lower) it are done
+    for (size_t step = 0; step < n; ++step) {
+      size_t j = triangle == Triangle::Upper ? step : n - 1 - step;
+      if (diagonal == Diagonal::NonUnit) {
+        row[j] /= a(j, j);
+      }
+      T value = row[j];
+      const T* a_row = a.row(j);
+      size_t l_begin = triangle == Triangle::Upper ? j + 1 : 0;
+      size_t l_end = triangle == Triangle::Upper ? n : j;
+      for (size_t l = l_begin; l < l_end; ++l) {
+        row[l] -= value * a_row[l];
+      }
+    }
+  }
+}
+
+template<typename T>
+void trmm_left_block(Triangle triangle, Diagonal diagonal, MatrixView<const T> a, MatrixView<T> b,
+                     size_t first, size_t last) {
+  size_t n = a.GetLength();
+  for (size_t step = 0; step < n; ++step) {
+    // row i of the product needs rows on its side of the diagonal, which are still intact
+    size_t i = triangle == Triangle::Upper ? step : n - 1 - step;
+    T* row = b.row(i);
+    const T* a_row = a.row(i);
+    if (diagonal == Diagonal::NonUnit) {
+      T pivot = a_row[i];
+      for (size_t j = first; j < last; ++j) {
+        row[j] *= pivot;
+      }
+    }
+    size_t p_begin = triangle == Triangle::Upper ? i + 1 : 0;
+    size_t p_end = triangle == Triangle::Upper ? n : i;
+    for (size_t p = p_begin; p < p_end; ++p) {
+      T factor = a_row[p];
+      const T* other = b.row(p);
+      for (size_t j = first; j < last; ++j) {
+        row[j] += factor * other[j];
+      }
+    }
+  }
+}
+
+template<typename T>
+void trmm_right_block(Triangle triangle, Diagonal diagonal, MatrixView<const T> a, MatrixView<T> b,
+                      size_t first, size_t last) {
+  size_t n = a.GetLength();
+  for (size_t i = first; i < last; ++i) {
+    T* row = b.row(i);
+    for (size_t step = 0; step < n; ++step) {
+      size_t j = triangle == Triangle::Upper ? n - 1 - step : step;
+      T value = diagonal == Diagonal::NonUnit ? row[j] * a(j, j) : row[j];
+      size_t k_begin = triangle == Triangle::Upper ? 0 : j + 1;
+      size_t k_end = triangle == Triangle::Upper ? j : n;
+      for (size_t k = k_begin; k < k_end; ++k) {
+        value += row[k] * a(k, j);
+      }
+      row[j] = value;
+    }
+  }
+}
+
+}  // namespace detail
+
+
+// C = alpha * A * B + beta * C
+template<typename T>
+void gemm(const detail::non_deduced_t<T>& alpha, detail::non_deduced_t<MatrixView<const T>> a,
+          detail::non_deduced_t<MatrixView<const T>> b, const detail::non_deduced_t<T>& beta, MatrixView<T> c) {
+  if (a.GetWidth() != b.GetLength() || a.GetLength() != c.GetLength() || b.GetWidth() != c.GetWidth()) {
+    throw std::length_error("Shapes do not match");
+  }
+  size_t work = a.GetLength() * a.GetWidth() * b.GetWidth();
+  ProfileScope profile("gemm", 2 * work, (a.GetLength() * a.GetWidth() + b.GetLength() * b.GetWidth() +
+                                          2 * c.GetLength() * c.GetWidth()) * sizeof(T));
+  detail::scale(c, beta);
+  if (c.GetLength() > 1) {
+    detail::split_range(c.GetLength(), work, [&] (size_t first, size_t last) {
+      detail::gemm_kernel(first, last, 0, c.GetWidth(), alpha, a, b, c);
+    });
+  } else {
+    detail::split_range(c.GetWidth(), work, [&] (size_t first, size_t last) {
+      detail::gemm_kernel(0, c.GetLength(), first, last, alpha, a, b, c);
+    });
+  }
+}
+
+// Solves op(A) X = alpha B (Side::Left) or X op(A) = alpha B (Side::Right) for a triangular A,
+// X overwrites B. Only the `triangle` half of A is read; with Diagonal::Unit the diagonal
+// is taken to be ones. Zeros on the diagonal are not checked, as in BLAS.
+template<typename T>
+void trsm(Side side, Triangle triangle, Diagonal diagonal, detail::non_deduced_t<MatrixView<const T>> a,
+          MatrixView<T> b, const detail::non_deduced_t<T>& alpha = static_cast<T>(1)) {
+  detail::check_triangular(a, side == Side::Left ? b.GetLength() : b.GetWidth());
+  size_t n = a.GetLength();
+  ProfileScope profile("trsm", n * b.GetLength() * b.GetWidth(), (n * n / 2 + 2 * b.GetLength() * b.GetWidth()) * sizeof(T));
+  detail::scale(b, alpha);
+  size_t nb = detail::triangular_block;
+  bool forward = (side == Side::Left) == (triangle == Triangle::Lower);
+  for (size_t step = 0; step < n; step += nb) {
+    size_t size = std::min(nb, n - step);
+    size_t k = forward ? step : n - step - size;
+    MatrixView<const T> diagonal_block = a.block(k, k, size, size);
+    // the block of X is solved, then the rest of B is updated with one GEMM
+    if (side == Side::Left) {
+      MatrixView<T> b_block = b.block(k, 0, size, b.GetWidth());
+      detail::split_range(b.GetWidth(), size * size * b.GetWidth() / 2, [&] (size_t first, size_t last) {
+        detail::trsm_left_block(triangle, diagonal, diagonal_block, b_block, first, last);
+      });
+      size_t rest_first = forward ? k + size : 0;
+      size_t rest = forward ? n - k - size : k;
+      if (rest > 0) {
+        gemm<T>(static_cast<T>(-1), a.block(rest_first, k, rest, size), b_block, static_cast<T>(1),
+                b.block(rest_first, 0, rest, b.GetWidth()));
+      }
+    } else {
+      MatrixView<T> b_block = b.block(0, k, b.GetLength(), size);
+      detail::split_range(b.GetLength(), size * size * b.GetLength() / 2, [&] (size_t first, size_t last) {
+        detail::trsm_right_block(triangle, diagonal, diagonal_block, b_block, first, last);
+      });
+      size_t rest_first = forward ? k + size : 0;
+      size_t rest = forward ? n - k - size : k;
+      if (rest > 0) {
+        gemm<T>(static_cast<T>(-1), b_block, a.block(k, rest_first, size, rest), static_cast<T>(1),
+                b.block(0, rest_first, b.GetLength(), rest));
+      }
+    }
+  }
+}
+
+// Solves A x = b for a triangular A, x overwrites the column `x`
+template<typename T>
+void trsv(Triangle triangle, Diagonal diagonal, detail::non_deduced_t<MatrixView<const T>> a, MatrixView<T> x) {
+  if (x.GetWidth() != 1) {
+    throw std::length_error("x has to be a column");
+  }
+  trsm<T>(Side::Left, triangle, diagonal, a, x);
+}
+
+// B = alpha * op(A) * B (Side::Left) or B = alpha * B * op(A) (Side::Right) for a triangular A
+template<typename T>
+void trmm(Side side, Triangle triangle, Diagonal diagonal, detail::non_deduced_t<MatrixView<const T>> a,
+          MatrixView<T> b, const detail::non_deduced_t<T>& alpha = static_cast<T>(1)) {
+  detail::check_triangular(a, side == Side::Left ? b.GetLength() : b.GetWidth());
+  size_t n = a.GetLength();
+  ProfileScope profile("trmm", n * b.GetLength() * b.GetWidth(), (n * n / 2 + 2 * b.GetLength() * b.GetWidth()) * sizeof(T));
+  detail::scale(b, alpha);
+  size_t nb = detail::triangular_block;
+  // a block of the product uses the untouched blocks on its side of the diagonal,
+  // so Upper (Left) / Lower (Right) goes forward and the other two backward
+  bool forward = (side == Side::Left) == (triangle == Triangle::Upper);
+  for (size_t step = 0; step < n; step += nb) {
+    size_t size = std::min(nb, n - step);
+    size_t k = forward ? step : n - step - size;
+    MatrixView<const T> diagonal_block = a.block(k, k, size, size);
+    size_t rest_first = forward ? k + size : 0;
+    size_t rest = forward ? n - k - size : k;
+    if (side == Side::Left) {
+      MatrixView<T> b_block = b.block(k, 0, size, b.GetWidth());
+      detail::split_range(b.GetWidth(), size * size * b.GetWidth() / 2, [&] (size_t first, size_t last) {
+        detail::trmm_left_block(triangle, diagonal, diagonal_block, b_block, first, last);
+      });
+      if (rest > 0) {
+        gemm<T>(static_cast<T>(1), a.block(k, rest_first, size, rest), b.block(rest_first, 0, rest, b.GetWidth()),
+                static_cast<T>(1), b_block);
+      }
+    } else {
+      MatrixView<T> b_block = b.block(0, k, b.GetLength(), size);
+      detail::split_range(b.GetLength(), size * size * b.GetLength() / 2, [&] (size_t first, size_t last) {
+        detail::trmm_right_block(triangle, diagonal, diagonal_block, b_block, first, last);
+      });
+      if (rest > 0) {
+        gemm<T>(static_cast<T>(1), b.block(0, rest_first, b.GetLength(), rest), a.block(rest_first, k, rest, size),
+                static_cast<T>(1), b_block);
+      }
+    }
+  }
+}
+
+// C = alpha * A A^T + beta * C (Transpose::NoTrans) or C = alpha * A^T A + beta * C (Transpose::Trans).
+// Only the `triangle` half of C is computed, about half of the flops of gemm; A is read in place
+template<typename T>
+void syrk(Triangle triangle, Transpose trans, const detail::non_deduced_t<T>& alpha,
+          detail::non_deduced_t<MatrixView<const T>> a, const detail::non_deduced_t<T>& beta, MatrixView<T> c) {
+  size_t n = c.GetLength();
+  size_t depth = trans == Transpose::Trans ? a.GetLength() : a.GetWidth();
+  ProfileScope profile("syrk", n * (n + 1) * depth, (n * depth + n * n) * sizeof(T));
+  detail::symmetric_update<T>(triangle, trans, alpha, a, a, beta, c, false);
+}
+
+// C = alpha * (A B^T + B A^T) + beta * C (Transpose::NoTrans) or alpha * (A^T B + B^T A) + beta * C
+// (Transpose::Trans), on the `triangle` half of C
+template<typename T>
+void syr2k(Triangle triangle, Transpose trans, const detail::non_deduced_t<T>& alpha,
+           detail::non_deduced_t<MatrixView<const T>> a, detail::non_deduced_t<MatrixView<const T>> b,
+           const detail::non_deduced_t<T>& beta, MatrixView<T> c) {
+  size_t n = c.GetLength();
+  size_t depth = trans == Transpose::Trans ? a.GetLength() : a.GetWidth();
+  ProfileScope profile("syr2k", 2 * n * (n + 1) * depth, (2 * n * depth + n * n) * sizeof(T));
+  detail::symmetric_update<T>(triangle, trans, alpha, a, b, beta, c, true);
+}
+
+
+template<typename T>
+void gemm(const detail::non_deduced_t<T>& alpha, const Matrix<T>& a, const Matrix<T>& b,
+          const detail::non_deduced_t<T>& beta, Matrix<T>& c) {
+  gemm<T>(alpha, a, b, beta, MatrixView<T>(c));
+}
+
+template<typename T>
+void trsm(Side side, Triangle triangle, Diagonal diagonal, const Matrix<T>& a, Matrix<T>& b,
+          const detail::non_deduced_t<T>& alpha = static_cast<T>(1)) {
+  trsm<T>(side, triangle, diagonal, a, MatrixView<T>(b), alpha);
+}
+
+template<typename T>
+void trsv(Triangle triangle, Diagonal diagonal, const Matrix<T>& a, Matrix<T>& x) {
+  trsv<T>(triangle, diagonal, a, MatrixView<T>(x));
+}
+
+template<typename T>
+void trmm(Side side, Triangle triangle, Diagonal diagonal, const Matrix<T>& a, Matrix<T>& b,
+          const detail::non_deduced_t<T>& alpha = static_cast<T>(1)) {
+  trmm<T>(side, triangle, diagonal, a, MatrixView<T>(b), alpha);
+}
+
+template<typename T>
+void syrk(Triangle triangle, Transpose trans, const detail::non_deduced_t<T>& alpha, const Matrix<T>& a,
+          const detail::non_deduced_t<T>& beta, Matrix<T>& c) {
+  syrk<T>(triangle, trans, alpha, a, beta, MatrixView<T>(c));
+}
+
+template<typename T>
+void syr2k(Triangle triangle, Transpose trans, const detail::non_deduced_t<T>& alpha, const Matrix<T>& a,
+           const Matrix<T>& b, const detail::non_deduced_t<T>& beta, Matrix<T>& c) {
+  syr2k<T>(triangle, trans, alpha, a, b, beta, MatrixView<T>(c));
+}
+
+// A^T A (Transpose::Trans) or A A^T (Transpose::NoTrans) without a transposed copy:
+// one triangle by syrk, then mirrored
+template<typename T>
+Matrix<T> gram(const Matrix<T>& a, Transpose trans = Transpose::Trans) {
+  size_t n = trans == Transpose::Trans ? a.GetWidth() : a.GetLength();
+  Matrix<T> res(n, n);
+  if (a.layout() == Layout::ColumnMajor) {
+    // the buffer is A^T by rows, and A^T A = (A^T) (A^T)^T
+    trans = trans == Transpose::Trans ? Transpose::NoTrans : Transpose::Trans;
+  }
+  syrk<T>(Triangle::Upper, trans, static_cast<T>(1), storage_view(a), static_cast<T>(0), res);
+  detail::mirror(MatrixView<T>(res), Triangle::Upper);
+  return res;
+}
+
+
+
+// BLAS-1 and BLAS-2: a vector is a MatrixView (or Matrix) with a single row or column
+
+// y = alpha * A * x + beta * y
+template<typename T>
+void gemv(const detail::non_deduced_t<T>& alpha, detail::non_deduced_t<MatrixView<const T>> a,
+          detail::non_deduced_t<MatrixView<const T>> x, const detail::non_deduced_t<T>& beta, MatrixView<T> y) {
+  auto x_vector = detail::as_vector(x);
+  auto y_vector = detail::as_vector(y);
+  if (x_vector.size != a.GetWidth() || y_vector.size != a.GetLength()) {
+    throw std::length_error("Shapes do not match");
+  }
+  size_t width = a.GetWidth();
+  ProfileScope profile("gemv", 2 * a.GetLength() * width, (a.GetLength() * width + width + 2 * a.GetLength()) * sizeof(T));
+  detail::split_range(a.GetLength(), a.GetLength() * width, [&] (size_t first, size_t last) {
+    for (size_t i = first; i < last; ++i) {
+      T value = alpha * detail::dot_kernel<T>(0, width, {a.row(i), width, 1}, x_vector);
+      y_vector[i] = beta == static_cast<T>(0) ? value : value + beta * y_vector[i];
+    }
+  });
+}
+
+// A += alpha * x * y^T
+template<typename T>
+void ger(const detail::non_deduced_t<T>& alpha, detail::non_deduced_t<MatrixView<const T>> x,
+         detail::non_deduced_t<MatrixView<const T>> y, MatrixView<T> a) {
+  auto x_vector = detail::as_vector(x);
+  auto y_vector = detail::as_vector(y);
+  if (x_vector.size != a.GetLength() || y_vector.size != a.GetWidth()) {
+    throw std::length_error("Shapes do not match");
+  }
+  size_t width = a.GetWidth();
+  detail::split_range(a.GetLength(), a.GetLength() * width, [&] (size_t first, size_t last) {
+    for (size_t i = first; i < last; ++i) {
+      detail::axpy_kernel<T>(0, width, alpha * x_vector[i], y_vector, {a.row(i), width, 1});
+    }
+  });
+}
+
+// y += alpha * x
+template<typename T>
+void axpy(const detail::non_deduced_t<T>& alpha, detail::non_deduced_t<MatrixView<const T>> x, MatrixView<T> y) {
+  auto x_vector = detail::as_vector(x);
+  auto y_vector = detail::as_vector(y);
+  if (x_vector.size != y_vector.size) {
+    throw std::length_error("Different shapes");
+  }
+  detail::split_range(x_vector.size, x_vector.size, [&] (size_t first, size_t last) {
+    detail::axpy_kernel<T>(first, last, alpha, x_vector, y_vector);
+  }, detail::vector_parallel_threshold);
+}
+
+// sum of x[i] * y[i], the vectors may be rows or columns
+template<typename T>
+T vdot(detail::non_deduced_t<MatrixView<const T>> x, detail::non_deduced_t<MatrixView<const T>> y) {
+  auto x_vector = detail::as_vector(x);
+  auto y_vector = detail::as_vector(y);
+  if (x_vector.size != y_vector.size) {
+    throw std::length_error("Different shapes");
+  }
+  return detail::split_reduce<T>(x_vector.size, [&] (size_t first, size_t last) {
+    return detail::dot_kernel<T>(first, last, x_vector, y_vector);
+  }, std::plus<T>());
+}
+
+// Euclidean norm, scaled by the largest element so that squares don't overflow
+template<typename T>
+T nrm2(detail::non_deduced_t<MatrixView<const T>> x) {
+  auto x_vector = detail::as_vector(x);
+  T largest = detail::split_reduce<T>(x_vector.size, [&] (size_t first, size_t last) {
+    T res = static_cast<T>(0);
+    for (size_t i = first; i < last; ++i) {
+      res = std::max(res, static_cast<T>(std::abs(x_vector[i])));
+    }
+    return res;
+  }, [] (const T& lhs, const T& rhs) { return std::max(lhs, rhs); });
+  if (largest == static_cast<T>(0)) {
+    return largest;
+  }
+  T sum = detail::split_reduce<T>(x_vector.size, [&] (size_t first, size_t last) {
+    T res = static_cast<T>(0);
+    for (size_t i = first; i < last; ++i) {
+      T scaled = x_vector[i] / largest;
+      res += scaled * scaled;
+    }
+    return res;
+  }, std::plus<T>());
+  return largest * static_cast<T>(std::sqrt(sum));
+}
+
+// x *= alpha
+template<typename T>
+void scal(const detail::non_deduced_t<T>& alpha, MatrixView<T> x) {
+  auto x_vector = detail::as_vector(x);
+  detail::split_range(x_vector.size, x_vector.size, [&] (size_t first, size_t last) {
+    for (size_t i = first; i < last; ++i) {
+      x_vector[i] *= alpha;
+    }
+  }, detail::vector_parallel_threshold);
+}
+
+
+template<typename T>
+void gemv(const detail::non_deduced_t<T>& alpha, const Matrix<T>& a, const Matrix<T>& x,
+          const detail::non_deduced_t<T>& beta, Matrix<T>& y) {
+  gemv<T>(alpha, a, x, beta, MatrixView<T>(y));
+}
+
+template<typename T>
+void ger(const detail::non_deduced_t<T>& alpha, const Matrix<T>& x, const Matrix<T>& y, Matrix<T>& a) {
+  ger<T>(alpha, x, y, MatrixView<T>(a));
+}
+
+template<typename T>
+void axpy(const detail::non_deduced_t<T>& alpha, const Matrix<T>& x, Matrix<T>& y) {
+  axpy<T>(alpha, x, MatrixView<T>(y));
+}
+
+template<typename T>
+T vdot(const Matrix<T>& x, const Matrix<T>& y) {
+  return vdot<T>(MatrixView<const T>(x), MatrixView<const T>(y));
+}
+
+template<typename T>
+T nrm2(const Matrix<T>& x) {
+  return nrm2<T>(MatrixView<const T>(x));
+}
+
+template<typename T>
+void scal(const detail::non_deduced_t<T>& alpha, Matrix<T>& x) {
+  scal<T>(alpha, MatrixView<T>(x));
+}
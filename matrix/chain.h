@@ -0,0 +1,192 @@
+#pragma once
+
+#include<exception>
+#include<initializer_list>
+#include<limits>
+#include<string>
+#include<thread>
+#include<vector>
+
+#include "functions.h"
+
+// Products of several matrices in the cheapest order. The order is found by the usual
+// dynamic programming over sub-chains, but the cost of a product is estimated the way
+// dot() runs it rather than by the flop count alone (see ChainCostModel).
+
+// The cost of dot() of an m x k and a k x n matrix, in multiply-adds
+struct ChainCostModel {
+  double element_cost = 2;              // per element of the operands and the result moved through memory
+  double call_cost = 2000;              // allocation of the result and setup of one product
+  double thread_cost = 40000;           // starting and joining the threads of a parallel kernel
+  size_t max_intermediate_bytes = 0;    // orders with a larger intermediate are avoided, 0 is no limit
+
+  double product_cost(size_t m, size_t k, size_t n) const {
+    double flops = static_cast<double>(m) * k * n;
+    // the innermost loop of the kernel dot() picks: over k for vdot and gemv, over n otherwise;
+    // short loops don't pay for their setup
+    size_t inner;
+    bool parallel;
+    if (n == 1) {
+      inner = k;
+      parallel = m == 1 ? k >= detail::vector_parallel_threshold : m * k >= detail::parallel_threshold;
+    } else {
+      inner = n;
+      parallel = m * k * n >= detail::parallel_threshold && (m > 1 || n > 1);
+    }
+    double compute = flops * (1 + 4.0 / static_cast<double>(inner)) / (parallel ? 2 : 1);
+    double memory = element_cost * static_cast<double>(m * k + k * n + m * n);
+    return compute + memory + call_cost + (parallel ? thread_cost : 0);
+  }
+};
+
+namespace detail {
+
+// sub-products at depth below this run their two halves on two threads
+constexpr size_t chain_parallel_depth = 2;
+
+struct ChainPlan {
+  std::vector<std::vector<size_t>> split;  // the product of i..j is (i..split[i][j]) (split[i][j] + 1..j)
+  double cost;
+};
+
+// dims[i] x dims[i + 1] is the shape of the i-th matrix
+inline ChainPlan plan_chain(const std::vector<size_t>& dims, const ChainCostModel& model, size_t element_size) {
+  size_t n = dims.size() - 1;
+  ChainPlan plan{ std::vector<std::vector<size_t>>(n, std::vector<size_t>(n, 0)), 0 };
+  std::vector<std::vector<double>> cost(n, std::vector<double>(n, 0));
+  for (size_t count = 2; count <= n; ++count) {
+    for (size_t i = 0; i + count <= n; ++i) {
+      size_t j = i + count - 1;
+      cost[i][j] = std::numeric_limits<double>::infinity();
+      bool intermediate = count < n;
+      if (intermediate && model.max_intermediate_bytes != 0 &&
+          dims[i] * dims[j + 1] * element_size > model.max_intermediate_bytes) {
+        continue;
+      }
+      for (size_t k = i; k < j; ++k) {
+        double c = cost[i][k] + cost[k + 1][j] + model.product_cost(dims[i], dims[k + 1], dims[j + 1]);
+        if (c < cost[i][j]) {
+          cost[i][j] = c;
+          plan.split[i][j] = k;
+        }
+      }
+    }
+  }
+  plan.cost = cost[0][n - 1];
+  if (plan.cost == std::numeric_limits<double>::infinity()) {
+    // no order fits into the limit, take the cheapest one
+    ChainCostModel unlimited = model;
+    unlimited.max_intermediate_bytes = 0;
+    return plan_chain(dims, unlimited, element_size);
+  }
+  return plan;
+}
+
+inline std::string chain_order(const ChainPlan& plan, size_t i, size_t j) {
+  if (i == j) {
+    return std::to_string(i);
+  }
+  size_t k = plan.split[i][j];
+  return "(" + chain_order(plan, i, k) + " " + chain_order(plan, k + 1, j) + ")";
+}
+
+template<typename T>
+std::vector<size_t> chain_dims(const std::vector<const Matrix<T>*>& matrices) {
+  if (matrices.empty()) {
+    throw std::invalid_argument("Nothing to multiply");
+  }
+  std::vector<size_t> dims = {matrices[0]->GetLength()};
+  for (size_t i = 0; i < matrices.size(); ++i) {
+    if (i > 0 && matrices[i - 1]->GetWidth() != matrices[i]->GetLength()) {
+      throw std::length_error("Left width (" + std::to_string(matrices[i - 1]->GetWidth()) + ") and right length (" +
+                                               std::to_string(matrices[i]->GetLength()) + ") are not equal");
+    }
+    dims.push_back(matrices[i]->GetWidth());
+  }
+  return dims;
+}
+
+// the product of matrices i..j, i < j
+template<typename T>
+Matrix<T> multiply_chain(const std::vector<const Matrix<T>*>& matrices, const ChainPlan& plan,
+                         size_t i, size_t j, size_t depth) {
+  size_t k = plan.split[i][j];
+  Matrix<T> left, right;
+  if (i < k && k + 1 < j && depth < chain_parallel_depth) {
+    // both halves are products of their own, they don't depend on each other
+    std::exception_ptr error;
+    std::vector<std::thread> threads;
+    ProfilePhase spawn(ProfilePhase::Spawn, 1);
+    threads.emplace_back([&] {
+      try {
+        left = multiply_chain(matrices, plan, i, k, depth + 1);
+      } catch (...) {
+        error = std::current_exception();
+      }
+    });
+    spawn.finish();
+    try {
+      right = multiply_chain(matrices, plan, k + 1, j, depth + 1);
+    } catch (...) {
+      // the thread still writes to `left`, and a joinable one must not be destroyed
+      join_threads(threads);
+      throw;
+    }
+    join_threads(threads);
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  } else {
+    if (i < k) {
+      left = multiply_chain(matrices, plan, i, k, depth + 1);
+    }
+    if (k + 1 < j) {
+      right = multiply_chain(matrices, plan, k + 1, j, depth + 1);
+    }
+  }
+  return dot(i < k ? left : *matrices[i], k + 1 < j ? right : *matrices[j]);
+}
+
+}  // namespace detail
+
+
+// The order multi_dot would take for matrices of these shapes, e.g. "((0 1) 2)"
+inline std::string multi_dot_order(const std::vector<std::pair<size_t, size_t>>& shapes,
+                                   const ChainCostModel& model = ChainCostModel(), size_t element_size = sizeof(double)) {
+  if (shapes.empty()) {
+    throw std::invalid_argument("Nothing to multiply");
+  }
+  std::vector<size_t> dims = {shapes[0].first};
+  for (size_t i = 0; i < shapes.size(); ++i) {
+    if (i > 0 && shapes[i - 1].second != shapes[i].first) {
+      throw std::length_error("Shapes do not match");
+    }
+    dims.push_back(shapes[i].second);
+  }
+  return detail::chain_order(detail::plan_chain(dims, model, element_size), 0, shapes.size() - 1);
+}
+
+template<typename T>
+Matrix<T> multi_dot(const std::vector<const Matrix<T>*>& matrices, const ChainCostModel& model = ChainCostModel()) {
+  std::vector<size_t> dims = detail::chain_dims(matrices);
+  if (matrices.size() == 1) {
+    return *matrices[0];
+  }
+  ProfileScope profile("multi_dot", 0, 0);
+  return detail::multiply_chain(matrices, detail::plan_chain(dims, model, sizeof(T)), 0, matrices.size() - 1, 0);
+}
+
+// multi_dot({A, B, C}); the list holds copies, multi_dot(A, B, C) doesn't
+template<typename T>
+Matrix<T> multi_dot(std::initializer_list<Matrix<T>> matrices, const ChainCostModel& model = ChainCostModel()) {
+  std::vector<const Matrix<T>*> pointers;
+  for (const Matrix<T>& matrix : matrices) {
+    pointers.push_back(&matrix);
+  }
+  return multi_dot(pointers, model);
+}
+
+template<typename T, typename... Matrices>
+Matrix<T> multi_dot(const Matrix<T>& first, const Matrix<T>& second, const Matrices&... rest) {
+  return multi_dot(std::vector<const Matrix<T>*>{&first, &second, &rest...});
+}
@@ -0,0 +1,801 @@
+#pragma once
+
+#include<cerrno>
+#include<functional>
+#include<type_traits>
+
+#if defined(__unix__)
+#include<sys/socket.h>
+#include<sys/types.h>
+#include<sys/wait.h>
+#include<unistd.h>
+#endif
+
+#include "functions.h"
+
+// Minimal message passing interface of the distributed layer. Backends implement
+// point-to-point send/recv; the collectives below are built on top of them and may
+// be overridden by a backend that has native ones (e.g. MPI_Bcast).
+// Every call blocks until its message is sent/received, sizes must match on both sides.
+class Communicator {
+public:
+  virtual ~Communicator() = default;
+
+  virtual size_t rank() const = 0;
+  virtual size_t size() const = 0;
+  virtual void send(size_t destination, const void* data, size_t bytes) = 0;
+  virtual void recv(size_t source, void* data, size_t bytes) = 0;
+
+  virtual void broadcast(void* data, size_t bytes, size_t root, const std::vector<size_t>& group) {
+    if (rank() == root) {
+      for (size_t member : group) {
+        if (member != root) {
+          send(member, data, bytes);
+        }
+      }
+    } else {
+      recv(root, data, bytes);
+    }
+  }
+
+  void broadcast(void* data, size_t bytes, size_t root) {
+    broadcast(data, bytes, root, everyone());
+  }
+
+  virtual void barrier() {
+    char token = 0;
+    allreduce(&token, 1, [] (char a, char) { return a; });
+  }
+
+  // the lower rank sends first, so a pair of processes never blocks on each other
+  void exchange(size_t peer, const void* out, void* in, size_t bytes) {
+    if (rank() < peer) {
+      send(peer, out, bytes);
+      recv(peer, in, bytes);
+    } else {
+      recv(peer, in, bytes);
+      send(peer, out, bytes);
+    }
+  }
+
+  // reduces in group order on the first member, so every member gets a bitwise identical result
+  template<typename T, typename Op>
+  void allreduce(T* data, size_t count, Op op, const std::vector<size_t>& group) {
+    static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values can be sent");
+    size_t bytes = count * sizeof(T);
+    size_t root = group.front();
+    if (rank() == root) {
+      std::vector<T> other(count);
+      for (size_t source : group) {
+        if (source == root) {
+          continue;
+        }
+        recv(source, other.data(), bytes);
+        for (size_t i = 0; i < count; ++i) {
+          data[i] = op(data[i], other[i]);
+        }
+      }
+    } else {
+      send(root, data, bytes);
+    }
+    broadcast(data, bytes, root, group);
+  }
+
+  template<typename T, typename Op>
+  void allreduce(T* data, size_t count, Op op) {
+    allreduce(data, count, op, everyone());
+  }
+
+private:
+  std::vector<size_t> everyone() const {
+    std::vector<size_t> group(size());
+    for (size_t i = 0; i < size(); ++i) {
+      group[i] = i;
+    }
+    return group;
+  }
+};
+
+
+#if defined(__unix__)
+
+// Stand-in transport for a single Linux host: one process per rank, a Unix
+// domain socket pair between every two of them.
+class LocalCommunicator : public Communicator {
+public:
+  LocalCommunicator(size_t rank, std::vector<int> sockets)
+      : rank_(rank), sockets_(std::move(sockets)) {
+  }
+
+  size_t rank() const override {
+    return rank_;
+  }
+
+  size_t size() const override {
+    return sockets_.size();
+  }
+
+  void send(size_t destination, const void* data, size_t bytes) override {
+    const char* first = static_cast<const char*>(data);
+    while (bytes > 0) {
+      ssize_t written = ::write(sockets_.at(destination), first, bytes);
+      if (written < 0 && errno == EINTR) {
+        continue;
+      }
+      if (written <= 0) {
+        throw std::runtime_error("Send to rank " + std::to_string(destination) + " failed");
+      }
+      first += written;
+      bytes -= static_cast<size_t>(written);
+    }
+  }
+
+  void recv(size_t source, void* data, size_t bytes) override {
+    char* first = static_cast<char*>(data);
+    while (bytes > 0) {
+      ssize_t read = ::read(sockets_.at(source), first, bytes);
+      if (read < 0 && errno == EINTR) {
+        continue;
+      }
+      if (read <= 0) {
+        throw std::runtime_error("Receive from rank " + std::to_string(source) + " failed");
+      }
+      first += read;
+      bytes -= static_cast<size_t>(read);
+    }
+  }
+
+private:
+  size_t rank_;
+  std::vector<int> sockets_;  // sockets_[rank_] is unused
+};
+
+// Forks n_processes processes, runs body(comm) in each of them and waits for all.
+// Returns true if every process finished without an exception.
+inline bool run_local_processes(size_t n_processes, const std::function<void(Communicator&)>& body) {
+  std::vector<std::vector<int>> sockets(n_processes, std::vector<int>(n_processes, -1));
+  for (size_t i = 0; i < n_processes; ++i) {
+    for (size_t j = i + 1; j < n_processes; ++j) {
+      int pair[2];
+      if (::socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+        throw std::runtime_error("socketpair failed");
+      }
+      sockets[i][j] = pair[0];
+      sockets[j][i] = pair[1];
+    }
+  }
+  std::vector<pid_t> children;
+  for (size_t id = 0; id < n_processes; ++id) {
+    pid_t pid = ::fork();
+    if (pid < 0) {
+      throw std::runtime_error("fork failed");
+    }
+    if (pid == 0) {
+      for (size_t i = 0; i < n_processes; ++i) {
+        for (size_t j = 0; j < n_processes; ++j) {
+          if (i != id && sockets[i][j] != -1) {
+            ::close(sockets[i][j]);
+          }
+        }
+      }
+      int status = 0;
+      try {
+        LocalCommunicator comm(id, sockets[id]);
+        body(comm);
+      } catch (...) {
+        status = 1;
+      }
+      ::_exit(status);
+    }
+    children.push_back(pid);
+  }
+  for (const auto& row : sockets) {
+    for (int socket : row) {
+      if (socket != -1) {
+        ::close(socket);
+      }
+    }
+  }
+  bool success = true;
+  for (pid_t child : children) {
+    int status = 0;
+    while (::waitpid(child, &status, 0) < 0 && errno == EINTR);
+    success = success && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  }
+  return success;
+}
+
+#endif
+
+
+struct ProcessGrid {
+  size_t rows;
+  size_t columns;
+};
+
+// number of indices out of [0, n) owned by process p of P, blocks of nb dealt cyclically
+inline size_t block_cyclic_count(size_t n, size_t nb, size_t p, size_t P) {
+  size_t blocks = n / nb;
+  size_t count = (blocks / P) * nb;
+  if (p < blocks % P) {
+    count += nb;
+  } else if (p == blocks % P) {
+    count += n % nb;
+  }
+  return count;
+}
+
+
+// Matrix distributed over a rows x columns process grid in a 2D block-cyclic layout:
+// block (I, J) of block_size x block_size lives on process (I % rows, J % columns).
+// Rank r is process (r / columns, r % columns).
+template<typename T>
+class DistributedMatrix {
+  static_assert(std::is_trivially_copyable_v<T>, "Elements are sent as raw bytes");
+
+public:
+  DistributedMatrix(Communicator& comm, const ProcessGrid& grid,
+                    const size_t& h, const size_t& w, const size_t& block_size)
+      : comm_(&comm), grid_(grid), length_(h), width_(w), block_size_(block_size) {
+    if (grid.rows * grid.columns != comm.size()) {
+      throw std::invalid_argument("Process grid doesn't match the number of processes");
+    }
+    if (block_size == 0) {
+      throw std::invalid_argument("Block size must be positive");
+    }
+    process_row_ = comm.rank() / grid.columns;
+    process_column_ = comm.rank() % grid.columns;
+    local_ = Matrix<T>(block_cyclic_count(h, block_size, process_row_, grid.rows),
+                       block_cyclic_count(w, block_size, process_column_, grid.columns));
+  }
+
+  // `matrix` is only read on `root`, the other processes may pass an empty one
+  static DistributedMatrix scatter(Communicator& comm, const ProcessGrid& grid, const Matrix<T>& matrix,
+                                   const size_t& block_size, size_t root = 0) {
+    size_t shape[2] = { matrix.GetLength(), matrix.GetWidth() };
+    comm.broadcast(shape, sizeof(shape), root);
+    DistributedMatrix res(comm, grid, shape[0], shape[1], block_size);
+    if (comm.rank() == root) {
+      for (size_t r = 0; r < comm.size(); ++r) {
+        size_t p = r / grid.columns;
+        size_t q = r % grid.columns;
+        Matrix<T> part(block_cyclic_count(shape[0], block_size, p, grid.rows),
+                       block_cyclic_count(shape[1], block_size, q, grid.columns));
+        for (size_t i = 0; i < part.GetLength(); ++i) {
+          for (size_t j = 0; j < part.GetWidth(); ++j) {
+            part(i, j) = matrix(res.to_global(i, p, grid.rows), res.to_global(j, q, grid.columns));
+          }
+        }
+        if (r == root) {
+          res.local_ = std::move(part);
+        } else {
+          comm.send(r, part.data(), part.GetLength() * part.GetWidth() * sizeof(T));
+        }
+      }
+    } else {
+      comm.recv(root, res.local_.data(), res.local_.GetLength() * res.local_.GetWidth() * sizeof(T));
+    }
+    return res;
+  }
+
+  // the whole matrix on `root`, an empty one everywhere else
+  Matrix<T> gather(size_t root = 0) const {
+    if (comm_->rank() != root) {
+      comm_->send(root, local_.data(), local_.GetLength() * local_.GetWidth() * sizeof(T));
+      return Matrix<T>();
+    }
+    Matrix<T> res(length_, width_);
+    for (size_t r = 0; r < comm_->size(); ++r) {
+      size_t p = r / grid_.columns;
+      size_t q = r % grid_.columns;
+      Matrix<T> part(block_cyclic_count(length_, block_size_, p, grid_.rows),
+                     block_cyclic_count(width_, block_size_, q, grid_.columns));
+      if (r == root) {
+        part = local_;
+      } else {
+        comm_->recv(r, part.data(), part.GetLength() * part.GetWidth() * sizeof(T));
+      }
+      for (size_t i = 0; i < part.GetLength(); ++i) {
+        for (size_t j = 0; j < part.GetWidth(); ++j) {
+          res(to_global(i, p, grid_.rows), to_global(j, q, grid_.columns)) = part(i, j);
+        }
+      }
+    }
+    return res;
+  }
+
+
+  size_t GetWidth() const {
+    return width_;
+  }
+
+  size_t GetLength() const {
+    return length_;
+  }
+
+  std::pair<size_t, size_t> GetShape() const {
+    return std::make_pair(length_, width_);
+  }
+
+  size_t block_size() const {
+    return block_size_;
+  }
+
+  const ProcessGrid& grid() const {
+    return grid_;
+  }
+
+  Communicator& communicator() const {
+    return *comm_;
+  }
+
+  size_t process_row() const {
+    return process_row_;
+  }
+
+  size_t process_column() const {
+    return process_column_;
+  }
+
+  Matrix<T>& local() {
+    return local_;
+  }
+
+  const Matrix<T>& local() const {
+    return local_;
+  }
+
+
+  size_t row_owner(const size_t& row) const {
+    return (row / block_size_) % grid_.rows;
+  }
+
+  size_t column_owner(const size_t& column) const {
+    return (column / block_size_) % grid_.columns;
+  }
+
+  // local index of a global row / column on its owner
+  size_t local_row(const size_t& row) const {
+    return (row / (block_size_ * grid_.rows)) * block_size_ + row % block_size_;
+  }
+
+  size_t local_column(const size_t& column) const {
+    return (column / (block_size_ * grid_.columns)) * block_size_ + column % block_size_;
+  }
+
+  size_t global_row(const size_t& local_row) const {
+    return to_global(local_row, process_row_, grid_.rows);
+  }
+
+  size_t global_column(const size_t& local_column) const {
+    return to_global(local_column, process_column_, grid_.columns);
+  }
+
+  size_t rank_of(const size_t& p, const size_t& q) const {
+    return p * grid_.columns + q;
+  }
+
+  std::vector<size_t> row_group() const {
+    std::vector<size_t> group;
+    for (size_t q = 0; q < grid_.columns; ++q) {
+      group.push_back(rank_of(process_row_, q));
+    }
+    return group;
+  }
+
+  std::vector<size_t> column_group() const {
+    std::vector<size_t> group;
+    for (size_t p = 0; p < grid_.rows; ++p) {
+      group.push_back(rank_of(p, process_column_));
+    }
+    return group;
+  }
+
+
+  // full global row / column on every process (collective)
+  std::vector<T> replicated_row(const size_t& row) const {
+    std::vector<T> values(width_, static_cast<T>(0));
+    if (row_owner(row) == process_row_) {
+      for (size_t j = 0; j < local_.GetWidth(); ++j) {
+        values[global_column(j)] = local_(local_row(row), j);
+      }
+    }
+    comm_->allreduce(values.data(), width_, std::plus<T>());
+    return values;
+  }
+
+  std::vector<T> replicated_column(const size_t& column) const {
+    std::vector<T> values(length_, static_cast<T>(0));
+    if (column_owner(column) == process_column_) {
+      for (size_t i = 0; i < local_.GetLength(); ++i) {
+        values[global_row(i)] = local_(i, local_column(column));
+      }
+    }
+    comm_->allreduce(values.data(), length_, std::plus<T>());
+    return values;
+  }
+
+  // swaps two global rows (collective)
+  void swap_rows(const size_t& row1, const size_t& row2) {
+    if (row1 == row2) {
+      return;
+    }
+    size_t owner1 = row_owner(row1);
+    size_t owner2 = row_owner(row2);
+    if (owner1 == owner2) {
+      if (owner1 == process_row_) {
+        local_.row_switching(local_row(row1), local_row(row2));
+      }
+      return;
+    }
+    if (owner1 != process_row_ && owner2 != process_row_) {
+      return;
+    }
+    size_t mine = owner1 == process_row_ ? row1 : row2;
+    size_t peer = rank_of(owner1 == process_row_ ? owner2 : owner1, process_column_);
+    Matrix<T> outgoing = local_.get_row(local_row(mine));
+    Matrix<T> incoming(1, local_.GetWidth());
+    comm_->exchange(peer, outgoing.data(), incoming.data(), local_.GetWidth() * sizeof(T));
+    for (size_t j = 0; j < local_.GetWidth(); ++j) {
+      local_(local_row(mine), j) = incoming(0, j);
+    }
+  }
+
+private:
+  size_t to_global(size_t local, size_t process, size_t processes) const {
+    return ((local / block_size_) * processes + process) * block_size_ + local % block_size_;
+  }
+
+  Communicator* comm_;
+  ProcessGrid grid_;
+  size_t length_;
+  size_t width_;
+  size_t block_size_;
+  size_t process_row_;
+  size_t process_column_;
+  Matrix<T> local_;
+};
+
+
+namespace detail {
+
+template<typename T>
+void check_same_distribution(const DistributedMatrix<T>& matrix1, const DistributedMatrix<T>& matrix2) {
+  if (&matrix1.communicator() != &matrix2.communicator() || matrix1.block_size() != matrix2.block_size() ||
+      matrix1.grid().rows != matrix2.grid().rows || matrix1.grid().columns != matrix2.grid().columns) {
+    throw std::invalid_argument("Matrices are distributed differently");
+  }
+}
+
+// local rows [first_row, last_row) of block column `block`, copied by its process column and
+// broadcast along every process row (collective)
+template<typename T>
+Matrix<T> row_broadcast_panel(const DistributedMatrix<T>& matrix, size_t block, size_t first_row, size_t last_row) {
+  size_t nb = matrix.block_size();
+  size_t width = std::min(nb, matrix.GetWidth() - block * nb);
+  Matrix<T> res(last_row - first_row, width);
+  size_t owner = block % matrix.grid().columns;
+  if (matrix.process_column() == owner) {
+    size_t column = matrix.local_column(block * nb);
+    for (size_t i = first_row; i < last_row; ++i) {
+      for (size_t j = 0; j < width; ++j) {
+        res(i - first_row, j) = matrix.local()(i, column + j);
+      }
+    }
+  }
+  matrix.communicator().broadcast(res.data(), res.GetLength() * width * sizeof(T),
+                                  matrix.rank_of(matrix.process_row(), owner), matrix.row_group());
+  return res;
+}
+
+}  // namespace detail
+
+
+// SUMMA: for every block column of `left` / block row of `right` the owners broadcast
+// their panels along process rows / columns, then every process updates its local block.
+template<typename T>
+DistributedMatrix<T> dot(const DistributedMatrix<T>& left, const DistributedMatrix<T>& right) {
+  if (left.GetWidth() != right.GetLength()) {
+    throw std::length_error("Left width (" + std::to_string(left.GetWidth()) + ") and right length (" +
+                                             std::to_string(right.GetLength()) + ") are not equal");
+  }
+  detail::check_same_distribution(left, right);
+  Communicator& comm = left.communicator();
+  const ProcessGrid& grid = left.grid();
+  size_t nb = left.block_size();
+  size_t inner = left.GetWidth();
+  DistributedMatrix<T> res(comm, grid, left.GetLength(), right.GetWidth(), nb);
+  size_t local_length = left.local().GetLength();
+  size_t local_width = right.local().GetWidth();
+  std::vector<size_t> row_group = left.row_group();
+  std::vector<size_t> column_group = left.column_group();
+  for (size_t block = 0; block * nb < inner; ++block) {
+    size_t panel = std::min(nb, inner - block * nb);
+    Matrix<T> left_panel(local_length, panel);
+    Matrix<T> right_panel(panel, local_width);
+    size_t left_owner = block % grid.columns;
+    if (left.process_column() == left_owner) {
+      size_t first = left.local_column(block * nb);
+      for (size_t i = 0; i < local_length; ++i) {
+        for (size_t j = 0; j < panel; ++j) {
+          left_panel(i, j) = left.local()(i, first + j);
+        }
+      }
+    }
+    comm.broadcast(left_panel.data(), local_length * panel * sizeof(T),
+                   left.rank_of(left.process_row(), left_owner), row_group);
+    size_t right_owner = block % grid.rows;
+    if (right.process_row() == right_owner) {
+      size_t first = right.local_row(block * nb);
+      for (size_t i = 0; i < panel; ++i) {
+        for (size_t j = 0; j < local_width; ++j) {
+          right_panel(i, j) = right.local()(first + i, j);
+        }
+      }
+    }
+    comm.broadcast(right_panel.data(), panel * local_width * sizeof(T),
+                   right.rank_of(right_owner, right.process_column()), column_group);
+    res.local() += dot(left_panel, right_panel);
+  }
+  return res;
+}
+
+
+// every process sends each peer the (row, column, value) triples that land there
+template<typename T>
+DistributedMatrix<T> transposed(const DistributedMatrix<T>& matrix) {
+  Communicator& comm = matrix.communicator();
+  DistributedMatrix<T> res(comm, matrix.grid(), matrix.GetWidth(), matrix.GetLength(), matrix.block_size());
+  std::vector<std::vector<size_t>> positions(comm.size());
+  std::vector<std::vector<T>> values(comm.size());
+  for (size_t i = 0; i < matrix.local().GetLength(); ++i) {
+    for (size_t j = 0; j < matrix.local().GetWidth(); ++j) {
+      size_t row = matrix.global_column(j);
+      size_t column = matrix.global_row(i);
+      size_t destination = res.rank_of(res.row_owner(row), res.column_owner(column));
+      positions[destination].push_back(res.local_row(row));
+      positions[destination].push_back(res.local_column(column));
+      values[destination].push_back(matrix.local()(i, j));
+    }
+  }
+  auto place = [&] (const std::vector<size_t>& incoming_positions, const std::vector<T>& incoming_values) {
+    for (size_t k = 0; k < incoming_values.size(); ++k) {
+      res.local()(incoming_positions[2 * k], incoming_positions[2 * k + 1]) = incoming_values[k];
+    }
+  };
+  // pairs are processed in the same global order by everyone, which rules out a deadlock
+  for (size_t peer = 0; peer < comm.size(); ++peer) {
+    if (peer == comm.rank()) {
+      place(positions[peer], values[peer]);
+      continue;
+    }
+    size_t outgoing = values[peer].size();
+    size_t incoming = 0;
+    comm.exchange(peer, &outgoing, &incoming, sizeof(size_t));
+    std::vector<size_t> incoming_positions(2 * incoming);
+    std::vector<T> incoming_values(incoming);
+    if (comm.rank() < peer) {
+      comm.send(peer, positions[peer].data(), 2 * outgoing * sizeof(size_t));
+      comm.send(peer, values[peer].data(), outgoing * sizeof(T));
+      comm.recv(peer, incoming_positions.data(), 2 * incoming * sizeof(size_t));
+      comm.recv(peer, incoming_values.data(), incoming * sizeof(T));
+    } else {
+      comm.recv(peer, incoming_positions.data(), 2 * incoming * sizeof(size_t));
+      comm.recv(peer, incoming_values.data(), incoming * sizeof(T));
+      comm.send(peer, positions[peer].data(), 2 * outgoing * sizeof(size_t));
+      comm.send(peer, values[peer].data(), outgoing * sizeof(T));
+    }
+    place(incoming_positions, incoming_values);
+  }
+  return res;
+}
+
+
+// Right-looking blocked LU with partial pivoting in place (L below the diagonal, unit diagonal implied).
+// For every block column the process column owning it reduces the panel below the diagonal within
+// itself and factors it, then sends the pivots and each process row its rows of L along the process
+// rows. The row swaps are applied to the whole matrix, the owners of the block row solve for their
+// part of U and broadcast it down their process columns, and every process updates its part of the
+// trailing matrix with one local gemm, as in the SUMMA dot.
+// Row k was swapped with pivots[k]. Returns false on every process if the matrix is singular.
+template<typename T>
+bool lu_decompose(DistributedMatrix<T>& matrix, std::vector<size_t>& pivots) {
+  if (matrix.GetWidth() != matrix.GetLength()) {
+    throw std::length_error("The matrix isn't a square");
+  }
+  Communicator& comm = matrix.communicator();
+  const ProcessGrid& grid = matrix.grid();
+  Matrix<T>& local = matrix.local();
+  size_t n = matrix.GetLength();
+  size_t nb = matrix.block_size();
+  size_t local_length = local.GetLength();
+  size_t local_width = local.GetWidth();
+  std::vector<size_t> row_group = matrix.row_group();
+  std::vector<size_t> column_group = matrix.column_group();
+  pivots.resize(n);
+  for (size_t block = 0; block * nb < n; ++block) {
+    size_t first = block * nb;
+    size_t panel_width = std::min(nb, n - first);
+    size_t last = first + panel_width;
+    // the local rows / columns from a global index on are the ones after the count of those before it
+    size_t panel_row = block_cyclic_count(first, nb, matrix.process_row(), grid.rows);
+    size_t trailing_row = block_cyclic_count(last, nb, matrix.process_row(), grid.rows);
+    size_t trailing_column = block_cyclic_count(last, nb, matrix.process_column(), grid.columns);
+    size_t trailing_length = local_length - trailing_row;
+    size_t trailing_width = local_width - trailing_column;
+
+    // [singular, pivots of the panel columns]
+    std::vector<size_t> header(panel_width + 1, 0);
+    Matrix<T> panel;
+    size_t panel_owner = block % grid.columns;
+    if (matrix.process_column() == panel_owner) {
+      panel = Matrix<T>(n - first, panel_width);
+      size_t column = matrix.local_column(first);
+      for (size_t i = panel_row; i < local_length; ++i) {
+        for (size_t j = 0; j < panel_width; ++j) {
+          panel(matrix.global_row(i) - first, j) = local(i, column + j);
+        }
+      }
+      comm.allreduce(panel.data(), (n - first) * panel_width, std::plus<T>(), column_group);
+      for (size_t c = 0; c < panel_width; ++c) {
+        size_t pivot = c;
+        for (size_t r = c + 1; r < panel.GetLength(); ++r) {
+          if (std::abs(panel(r, c)) > std::abs(panel(pivot, c))) {
+            pivot = r;
+          }
+        }
+        if (panel(pivot, c) == static_cast<T>(0)) {
+          header[0] = 1;
+          break;
+        }
+        header[c + 1] = first + pivot;
+        if (pivot != c) {
+          panel.row_switching(pivot, c);
+        }
+        for (size_t r = c + 1; r < panel.GetLength(); ++r) {
+          T factor = panel(r, c) / panel(c, c);
+          panel(r, c) = factor;
+          for (size_t j = c + 1; j < panel_width; ++j) {
+            panel(r, j) -= factor * panel(c, j);
+          }
+        }
+      }
+    }
+    comm.broadcast(header.data(), header.size() * sizeof(size_t),
+                   matrix.rank_of(matrix.process_row(), panel_owner), row_group);
+    if (header[0] != 0) {
+      return false;
+    }
+    for (size_t k = first; k < last; ++k) {
+      pivots[k] = header[k - first + 1];
+      matrix.swap_rows(k, pivots[k]);
+    }
+    if (matrix.process_column() == panel_owner) {
+      size_t column = matrix.local_column(first);
+      for (size_t i = panel_row; i < local_length; ++i) {
+        for (size_t j = 0; j < panel_width; ++j) {
+          local(i, column + j) = panel(matrix.global_row(i) - first, j);
+        }
+      }
+    }
+    // this process row's rows of L11 / L21, L11 only on the owners of the block row
+    Matrix<T> l = detail::row_broadcast_panel(matrix, block, panel_row, local_length);
+
+    // U12 = L11^-1 A12 on the block row, sent down the process columns
+    Matrix<T> u(panel_width, trailing_width);
+    size_t u_owner = block % grid.rows;
+    if (matrix.process_row() == u_owner && trailing_width > 0) {
+      MatrixView<T> u_block = MatrixView<T>(local).block(matrix.local_row(first), trailing_column,
+                                                         panel_width, trailing_width);
+      trsm<T>(Side::Left, Triangle::Lower, Diagonal::Unit,
+              MatrixView<const T>(l).block(0, 0, panel_width, panel_width), u_block);
+      for (size_t i = 0; i < panel_width; ++i) {
+        std::copy_n(u_block.row(i), trailing_width, u.data() + i * trailing_width);
+      }
+    }
+    comm.broadcast(u.data(), panel_width * trailing_width * sizeof(T),
+                   matrix.rank_of(u_owner, matrix.process_column()), column_group);
+
+    // A22 -= L21 U12
+    if (trailing_length > 0 && trailing_width > 0) {
+      gemm<T>(static_cast<T>(-1),
+              MatrixView<const T>(l).block(trailing_row - panel_row, 0, trailing_length, panel_width), u,
+              static_cast<T>(1),
+              MatrixView<T>(local).block(trailing_row, trailing_column, trailing_length, trailing_width));
+    }
+  }
+  return true;
+}
+
+template<typename T>
+T det(const DistributedMatrix<T>& matrix) {
+  DistributedMatrix<T> lu = matrix;
+  std::vector<size_t> pivots;
+  if (!lu_decompose(lu, pivots)) {
+    return static_cast<T>(0);
+  }
+  T res = static_cast<T>(1);
+  for (size_t k = 0; k < lu.GetLength(); ++k) {
+    if (lu.row_owner(k) == lu.process_row() && lu.column_owner(k) == lu.process_column()) {
+      res *= lu.local()(lu.local_row(k), lu.local_column(k));
+    }
+  }
+  lu.communicator().allreduce(&res, 1, [] (const T& a, const T& b) { return a * b; });
+  for (size_t k = 0; k < lu.GetLength(); ++k) {
+    if (pivots[k] != k) {
+      res *= static_cast<T>(-1);
+    }
+  }
+  return res;
+}
+
+// returns a 0 x 0 matrix if there is no unique solution
+template<typename T>
+DistributedMatrix<T> sle_solution(const DistributedMatrix<T>& left_part, const DistributedMatrix<T>& right_part) {
+  if (left_part.GetLength() != right_part.GetLength()) {
+    throw std::length_error("Shapes do not match");
+  }
+  detail::check_same_distribution(left_part, right_part);
+  DistributedMatrix<T> lu = left_part;
+  std::vector<size_t> pivots;
+  if (!lu_decompose(lu, pivots)) {
+    return DistributedMatrix<T>(lu.communicator(), lu.grid(), 0, 0, lu.block_size());
+  }
+  DistributedMatrix<T> x = right_part;
+  Communicator& comm = x.communicator();
+  Matrix<T>& local = x.local();
+  size_t n = lu.GetLength();
+  size_t nb = lu.block_size();
+  size_t local_length = local.GetLength();
+  size_t local_width = local.GetWidth();
+  std::vector<size_t> column_group = x.column_group();
+  for (size_t k = 0; k < n; ++k) {
+    x.swap_rows(k, pivots[k]);
+  }
+  // the owners of a block row of x solve it with the diagonal block of `triangle`, whose rows
+  // start at `diagonal_row`, and broadcast it down their process columns
+  auto solve_block_row = [&] (size_t block, const Matrix<T>& triangle, size_t diagonal_row,
+                              Triangle shape, Diagonal diagonal) {
+    size_t first = block * nb;
+    size_t panel_width = std::min(nb, n - first);
+    Matrix<T> solved(panel_width, local_width);
+    size_t owner = block % x.grid().rows;
+    if (x.process_row() == owner && local_width > 0) {
+      MatrixView<T> rows = MatrixView<T>(local).block(x.local_row(first), 0, panel_width, local_width);
+      trsm<T>(Side::Left, shape, diagonal,
+              MatrixView<const T>(triangle).block(diagonal_row, 0, panel_width, panel_width), rows);
+      for (size_t i = 0; i < panel_width; ++i) {
+        std::copy_n(rows.row(i), local_width, solved.data() + i * local_width);
+      }
+    }
+    comm.broadcast(solved.data(), panel_width * local_width * sizeof(T),
+                   x.rank_of(owner, x.process_column()), column_group);
+    return solved;
+  };
+  size_t blocks = (n + nb - 1) / nb;
+  // L y = P b, one block row at a time: the rows below take the block's L21 times its solution
+  for (size_t block = 0; block < blocks; ++block) {
+    size_t panel_row = block_cyclic_count(block * nb, nb, x.process_row(), x.grid().rows);
+    size_t trailing_row = block_cyclic_count(std::min(n, (block + 1) * nb), nb, x.process_row(), x.grid().rows);
+    size_t trailing_length = local_length - trailing_row;
+    Matrix<T> l = detail::row_broadcast_panel(lu, block, panel_row, local_length);
+    Matrix<T> solved = solve_block_row(block, l, 0, Triangle::Lower, Diagonal::Unit);
+    if (trailing_length > 0 && local_width > 0) {
+      gemm<T>(static_cast<T>(-1), MatrixView<const T>(l).block(trailing_row - panel_row, 0, trailing_length,
+                                                              solved.GetLength()),
+              solved, static_cast<T>(1), MatrixView<T>(local).block(trailing_row, 0, trailing_length, local_width));
+    }
+  }
+  // U x = y the same way from the last block row up
+  for (size_t block = blocks; block-- > 0;) {
+    size_t panel_row = block_cyclic_count(block * nb, nb, x.process_row(), x.grid().rows);
+    size_t trailing_row = block_cyclic_count(std::min(n, (block + 1) * nb), nb, x.process_row(), x.grid().rows);
+    Matrix<T> u = detail::row_broadcast_panel(lu, block, 0, trailing_row);
+    Matrix<T> solved = solve_block_row(block, u, panel_row, Triangle::Upper, Diagonal::NonUnit);
+    if (panel_row > 0 && local_width > 0) {
+      gemm<T>(static_cast<T>(-1), MatrixView<const T>(u).block(0, 0, panel_row, solved.GetLength()),
+              solved, static_cast<T>(1), MatrixView<T>(local).block(0, 0, panel_row, local_width));
+    }
+  }
+  return x;
+}
@@ -0,0 +1,440 @@
+#pragma once
+
+#include<cmath>
+#include<cstdint>
+#include<limits>
+#include<random>
+#include<type_traits>
+
+#include "blas.h"
+
+// Exact determinant and rank of integer matrices.
+//
+// Fraction-free (Bareiss) elimination keeps every intermediate value a minor of the matrix,
+// so it needs no rationals, but the products of two minors have to fit in a machine word.
+// Larger inputs go through residues modulo several primes and the Chinese remainder theorem.
+
+namespace detail {
+
+template<typename T>
+constexpr bool is_exact_v = std::is_integral_v<T> && std::is_signed_v<T>;
+
+template<typename T>
+using exact_wide_t = std::conditional_t<(sizeof(T) < sizeof(long long)), long long, T>;
+
+// log2 of the Hadamard bound: no minor of `matrix` exceeds the product of the norms of its
+// non-zero rows (integer rows that aren't zero have norms of at least 1)
+template<typename T>
+double log2_hadamard_bound(const Matrix<T>& matrix) {
+  double res = 0;
+  for (size_t i = 0; i < matrix.GetLength(); ++i) {
+    long double norm = 0;
+    for (size_t j = 0; j < matrix.GetWidth(); ++j) {
+      long double value = static_cast<long double>(matrix(i, j));
+      norm += value * value;
+    }
+    if (norm > 0) {
+      res += 0.5 * static_cast<double>(std::log2(norm));
+    }
+  }
+  return res;
+}
+
+// Bareiss computes a * b - c * d of two minors, all of them bounded by the Hadamard bound
+template<typename T>
+bool bareiss_fits(double log2_bound) {
+  double wide_bits = std::numeric_limits<exact_wide_t<T>>::digits;
+  return log2_bound + 1 < std::numeric_limits<T>::digits && 2 * log2_bound + 2 < wide_bits;
+}
+
+// Bareiss elimination below (row, column): every entry to the right of the pivot column becomes
+// (pivot * a_ij - a_i,column * a_row,j) / previous, which divides exactly
+template<typename T>
+void bareiss_step(Matrix<T>& matrix, size_t row, size_t column, exact_wide_t<T> previous, size_t last_row) {
+  using W = exact_wide_t<T>;
+  size_t width = matrix.GetWidth();
+  W pivot = matrix(row, column);
+  const T* pivot_row = matrix.data() + row * width;
+  size_t rows = last_row - row - 1;
+  split_range(rows, rows * (width - column), [&] (size_t first, size_t last) {
+    for (size_t i = row + 1 + first; i < row + 1 + last; ++i) {
+      T* current = matrix.data() + i * width;
+      W factor = current[column];
+      for (size_t j = column + 1; j < width; ++j) {
+        current[j] = static_cast<T>((pivot * current[j] - factor * pivot_row[j]) / previous);
+      }
+      current[column] = static_cast<T>(0);
+    }
+  });
+}
+
+template<typename T>
+T bareiss_det_in_place(Matrix<T>& matrix) {
+  size_t n = matrix.GetLength();
+  exact_wide_t<T> previous = 1;
+  bool negative = false;
+  for (size_t k = 0; k < n; ++k) {
+    size_t pivot = k;
+    while (pivot < n && matrix(pivot, k) == static_cast<T>(0)) {
+      ++pivot;
+    }
+    if (pivot == n) {
+      return static_cast<T>(0);
+    }
+    if (pivot != k) {
+      matrix.row_switching(pivot, k);
+      negative = !negative;
+    }
+    bareiss_step(matrix, k, k, previous, n);
+    previous = matrix(k, k);
+  }
+  T res = n == 0 ? static_cast<T>(1) : matrix(n - 1, n - 1);
+  return negative ? -res : res;
+}
+
+template<typename T>
+size_t bareiss_rank_in_place(Matrix<T>& matrix) {
+  size_t length = matrix.GetLength();
+  exact_wide_t<T> previous = 1;
+  size_t row = 0;
+  for (size_t column = 0; column < matrix.GetWidth() && row < length; ++column) {
+    size_t pivot = row;
+    while (pivot < length && matrix(pivot, column) == static_cast<T>(0)) {
+      ++pivot;
+    }
+    if (pivot == length) {
+      continue;
+    }
+    if (pivot != row) {
+      matrix.row_switching(pivot, row);
+    }
+    bareiss_step(matrix, row, column, previous, length);
+    previous = matrix(row, column);
+    ++row;
+  }
+  return row;
+}
+
+
+// Primes below 2^26: a product of two residues is below 2^52 and stays exact in a double,
+// so the row updates are plain floating-point loops the compiler can vectorize.
+constexpr int64_t modular_prime_limit = int64_t(1) << 26;
+
+inline bool is_prime(int64_t n) {
+  if (n < 2) {
+    return false;
+  }
+  for (int64_t d = 2; d * d <= n; ++d) {
+    if (n % d == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// `count` distinct primes going down from `start`
+inline std::vector<int64_t> modular_primes(size_t count, int64_t start = modular_prime_limit - 1) {
+  std::vector<int64_t> res;
+  for (int64_t candidate = start | 1; res.size() < count; candidate -= 2) {
+    if (candidate < modular_prime_limit / 2) {
+      candidate = modular_prime_limit - 1;
+    }
+    if (is_prime(candidate) && std::find(res.begin(), res.end(), candidate) == res.end()) {
+      res.push_back(candidate);
+    }
+  }
+  return res;
+}
+
+inline int64_t modular_inverse(int64_t value, int64_t p) {
+  int64_t a = value;
+  int64_t b = p;
+  int64_t x = 1;
+  int64_t y = 0;
+  while (b != 0) {
+    int64_t q = a / b;
+    a -= q * b;
+    std::swap(a, b);
+    x -= q * y;
+    std::swap(x, y);
+  }
+  return (x % p + p) % p;
+}
+
+// r mod p for |r| < 2^53; the quotient estimate can be off by one, which the last step fixes
+inline double reduce(double r, double p, double inverse_p) {
+  r -= p * std::floor(r * inverse_p);
+  if (r < 0) {
+    r += p;
+  } else if (r >= p) {
+    r -= p;
+  }
+  return r;
+}
+
+// Gaussian elimination over Z/pZ, returns det(matrix) mod p (0 unless square and regular)
+template<typename T>
+int64_t modular_elimination(const Matrix<T>& matrix, int64_t p, size_t& rank) {
+  // a column-major buffer is A^T by rows, with the same det and rank
+  bool rows = matrix.layout() == Layout::RowMajor;
+  size_t length = rows ? matrix.GetLength() : matrix.GetWidth();
+  size_t width = rows ? matrix.GetWidth() : matrix.GetLength();
+  double p_value = static_cast<double>(p);
+  double inverse_p = 1.0 / p_value;
+  std::vector<double> residues(length * width);
+  for (size_t i = 0; i < length * width; ++i) {
+    int64_t value = static_cast<int64_t>(matrix.data()[i]) % p;
+    residues[i] = static_cast<double>(value < 0 ? value + p : value);
+  }
+  int64_t det = 1;
+  size_t row = 0;
+  for (size_t column = 0; column < width && row < length; ++column) {
+    size_t pivot = row;
+    while (pivot < length && residues[pivot * width + column] == 0) {
+      ++pivot;
+    }
+    if (pivot == length) {
+      det = 0;
+      continue;
+    }
+    if (pivot != row) {
+      std::swap_ranges(residues.begin() + pivot * width, residues.begin() + (pivot + 1) * width,
+                       residues.begin() + row * width);
+      det = (p - det) % p;
+    }
+    const double* pivot_row = residues.data() + row * width;
+    int64_t pivot_value = static_cast<int64_t>(pivot_row[column]);
+    det = det * pivot_value % p;
+    double pivot_inverse = static_cast<double>(modular_inverse(pivot_value, p));
+    for (size_t i = row + 1; i < length; ++i) {
+      double* current = residues.data() + i * width;
+      if (current[column] == 0) {
+        continue;
+      }
+      double factor = reduce(current[column] * pivot_inverse, p_value, inverse_p);
+      for (size_t j = column + 1; j < width; ++j) {
+        current[j] = reduce(current[j] - factor * pivot_row[j], p_value, inverse_p);
+      }
+      current[column] = 0;
+    }
+    ++row;
+  }
+  rank = row;
+  return length == width && row == length ? det : 0;
+}
+
+// number of primes whose product exceeds 2^bits
+inline size_t primes_for_bits(double bits) {
+  return static_cast<size_t>(std::ceil(bits / std::log2(static_cast<double>(modular_prime_limit / 2)))) + 1;
+}
+
+// runs modular_elimination for every prime, the primes are split between two threads
+template<typename T>
+void modular_eliminations(const Matrix<T>& matrix, const std::vector<int64_t>& primes,
+                          std::vector<int64_t>& dets, std::vector<size_t>& ranks) {
+  dets.resize(primes.size());
+  ranks.resize(primes.size());
+  size_t n_threads = primes.size() > 1 ? 2 : 1;
+  std::vector<std::thread> threads;
+  ProfilePhase spawn(ProfilePhase::Spawn, n_threads);
+  for (size_t k = 0; k < n_threads; ++k) {
+    threads.emplace_back([&] (size_t id) {
+      for (size_t i = id; i < primes.size(); i += n_threads) {
+        dets[i] = modular_elimination(matrix, primes[i], ranks[i]);
+      }
+    }, k);
+  }
+  spawn.finish();
+  join_threads(threads);
+}
+
+// The integer in (-M/2, M/2], M = product of the primes, with the given residues.
+// Garner's mixed radix digits are taken symmetric, so the sign comes out directly;
+// throws std::overflow_error if the value doesn't fit in T.
+template<typename T>
+T symmetric_crt(const std::vector<int64_t>& residues, const std::vector<int64_t>& primes) {
+  std::vector<int64_t> digits(primes.size());
+  for (size_t i = 0; i < primes.size(); ++i) {
+    int64_t p = primes[i];
+    int64_t known = 0;
+    int64_t radix = 1;
+    for (size_t j = 0; j < i; ++j) {
+      known = (known + (digits[j] % p + p) % p * radix) % p;
+      radix = radix * (primes[j] % p) % p;
+    }
+    int64_t digit = ((residues[i] - known) % p + p) % p * modular_inverse(radix, p) % p;
+    digits[i] = digit > p / 2 ? digit - p : digit;
+  }
+  long long res = 0;
+  for (size_t i = primes.size(); i-- > 0;) {
+    if (__builtin_mul_overflow(res, static_cast<long long>(primes[i]), &res) ||
+        __builtin_add_overflow(res, static_cast<long long>(digits[i]), &res)) {
+      throw std::overflow_error("The result doesn't fit in the matrix type");
+    }
+  }
+  if (res < static_cast<long long>(std::numeric_limits<T>::min()) ||
+      res > static_cast<long long>(std::numeric_limits<T>::max())) {
+    throw std::overflow_error("The result doesn't fit in the matrix type");
+  }
+  return static_cast<T>(res);
+}
+
+}  // namespace detail
+
+
+// Exact determinant of an integer matrix from its residues modulo enough primes to
+// cover twice the Hadamard bound. Throws std::overflow_error if it doesn't fit in T.
+template<typename T>
+T modular_det(const Matrix<T>& matrix) {
+  static_assert(std::is_integral_v<T>, "modular_det needs an integer matrix");
+  if (matrix.GetWidth() != matrix.GetLength()) {
+    throw std::length_error("The matrix isn't a square");
+  }
+  std::vector<int64_t> primes = detail::modular_primes(detail::primes_for_bits(detail::log2_hadamard_bound(matrix) + 1));
+  std::vector<int64_t> dets;
+  std::vector<size_t> ranks;
+  detail::modular_eliminations(matrix, primes, dets, ranks);
+  return detail::symmetric_crt<T>(dets, primes);
+}
+
+// Exact rank of an integer matrix. The rank modulo p only drops if p divides every maximal
+// non-zero minor; the primes are chosen at random and their product exceeds the Hadamard
+// bound, so at least one of them keeps the rank.
+template<typename T>
+size_t modular_rank(const Matrix<T>& matrix) {
+  static_assert(std::is_integral_v<T>, "modular_rank needs an integer matrix");
+  static std::random_device rd;
+  static std::mt19937 gen(rd());
+  std::uniform_int_distribution<int64_t> distrib(detail::modular_prime_limit / 2, detail::modular_prime_limit - 1);
+  std::vector<int64_t> primes = detail::modular_primes(detail::primes_for_bits(detail::log2_hadamard_bound(matrix)),
+                                                       distrib(gen));
+  std::vector<int64_t> dets;
+  std::vector<size_t> ranks;
+  detail::modular_eliminations(matrix, primes, dets, ranks);
+  return ranks.empty() ? 0 : *std::max_element(ranks.begin(), ranks.end());
+}
+
+// Used by det and rank for signed integer types: Bareiss in place when the Hadamard bound
+// guarantees no overflow, the modular algorithms otherwise.
+template<typename T>
+T exact_det_in_place(Matrix<T>& matrix) {
+  if (matrix.GetWidth() != matrix.GetLength()) {
+    throw std::length_error("The matrix isn't a square");
+  }
+  if (matrix.layout() == Layout::ColumnMajor) {
+    matrix.transpose_layout();
+  }
+  if (detail::bareiss_fits<T>(detail::log2_hadamard_bound(matrix))) {
+    return detail::bareiss_det_in_place(matrix);
+  }
+  return modular_det(matrix);
+}
+
+template<typename T>
+size_t exact_rank_in_place(Matrix<T>& matrix) {
+  if (matrix.layout() == Layout::ColumnMajor) {
+    matrix.transpose_layout();
+  }
+  if (detail::bareiss_fits<T>(detail::log2_hadamard_bound(matrix))) {
+    return detail::bareiss_rank_in_place(matrix);
+  }
+  return modular_rank(matrix);
+}
+
+// Adjugate of an integer matrix, so that dot(matrix, adjugate(matrix)) == det(matrix) * E.
+// Fraction-free Gauss-Jordan on [A | E] ends with [d E | d A^-1], d = +-det(A).
+// A singular matrix of rank n - 1 falls back to cofactors. Throws std::overflow_error
+// if the intermediate minors may not fit in T.
+template<typename T>
+Matrix<T> adjugate(const Matrix<T>& matrix) {
+  static_assert(detail::is_exact_v<T>, "adjugate needs a signed integer matrix");
+  using W = detail::exact_wide_t<T>;
+  size_t n = matrix.GetLength();
+  if (matrix.GetWidth() != n) {
+    throw std::length_error("The matrix isn't a square");
+  }
+  size_t width = 2 * n;
+  Matrix<T> sle(n, width);
+  Matrix<T> row_major_copy;
+  const Matrix<T>& rows = detail::row_major(matrix, row_major_copy);
+  for (size_t i = 0; i < n; ++i) {
+    std::copy_n(rows.data() + i * n, n, sle.data() + i * width);
+    sle(i, n + i) = static_cast<T>(1);
+  }
+  // the right half ends up holding minors of [A | E]
+  if (!detail::bareiss_fits<T>(detail::log2_hadamard_bound(sle))) {
+    throw std::overflow_error("Minors of the matrix may not fit in the matrix type");
+  }
+  Matrix<T> res(n, n);
+  if (n == 1) {
+    res(0, 0) = static_cast<T>(1);
+    return res;
+  }
+  W previous = 1;
+  bool negative = false;
+  bool singular = false;
+  for (size_t k = 0; k < n && !singular; ++k) {
+    size_t pivot = k;
+    while (pivot < n && sle(pivot, k) == static_cast<T>(0)) {
+      ++pivot;
+    }
+    if (pivot == n) {
+      singular = true;
+      break;
+    }
+    if (pivot != k) {
+      sle.row_switching(pivot, k);
+      negative = !negative;
+    }
+    W pivot_value = sle(k, k);
+    const T* pivot_row = sle.data() + k * width;
+    detail::split_range(n, n * width, [&] (size_t first, size_t last) {
+      for (size_t i = first; i < last; ++i) {
+        if (i == k) {
+          continue;
+        }
+        T* current = sle.data() + i * width;
+        W factor = current[k];
+        for (size_t j = 0; j < width; ++j) {
+          if (j != k) {
+            current[j] = static_cast<T>((pivot_value * current[j] - factor * pivot_row[j]) / previous);
+          }
+        }
+        current[k] = static_cast<T>(0);
+      }
+    });
+    previous = pivot_value;
+  }
+  if (!singular) {
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = 0; j < n; ++j) {
+        res(i, j) = negative ? -sle(i, n + j) : sle(i, n + j);
+      }
+    }
+    return res;
+  }
+  Matrix<T> copy = rows;
+  if (detail::bareiss_rank_in_place(copy) < n - 1) {
+    return res;  // all minors of order n - 1 are zero
+  }
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0; j < n; ++j) {
+      // adj(A)_ij = (-1)^(i+j) * det of A without row j and column i
+      Matrix<T> minor(n - 1, n - 1);
+      for (size_t r = 0, mr = 0; r < n; ++r) {
+        if (r == j) {
+          continue;
+        }
+        for (size_t c = 0, mc = 0; c < n; ++c) {
+          if (c != i) {
+            minor(mr, mc++) = matrix(r, c);
+          }
+        }
+        ++mr;
+      }
+      T value = detail::bareiss_det_in_place(minor);
+      res(i, j) = (i + j) % 2 == 0 ? value : -value;
+    }
+  }
+  return res;
+}
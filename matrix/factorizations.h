@@ -0,0 +1,787 @@
+#pragma once
+
+#include<cmath>
+#include<limits>
+#include<random>
+
+#include "functions.h"
+#include "reductions.h"
+
+namespace detail {
+
+// the 1-norm estimator usually stops after two or three steps
+constexpr size_t norm1_estimate_steps = 5;
+constexpr size_t power_iteration_steps = 100;
+constexpr double power_iteration_tolerance = 1e-6;
+
+// Estimates ||B||_1 of an n x n B from products with B and B^T only: Hager's method with
+// Higham's refinements, as in LAPACK's xLACON. With B = A^-1 the products are solves with
+// a factorization of A, O(n^2) each. The estimate is a lower bound, almost always within a
+// factor of 3 of the true norm
+template<typename T, typename Apply, typename ApplyTransposed>
+T norm1_estimate(size_t n, Apply apply, ApplyTransposed apply_transposed) {
+  ProfileScope profile("norm1_estimate", 0, 0);
+  if (n == 0) {
+    return static_cast<T>(0);
+  }
+  Matrix<T> x(n, 1);
+  for (size_t i = 0; i < n; ++i) {
+    x(i, 0) = static_cast<T>(1) / static_cast<T>(n);
+  }
+  T estimate = static_cast<T>(0);
+  Matrix<T> signs;
+  for (size_t step = 0; step < norm1_estimate_steps; ++step) {
+    Matrix<T> y = apply(x);
+    T y_norm = norm(y, Norm::One);
+    if (step > 0 && y_norm <= estimate) {
+      break;
+    }
+    estimate = y_norm;
+    Matrix<T> new_signs(n, 1);
+    for (size_t i = 0; i < n; ++i) {
+      new_signs(i, 0) = y(i, 0) < static_cast<T>(0) ? static_cast<T>(-1) : static_cast<T>(1);
+    }
+    if (step > 0 && new_signs == signs) {
+      break;
+    }
+    signs = std::move(new_signs);
+    // the gradient of ||Bx||_1: moving to the unit vector of its largest entry increases the estimate
+    Matrix<T> z = apply_transposed(signs);
+    size_t j = 0;
+    T z_x = static_cast<T>(0);
+    for (size_t i = 0; i < n; ++i) {
+      if (std::abs(z(i, 0)) > std::abs(z(j, 0))) {
+        j = i;
+      }
+      z_x += z(i, 0) * x(i, 0);
+    }
+    if (step > 0 && std::abs(z(j, 0)) <= z_x) {
+      break;
+    }
+    x = Matrix<T>(n, 1);
+    x(j, 0) = static_cast<T>(1);
+  }
+  // an alternating vector catches the matrices the iteration underestimates
+  for (size_t i = 0; i < n; ++i) {
+    T magnitude = static_cast<T>(1) + (n > 1 ? static_cast<T>(i) / static_cast<T>(n - 1) : static_cast<T>(0));
+    x(i, 0) = i % 2 == 0 ? magnitude : -magnitude;
+  }
+  T alternative = 2 * norm(apply(x), Norm::One) / static_cast<T>(3 * n);
+  return std::max(estimate, alternative);
+}
+
+// Estimates ||B||_2, the largest singular value of B (m x n), by power iteration on B^T B.
+// Every step is one product with B and one with B^T; the estimate grows to the norm from below
+template<typename T, typename Apply, typename ApplyTransposed>
+T norm2_estimate(size_t n, Apply apply, ApplyTransposed apply_transposed, size_t steps) {
+  ProfileScope profile("norm2_estimate", 0, 0);
+  // a fixed random start: reproducible, and not orthogonal to the top singular vector in practice
+  std::mt19937 generator(5489u);
+  std::uniform_real_distribution<double> distribution(0.5, 1.5);
+  Matrix<T> x(n, 1);
+  for (size_t i = 0; i < n; ++i) {
+    x(i, 0) = static_cast<T>(distribution(generator));
+  }
+  T estimate = static_cast<T>(0);
+  for (size_t step = 0; step < steps; ++step) {
+    T x_norm = norm(x);
+    if (x_norm == static_cast<T>(0)) {
+      break;  // x fell into the null space
+    }
+    Matrix<T> y = apply(static_cast<T>(1) / x_norm * x);
+    T previous = estimate;
+    estimate = norm(y);
+    if (step > 0 && std::abs(estimate - previous) <= static_cast<T>(power_iteration_tolerance) * estimate) {
+      break;
+    }
+    x = apply_transposed(y);
+  }
+  return estimate;
+}
+
+// L U + u v^T for the unit lower L and upper U packed in `lu`, Bennett's algorithm: step k
+// settles row k of U and column k of L and leaves a rank one update of the trailing factors
+// in u and v. Returns false if a pivot vanishes
+template<typename T>
+bool lu_rank_one(Matrix<T>& lu, std::vector<T>& u, std::vector<T>& v) {
+  size_t n = lu.GetLength();
+  T* data = lu.data();
+  for (size_t k = 0; k < n; ++k) {
+    T* row = data + k * n;
+    T pivot = row[k] + u[k] * v[k];
+    if (pivot == static_cast<T>(0)) {
+      return false;
+    }
+    T ratio = v[k] / pivot;
+    for (size_t j = k + 1; j < n; ++j) {
+      row[j] += u[k] * v[j];
+      v[j] -= ratio * row[j];
+    }
+    for (size_t i = k + 1; i < n; ++i) {
+      T& l = data[i * n + k];
+      T old = l;
+      l = (old * row[k] + u[i] * v[k]) / pivot;
+      u[i] -= u[k] * old;
+    }
+    row[k] = pivot;
+  }
+  return true;
+}
+
+}  // namespace detail
+
+// PA = LU with partial pivoting, L (unit diagonal) and U are packed into one matrix.
+// The factorization is done once, solve() can then be called for any right part.
+template<typename T>
+class LUDecomposition {
+public:
+  explicit LUDecomposition(const Matrix<T>& matrix) : lu_(matrix) {
+    if (matrix.GetWidth() != matrix.GetLength()) {
+      throw std::length_error("The matrix isn't a square");
+    }
+    lu_.set_layout(Layout::RowMajor);
+    column_norms_ = detail::line_sums<T>(matrix, false, [] (T value) { return std::abs(value); });
+    factorize();
+  }
+
+  size_t size() const {
+    return lu_.GetLength();
+  }
+
+  bool singular() const {
+    return singular_;
+  }
+
+  const Matrix<T>& factors() const {
+    return lu_;
+  }
+
+  // row i was swapped with pivots()[i] at step i
+  const std::vector<size_t>& pivots() const {
+    return pivots_;
+  }
+
+  T det() const {
+    if (singular_) {
+      return static_cast<T>(0);
+    }
+    T res = odd_swaps_ ? static_cast<T>(-1) : static_cast<T>(1);
+    for (size_t i = 0; i < size(); ++i) {
+      res *= lu_(i, i);
+    }
+    return res;
+  }
+
+  // returns a 0 x 0 matrix if the matrix is singular
+  Matrix<T> solve(const Matrix<T>& right_part) const {
+    if (right_part.GetLength() != size()) {
+      throw std::length_error("Shapes do not match");
+    }
+    if (singular_) {
+      return Matrix<T>(0, 0);
+    }
+    Matrix<T> x = right_part;
+    x.set_layout(Layout::RowMajor);
+    for (size_t i = 0; i < size(); ++i) {
+      if (pivots_[i] != i) {
+        x.row_switching(i, pivots_[i]);
+      }
+    }
+    trsm<T>(Side::Left, Triangle::Lower, Diagonal::Unit, lu_, x);
+    trsm<T>(Side::Left, Triangle::Upper, Diagonal::NonUnit, lu_, x);
+    return x;
+  }
+
+  // solves A^T x = right_part; returns a 0 x 0 matrix if the matrix is singular
+  Matrix<T> solve_transposed(const Matrix<T>& right_part) const {
+    if (right_part.GetLength() != size()) {
+      throw std::length_error("Shapes do not match");
+    }
+    if (singular_) {
+      return Matrix<T>(0, 0);
+    }
+    // x^T P^T L U = b^T, solved from the right: y U = b^T, then (P x)^T L = y
+    Matrix<T> y = transposed(right_part);
+    y.set_layout(Layout::RowMajor);
+    trsm<T>(Side::Right, Triangle::Upper, Diagonal::NonUnit, lu_, y);
+    trsm<T>(Side::Right, Triangle::Lower, Diagonal::Unit, lu_, y);
+    Matrix<T> x = transposed(y);
+    undo_swaps(x);
+    return x;
+  }
+
+  // Estimate of the 1-norm condition number ||A||_1 ||A^-1||_1 in O(n^2), infinity if singular
+  T cond_estimate() const {
+    if (singular_) {
+      return std::numeric_limits<T>::infinity();
+    }
+    return norm_one() * detail::norm1_estimate<T>(size(), [this] (const Matrix<T>& x) { return solve(x); },
+                                                [this] (const Matrix<T>& x) { return solve_transposed(x); });
+  }
+
+  // Borders A with a new last row and column in O(n^2) instead of a new O(n^3) factorization:
+  // `column` is (n + 1) x 1 with the new diagonal entry last, `row` is 1 x n. The new row is
+  // not pivoted, so a small last pivot loses accuracy: check cond_estimate() after a series of
+  // appends and refactor if it grows
+  void append(const Matrix<T>& column, const Matrix<T>& row) {
+    size_t n = size();
+    if (column.GetShape() != std::make_pair(n + 1, size_t(1)) || row.GetShape() != std::make_pair(size_t(1), n)) {
+      throw std::length_error("Shapes do not match");
+    }
+    if (singular_) {
+      throw std::invalid_argument("The factorization is singular");
+    }
+    // [P 0; 0 1] [A b; c^T d] = [L 0; m^T 1] [U w; 0 d - m^T w], L w = P b, m^T U = c^T.
+    // Appending to an empty factorization leaves w and m empty, the pivot is d
+    Matrix<T> w(n, 1);
+    Matrix<T> m(1, n);
+    if (n > 0) {
+      w = column.get_submatrix(0, n - 1, 0, 0);
+      w.set_layout(Layout::RowMajor);
+      for (size_t i = 0; i < n; ++i) {
+        if (pivots_[i] != i) {
+          w.row_switching(i, pivots_[i]);
+        }
+      }
+      trsm<T>(Side::Left, Triangle::Lower, Diagonal::Unit, lu_, w);
+      m = row;
+      m.set_layout(Layout::RowMajor);
+      trsm<T>(Side::Right, Triangle::Upper, Diagonal::NonUnit, lu_, m);
+    }
+    T pivot = column(n, 0);
+    for (size_t i = 0; i < n; ++i) {
+      pivot -= m(0, i) * w(i, 0);
+    }
+    Matrix<T> grown(n + 1, n + 1);
+    for (size_t i = 0; i < n; ++i) {
+      std::copy_n(lu_.data() + i * n, n, grown.data() + i * (n + 1));
+      grown(i, n) = w(i, 0);
+      grown(n, i) = m(0, i);
+    }
+    grown(n, n) = pivot;
+    bool exact_norms = column_norms_.size() == n;
+    lu_ = std::move(grown);
+    pivots_.push_back(n);
+    singular_ = pivot == static_cast<T>(0);
+    if (exact_norms) {
+      for (size_t i = 0; i < n; ++i) {
+        column_norms_[i] += std::abs(row(0, i));
+      }
+      column_norms_.push_back(norm(column, Norm::One));
+    } else if (!singular_) {
+      estimate_norm();
+    }
+  }
+
+  // A + x y^T for n x k x and y in O(n^2 k) instead of a new O(n^3) factorization: Bennett's
+  // algorithm, one column of x and y at a time. The pivots stay as they were, so a pivot that gets
+  // small loses accuracy and one that vanishes stops the update even if A + x y^T is regular.
+  // Returns false (and nothing changes) then, refactor instead. After an update ||A||_1 for
+  // cond_estimate() is estimated from the factors
+  bool update(const Matrix<T>& x, const Matrix<T>& y) {
+    size_t n = size();
+    if (x.GetLength() != n || y.GetShape() != x.GetShape()) {
+      throw std::length_error("Shapes do not match");
+    }
+    if (singular_) {
+      throw std::invalid_argument("The factorization is singular");
+    }
+    ProfileScope profile("lu_update", 0, 0);
+    // P (A + x y^T) = L U + (P x) y^T; a vanishing pivot may stop it halfway, so it works on a copy
+    Matrix<T> updated = lu_;
+    std::vector<T> u(n);
+    std::vector<T> v(n);
+    for (size_t j = 0; j < x.GetWidth(); ++j) {
+      for (size_t i = 0; i < n; ++i) {
+        u[i] = x(i, j);
+        v[i] = y(i, j);
+      }
+      for (size_t i = 0; i < n; ++i) {
+        std::swap(u[i], u[pivots_[i]]);
+      }
+      if (!detail::lu_rank_one(updated, u, v)) {
+        return false;
+      }
+    }
+    lu_ = std::move(updated);
+    column_norms_.clear();
+    estimate_norm();
+    return true;
+  }
+
+  // Estimate of the 2-norm condition number sigma_max / sigma_min by power iteration on A and
+  // on A^-1, O(n^2) per step; infinity if singular
+  T cond2_estimate(size_t steps = detail::power_iteration_steps) const {
+    if (singular_) {
+      return std::numeric_limits<T>::infinity();
+    }
+    T matrix_norm = detail::norm2_estimate<T>(size(), [this] (const Matrix<T>& x) { return multiply(x); },
+                                              [this] (const Matrix<T>& x) { return multiply_transposed(x); }, steps);
+    T inverse_norm = detail::norm2_estimate<T>(size(), [this] (const Matrix<T>& x) { return solve(x); },
+                                               [this] (const Matrix<T>& x) { return solve_transposed(x); }, steps);
+    return matrix_norm * inverse_norm;
+  }
+
+private:
+  // A x = P^T L U x
+  Matrix<T> multiply(const Matrix<T>& x) const {
+    Matrix<T> res = x;
+    res.set_layout(Layout::RowMajor);
+    trmm<T>(Side::Left, Triangle::Upper, Diagonal::NonUnit, lu_, res);
+    trmm<T>(Side::Left, Triangle::Lower, Diagonal::Unit, lu_, res);
+    undo_swaps(res);
+    return res;
+  }
+
+  // (A^T x)^T = (P x)^T L U
+  Matrix<T> multiply_transposed(const Matrix<T>& x) const {
+    Matrix<T> swapped = x;
+    swapped.set_layout(Layout::RowMajor);
+    for (size_t i = 0; i < size(); ++i) {
+      if (pivots_[i] != i) {
+        swapped.row_switching(i, pivots_[i]);
+      }
+    }
+    Matrix<T> res = transposed(swapped);
+    trmm<T>(Side::Right, Triangle::Lower, Diagonal::Unit, lu_, res);
+    trmm<T>(Side::Right, Triangle::Upper, Diagonal::NonUnit, lu_, res);
+    return transposed(res);
+  }
+
+  T norm_one() const {
+    if (column_norms_.size() != size()) {
+      return norm_one_;
+    }
+    T res = static_cast<T>(0);
+    for (T column_norm : column_norms_) {
+      res = std::max(res, column_norm);
+    }
+    return res;
+  }
+
+  void estimate_norm() {
+    norm_one_ = detail::norm1_estimate<T>(size(), [this] (const Matrix<T>& x) { return multiply(x); },
+                                          [this] (const Matrix<T>& x) { return multiply_transposed(x); });
+  }
+
+  // applies P^T: the swaps of factorize() in reverse order
+  void undo_swaps(Matrix<T>& x) const {
+    for (size_t i = size(); i-- > 0;) {
+      if (pivots_[i] != i) {
+        x.row_switching(i, pivots_[i]);
+      }
+    }
+  }
+
+  void factorize() {
+    size_t n = size();
+    ProfileScope profile("lu", 2 * n * n * n / 3, n * n * sizeof(T));
+    pivots_.resize(n);
+    size_t n_threads = 2;
+    for (size_t k = 0; k < n; ++k) {
+      size_t pivot = k;
+      for (size_t i = k + 1; i < n; ++i) {
+        if (std::abs(lu_(i, k)) > std::abs(lu_(pivot, k))) {
+          pivot = i;
+        }
+      }
+      pivots_[k] = pivot;
+      if (lu_(pivot, k) == static_cast<T>(0)) {
+        singular_ = true;
+        return;
+      }
+      if (pivot != k) {
+        lu_.row_switching(pivot, k);
+        odd_swaps_ = !odd_swaps_;
+      }
+      const T* pivot_row = lu_.data() + k * n;
+      std::vector<std::thread> threads;
+      ProfilePhase spawn(ProfilePhase::Spawn, n_threads);
+      for (size_t t = 0; t < n_threads; ++t) {
+        threads.emplace_back([&] (size_t id) {
+          for (size_t i = k + 1 + id * (n - k - 1) / n_threads; i < k + 1 + (id + 1) * (n - k - 1) / n_threads; ++i) {
+            T* row = lu_.data() + i * n;
+            T factor = row[k] / pivot_row[k];
+            row[k] = factor;
+            for (size_t j = k + 1; j < n; ++j) {
+              row[j] -= factor * pivot_row[j];
+            }
+          }
+        }, t);
+      }
+      spawn.finish();
+      join_threads(threads);
+    }
+  }
+
+  Matrix<T> lu_;
+  std::vector<size_t> pivots_;
+  std::vector<T> column_norms_;  // sums of |a_ij| over the columns of A, for ||A||_1; dropped by update()
+  T norm_one_ = static_cast<T>(0);  // the estimate of ||A||_1 once the column sums are unknown
+  bool singular_ = false;
+  bool odd_swaps_ = false;
+};
+
+
+namespace detail {
+
+// L L^T +- x x^T for the L whose transpose is in the upper half of `l`, from row `first` on
+// (x is zero above it). Each step is a rotation of row k of L^T with x, along the row.
+// Only the upper half is updated. Returns false if a downdated pivot isn't positive
+template<typename T>
+bool cholesky_rank_one(Matrix<T>& l, size_t first, std::vector<T>& x, bool downdate) {
+  size_t n = l.GetLength();
+  for (size_t k = first; k < n; ++k) {
+    T* row = l.data() + k * n;
+    T pivot = downdate ? row[k] * row[k] - x[k] * x[k] : row[k] * row[k] + x[k] * x[k];
+    if (!(pivot > static_cast<T>(0))) {
+      return false;
+    }
+    T r = std::sqrt(pivot);
+    T c = r / row[k];
+    T s = x[k] / row[k];
+    row[k] = r;
+    for (size_t i = k + 1; i < n; ++i) {
+      row[i] = downdate ? (row[i] - s * x[i]) / c : (row[i] + s * x[i]) / c;
+      x[i] = c * x[i] - s * row[i];
+    }
+  }
+  return true;
+}
+
+}  // namespace detail
+
+
+// A = L L^T for a symmetric positive definite A, half the work of the LU and no pivoting.
+// Only the lower triangle of A is read. L^T is mirrored into the upper half of factor(),
+// so both triangular solves go along rows.
+template<typename T>
+class CholeskyDecomposition {
+public:
+  explicit CholeskyDecomposition(const Matrix<T>& matrix) : l_(matrix) {
+    if (matrix.GetWidth() != matrix.GetLength()) {
+      throw std::length_error("The matrix isn't a square");
+    }
+    l_.set_layout(Layout::RowMajor);
+    detail::mirror(MatrixView<T>(l_), Triangle::Lower);
+    norm_one_ = norm(l_, Norm::One);
+    factorize();
+  }
+
+  size_t size() const {
+    return l_.GetLength();
+  }
+
+  // false if a pivot wasn't positive: the matrix isn't positive definite (or is too close to it)
+  bool positive_definite() const {
+    return positive_definite_;
+  }
+
+  const Matrix<T>& factor() const {
+    return l_;
+  }
+
+  T det() const {
+    if (!positive_definite_) {
+      throw std::invalid_argument("The matrix isn't positive definite");
+    }
+    T res = static_cast<T>(1);
+    for (size_t i = 0; i < size(); ++i) {
+      res *= l_(i, i) * l_(i, i);
+    }
+    return res;
+  }
+
+  // returns a 0 x 0 matrix if the matrix isn't positive definite
+  Matrix<T> solve(const Matrix<T>& right_part) const {
+    if (right_part.GetLength() != size()) {
+      throw std::length_error("Shapes do not match");
+    }
+    if (!positive_definite_) {
+      return Matrix<T>(0, 0);
+    }
+    Matrix<T> x = right_part;
+    x.set_layout(Layout::RowMajor);
+    trsm<T>(Side::Left, Triangle::Lower, Diagonal::NonUnit, l_, x);
+    trsm<T>(Side::Left, Triangle::Upper, Diagonal::NonUnit, l_, x);
+    return x;
+  }
+
+  // the same estimates as LUDecomposition's; A^-1 is symmetric, so one solve serves both products
+  T cond_estimate() const {
+    if (!positive_definite_) {
+      return std::numeric_limits<T>::infinity();
+    }
+    auto solve = [this] (const Matrix<T>& x) { return this->solve(x); };
+    return norm_one_ * detail::norm1_estimate<T>(size(), solve, solve);
+  }
+
+  T cond2_estimate(size_t steps = detail::power_iteration_steps) const {
+    if (!positive_definite_) {
+      return std::numeric_limits<T>::infinity();
+    }
+    auto multiply = [this] (const Matrix<T>& x) { return this->multiply(x); };
+    auto solve = [this] (const Matrix<T>& x) { return this->solve(x); };
+    return detail::norm2_estimate<T>(size(), multiply, multiply, steps) *
+           detail::norm2_estimate<T>(size(), solve, solve, steps);
+  }
+
+  // The updates below cost O(n^2) per column of x instead of the O(n^3) of a new factorization.
+  // After them ||A||_1 for cond_estimate() is estimated from the factor as well.
+
+  // A + x x^T for an n x k x
+  void update(const Matrix<T>& x) {
+    rank_update(x, false);
+  }
+
+  // A - x x^T; false (and nothing changes) if the result isn't positive definite
+  bool downdate(const Matrix<T>& x) {
+    return rank_update(x, true);
+  }
+
+  // Borders A with one row and column: `column` is (n + 1) x 1, its last entry the new diagonal one.
+  // False (and nothing changes) if the result isn't positive definite
+  bool append(const Matrix<T>& column) {
+    size_t n = size();
+    if (column.GetShape() != std::make_pair(n + 1, size_t(1))) {
+      throw std::length_error("Shapes do not match");
+    }
+    check_factored();
+    // [L 0; l^T d] [L^T l; 0 d] = [A b; b^T c]: L l = b, d^2 = c - l^T l.
+    // Appending to an empty factorization leaves l empty, d^2 = c
+    Matrix<T> l(n, 1);
+    if (n > 0) {
+      l = column.get_submatrix(0, n - 1, 0, 0);
+      l.set_layout(Layout::RowMajor);
+      trsm<T>(Side::Left, Triangle::Lower, Diagonal::NonUnit, l_, l);
+    }
+    T pivot = column(n, 0);
+    for (size_t i = 0; i < n; ++i) {
+      pivot -= l(i, 0) * l(i, 0);
+    }
+    if (!(pivot > static_cast<T>(0))) {
+      return false;
+    }
+    Matrix<T> grown(n + 1, n + 1);
+    for (size_t i = 0; i < n; ++i) {
+      std::copy_n(l_.data() + i * n, n, grown.data() + i * (n + 1));
+      grown(i, n) = l(i, 0);
+      grown(n, i) = l(i, 0);
+    }
+    grown(n, n) = std::sqrt(pivot);
+    l_ = std::move(grown);
+    estimate_norm();
+    return true;
+  }
+
+  // Removes row and column k of A
+  void remove(size_t k) {
+    size_t n = size();
+    if (k >= n) {
+      throw std::out_of_range("Specified row doesn't exist");
+    }
+    check_factored();
+    // the rows below k lose column k of L: L33' L33'^T = L33 L33^T + l32 l32^T
+    std::vector<T> x(n - 1, static_cast<T>(0));
+    Matrix<T> shrunk(n - 1, n - 1);
+    for (size_t i = 0, row = 0; i < n; ++i) {
+      if (i == k) {
+        continue;
+      }
+      const T* source = l_.data() + i * n;
+      std::copy_n(source, k, shrunk.data() + row * (n - 1));
+      std::copy_n(source + k + 1, n - k - 1, shrunk.data() + row * (n - 1) + k);
+      x[row] = source[k];
+      ++row;
+    }
+    l_ = std::move(shrunk);
+    detail::cholesky_rank_one(l_, k, x, false);
+    detail::mirror(MatrixView<T>(l_), Triangle::Upper);
+    estimate_norm();
+  }
+
+private:
+  // A x = L (L^T x)
+  Matrix<T> multiply(const Matrix<T>& x) const {
+    Matrix<T> res = x;
+    res.set_layout(Layout::RowMajor);
+    trmm<T>(Side::Left, Triangle::Upper, Diagonal::NonUnit, l_, res);
+    trmm<T>(Side::Left, Triangle::Lower, Diagonal::NonUnit, l_, res);
+    return res;
+  }
+
+  bool rank_update(const Matrix<T>& x, bool downdate) {
+    size_t n = size();
+    if (x.GetLength() != n) {
+      throw std::length_error("Shapes do not match");
+    }
+    check_factored();
+    ProfileScope profile(downdate ? "cholesky_downdate" : "cholesky_update", 0, 0);
+    // a downdate may fail halfway, so it works on a copy
+    Matrix<T> updated = l_;
+    std::vector<T> column(n);
+    for (size_t j = 0; j < x.GetWidth(); ++j) {
+      for (size_t i = 0; i < n; ++i) {
+        column[i] = x(i, j);
+      }
+      if (!detail::cholesky_rank_one(updated, 0, column, downdate)) {
+        return false;
+      }
+    }
+    detail::mirror(MatrixView<T>(updated), Triangle::Upper);
+    l_ = std::move(updated);
+    estimate_norm();
+    return true;
+  }
+
+  void check_factored() const {
+    if (!positive_definite_) {
+      throw std::invalid_argument("The matrix isn't positive definite");
+    }
+  }
+
+  void estimate_norm() {
+    auto multiply = [this] (const Matrix<T>& x) { return this->multiply(x); };
+    norm_one_ = detail::norm1_estimate<T>(size(), multiply, multiply);
+  }
+
+  // left-looking: column j of L is row j's and the rows below's dot products with row j
+  void factorize() {
+    size_t n = size();
+    ProfileScope profile("cholesky", n * n * n / 3, n * n * sizeof(T));
+    for (size_t j = 0; j < n; ++j) {
+      T* row_j = l_.data() + j * n;
+      T pivot = row_j[j];
+      for (size_t k = 0; k < j; ++k) {
+        pivot -= row_j[k] * row_j[k];
+      }
+      if (!(pivot > static_cast<T>(0))) {
+        positive_definite_ = false;
+        return;
+      }
+      row_j[j] = std::sqrt(pivot);
+      detail::split_range(n - j - 1, (n - j - 1) * j, [&] (size_t first, size_t last) {
+        for (size_t i = j + 1 + first; i < j + 1 + last; ++i) {
+          T* row_i = l_.data() + i * n;
+          T value = row_i[j];
+          for (size_t k = 0; k < j; ++k) {
+            value -= row_i[k] * row_j[k];
+          }
+          row_i[j] = value / row_j[j];
+        }
+      });
+    }
+    detail::mirror(MatrixView<T>(l_), Triangle::Lower);
+  }
+
+  Matrix<T> l_;
+  T norm_one_ = static_cast<T>(0);
+  bool positive_definite_ = true;
+};
+
+
+// (A + U V^T)^-1 from A^-1 for n x k U and V in O(n^2 k), by the Sherman-Morrison-Woodbury formula
+// A^-1 - A^-1 U (E + V^T A^-1 U)^-1 V^T A^-1. Returns a 0 x 0 matrix if A + U V^T is singular
+template<typename T>
+Matrix<T> woodbury_update(const Matrix<T>& inverse, const Matrix<T>& u, const Matrix<T>& v) {
+  size_t n = inverse.GetLength();
+  if (inverse.GetWidth() != n) {
+    throw std::length_error("The matrix isn't a square");
+  }
+  if (u.GetLength() != n || v.GetShape() != u.GetShape()) {
+    throw std::length_error("Shapes do not match");
+  }
+  ProfileScope profile("woodbury_update", 0, 0);
+  Matrix<T> v_transposed = transposed(v);
+  Matrix<T> inverse_u = dot(inverse, u);
+  LUDecomposition<T> capacitance(diag(static_cast<T>(1), u.GetWidth()) + dot(v_transposed, inverse_u));
+  if (capacitance.singular()) {
+    return Matrix<T>(0, 0);
+  }
+  return inverse - dot(inverse_u, capacitance.solve(dot(v_transposed, inverse)));
+}
+
+// Estimate of the 1-norm condition number of a square matrix from its LU, without the inverse
+template<typename T>
+T cond_estimate(const Matrix<T>& matrix) {
+  return LUDecomposition<T>(matrix).cond_estimate();
+}
+
+// Estimate of the 2-norm of any matrix, its largest singular value, by power iteration
+template<typename T>
+T norm2_estimate(const Matrix<T>& matrix, size_t steps = detail::power_iteration_steps) {
+  Matrix<T> copy;
+  const Matrix<T>& rows = detail::row_major(matrix, copy);
+  return detail::norm2_estimate<T>(matrix.GetWidth(), [&] (const Matrix<T>& x) { return dot(rows, x); },
+                                   [&] (const Matrix<T>& y) { return transposed(dot(transposed(y), rows)); },
+                                   steps);
+}
+
+
+struct MixedPrecisionInfo {
+  size_t iterations = 0;          // refinement steps done
+  bool fell_back = false;         // true if the system was solved by a full factorization in T
+  double residual_norm = 0;       // ||b - Ax||_inf of the returned solution
+};
+
+
+// Solves a square system by factoring it in Low (float by default, twice the SIMD width)
+// and refining the solution with residuals computed in T. If the refinement stalls
+// (the matrix is too ill-conditioned for Low), the system is solved with an LU in T.
+// Returns a 0 x 0 matrix if there is no unique solution, as sle_solution does.
+template<typename T, typename Low = float>
+Matrix<T> mixed_sle_solution(const Matrix<T>& left_part, const Matrix<T>& right_part,
+                             MixedPrecisionInfo* info = nullptr, size_t max_iterations = 30) {
+  if (left_part.GetLength() != right_part.GetLength()) {
+    throw std::length_error("Shapes do not match");
+  }
+  if (left_part.GetLength() != left_part.GetWidth()) {
+    throw std::length_error("Mixed precision solver requires a square system");
+  }
+  MixedPrecisionInfo local_info;
+  MixedPrecisionInfo& stats = info ? *info : local_info;
+  stats = MixedPrecisionInfo();
+
+  auto fall_back = [&] {
+    stats.fell_back = true;
+    Matrix<T> x = LUDecomposition<T>(left_part).solve(right_part);
+    if (!x.empty()) {
+      stats.residual_norm = static_cast<double>(norm(right_part - dot(left_part, x), Norm::Max));
+    }
+    return x;
+  };
+
+  LUDecomposition<Low> low(matrix_cast<Low>(left_part));
+  if (low.singular()) {
+    return fall_back();
+  }
+  Matrix<T> x = matrix_cast<T>(low.solve(matrix_cast<Low>(right_part)));
+  T tolerance = std::sqrt(static_cast<T>(left_part.GetLength())) * std::numeric_limits<T>::epsilon() *
+                norm(left_part, Norm::Inf);
+  T previous_correction = std::numeric_limits<T>::infinity();
+  for (size_t iteration = 0; iteration < max_iterations; ++iteration) {
+    Matrix<T> residual = right_part - dot(left_part, x);
+    T residual_norm = norm(residual, Norm::Max);
+    stats.residual_norm = static_cast<double>(residual_norm);
+    if (!std::isfinite(residual_norm)) {
+      return fall_back();
+    }
+    if (residual_norm <= tolerance * norm(x, Norm::Max)) {
+      return x;
+    }
+    Matrix<T> correction = matrix_cast<T>(low.solve(matrix_cast<Low>(residual)));
+    T correction_norm = norm(correction, Norm::Max);
+    // each step has to at least halve the correction, otherwise Low is not enough
+    if (!(correction_norm < previous_correction / 2)) {
+      return fall_back();
+    }
+    previous_correction = correction_norm;
+    x += correction;
+    ++stats.iterations;
+    if (correction_norm <= std::numeric_limits<T>::epsilon() * norm(x, Norm::Max)) {
+      stats.residual_norm = static_cast<double>(norm(right_part - dot(left_part, x), Norm::Max));
+      return x;
+    }
+  }
+  return fall_back();
+}
@@ -1,7 +1,45 @@
 #pragma once
 
+#include<array>
+
+#include "blas.h"
+#include "exact.h"
 #include "matrix.h"
 
+namespace detail {
+
+// the element at position i of a buffer with the same shape in `layout`
+template<typename T>
+T element_in_order(const Matrix<T>& matrix, Layout layout, size_t i) {
+  if (matrix.layout() == layout) {
+    return matrix.data()[i];
+  }
+  return layout == Layout::RowMajor ? matrix(i / matrix.GetWidth(), i % matrix.GetWidth())
+                                    : matrix(i % matrix.GetLength(), i / matrix.GetLength());
+}
+
+// target rows of eliminate_rows per fused pass: their factors fit on the stack
+constexpr size_t elimination_rows = 64;
+
+// Zeroes `column` in rows [first, last) with the pivot row, one fused pass over columns
+// [column, column_end) per elimination_rows rows: the pivot row is zero left of `column`.
+// Nothing is allocated, so the workspace overloads of det and rank stay allocation-free
+template<typename T>
+void eliminate_rows(Matrix<T>& matrix, size_t first, size_t last, size_t pivot_row, size_t column,
+                    size_t column_end) {
+  std::array<T, elimination_rows> factors;
+  for (size_t chunk = first; chunk < last; chunk += elimination_rows) {
+    size_t chunk_end = std::min(last, chunk + elimination_rows);
+    for (size_t r = chunk; r < chunk_end; ++r) {
+      factors[r - chunk] = -matrix(r, column) / matrix(pivot_row, column);
+    }
+    matrix.rows_addition(chunk, chunk_end, pivot_row, factors.data(), column, column_end);
+  }
+}
+
+}  // namespace detail
+
+// Element-wise operations give a matrix in the layout of the left operand and walk the buffers in order
 template<typename T>
 Matrix<T> operator+(const Matrix<T>& matrix1, const Matrix<T>& matrix2) {
   if (!(matrix1.GetLength() == matrix2.GetLength() && matrix1.GetWidth() == matrix2.GetWidth())) {
@@ -9,20 +47,23 @@ Matrix<T> operator+(const Matrix<T>& matrix1, const Matrix<T>& matrix2) {
   }
   size_t width = matrix1.GetWidth();
   size_t length = matrix1.GetLength();
-  Matrix<T> res(length, width);
+  ProfileScope profile("add", length * width, 3 * length * width * sizeof(T));
+  Layout layout = matrix1.layout();
+  Matrix<T> res = Matrix<T>::uninitialized(length, width, layout);
   size_t n_threads = 2;
   size_t to_look_at = (length * width) / n_threads + ((length * width) % n_threads == 0 ? 0 : 1);
   std::vector<std::thread> threads;
+  ProfilePhase spawn(ProfilePhase::Spawn, n_threads);
   for (size_t k = 0; k < n_threads; ++k) {
     threads.emplace_back([&] (size_t id) {
+      detail::pin_partition(id, n_threads);
       for (size_t i = to_look_at * id; i < length * width && i < to_look_at * (id + 1); ++i) {
-        res(i / width, i % width) = matrix1(i / width, i % width) + matrix2(i / width, i % width);
+        res.data()[i] = matrix1.data()[i] + detail::element_in_order(matrix2, layout, i);
       }
     }, k);
   }
-  for (auto& t : threads) {
-    t.join();
-  }
+  spawn.finish();
+  join_threads(threads);
   return res;
 }
 
@@ -33,20 +74,23 @@ Matrix<T> operator-(const Matrix<T>& matrix1, const Matrix<T>& matrix2) {
   }
   size_t width = matrix1.GetWidth();
   size_t length = matrix1.GetLength();
-  Matrix<T> res(length, width);
+  ProfileScope profile("subtract", length * width, 3 * length * width * sizeof(T));
+  Layout layout = matrix1.layout();
+  Matrix<T> res = Matrix<T>::uninitialized(length, width, layout);
   size_t n_threads = 2;
   size_t to_look_at = (length * width) / n_threads + ((length * width) % n_threads == 0 ? 0 : 1);
   std::vector<std::thread> threads;
+  ProfilePhase spawn(ProfilePhase::Spawn, n_threads);
   for (size_t k = 0; k < n_threads; ++k) {
     threads.emplace_back([&] (size_t id) {
+      detail::pin_partition(id, n_threads);
       for (size_t i = to_look_at * id; i < length * width && i < to_look_at * (id + 1); ++i) {
-        res(i / width, i % width) = matrix1(i / width, i % width) - matrix2(i / width, i % width);
+        res.data()[i] = matrix1.data()[i] - detail::element_in_order(matrix2, layout, i);
       }
     }, k);
   }
-  for (auto& t : threads) {
-    t.join();
-  }
+  spawn.finish();
+  join_threads(threads);
   return res;
 }
 
@@ -58,20 +102,23 @@ Matrix<T> operator*(const Matrix<T>& matrix1, const Matrix<T>& matrix2) {
   }
   size_t width = matrix1.GetWidth();
   size_t length = matrix1.GetLength();
-  Matrix<T> res(length, width);
+  ProfileScope profile("multiply", length * width, 3 * length * width * sizeof(T));
+  Layout layout = matrix1.layout();
+  Matrix<T> res = Matrix<T>::uninitialized(length, width, layout);
   size_t n_threads = 2;
   size_t to_look_at = (length * width) / n_threads + ((length * width) % n_threads == 0 ? 0 : 1);
   std::vector<std::thread> threads;
+  ProfilePhase spawn(ProfilePhase::Spawn, n_threads);
   for (size_t k = 0; k < n_threads; ++k) {
     threads.emplace_back([&] (size_t id) {
+      detail::pin_partition(id, n_threads);
       for (size_t i = to_look_at * id; i < length*width && i < to_look_at * (id + 1); ++i) {
-        res(i / width, i % width) = matrix1(i / width, i % width) * matrix2(i / width, i % width);
+        res.data()[i] = matrix1.data()[i] * detail::element_in_order(matrix2, layout, i);
       }
     }, k);
   }
-  for (auto& t : threads) {
-    t.join();
-  }
+  spawn.finish();
+  join_threads(threads);
   return res;
 }
 
@@ -79,20 +126,22 @@ template<typename T>
 Matrix<T> operator*(const T& scale, const Matrix<T>& matrix) {
   size_t width = matrix.GetWidth();
   size_t length = matrix.GetLength();
-  Matrix<T> res(length, width);
+  ProfileScope profile("scale", length * width, 2 * length * width * sizeof(T));
+  Matrix<T> res = Matrix<T>::uninitialized(length, width, matrix.layout());
   size_t n_threads = 2;
   size_t to_look_at = (length * width) / n_threads + ((length * width) % n_threads == 0 ? 0 : 1);
   std::vector<std::thread> threads;
+  ProfilePhase spawn(ProfilePhase::Spawn, n_threads);
   for (size_t k = 0; k < n_threads; ++k) {
     threads.emplace_back([&] (size_t id) {
+      detail::pin_partition(id, n_threads);
       for (size_t i = to_look_at * id; i < length * width && i < to_look_at * (id + 1); ++i) {
-        res(i / width, i % width) = matrix(i / width, i % width) * scale;
+        res.data()[i] = matrix.data()[i] * scale;
       }
     }, k);
   }
-  for (auto& t : threads) {
-    t.join();
-  }
+  spawn.finish();
+  join_threads(threads);
   return res;
 }
 
@@ -109,50 +158,63 @@ Matrix<T> operator/(const Matrix<T>& matrix1, const Matrix<T>& matrix2) {
   }
   size_t width = matrix1.GetWidth();
   size_t length = matrix1.GetLength();
-  Matrix<T> res(length, width);
+  ProfileScope profile("divide", length * width, 3 * length * width * sizeof(T));
+  Layout layout = matrix1.layout();
+  Matrix<T> res = Matrix<T>::uninitialized(length, width, layout);
   size_t n_threads = 2;
   size_t to_look_at = (length * width) / n_threads + ((length * width) % n_threads == 0 ? 0 : 1);
   std::vector<std::thread> threads;
+  ProfilePhase spawn(ProfilePhase::Spawn, n_threads);
   for (size_t k = 0; k < n_threads; ++k) {
     threads.emplace_back([&] (size_t id) {
+      detail::pin_partition(id, n_threads);
       for (size_t i = to_look_at * id; i < length * width && i < to_look_at * (id + 1); ++i) {
-        res(i / width, i % width) = matrix1(i / width, i % width) / matrix2(i / width, i % width);
+        res.data()[i] = matrix1.data()[i] / detail::element_in_order(matrix2, layout, i);
       }
     }, k);
   }
-  for (auto& t : threads) {
-    t.join();
-  }
+  spawn.finish();
+  join_threads(threads);
   return res;
 }
 
 
+namespace detail {
+
+template<typename T>
+void dot_kernel(non_deduced_t<MatrixView<const T>> left, non_deduced_t<MatrixView<const T>> right, MatrixView<T> res) {
+  // vector shapes skip the blocked kernel
+  if (left.GetLength() == 1 && right.GetWidth() == 1) {
+    res(0, 0) = vdot<T>(left, right);
+  } else if (right.GetWidth() == 1) {
+    gemv<T>(static_cast<T>(1), left, right, static_cast<T>(0), res);
+  } else if (left.GetWidth() == 1) {
+    ger<T>(static_cast<T>(1), left, right, res);
+  } else {
+    gemm<T>(static_cast<T>(1), left, right, static_cast<T>(0), res);
+  }
+}
+
+}  // namespace detail
+
 template<typename T>
 Matrix<T> dot(const Matrix<T>& left, const Matrix<T>& right) {
   if (left.GetWidth() != right.GetLength()) {
     throw std::length_error("Left width (" + std::to_string(left.GetWidth()) + ") and right length (" +
                                              std::to_string(right.GetLength()) + ") are not equal");
   }
-  size_t n_threads = 2;
-  size_t width = right.GetWidth();
-  size_t length = left.GetLength();
-  size_t count_iter = left.GetWidth();
-  Matrix<T> res(length, width);
-  std::vector<std::thread> threads;
-  for (size_t k = 0; k < n_threads; ++k) {
-    threads.emplace_back([&] (const size_t& id) {
-      for (size_t i = id * width / n_threads; i < (id + 1) * width / n_threads; ++i) {
-        for (size_t j = 0; j < length; ++j) {
-          for (size_t p = 0; p < count_iter; ++p) {
-            res(j, i) += left(j, p) * right(p, i);
-          }
-        }
-      }
-    }, k);
-  }
-  for (auto& t : threads) {
-      t.join();
+  ProfileScope profile("dot", 2 * left.GetLength() * left.GetWidth() * right.GetWidth(),
+                       (left.GetLength() * left.GetWidth() + right.GetLength() * right.GetWidth() +
+                        left.GetLength() * right.GetWidth()) * sizeof(T));
+  if (left.layout() == Layout::ColumnMajor && right.layout() == Layout::ColumnMajor) {
+    // the buffers hold A^T and B^T by rows, and C^T = B^T A^T is the buffer of a column-major C
+    Matrix<T> res(left.GetLength(), right.GetWidth(), Layout::ColumnMajor);
+    detail::dot_kernel<T>(storage_view(right), storage_view(left), storage_view(res));
+    return res;
   }
+  Matrix<T> left_copy, right_copy;
+  Matrix<T> res(left.GetLength(), right.GetWidth());
+  detail::dot_kernel<T>(detail::row_major(left, left_copy), detail::row_major(right, right_copy), res);
   return res;
 }
 
@@ -165,11 +227,125 @@ Matrix<T> operator^(const Matrix<T>& matrix1, const Matrix<T>& matrix2) {
 
 template<typename T>
 Matrix<T> concatenate(const Matrix<T>& matrix1, const Matrix<T>& matrix2, size_t axis=0) {
+  if (axis == 0) {
+    Matrix<T> new_matrix;
+    new_matrix.resize(0, matrix1.GetWidth(), matrix1.layout());
+    new_matrix.reserve(matrix1.GetLength() + matrix2.GetLength());
+    new_matrix.concatenate(matrix1);
+    new_matrix.concatenate(matrix2);
+    return new_matrix;
+  }
   Matrix<T> new_matrix = matrix1;
   new_matrix.concatenate(matrix2, axis);
   return new_matrix;
 }
 
+template<typename T>
+Matrix<T> concatenate(Matrix<T>&& matrix1, const Matrix<T>& matrix2, size_t axis=0) {
+  matrix1.concatenate(matrix2, axis);
+  return std::move(matrix1);
+}
+
+
+// [A | B] (axis=1) or [A; B] (axis=0) without copying A and B.
+// Both matrices have to outlive the view.
+template<typename T>
+class ConcatenationView {
+public:
+  ConcatenationView(const Matrix<T>& first, const Matrix<T>& second, size_t axis=0)
+      : first_(first), second_(second), axis_(axis) {
+    if (axis == 0 ? first.GetWidth() != second.GetWidth() : first.GetLength() != second.GetLength()) {
+      throw std::length_error("Different shapes");
+    }
+  }
+
+  size_t GetLength() const {
+    return axis_ == 0 ? first_.GetLength() + second_.GetLength() : first_.GetLength();
+  }
+
+  size_t GetWidth() const {
+    return axis_ == 0 ? first_.GetWidth() : first_.GetWidth() + second_.GetWidth();
+  }
+
+  std::pair<size_t, size_t> GetShape() const {
+    return std::make_pair(GetLength(), GetWidth());
+  }
+
+  T operator()(const size_t& row, const size_t& column) const {
+    if (axis_ == 0) {
+      return row < first_.GetLength() ? first_(row, column) : second_(row - first_.GetLength(), column);
+    }
+    return column < first_.GetWidth() ? first_(row, column) : second_(row, column - first_.GetWidth());
+  }
+
+  // writes the concatenation into `out` by rows, reusing its buffer
+  void copy_to(Matrix<T>& out) const {
+    size_t first_width = first_.GetWidth();
+    size_t second_width = second_.GetWidth();
+    out.resize(GetLength(), GetWidth(), Layout::RowMajor);
+    if (first_.layout() != Layout::RowMajor || second_.layout() != Layout::RowMajor) {
+      for (size_t i = 0; i < GetLength(); ++i) {
+        for (size_t j = 0; j < GetWidth(); ++j) {
+          out(i, j) = (*this)(i, j);
+        }
+      }
+      return;
+    }
+    if (axis_ == 0) {
+      std::copy_n(first_.data(), first_.GetLength() * first_width, out.data());
+      std::copy_n(second_.data(), second_.GetLength() * second_width,
+                  out.data() + first_.GetLength() * first_width);
+      return;
+    }
+    for (size_t i = 0; i < GetLength(); ++i) {
+      T* row = out.data() + i * (first_width + second_width);
+      std::copy_n(first_.data() + i * first_width, first_width, row);
+      std::copy_n(second_.data() + i * second_width, second_width, row + first_width);
+    }
+  }
+
+  Matrix<T> to_matrix() const {
+    Matrix<T> res;
+    copy_to(res);
+    return res;
+  }
+
+  const Matrix<T>& first() const {
+    return first_;
+  }
+
+  const Matrix<T>& second() const {
+    return second_;
+  }
+
+  size_t axis() const {
+    return axis_;
+  }
+
+private:
+  const Matrix<T>& first_;
+  const Matrix<T>& second_;
+  size_t axis_;
+};
+
+// [A | B] x = A x_top + B x_bottom and [A; B] x = [A x; B x]
+template<typename T>
+Matrix<T> dot(const ConcatenationView<T>& left, const Matrix<T>& right) {
+  if (left.GetWidth() != right.GetLength()) {
+    throw std::length_error("Shapes do not match");
+  }
+  if (left.axis() == 0) {
+    return concatenate(dot(left.first(), right), dot(left.second(), right));
+  }
+  size_t split = left.first().GetWidth();
+  if (split == 0 || split == left.GetWidth()) {
+    return split == 0 ? dot(left.second(), right) : dot(left.first(), right);
+  }
+  Matrix<T> res = dot(left.first(), right.get_submatrix(0, split - 1, 0, right.GetWidth() - 1));
+  res += dot(left.second(), right.get_submatrix(split, right.GetLength() - 1, 0, right.GetWidth() - 1));
+  return res;
+}
+
 
 template<typename T>
 Matrix<T> diag(const T& elem, const size_t& size) {
@@ -195,19 +371,63 @@ Matrix<T> diag_from_vector(const std::vector<T> vector) {
 template<typename T=double>
 Matrix<T> random_matrix(const size_t& h, const size_t& w,
                         const T& range_low=0.0, const T& range_high=1.0) {
-  Matrix<T> res(h, w);
+  Matrix<T> res = Matrix<T>::uninitialized(h, w);
   res.fill_random(range_low, range_high);
   return res;
 }
 
 
+namespace detail {
+
+// converts n elements; specialized for the storage types with vector conversions (low_precision.h)
+template<typename To, typename From>
+struct ElementConverter {
+  static void convert(const From* source, To* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = static_cast<To>(source[i]);
+    }
+  }
+};
+
+}  // namespace detail
+
+template<typename To, typename From>
+Matrix<To> matrix_cast(const Matrix<From>& matrix) {
+  size_t width = matrix.GetWidth();
+  size_t length = matrix.GetLength();
+  Matrix<To> res = Matrix<To>::uninitialized(length, width, matrix.layout());
+  size_t size = length * width;
+  size_t n_threads = 2;
+  std::vector<std::thread> threads;
+  ProfilePhase spawn(ProfilePhase::Spawn, n_threads);
+  for (size_t k = 0; k < n_threads; ++k) {
+    threads.emplace_back([&] (size_t id) {
+      size_t first = id * size / n_threads;
+      detail::ElementConverter<To, From>::convert(matrix.data() + first, res.data() + first,
+                                                  (id + 1) * size / n_threads - first);
+    }, k);
+  }
+  spawn.finish();
+  join_threads(threads);
+  return res;
+}
+
+
+// destroys `matrix`, no copies are made
 template<typename T>
-T det(Matrix<T> matrix) {
+T det_in_place(Matrix<T>& matrix) {
+    if (matrix.layout() == Layout::ColumnMajor) {
+        matrix.transpose_layout();  // det(A^T) = det(A), and the rows of A^T are contiguous
+    }
+    if constexpr (detail::is_exact_v<T>) {
+        return exact_det_in_place(matrix);  // integer division would lose the exactness
+    }
     size_t width = matrix.GetWidth();
     size_t length = matrix.GetLength();
     if (width != length) {
         throw std::length_error("The matrix isn't a square");
     }
+    ProfileScope profile("det", 2 * width * width * width / 3, width * width * sizeof(T));
     T res = static_cast<T>(1);
     size_t n_threads = 2;
     for (size_t i = 0; i < width - 1; ++i) {
@@ -215,7 +435,8 @@ T det(Matrix<T> matrix) {
         threads.reserve(n_threads);
         if (matrix(i, i) == static_cast<T>(0)) {
             bool has_non_zero = false;
-            size_t index_non_zero;
+            size_t index_non_zero = i;
+            ProfilePhase spawn(ProfilePhase::Spawn, n_threads);
             for (size_t k = 0; k < n_threads; ++k) {
                 threads.emplace_back([&] (const size_t& id){
                     // divide the rows in range [i, width] evenly between all threads
@@ -229,9 +450,8 @@ T det(Matrix<T> matrix) {
                     }
                 }, k);
             }
-            for (auto& t : threads) {
-                t.join();
-            }
+            spawn.finish();
+            join_threads(threads);
             if (!has_non_zero) {
                 return static_cast<T>(0);
             }
@@ -240,22 +460,18 @@ T det(Matrix<T> matrix) {
         }
         threads.clear();
         // the same as above, except the first thread mustn't have the i-th row in it
+        ProfilePhase spawn(ProfilePhase::Spawn, n_threads);
         threads.emplace_back([&] {
-            for (size_t j = i + 1; j < i + (width - i) / n_threads; ++j) {
-                matrix.row_addition(j, i, static_cast<T>(-1) * matrix(j, i) / matrix(i, i));
-            }
+            detail::eliminate_rows(matrix, i + 1, i + (width - i) / n_threads, i, i, width);
         });
         for (size_t k = 1; k < n_threads; ++k) {
             threads.emplace_back([&](const size_t& id) {
-                for (size_t j = std::max(i + id * (width - i) / n_threads, i + 1);
-                     j < i + (id + 1) * (width - i) / n_threads; ++j) {
-                    matrix.row_addition(j, i, static_cast<T>(-1) * matrix(j, i) / matrix(i, i));
-                }
+                detail::eliminate_rows(matrix, std::max(i + id * (width - i) / n_threads, i + 1),
+                                       i + (id + 1) * (width - i) / n_threads, i, i, width);
             }, k);
         }
-        for (auto& t : threads) {
-            t.join();
-        }
+        spawn.finish();
+        join_threads(threads);
     }
     for (size_t i = 0; i < width; ++i) {
         res *= matrix(i, i);
@@ -263,21 +479,39 @@ T det(Matrix<T> matrix) {
     return res;
 }
 
+template<typename T>
+T det(Matrix<T> matrix) {
+  return det_in_place(matrix);
+}
+
 
 template<typename T>
 Matrix<T> inverse(const Matrix<T>& matrix) {
   if (matrix.GetWidth() != matrix.GetLength()) {
     throw std::length_error("The matrix isn't a square");
   }
+  if (matrix.layout() == Layout::ColumnMajor) {
+    // A^-1 = ((A^T)^-1)^T, and both transposes are free
+    Matrix<T> res = matrix;
+    res.transpose_layout();
+    res = inverse(res);
+    res.transpose_layout();
+    return res;
+  }
   size_t width = matrix.GetWidth();
+  ProfileScope profile("inverse", 2 * width * width * width, 3 * width * width * sizeof(T));
   Matrix<T> sle = concatenate(matrix, diag(1.0, width), 1);
   size_t n_threads = 2;
   std::vector<std::thread> threads;
+  // rows of the right half are zero from column width + max(i + 1, filled) on: it starts as
+  // the identity and only swaps bring entries from further right
+  size_t filled = 0;
   for (size_t i = 0; i < width - 1; ++i) {
     if (sle(i, i) == static_cast<T>(0)) {
       bool has_non_zero = false;
-      size_t index_non_zero;
+      size_t index_non_zero = i;
       threads.clear();
+      ProfilePhase spawn(ProfilePhase::Spawn, n_threads);
       for (size_t k = 0; k < n_threads; ++k) {
         threads.emplace_back([&](const size_t& id) {
           // divide the rows in range [i, width] evenly between all threads
@@ -291,58 +525,74 @@ Matrix<T> inverse(const Matrix<T>& matrix) {
           }
         }, k);
       }
-      for (auto& t : threads) {
-        t.join();
-      }
+      spawn.finish();
+      join_threads(threads);
       if (!has_non_zero) {
         throw std::invalid_argument("Determinant equals 0, inverse matrix doesn't exist");
       }
       sle.row_switching(i, index_non_zero);
+      filled = std::max(filled, index_non_zero + 1);
     }
     threads.clear();
     // the same as above, except the first thread mustn't have the i-th row in it
+    ProfilePhase spawn(ProfilePhase::Spawn, n_threads);
+    size_t column_end = width + std::max(i + 1, filled);
     threads.emplace_back([&] {
-      for (size_t j = i + 1; j < i + (width - i) / n_threads; ++j) {
-        sle.row_addition(j, i, static_cast<T>(-1) * sle(j, i) / sle(i, i));
-      }
+      detail::eliminate_rows(sle, i + 1, i + (width - i) / n_threads, i, i, column_end);
     });
     for (size_t k = 1; k < n_threads; ++k) {
       threads.emplace_back([&] (const size_t& id) {
-        for (size_t j = std::max(i + id * (width - i) / n_threads, i + 1);
-             j < i + (id + 1) * (width - i) / n_threads; ++j) {
-          sle.row_addition(j, i, static_cast<T>(-1) * sle(j, i) / sle(i, i));
-        }
+        detail::eliminate_rows(sle, std::max(i + id * (width - i) / n_threads, i + 1),
+                               i + (id + 1) * (width - i) / n_threads, i, i, column_end);
       }, k);
     }
-    for (auto& t : threads) {
-      t.join();
-    }
+    spawn.finish();
+    join_threads(threads);
   }
   if (sle(width - 1, width - 1) == 0) {
     throw std::invalid_argument("Determinant equals 0, inverse matrix doesn't exist");
   }
-  for (long long int i = static_cast<long long>(width) - 1; i >= 0; --i) {
-    sle.row_multiplication(i, 1 / sle(i, i));
-    threads.clear();
-    for (size_t k = 0; k < n_threads; ++k) {
-      threads.emplace_back([&] (const size_t& id) {
-        for (size_t j = id * i / n_threads; j < (id + 1) * i / n_threads; ++j) {
-          sle.row_addition(j, i, -sle(j, i));
-        }
-      }, k);
-    }
-    for (auto& t : threads) {
-      t.join();
-    }
-  }
+  // back substitution on the right half, the left one is upper triangular now
+  trsm<T>(Side::Left, Triangle::Upper, Diagonal::NonUnit,
+          MatrixView<const T>(sle.data(), width, width, 2 * width),
+          MatrixView<T>(sle.data() + width, width, width, 2 * width));
   return sle.get_submatrix(0, width - 1, width, 2 * width - 1);
 }
 
 
+namespace detail {
+
+// tiles of transposed: two 32 x 32 tiles of doubles fit in L1
+constexpr size_t transpose_block = 32;
+
+}  // namespace detail
+
+// out of place: the buffer is read once and the result written once, tile by tile
 template<typename T>
 Matrix<T> transposed(const Matrix<T> &matrix) {
-  Matrix<T> res = matrix;
-  res.transpose();
+  auto [length, width] = matrix.GetShape();
+  ProfileScope profile("transpose", 0, 2 * length * width * sizeof(T));
+  Matrix<T> res = Matrix<T>::uninitialized(width, length, matrix.layout());
+  // either way the result buffer is the transpose of the source buffer read as rows x columns
+  bool by_rows = matrix.layout() == Layout::RowMajor;
+  size_t rows = by_rows ? length : width;
+  size_t columns = by_rows ? width : length;
+  const T* source = matrix.data();
+  T* out = res.data();
+  size_t block = detail::transpose_block;
+  detail::split_range(columns, rows * columns, [&] (size_t first, size_t last) {
+    for (size_t jj = first; jj < last; jj += block) {
+      size_t j_end = std::min(last, jj + block);
+      for (size_t ii = 0; ii < rows; ii += block) {
+        size_t i_end = std::min(rows, ii + block);
+        for (size_t j = jj; j < j_end; ++j) {
+          for (size_t i = ii; i < i_end; ++i) {
+            out[j * rows + i] = source[i * columns + j];
+          }
+        }
+      }
+    }
+  }, detail::vector_parallel_threshold);
   return res;
 }
 
@@ -356,7 +606,9 @@ Matrix<T> sle_solution(const Matrix<T>& left_part, const Matrix<T>& right_part)
   if (left_length != right_length) {
     throw std::length_error("Shapes do not match");
   }
-  Matrix<T> sle_matrix = concatenate(left_part, right_part, 1);
+  ProfileScope profile("sle_solution", uint64_t(2) * left_length * left_width * (left_width + right_width),
+                       uint64_t(left_length) * (left_width + 2 * right_width) * sizeof(T));
+  Matrix<T> sle_matrix = ConcatenationView<T>(left_part, right_part, 1).to_matrix();
   int n_threads = 2;
   std::vector<std::thread> threads;
   threads.reserve(n_threads);
@@ -368,6 +620,7 @@ Matrix<T> sle_solution(const Matrix<T>& left_part, const Matrix<T>& right_part)
     if (sle_matrix(i, i) == 0) {
       std::atomic<int> first_not_zero{ i };
       std::atomic<bool> has_not_zero{ false };
+      ProfilePhase spawn(ProfilePhase::Spawn, n_threads);
       for (int k = 0; k < n_threads; ++k) {
         threads.emplace_back([&] (int id) {
           for (int j = i + 1 + id * to_look_at;
@@ -380,31 +633,31 @@ Matrix<T> sle_solution(const Matrix<T>& left_part, const Matrix<T>& right_part)
           }
         }, k);
       }
-      for (auto& t : threads) {
-        t.join();
-      }
+      spawn.finish();
+      join_threads(threads);
       threads.clear();
       if (!has_not_zero.load()) {
         return Matrix<T>(0, 0);  // inf or no solution
       }
       sle_matrix.row_switching(i, first_not_zero.load());
     }
+    ProfilePhase spawn(ProfilePhase::Spawn, n_threads);
     for (int k = 0; k < n_threads; ++k) {
       threads.emplace_back([&] (int id) {
-        for (int j = i + 1 + id * to_look_at; j < left_length && j < i + 1 + (id + 1) * to_look_at; ++j) {
-          sle_matrix.row_addition(j, i, -sle_matrix(j, i) / sle_matrix(i, i));
-        }
+        detail::eliminate_rows(sle_matrix, i + 1 + id * to_look_at,
+                               std::min(left_length, i + 1 + (id + 1) * to_look_at), i, i,
+                               left_width + right_width);
       }, k);
     }
-    for (auto& t : threads) {
-      t.join();
-    }
+    spawn.finish();
+    join_threads(threads);
     threads.clear();
-    sle_matrix.row_multiplication(i, 1 / sle_matrix(i, i));
+    sle_matrix.row_multiplication(i, 1 / sle_matrix(i, i), i, left_width + right_width);
   }
   if (left_length > left_width) {
     int to_look_at = (left_length - left_width) / n_threads + ((left_length - left_width) % n_threads == 0 ? 0 : 1);
     std::atomic<bool> do_not_have_solution{ false };
+    ProfilePhase spawn(ProfilePhase::Spawn, n_threads);
     for (int k = 0; k < n_threads; ++k) {
       threads.emplace_back([&] (int id) {
         for (int i = left_width + id * to_look_at;
@@ -418,29 +671,17 @@ Matrix<T> sle_solution(const Matrix<T>& left_part, const Matrix<T>& right_part)
         }
       }, k);
     }
-    for (auto& t : threads) {
-      t.join();
-    }
+    spawn.finish();
+    join_threads(threads);
     threads.clear();
     if (do_not_have_solution.load()) {
       return Matrix<T>(0, 0);// no solution
     }
   }
-  // reversed gauss
-  for (int i = left_width - 1; i != -1; --i) {
-    int to_look_at = i / n_threads + (i % n_threads == 0 ? 0 : 1);
-    for (int k = 0; k < n_threads; ++k) {
-      threads.emplace_back([&] (int id) {
-        for (int j = id * to_look_at; j < i && j < (id + 1) * to_look_at; ++j) {
-          sle_matrix.row_addition(j, i, -sle_matrix(j, i));
-        }
-      }, k);
-    }
-    for (auto& t : threads) {
-      t.join();
-    }
-    threads.clear();
-  }
+  // reversed gauss, the rows are already normalized
+  trsm<T>(Side::Left, Triangle::Upper, Diagonal::Unit,
+          MatrixView<const T>(sle_matrix.data(), left_width, left_width, left_width + right_width),
+          MatrixView<T>(sle_matrix.data() + left_width, left_width, right_width, left_width + right_width));
   return sle_matrix.get_submatrix(0, left_width - 1, left_width, left_width + right_width - 1);
 }
 
@@ -456,7 +697,9 @@ Matrix<T> fast_sle_solution(const Matrix<T>& left_part, const Matrix<T>& right_p
   }
   int length = left_width;
   int width = right_width;
-  Matrix<T> sle_matrix = concatenate(left_part, right_part, 1);
+  ProfileScope profile("fast_sle_solution", uint64_t(2) * left_length * left_width * (left_width + right_width),
+                       uint64_t(left_length) * (left_width + 2 * right_width) * sizeof(T));
+  Matrix<T> sle_matrix = ConcatenationView<T>(left_part, right_part, 1).to_matrix();
   Matrix<T> answer(length, width);
   std::vector<std::atomic<int>> sequence(left_width);
   for (size_t i = 0; i < size_t(left_width); ++i) {
@@ -498,7 +741,8 @@ Matrix<T> fast_sle_solution(const Matrix<T>& left_part, const Matrix<T>& right_p
             break;
           }
           sle_matrix.row_addition(id, sequence[pos].load(),
-                                  -sle_matrix(id, pos) / sle_matrix(sequence[pos].load(), pos));
+                                  -sle_matrix(id, pos) / sle_matrix(sequence[pos].load(), pos),
+                                  pos, left_width + right_width);
           ++pos;
           needed_val = -1;
         }
@@ -517,7 +761,7 @@ Matrix<T> fast_sle_solution(const Matrix<T>& left_part, const Matrix<T>& right_p
             }
           }
           else {
-            sle_matrix.row_multiplication(id, 1 / sle_matrix(id, pos));
+            sle_matrix.row_multiplication(id, 1 / sle_matrix(id, pos), pos, left_width + right_width);
           }
         }
         phase[1].fetch_add(1);
@@ -529,7 +773,7 @@ Matrix<T> fast_sle_solution(const Matrix<T>& left_part, const Matrix<T>& right_p
             while (phase[2].load() < left_width - j) {
               std::this_thread::yield();
             }
-            sle_matrix.row_addition(id, sequence[j].load(), -sle_matrix(id, j));
+            sle_matrix.row_addition(id, sequence[j].load(), -sle_matrix(id, j), j, left_width + right_width);
           }
           phase[2].fetch_add(1);
           for (int j = 0; j < width; ++j) {
@@ -538,9 +782,7 @@ Matrix<T> fast_sle_solution(const Matrix<T>& left_part, const Matrix<T>& right_p
         }
       }, i);
     }
-    for (auto& t : threads) {
-      t.join();
-    }
+    join_threads(threads);
   }
   if (inf_solution.load() || do_not_have_solution.load()) {
     return Matrix<T>(0, 0);
@@ -549,19 +791,29 @@ Matrix<T> fast_sle_solution(const Matrix<T>& left_part, const Matrix<T>& right_p
 }
 
 
+// destroys `matrix`, no copies are made
 template <typename T>
-size_t rank(Matrix<T> matrix) {
+size_t rank_in_place(Matrix<T>& matrix) {
+  if (matrix.layout() == Layout::ColumnMajor) {
+    matrix.transpose_layout();  // rank(A^T) = rank(A)
+  }
+  if constexpr (detail::is_exact_v<T>) {
+    return exact_rank_in_place(matrix);
+  }
   int n_threads = 2;
   std::vector<std::thread> threads;
   threads.reserve(n_threads);
   int width = matrix.GetWidth();
   int length = matrix.GetLength();
+  ProfileScope profile("rank", uint64_t(2) * length * width * std::min(length, width),
+                       uint64_t(length) * width * sizeof(T));
   int row = 0;
   for (int column = 0; column < width && row < length; ++column) {
     int to_look_at = (length - 1 - row) / n_threads + ((length - 1 - row) % n_threads == 0 ? 0 : 1);
     if (matrix(row, column) == 0) {
       std::atomic<int> first_not_zero{ row };
       std::atomic<bool> has_not_zero{ false };
+      ProfilePhase spawn(ProfilePhase::Spawn, n_threads);
       for (int k = 0; k < n_threads; ++k) {
         threads.emplace_back([&](int id) {
           for (int i = row + 1 + id * to_look_at;
@@ -574,34 +826,40 @@ size_t rank(Matrix<T> matrix) {
           }
         }, k);
       }
-      for (auto& t : threads) {
-        t.join();
-      }
+      spawn.finish();
+      join_threads(threads);
       threads.clear();
       if (!has_not_zero.load()) {
         continue;
       }
       matrix.row_switching(first_not_zero.load(), row);
     }
+    ProfilePhase spawn(ProfilePhase::Spawn, n_threads);
     for (int k = 0; k < n_threads; ++k) {
       threads.emplace_back([&](int id) {
-        for (int i = row + 1 + id * to_look_at; i < length && i < row + 1 + (id + 1) * to_look_at; ++i) {
-          matrix.row_addition(i, row, -matrix(i, column) / matrix(row, column));
-        }
+        detail::eliminate_rows(matrix, row + 1 + id * to_look_at,
+                               std::min(length, row + 1 + (id + 1) * to_look_at), row, column, width);
       }, k);
     }
-    for (auto& t : threads) {
-      t.join();
-    }
+    spawn.finish();
+    join_threads(threads);
     threads.clear();
     ++row;
   }
   return row;
 }
 
+template <typename T>
+size_t rank(Matrix<T> matrix) {
+  return rank_in_place(matrix);
+}
+
 
 template <typename T>
 size_t fast_rank(Matrix<T> matrix) {
+  if (matrix.layout() == Layout::ColumnMajor) {
+    matrix.transpose_layout();
+  }
   int width = matrix.GetWidth();
   int length = matrix.GetLength();
   std::atomic<size_t> result{0};
@@ -636,15 +894,172 @@ size_t fast_rank(Matrix<T> matrix) {
           }
         }
         if (sequence[pos].load() != -1)
-          matrix.row_addition(id, sequence[pos].load(), -matrix(id, pos) / matrix(sequence[pos].load(), pos));
+          matrix.row_addition(id, sequence[pos].load(), -matrix(id, pos) / matrix(sequence[pos].load(), pos),
+                              pos, width);
         ++pos;
         needed_val = -1;
       }
       counter.fetch_add(1);
     }, i);
   }
-  for (auto& t : threads) {
-    t.join();
-  }
+  join_threads(threads);
   return result.load();
 }
+
+
+// Scratch buffers for the solver overloads below. Reusing one workspace for
+// systems of the same size means the solvers don't allocate matrix buffers.
+template<typename T>
+struct SolverWorkspace {
+  Matrix<T> left;
+  Matrix<T> right;
+};
+
+// Gauss elimination on `left_part` and `right_part` directly, without building [A | B].
+// Both inputs are destroyed; `out` gets the solution, or 0 x 0 if there is no unique one.
+// `out` may be `right_part` itself.
+template<typename T>
+bool sle_solution_in_place(Matrix<T>& left_part, Matrix<T>& right_part, Matrix<T>& out) {
+  size_t left_length = left_part.GetLength();
+  size_t left_width = left_part.GetWidth();
+  size_t right_width = right_part.GetWidth();
+  if (left_length != right_part.GetLength()) {
+    throw std::length_error("Shapes do not match");
+  }
+  if (left_length < left_width) {
+    out.resize(0, 0);
+    return false;  // inf solutions
+  }
+  left_part.set_layout(Layout::RowMajor);
+  right_part.set_layout(Layout::RowMajor);
+  ProfileScope profile("sle_solution_in_place", 2 * left_length * left_width * (left_width + right_width),
+                       left_length * (left_width + 2 * right_width) * sizeof(T));
+  size_t n_threads = 2;
+  std::vector<std::thread> threads;
+  threads.reserve(n_threads);
+  T* left = left_part.data();
+  T* right = right_part.data();
+  for (size_t i = 0; i < left_width; ++i) {
+    size_t pivot = i;
+    for (size_t j = i + 1; j < left_length; ++j) {
+      if (std::abs(left[j * left_width + i]) > std::abs(left[pivot * left_width + i])) {
+        pivot = j;
+      }
+    }
+    if (left[pivot * left_width + i] == static_cast<T>(0)) {
+      out.resize(0, 0);
+      return false;  // inf or no solution
+    }
+    if (pivot != i) {
+      left_part.row_switching(i, pivot);
+      right_part.row_switching(i, pivot);
+    }
+    const T* left_pivot = left + i * left_width;
+    const T* right_pivot = right + i * right_width;
+    ProfilePhase spawn(ProfilePhase::Spawn, n_threads);
+    for (size_t k = 0; k < n_threads; ++k) {
+      threads.emplace_back([&] (size_t id) {
+        size_t rows = left_length - i - 1;
+        for (size_t j = i + 1 + id * rows / n_threads; j < i + 1 + (id + 1) * rows / n_threads; ++j) {
+          T* left_row = left + j * left_width;
+          T* right_row = right + j * right_width;
+          T factor = left_row[i] / left_pivot[i];
+          // the columns before i are already zero
+          for (size_t x = i + 1; x < left_width; ++x) {
+            left_row[x] -= factor * left_pivot[x];
+          }
+          for (size_t x = 0; x < right_width; ++x) {
+            right_row[x] -= factor * right_pivot[x];
+          }
+        }
+      }, k);
+    }
+    spawn.finish();
+    join_threads(threads);
+    threads.clear();
+  }
+  for (size_t i = left_width; i < left_length; ++i) {
+    for (size_t x = 0; x < right_width; ++x) {
+      if (right[i * right_width + x] != static_cast<T>(0)) {
+        out.resize(0, 0);
+        return false;  // no solution
+      }
+    }
+  }
+  trsm<T>(Side::Left, Triangle::Upper, Diagonal::NonUnit,
+          MatrixView<const T>(left, left_width, left_width, left_width),
+          MatrixView<T>(right, left_width, right_width, right_width));
+  // row-major, so shrinking right_part itself keeps exactly the solution rows
+  out.resize(left_width, right_width, Layout::RowMajor);
+  if (&out != &right_part) {
+    std::copy(right, right + left_width * right_width, out.data());
+  }
+  return true;
+}
+
+template<typename T>
+bool sle_solution(const Matrix<T>& left_part, const Matrix<T>& right_part,
+                  Matrix<T>& out, SolverWorkspace<T>& workspace) {
+  workspace.left = left_part;
+  workspace.right = right_part;
+  return sle_solution_in_place(workspace.left, workspace.right, out);
+}
+
+// destroys `matrix`, `out` gets the inverse
+template<typename T>
+void inverse_in_place(Matrix<T>& matrix, Matrix<T>& out) {
+  size_t width = matrix.GetWidth();
+  if (width != matrix.GetLength()) {
+    throw std::length_error("The matrix isn't a square");
+  }
+  out.resize(width, width, Layout::RowMajor);
+  std::fill(out.data(), out.data() + width * width, static_cast<T>(0));
+  for (size_t i = 0; i < width; ++i) {
+    out(i, i) = static_cast<T>(1);
+  }
+  if (!sle_solution_in_place(matrix, out, out)) {
+    throw std::invalid_argument("Determinant equals 0, inverse matrix doesn't exist");
+  }
+}
+
+template<typename T>
+void inverse(const Matrix<T>& matrix, Matrix<T>& out, SolverWorkspace<T>& workspace) {
+  workspace.left = matrix;
+  inverse_in_place(workspace.left, out);
+}
+
+template<typename T>
+T det(const Matrix<T>& matrix, SolverWorkspace<T>& workspace) {
+  workspace.left = matrix;
+  return det_in_place(workspace.left);
+}
+
+template<typename T>
+size_t rank(const Matrix<T>& matrix, SolverWorkspace<T>& workspace) {
+  workspace.left = matrix;
+  return rank_in_place(workspace.left);
+}
+
+
+// the view is copied straight into the workspace, [A | B] is never built separately
+template<typename T>
+bool sle_solution(const ConcatenationView<T>& left_part, const Matrix<T>& right_part,
+                  Matrix<T>& out, SolverWorkspace<T>& workspace) {
+  left_part.copy_to(workspace.left);
+  workspace.right = right_part;
+  return sle_solution_in_place(workspace.left, workspace.right, out);
+}
+
+template<typename T>
+Matrix<T> sle_solution(const ConcatenationView<T>& left_part, const Matrix<T>& right_part) {
+  SolverWorkspace<T> workspace;
+  Matrix<T> out;
+  sle_solution(left_part, right_part, out, workspace);
+  return out;
+}
+
+template<typename T>
+size_t rank(const ConcatenationView<T>& matrix, SolverWorkspace<T>& workspace) {
+  matrix.copy_to(workspace.left);
+  return rank_in_place(workspace.left);
+}
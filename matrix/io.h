@@ -0,0 +1,446 @@
+#pragma once
+
+#include<cctype>
+#include<charconv>
+#include<fstream>
+#include<sstream>
+#include<stdexcept>
+#include<type_traits>
+
+#include "matrix.h"
+
+namespace detail {
+
+constexpr size_t io_chunk_size = 1 << 22;
+constexpr size_t io_rows_per_batch = 1 << 12;
+
+using LineRange = std::pair<const char*, const char*>;
+
+inline bool is_blank(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool is_blank_line(const char* first, const char* last) {
+  for (; first != last; ++first) {
+    if (!is_blank(*first)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template<typename T>
+bool parse_value(const char*& first, const char* last, T& value) {
+  if (first != last && *first == '+') {
+    ++first;
+  }
+  std::from_chars_result result;
+  if constexpr (std::is_floating_point_v<T>) {
+    result = std::from_chars(first, last, value, std::chars_format::general);
+  } else {
+    result = std::from_chars(first, last, value);
+  }
+  if (result.ec != std::errc()) {
+    return false;
+  }
+  first = result.ptr;
+  return true;
+}
+
+// parses exactly `count` values separated by `delimiter` (by any blanks if delimiter == ' ')
+template<typename T>
+bool parse_line(const char* first, const char* last, char delimiter, T* out, size_t count) {
+  auto skip_blanks = [&] {
+    while (first != last && is_blank(*first) && (delimiter == ' ' || *first != delimiter)) {
+      ++first;
+    }
+  };
+  for (size_t j = 0; j < count; ++j) {
+    skip_blanks();
+    if (!parse_value(first, last, out[j])) {
+      return false;
+    }
+    const char* value_end = first;
+    skip_blanks();
+    if (j + 1 < count) {
+      if (delimiter == ' ') {
+        if (first == value_end) {
+          return false;
+        }
+      } else {
+        if (first == last || *first != delimiter) {
+          return false;
+        }
+        ++first;
+      }
+    }
+  }
+  return first == last;
+}
+
+// Reads the stream in fixed-size chunks and hands every chunk's complete,
+// non-blank lines to `process`. Only the unfinished tail line is carried over.
+template<typename F>
+void for_each_line_chunk(std::istream& in, F process) {
+  std::string buffer;
+  std::string carry;
+  std::vector<LineRange> lines;
+  while (in) {
+    buffer.swap(carry);
+    carry.clear();
+    size_t old_size = buffer.size();
+    buffer.resize(old_size + io_chunk_size);
+    in.read(&buffer[old_size], io_chunk_size);
+    buffer.resize(old_size + static_cast<size_t>(in.gcount()));
+    if (in) {
+      size_t last_newline = buffer.rfind('\n');
+      if (last_newline == std::string::npos) {
+        carry.swap(buffer);
+        continue;
+      }
+      carry.assign(buffer, last_newline + 1, std::string::npos);
+      buffer.resize(last_newline + 1);
+    }
+    lines.clear();
+    const char* first = buffer.data();
+    const char* end = buffer.data() + buffer.size();
+    while (first < end) {
+      const char* last = std::find(first, end, '\n');
+      if (!is_blank_line(first, last)) {
+        lines.emplace_back(first, last);
+      }
+      first = last + 1;
+    }
+    if (!lines.empty()) {
+      process(lines);
+    }
+  }
+}
+
+// runs `parse(i)` for every i in [0, count) on n_threads threads,
+// returns the index of the first line that failed or `count` on success
+template<typename F>
+size_t parallel_parse(size_t count, F parse) {
+  size_t n_threads = 2;
+  std::atomic<size_t> first_failed{ count };
+  std::vector<std::thread> threads;
+  for (size_t k = 0; k < n_threads; ++k) {
+    threads.emplace_back([&] (size_t id) {
+      for (size_t i = id * count / n_threads; i < (id + 1) * count / n_threads; ++i) {
+        if (!parse(i)) {
+          size_t expected = first_failed.load();
+          while (i < expected && !first_failed.compare_exchange_weak(expected, i));
+          return;
+        }
+      }
+    }, k);
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  return first_failed.load();
+}
+
+template<typename T>
+char* format_value(char* first, char* last, const T& value) {
+  return std::to_chars(first, last, value).ptr;
+}
+
+inline std::string read_header_line(std::istream& in) {
+  std::string line;
+  std::getline(in, line);
+  if (!line.empty() && line.back() == '\r') {
+    line.pop_back();
+  }
+  return line;
+}
+
+inline std::string to_lower(std::string str) {
+  std::transform(str.begin(), str.end(), str.begin(), [] (unsigned char c) { return std::tolower(c); });
+  return str;
+}
+
+}  // namespace detail
+
+
+// parses straight into the buffer of the result, which grows by whole chunks of rows
+template<typename T>
+Matrix<T> read_delimited(std::istream& in, char delimiter = ',') {
+  Matrix<T> res;
+  size_t width = 0;
+  size_t length = 0;
+  detail::for_each_line_chunk(in, [&] (const std::vector<detail::LineRange>& lines) {
+    if (width == 0) {
+      width = std::count(lines[0].first, lines[0].second, delimiter) + 1;
+    }
+    res.resize(length + lines.size(), width);
+    T* out = res.data() + length * width;
+    size_t failed = detail::parallel_parse(lines.size(), [&] (size_t i) {
+      return detail::parse_line(lines[i].first, lines[i].second, delimiter, out + i * width, width);
+    });
+    if (failed != lines.size()) {
+      throw std::invalid_argument("Malformed row " + std::to_string(length + failed) +
+                                  ", expected " + std::to_string(width) + " numeric values");
+    }
+    length += lines.size();
+  });
+  return res;
+}
+
+template<typename T>
+Matrix<T> read_csv(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("Can't open " + path);
+  }
+  return read_delimited<T>(in, ',');
+}
+
+template<typename T>
+Matrix<T> read_tsv(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("Can't open " + path);
+  }
+  return read_delimited<T>(in, '\t');
+}
+
+
+// Shortest representation that parses back to the same value (std::to_chars),
+// rows are formatted in parallel batches and written in order.
+template<typename T>
+void write_delimited(std::ostream& out, const Matrix<T>& matrix, char delimiter = ',') {
+  size_t length = matrix.GetLength();
+  size_t width = matrix.GetWidth();
+  size_t n_threads = 2;
+  std::vector<std::string> parts(n_threads);
+  for (size_t batch = 0; batch < length; batch += detail::io_rows_per_batch) {
+    size_t batch_end = std::min(length, batch + detail::io_rows_per_batch);
+    std::vector<std::thread> threads;
+    for (size_t k = 0; k < n_threads; ++k) {
+      threads.emplace_back([&] (size_t id) {
+        std::string& part = parts[id];
+        part.clear();
+        char buffer[64];
+        for (size_t i = batch + id * (batch_end - batch) / n_threads;
+             i < batch + (id + 1) * (batch_end - batch) / n_threads; ++i) {
+          for (size_t j = 0; j < width; ++j) {
+            if (j != 0) {
+              part.push_back(delimiter);
+            }
+            part.append(buffer, detail::format_value(buffer, buffer + sizeof(buffer), matrix(i, j)));
+          }
+          part.push_back('\n');
+        }
+      }, k);
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    for (const auto& part : parts) {
+      out.write(part.data(), part.size());
+    }
+  }
+}
+
+template<typename T>
+void write_csv(const std::string& path, const Matrix<T>& matrix) {
+  std::ofstream out(path, std::ios::binary);
+  if (!out) {
+    throw std::runtime_error("Can't open " + path);
+  }
+  write_delimited(out, matrix, ',');
+}
+
+template<typename T>
+void write_tsv(const std::string& path, const Matrix<T>& matrix) {
+  std::ofstream out(path, std::ios::binary);
+  if (!out) {
+    throw std::runtime_error("Can't open " + path);
+  }
+  write_delimited(out, matrix, '\t');
+}
+
+
+// Matrix Market: `array` (dense, column-major) and `coordinate` formats,
+// `general` / `symmetric` / `skew-symmetric` and `real` / `integer` / `pattern` fields.
+// There is no sparse Matrix in the library yet, so coordinate files are loaded densely.
+template<typename T>
+Matrix<T> read_matrix_market(std::istream& in) {
+  std::istringstream banner(detail::to_lower(detail::read_header_line(in)));
+  std::string tag, object, format, field, symmetry;
+  banner >> tag >> object >> format >> field >> symmetry;
+  if (tag != "%%matrixmarket" || object != "matrix") {
+    throw std::invalid_argument("Not a Matrix Market matrix");
+  }
+  if (format != "array" && format != "coordinate") {
+    throw std::invalid_argument("Unknown Matrix Market format: " + format);
+  }
+  if (field == "complex") {
+    throw std::invalid_argument("Complex Matrix Market files are not supported");
+  }
+  if (symmetry != "general" && symmetry != "symmetric" && symmetry != "skew-symmetric") {
+    throw std::invalid_argument("Unsupported Matrix Market symmetry: " + symmetry);
+  }
+  bool pattern = field == "pattern";
+  bool mirrored = symmetry != "general";
+  T mirror_sign = symmetry == "skew-symmetric" ? static_cast<T>(-1) : static_cast<T>(1);
+
+  std::string size_line;
+  do {
+    size_line = detail::read_header_line(in);
+  } while (in && (size_line.empty() || size_line[0] == '%'));
+  std::istringstream sizes(size_line);
+  size_t length = 0, width = 0, entries = 0;
+  sizes >> length >> width;
+  if (format == "coordinate") {
+    sizes >> entries;
+  }
+  if (!sizes) {
+    throw std::invalid_argument("Malformed Matrix Market size line");
+  }
+
+  Matrix<T> res(length, width);
+  T* out = res.data();
+  size_t read = 0;
+  if (format == "array") {
+    // column-major; symmetric files only store the lower triangle
+    std::vector<std::pair<size_t, size_t>> positions;
+    if (mirrored) {
+      for (size_t j = 0; j < width; ++j) {
+        for (size_t i = (symmetry == "symmetric" ? j : j + 1); i < length; ++i) {
+          positions.emplace_back(i, j);
+        }
+      }
+    }
+    size_t expected = mirrored ? positions.size() : length * width;
+    detail::for_each_line_chunk(in, [&] (const std::vector<detail::LineRange>& lines) {
+      if (read + lines.size() > expected) {
+        throw std::length_error("Too many values in Matrix Market file");
+      }
+      size_t failed = detail::parallel_parse(lines.size(), [&] (size_t k) {
+        size_t index = read + k;
+        size_t i = mirrored ? positions[index].first : index % length;
+        size_t j = mirrored ? positions[index].second : index / length;
+        T value;
+        if (!detail::parse_line(lines[k].first, lines[k].second, ' ', &value, 1)) {
+          return false;
+        }
+        out[i * width + j] = value;
+        if (mirrored) {
+          out[j * width + i] = mirror_sign * value;
+        }
+        return true;
+      });
+      if (failed != lines.size()) {
+        throw std::invalid_argument("Malformed value #" + std::to_string(read + failed));
+      }
+      read += lines.size();
+    });
+    if (read != expected) {
+      throw std::length_error("Expected " + std::to_string(expected) + " values, got " + std::to_string(read));
+    }
+  } else {
+    std::vector<size_t> rows, columns;
+    std::vector<T> values;
+    detail::for_each_line_chunk(in, [&] (const std::vector<detail::LineRange>& lines) {
+      if (read + lines.size() > entries) {
+        throw std::length_error("Too many entries in Matrix Market file");
+      }
+      rows.resize(lines.size());
+      columns.resize(lines.size());
+      values.resize(lines.size());
+      size_t failed = detail::parallel_parse(lines.size(), [&] (size_t k) {
+        const char* first = lines[k].first;
+        const char* last = lines[k].second;
+        size_t coordinates[2];
+        for (size_t c = 0; c < 2; ++c) {
+          while (first != last && detail::is_blank(*first)) {
+            ++first;
+          }
+          if (!detail::parse_value(first, last, coordinates[c])) {
+            return false;
+          }
+        }
+        rows[k] = coordinates[0] - 1;
+        columns[k] = coordinates[1] - 1;
+        if (pattern) {
+          values[k] = static_cast<T>(1);
+          return detail::is_blank_line(first, last);
+        }
+        return detail::parse_line(first, last, ' ', &values[k], 1);
+      });
+      if (failed != lines.size()) {
+        throw std::invalid_argument("Malformed entry #" + std::to_string(read + failed));
+      }
+      // duplicates are summed as the format prescribes, so the scatter is sequential
+      for (size_t k = 0; k < lines.size(); ++k) {
+        if (rows[k] >= length || columns[k] >= width) {
+          throw std::out_of_range("Entry #" + std::to_string(read + k) + " is out of the matrix");
+        }
+        out[rows[k] * width + columns[k]] += values[k];
+        if (mirrored && rows[k] != columns[k]) {
+          out[columns[k] * width + rows[k]] += mirror_sign * values[k];
+        }
+      }
+      read += lines.size();
+    });
+    if (read != entries) {
+      throw std::length_error("Expected " + std::to_string(entries) + " entries, got " + std::to_string(read));
+    }
+  }
+  return res;
+}
+
+template<typename T>
+Matrix<T> read_matrix_market(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("Can't open " + path);
+  }
+  return read_matrix_market<T>(in);
+}
+
+template<typename T>
+void write_matrix_market(std::ostream& out, const Matrix<T>& matrix) {
+  size_t length = matrix.GetLength();
+  size_t width = matrix.GetWidth();
+  out << "%%MatrixMarket matrix array " << (std::is_integral_v<T> ? "integer" : "real") << " general\n";
+  out << length << " " << width << "\n";
+  size_t n_threads = 2;
+  std::vector<std::string> parts(n_threads);
+  size_t columns_per_batch = std::max<size_t>(1, detail::io_rows_per_batch * 16 / std::max<size_t>(1, length));
+  for (size_t batch = 0; batch < width; batch += columns_per_batch) {
+    size_t batch_end = std::min(width, batch + columns_per_batch);
+    std::vector<std::thread> threads;
+    for (size_t k = 0; k < n_threads; ++k) {
+      threads.emplace_back([&] (size_t id) {
+        std::string& part = parts[id];
+        part.clear();
+        char buffer[64];
+        for (size_t j = batch + id * (batch_end - batch) / n_threads;
+             j < batch + (id + 1) * (batch_end - batch) / n_threads; ++j) {
+          for (size_t i = 0; i < length; ++i) {
+            part.append(buffer, detail::format_value(buffer, buffer + sizeof(buffer), matrix(i, j)));
+            part.push_back('\n');
+          }
+        }
+      }, k);
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    for (const auto& part : parts) {
+      out.write(part.data(), part.size());
+    }
+  }
+}
+
+template<typename T>
+void write_matrix_market(const std::string& path, const Matrix<T>& matrix) {
+  std::ofstream out(path, std::ios::binary);
+  if (!out) {
+    throw std::runtime_error("Can't open " + path);
+  }
+  write_matrix_market(out, matrix);
+}
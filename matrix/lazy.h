@@ -0,0 +1,518 @@
+#pragma once
+
+#include<algorithm>
+#include<functional>
+#include<limits>
+#include<map>
+#include<memory>
+#include<sstream>
+#include<string>
+#include<vector>
+
+#include "async.h"
+#include "chain.h"
+#include "functions.h"
+
+// Lazy expressions: lazy(A) wraps a matrix, and the usual operators on Lazy<T> only record
+// a graph. eval() rewrites the graph before computing it:
+//   transposed(A) ^ A      -> gram(A) by syrk, without the transpose copy (A ^ transposed(A) too)
+//   inverse(A) ^ B         -> sle_solution(A, B), without the inverse
+//   A ^ B ^ C ^ ...        -> the cheapest order of the products, as in multi_dot
+//   A + B * C - 2 * D ...  -> one pass over the elements, without temporaries
+//   transposed(transposed(A)) -> A
+// Equal subexpressions are computed once, and independent nodes run in parallel on the pool.
+
+namespace detail {
+
+enum class LazyOp { Leaf, Transpose, Product, Inverse, Add, Subtract, Multiply, Divide, Scale, Gram, RowGram, Solve,
+                    Fused };
+
+// A step of a fused element-wise program over a stack of operand blocks: Leaf pushes
+// inputs[input], Scale multiplies the top by `scalar`, the others combine the top two
+template<typename T>
+struct FusedStep {
+  LazyOp op;
+  size_t input;
+  T scalar;
+};
+
+template<typename T>
+struct LazyNode {
+  LazyOp op;
+  std::vector<std::shared_ptr<LazyNode>> inputs;
+  size_t length = 0;
+  size_t width = 0;
+  std::shared_ptr<const Matrix<T>> matrix;  // Leaf
+  T scalar = T();                           // Scale
+  std::vector<FusedStep<T>> program;        // Fused
+};
+
+template<typename T>
+using LazyNodePtr = std::shared_ptr<LazyNode<T>>;
+
+template<typename T>
+LazyNodePtr<T> make_lazy_node(LazyOp op, std::vector<LazyNodePtr<T>> inputs, size_t length, size_t width) {
+  auto node = std::make_shared<LazyNode<T>>();
+  node->op = op;
+  node->inputs = std::move(inputs);
+  node->length = length;
+  node->width = width;
+  return node;
+}
+
+// fused programs run on blocks of this many elements, so the operand stack stays in cache
+constexpr size_t fused_block = 256;
+
+template<typename T>
+Matrix<T> run_fused(const LazyNode<T>& node, const std::vector<const Matrix<T>*>& inputs) {
+  size_t size = node.length * node.width;
+  ProfileScope profile("fused", size * (node.program.size() - node.inputs.size()),
+                       size * (node.inputs.size() + 1) * sizeof(T));
+  // the program walks the buffers in order, so they all take the layout of the first input
+  Layout layout = inputs[0]->layout();
+  std::vector<Matrix<T>> converted(inputs.size());
+  std::vector<const Matrix<T>*> operands = inputs;
+  for (size_t k = 0; k < inputs.size(); ++k) {
+    if (inputs[k]->layout() != layout) {
+      converted[k] = *inputs[k];
+      converted[k].set_layout(layout);
+      operands[k] = &converted[k];
+    }
+  }
+  Matrix<T> res = Matrix<T>::uninitialized(node.length, node.width, layout);
+  split_range(size, size * node.program.size(), [&] (size_t first, size_t last) {
+    std::vector<std::vector<T>> stack;
+    for (size_t begin = first; begin < last; begin += fused_block) {
+      size_t count = std::min(fused_block, last - begin);
+      size_t depth = 0;
+      for (const FusedStep<T>& step : node.program) {
+        if (step.op == LazyOp::Leaf) {
+          if (stack.size() == depth) {
+            stack.emplace_back(fused_block);
+          }
+          std::copy_n(operands[step.input]->data() + begin, count, stack[depth++].begin());
+          continue;
+        }
+        if (step.op == LazyOp::Scale) {
+          for (T& value : stack[depth - 1]) {
+            value *= step.scalar;
+          }
+          continue;
+        }
+        T* left = stack[depth - 2].data();
+        const T* right = stack[depth - 1].data();
+        for (size_t i = 0; i < count; ++i) {
+          switch (step.op) {
+            case LazyOp::Add: left[i] += right[i]; break;
+            case LazyOp::Subtract: left[i] -= right[i]; break;
+            case LazyOp::Multiply: left[i] *= right[i]; break;
+            default: left[i] /= right[i]; break;
+          }
+        }
+        --depth;
+      }
+      std::copy_n(stack[0].begin(), count, res.data() + begin);
+    }
+  });
+  return res;
+}
+
+template<typename T>
+Matrix<T> compute_lazy_node(const LazyNode<T>& node, const std::vector<const Matrix<T>*>& inputs) {
+  switch (node.op) {
+    case LazyOp::Transpose:
+      return transposed(*inputs[0]);
+    case LazyOp::Product:
+      return dot(*inputs[0], *inputs[1]);
+    case LazyOp::Inverse:
+      return inverse(*inputs[0]);
+    case LazyOp::Gram:
+      return gram(*inputs[0]);
+    case LazyOp::RowGram:
+      return gram(*inputs[0], Transpose::NoTrans);
+    case LazyOp::Solve: {
+      Matrix<T> res = sle_solution(*inputs[0], *inputs[1]);
+      if (res.GetLength() != node.length) {
+        throw std::invalid_argument("Determinant equals 0, inverse matrix doesn't exist");
+      }
+      return res;
+    }
+    case LazyOp::Fused:
+      return run_fused(node, inputs);
+    default:
+      throw std::logic_error("The graph has to be optimized first");
+  }
+}
+
+
+// Rewrites a graph into one that computes the same matrix with fewer operations.
+// Nodes with the same operation, parameters and inputs are merged into one.
+template<typename T>
+class LazyPlanner {
+public:
+  LazyNodePtr<T> optimize(const LazyNodePtr<T>& node) {
+    auto it = optimized_.find(node.get());
+    if (it != optimized_.end()) {
+      return it->second;
+    }
+    LazyNodePtr<T> res;
+    switch (node->op) {
+      case LazyOp::Leaf:
+        res = intern(node);
+        break;
+      case LazyOp::Transpose: {
+        LazyNodePtr<T> input = optimize(node->inputs[0]);
+        res = input->op == LazyOp::Transpose
+            ? input->inputs[0]
+            : intern(make_lazy_node<T>(LazyOp::Transpose, {input}, node->length, node->width));
+        break;
+      }
+      case LazyOp::Inverse:
+        res = intern(make_lazy_node<T>(LazyOp::Inverse, {optimize(node->inputs[0])}, node->length, node->width));
+        break;
+      case LazyOp::Product: {
+        std::vector<LazyNodePtr<T>> factors;
+        collect_factors(node, factors);
+        res = chain(std::move(factors));
+        break;
+      }
+      default:
+        res = fuse(node);
+        break;
+    }
+    optimized_[node.get()] = res;
+    return res;
+  }
+
+private:
+  LazyNodePtr<T> intern(const LazyNodePtr<T>& node) {
+    std::ostringstream key;
+    key.precision(std::numeric_limits<T>::max_digits10);
+    key << static_cast<int>(node->op) << ' ' << node->length << ' ' << node->width << ' ' << node->matrix.get();
+    if (node->op == LazyOp::Scale) {
+      key << ' ' << node->scalar;
+    }
+    for (const FusedStep<T>& step : node->program) {
+      key << ' ' << static_cast<int>(step.op) << ':' << step.input << ':' << step.scalar;
+    }
+    for (const auto& input : node->inputs) {
+      key << ' ' << ids_.at(input.get());
+    }
+    auto [it, inserted] = interned_.emplace(key.str(), node);
+    if (inserted) {
+      ids_.emplace(node.get(), ids_.size());
+    }
+    return it->second;
+  }
+
+  void collect_factors(const LazyNodePtr<T>& node, std::vector<LazyNodePtr<T>>& factors) {
+    if (node->op == LazyOp::Product) {
+      collect_factors(node->inputs[0], factors);
+      collect_factors(node->inputs[1], factors);
+    } else {
+      factors.push_back(optimize(node));
+    }
+  }
+
+  LazyNodePtr<T> chain(std::vector<LazyNodePtr<T>> factors) {
+    // X^T X and X X^T
+    for (size_t k = 0; k + 1 < factors.size(); ++k) {
+      if (factors[k]->op == LazyOp::Transpose && factors[k]->inputs[0] == factors[k + 1]) {
+        const LazyNodePtr<T>& x = factors[k + 1];
+        factors[k] = intern(make_lazy_node<T>(LazyOp::Gram, {x}, x->width, x->width));
+        factors.erase(factors.begin() + k + 1);
+      } else if (factors[k + 1]->op == LazyOp::Transpose && factors[k + 1]->inputs[0] == factors[k]) {
+        const LazyNodePtr<T>& x = factors[k];
+        factors[k] = intern(make_lazy_node<T>(LazyOp::RowGram, {x}, x->length, x->length));
+        factors.erase(factors.begin() + k + 1);
+      }
+    }
+    // inverse(A) B ... -> solve(A, B ...)
+    for (size_t k = 0; k + 1 < factors.size(); ++k) {
+      if (factors[k]->op == LazyOp::Inverse) {
+        LazyNodePtr<T> right = chain(std::vector<LazyNodePtr<T>>(factors.begin() + k + 1, factors.end()));
+        const LazyNodePtr<T>& a = factors[k]->inputs[0];
+        LazyNodePtr<T> solve = intern(make_lazy_node<T>(LazyOp::Solve, {a, right}, a->width, right->width));
+        factors.resize(k);
+        factors.push_back(solve);
+        break;
+      }
+    }
+    return order(factors);
+  }
+
+  // the cheapest parenthesization by the cost model of multi_dot
+  LazyNodePtr<T> order(const std::vector<LazyNodePtr<T>>& factors) {
+    std::vector<size_t> dims = {factors[0]->length};
+    for (const auto& factor : factors) {
+      dims.push_back(factor->width);
+    }
+    ChainPlan plan = plan_chain(dims, ChainCostModel(), sizeof(T));
+    std::function<LazyNodePtr<T>(size_t, size_t)> build = [&] (size_t i, size_t j) {
+      if (i == j) {
+        return factors[i];
+      }
+      size_t k = plan.split[i][j];
+      return intern(make_lazy_node<T>(LazyOp::Product, {build(i, k), build(k + 1, j)},
+                                       factors[i]->length, factors[j]->width));
+    };
+    return build(0, factors.size() - 1);
+  }
+
+  // a tree of element-wise operations becomes one Fused node over its other operands
+  LazyNodePtr<T> fuse(const LazyNodePtr<T>& node) {
+    auto fused = make_lazy_node<T>(LazyOp::Fused, {}, node->length, node->width);
+    for (const auto& input : node->inputs) {
+      LazyNodePtr<T> operand = optimize(input);
+      if (operand->op == LazyOp::Fused) {
+        for (FusedStep<T> step : operand->program) {
+          if (step.op == LazyOp::Leaf) {
+            step.input = fused_input(*fused, operand->inputs[step.input]);
+          }
+          fused->program.push_back(step);
+        }
+      } else {
+        fused->program.push_back({LazyOp::Leaf, fused_input(*fused, operand), T()});
+      }
+    }
+    fused->program.push_back({node->op, 0, node->scalar});
+    return intern(fused);
+  }
+
+  static size_t fused_input(LazyNode<T>& fused, const LazyNodePtr<T>& input) {
+    auto it = std::find(fused.inputs.begin(), fused.inputs.end(), input);
+    if (it != fused.inputs.end()) {
+      return it - fused.inputs.begin();
+    }
+    fused.inputs.push_back(input);
+    return fused.inputs.size() - 1;
+  }
+
+  std::map<const LazyNode<T>*, LazyNodePtr<T>> optimized_;
+  std::map<std::string, LazyNodePtr<T>> interned_;
+  std::map<const LazyNode<T>*, size_t> ids_;
+};
+
+// Computes an optimized graph level by level: a node's level is one more than its inputs',
+// and the nodes of one level are independent, so they run on the pool together
+template<typename T>
+Matrix<T> evaluate_lazy(const LazyNodePtr<T>& root, ThreadPool& pool) {
+  std::map<const LazyNode<T>*, size_t> index;
+  std::vector<const LazyNode<T>*> nodes;
+  std::vector<size_t> levels;
+  std::function<size_t(const LazyNodePtr<T>&)> visit = [&] (const LazyNodePtr<T>& node) {
+    auto it = index.find(node.get());
+    if (it != index.end()) {
+      return levels[it->second];
+    }
+    size_t level = 0;
+    for (const auto& input : node->inputs) {
+      level = std::max(level, visit(input) + 1);
+    }
+    index.emplace(node.get(), nodes.size());
+    nodes.push_back(node.get());
+    levels.push_back(level);
+    return level;
+  };
+  size_t depth = visit(root);
+
+  std::vector<std::shared_ptr<const Matrix<T>>> results(nodes.size());
+  auto compute = [&results, &index] (const LazyNode<T>* node) {
+    std::vector<const Matrix<T>*> inputs;
+    for (const auto& input : node->inputs) {
+      inputs.push_back(results[index.at(input.get())].get());
+    }
+    return std::make_shared<const Matrix<T>>(compute_lazy_node(*node, inputs));
+  };
+  for (size_t level = 0; level <= depth; ++level) {
+    std::vector<size_t> current;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      if (levels[i] == level) {
+        current.push_back(i);
+      }
+    }
+    if (level == 0) {
+      for (size_t i : current) {
+        results[i] = nodes[i]->matrix;
+      }
+    } else if (current.size() == 1) {
+      results[current[0]] = compute(nodes[current[0]]);
+    } else {
+      std::vector<Future<std::shared_ptr<const Matrix<T>>>> futures;
+      for (size_t i : current) {
+        futures.push_back(submit(pool, compute, nodes[i]));
+      }
+      // the tasks reference results and index: none may still run when a failure unwinds them
+      for (const auto& future : futures) {
+        future.wait();
+      }
+      for (size_t k = 0; k < current.size(); ++k) {
+        results[current[k]] = futures[k].get();
+      }
+    }
+  }
+  return *results[index.at(root.get())];
+}
+
+}  // namespace detail
+
+
+template<typename T>
+class Lazy {
+public:
+  // the matrix is referenced, not copied, so it has to outlive eval()
+  Lazy(const Matrix<T>& matrix) : Lazy(std::shared_ptr<const Matrix<T>>(&matrix, [] (const Matrix<T>*) {})) {}
+
+  Lazy(Matrix<T>&& matrix) : Lazy(std::make_shared<const Matrix<T>>(std::move(matrix))) {}
+
+  explicit Lazy(detail::LazyNodePtr<T> node) : node_(std::move(node)) {}
+
+  size_t GetLength() const {
+    return node_->length;
+  }
+
+  size_t GetWidth() const {
+    return node_->width;
+  }
+
+  std::pair<size_t, size_t> GetShape() const {
+    return std::make_pair(node_->length, node_->width);
+  }
+
+  // Don't call from a task of the same pool: the levels are waited for
+  Matrix<T> eval(ThreadPool& pool = ThreadPool::global()) const {
+    detail::LazyPlanner<T> planner;
+    return detail::evaluate_lazy(planner.optimize(node_), pool);
+  }
+
+  // the optimized graph, e.g. "solve(m0, gram(m1))", leaves are named in order of appearance
+  std::string plan() const {
+    detail::LazyPlanner<T> planner;
+    std::map<const Matrix<T>*, size_t> names;
+    std::function<std::string(const detail::LazyNodePtr<T>&)> print = [&] (const detail::LazyNodePtr<T>& node) {
+      using detail::LazyOp;
+      if (node->op == LazyOp::Leaf) {
+        return "m" + std::to_string(names.emplace(node->matrix.get(), names.size()).first->second);
+      }
+      std::vector<std::string> inputs;
+      for (const auto& input : node->inputs) {
+        inputs.push_back(print(input));
+      }
+      switch (node->op) {
+        case LazyOp::Transpose: return "transpose(" + inputs[0] + ")";
+        case LazyOp::Product: return "dot(" + inputs[0] + ", " + inputs[1] + ")";
+        case LazyOp::Inverse: return "inverse(" + inputs[0] + ")";
+        case LazyOp::Gram: return "gram(" + inputs[0] + ")";
+        case LazyOp::RowGram: return "row_gram(" + inputs[0] + ")";
+        case LazyOp::Solve: return "solve(" + inputs[0] + ", " + inputs[1] + ")";
+        default: break;
+      }
+      std::ostringstream out;
+      out << "fused(";
+      for (const auto& step : node->program) {
+        switch (step.op) {
+          case LazyOp::Leaf: out << inputs[step.input]; break;
+          case LazyOp::Add: out << "+"; break;
+          case LazyOp::Subtract: out << "-"; break;
+          case LazyOp::Multiply: out << "*"; break;
+          case LazyOp::Divide: out << "/"; break;
+          default: out << "*" << step.scalar; break;
+        }
+        out << (&step == &node->program.back() ? ")" : " ");
+      }
+      return out.str();
+    };
+    return print(planner.optimize(node_));
+  }
+
+  const detail::LazyNodePtr<T>& node() const {
+    return node_;
+  }
+
+private:
+  explicit Lazy(std::shared_ptr<const Matrix<T>> matrix)
+      : node_(detail::make_lazy_node<T>(detail::LazyOp::Leaf, {}, matrix->GetLength(), matrix->GetWidth())) {
+    node_->matrix = std::move(matrix);
+  }
+
+  detail::LazyNodePtr<T> node_;
+};
+
+template<typename T>
+Lazy<T> lazy(const Matrix<T>& matrix) {
+  return Lazy<T>(matrix);
+}
+
+template<typename T>
+Lazy<T> lazy(Matrix<T>&& matrix) {
+  return Lazy<T>(std::move(matrix));
+}
+
+namespace detail {
+
+template<typename T>
+Lazy<T> lazy_elementwise(LazyOp op, const Lazy<T>& left, const Lazy<T>& right) {
+  if (left.GetShape() != right.GetShape()) {
+    throw std::length_error("Different shapes");
+  }
+  return Lazy<T>(make_lazy_node<T>(op, {left.node(), right.node()}, left.GetLength(), left.GetWidth()));
+}
+
+}  // namespace detail
+
+template<typename T>
+Lazy<T> operator+(const Lazy<T>& left, const Lazy<T>& right) {
+  return detail::lazy_elementwise(detail::LazyOp::Add, left, right);
+}
+
+template<typename T>
+Lazy<T> operator-(const Lazy<T>& left, const Lazy<T>& right) {
+  return detail::lazy_elementwise(detail::LazyOp::Subtract, left, right);
+}
+
+template<typename T>
+Lazy<T> operator*(const Lazy<T>& left, const Lazy<T>& right) {
+  return detail::lazy_elementwise(detail::LazyOp::Multiply, left, right);
+}
+
+template<typename T>
+Lazy<T> operator/(const Lazy<T>& left, const Lazy<T>& right) {
+  return detail::lazy_elementwise(detail::LazyOp::Divide, left, right);
+}
+
+template<typename T>
+Lazy<T> operator*(const detail::non_deduced_t<T>& scale, const Lazy<T>& matrix) {
+  auto node = detail::make_lazy_node<T>(detail::LazyOp::Scale, {matrix.node()}, matrix.GetLength(), matrix.GetWidth());
+  node->scalar = scale;
+  return Lazy<T>(node);
+}
+
+template<typename T>
+Lazy<T> operator*(const Lazy<T>& matrix, const detail::non_deduced_t<T>& scale) {
+  return scale * matrix;
+}
+
+template<typename T>
+Lazy<T> operator^(const Lazy<T>& left, const Lazy<T>& right) {
+  if (left.GetWidth() != right.GetLength()) {
+    throw std::length_error("Left width (" + std::to_string(left.GetWidth()) + ") and right length (" +
+                                             std::to_string(right.GetLength()) + ") are not equal");
+  }
+  return Lazy<T>(detail::make_lazy_node<T>(detail::LazyOp::Product, {left.node(), right.node()},
+                                           left.GetLength(), right.GetWidth()));
+}
+
+template<typename T>
+Lazy<T> transposed(const Lazy<T>& matrix) {
+  return Lazy<T>(detail::make_lazy_node<T>(detail::LazyOp::Transpose, {matrix.node()},
+                                           matrix.GetWidth(), matrix.GetLength()));
+}
+
+template<typename T>
+Lazy<T> inverse(const Lazy<T>& matrix) {
+  if (matrix.GetLength() != matrix.GetWidth()) {
+    throw std::length_error("The matrix isn't a square");
+  }
+  return Lazy<T>(detail::make_lazy_node<T>(detail::LazyOp::Inverse, {matrix.node()},
+                                           matrix.GetLength(), matrix.GetWidth()));
+}
@@ -0,0 +1,428 @@
+#pragma once
+
+#include<algorithm>
+#include<cmath>
+#include<cstdint>
+#include<cstring>
+#include<stdexcept>
+#include<type_traits>
+#include<vector>
+
+#if defined(__F16C__) || defined(__AVX512BF16__) || defined(__AVX512VNNI__)
+#include<immintrin.h>
+#endif
+
+#include "functions.h"
+
+// 16- and 8-bit storage: half (IEEE binary16), bfloat16 (the top half of a float) and int8_t
+// with a scale per row or column. Values are widened to float (int32_t for int8_t) before any
+// arithmetic, so Matrix<half> and Matrix<bfloat16> work with every element-wise operation, and
+// widened_dot multiplies them with float (int32_t) accumulators while reading a half or a
+// quarter of the bytes of Matrix<float>.
+//
+// Conversions use F16C and AVX-512 BF16, the int8 product AVX-512 VNNI, when the compiler
+// targets them (-mf16c, -mavx512bf16, -mavx512vnni or -march=native); otherwise they are done
+// in software, rounding to nearest even in both cases (the AVX-512 conversion to bfloat16
+// flushes subnormal floats to zero).
+
+namespace detail {
+
+inline uint32_t float_bits(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+inline float bits_float(uint32_t bits) {
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+inline uint16_t float_to_half_bits(float value) {
+  uint32_t x = float_bits(value);
+  uint16_t sign = static_cast<uint16_t>((x >> 16) & 0x8000);
+  uint32_t magnitude = x & 0x7fffffff;
+  if (magnitude >= 0x7f800000) {  // infinity, or a quiet NaN
+    return sign | 0x7c00 | (magnitude > 0x7f800000 ? 0x200 : 0);
+  }
+  if (magnitude >= 0x477ff000) {  // rounds past 65504
+    return sign | 0x7c00;
+  }
+  if (magnitude >= 0x38800000) {  // normal: rebias the exponent, round the mantissa to 10 bits
+    uint32_t rounded = magnitude + 0xfff + ((magnitude >> 13) & 1);
+    return sign | static_cast<uint16_t>((rounded - 0x38000000) >> 13);
+  }
+  // subnormal: the value in units of 2^-24
+  uint32_t exponent = magnitude >> 23;
+  if (exponent < 102) {
+    return sign;
+  }
+  uint32_t mantissa = (magnitude & 0x7fffff) | 0x800000;
+  uint32_t shift = 126 - exponent;
+  uint32_t res = mantissa >> shift;
+  uint32_t remainder = mantissa & ((1u << shift) - 1);
+  uint32_t halfway = 1u << (shift - 1);
+  if (remainder > halfway || (remainder == halfway && (res & 1))) {
+    ++res;
+  }
+  return sign | static_cast<uint16_t>(res);
+}
+
+inline float half_bits_to_float(uint16_t bits) {
+  uint32_t sign = static_cast<uint32_t>(bits & 0x8000) << 16;
+  uint32_t exponent = (bits >> 10) & 0x1f;
+  uint32_t mantissa = bits & 0x3ff;
+  if (exponent == 0) {
+    float value = std::ldexp(static_cast<float>(mantissa), -24);
+    return sign ? -value : value;
+  }
+  if (exponent == 31) {  // NaNs come out quiet, as from F16C
+    return bits_float(sign | 0x7f800000 | (mantissa << 13) | (mantissa != 0 ? 0x400000 : 0));
+  }
+  return bits_float(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+inline uint16_t float_to_bfloat16_bits(float value) {
+  uint32_t x = float_bits(value);
+  if ((x & 0x7fffffff) > 0x7f800000) {
+    return static_cast<uint16_t>((x >> 16) | 0x40);
+  }
+  return static_cast<uint16_t>((x + 0x7fff + ((x >> 16) & 1)) >> 16);
+}
+
+}  // namespace detail
+
+// IEEE binary16: 5 exponent bits, 10 mantissa bits, up to 65504.
+// Default construction leaves the value unset like a float; half() is zero
+struct half {
+  uint16_t bits;
+
+  half() = default;
+
+  half(float value) {
+#if defined(__F16C__)
+    bits = static_cast<uint16_t>(_cvtss_sh(value, _MM_FROUND_TO_NEAREST_INT));
+#else
+    bits = detail::float_to_half_bits(value);
+#endif
+  }
+
+  operator float() const {
+#if defined(__F16C__)
+    return _cvtsh_ss(bits);
+#else
+    return detail::half_bits_to_float(bits);
+#endif
+  }
+
+  static half from_bits(uint16_t bits) {
+    half res;
+    res.bits = bits;
+    return res;
+  }
+};
+
+// the top 16 bits of a float: the range of float with 8 mantissa bits
+struct bfloat16 {
+  uint16_t bits;
+
+  bfloat16() = default;
+
+  bfloat16(float value) : bits(detail::float_to_bfloat16_bits(value)) {}
+
+  operator float() const {
+    return detail::bits_float(static_cast<uint32_t>(bits) << 16);
+  }
+
+  static bfloat16 from_bits(uint16_t bits) {
+    bfloat16 res;
+    res.bits = bits;
+    return res;
+  }
+};
+
+// the type widened_dot accumulates a storage type in
+template<typename T>
+struct accumulator {
+  using type = T;
+};
+
+template<>
+struct accumulator<half> {
+  using type = float;
+};
+
+template<>
+struct accumulator<bfloat16> {
+  using type = float;
+};
+
+template<>
+struct accumulator<int8_t> {
+  using type = int32_t;
+};
+
+template<typename T>
+using accumulator_t = typename accumulator<T>::type;
+
+// int8_t values with one float scale per row (per_row) or per column: element (i, j) stands
+// for values(i, j) * scales[per_row ? i : j]
+struct QuantizedMatrix {
+  Matrix<int8_t> values;
+  std::vector<float> scales;
+  bool per_row = true;
+};
+
+namespace detail {
+
+template<>
+struct ElementConverter<half, float> {
+  static void convert(const float* source, half* out, size_t n) {
+    size_t i = 0;
+#if defined(__F16C__)
+    for (; i + 8 <= n; i += 8) {
+      __m128i packed = _mm256_cvtps_ph(_mm256_loadu_ps(source + i), _MM_FROUND_TO_NEAREST_INT);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), packed);
+    }
+#endif
+    for (; i < n; ++i) {
+      out[i] = half(source[i]);
+    }
+  }
+};
+
+template<>
+struct ElementConverter<float, half> {
+  static void convert(const half* source, float* out, size_t n) {
+    size_t i = 0;
+#if defined(__F16C__)
+    for (; i + 8 <= n; i += 8) {
+      __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+      _mm256_storeu_ps(out + i, _mm256_cvtph_ps(packed));
+    }
+#endif
+    for (; i < n; ++i) {
+      out[i] = static_cast<float>(source[i]);
+    }
+  }
+};
+
+template<>
+struct ElementConverter<bfloat16, float> {
+  static void convert(const float* source, bfloat16* out, size_t n) {
+    size_t i = 0;
+#if defined(__AVX512BF16__) && defined(__AVX512F__)
+    for (; i + 16 <= n; i += 16) {
+      __m256bh packed = _mm512_cvtneps_pbh(_mm512_loadu_ps(source + i));
+      std::memcpy(out + i, &packed, sizeof(packed));
+    }
+#endif
+    for (; i < n; ++i) {
+      out[i] = bfloat16(source[i]);
+    }
+  }
+};
+
+template<>
+struct ElementConverter<float, bfloat16> {
+  static void convert(const bfloat16* source, float* out, size_t n) {
+    // a shift per element, vectorized by the compiler
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = bits_float(static_cast<uint32_t>(source[i].bits) << 16);
+    }
+  }
+};
+
+template<typename S>
+constexpr bool is_low_precision_v = std::is_same_v<S, half> || std::is_same_v<S, bfloat16> ||
+                                    std::is_same_v<S, int8_t>;
+
+// C[first:last, :] += A[first:last, :] * B with A and B in half or bfloat16 and C in float.
+// Panels of B are widened once per thread, rows of A once per panel
+template<typename S>
+void widened_gemm_kernel(size_t first, size_t last, const Matrix<S>& a, const Matrix<S>& b, Matrix<float>& c) {
+  size_t depth = a.GetWidth();
+  size_t width = b.GetWidth();
+  std::vector<float> panel(gemm_depth * gemm_columns);
+  std::vector<float> a_row(gemm_depth);
+  for (size_t jj = 0; jj < width; jj += gemm_columns) {
+    size_t columns = std::min(width, jj + gemm_columns) - jj;
+    for (size_t pp = 0; pp < depth; pp += gemm_depth) {
+      size_t p_count = std::min(depth, pp + gemm_depth) - pp;
+      for (size_t p = 0; p < p_count; ++p) {
+        ElementConverter<float, S>::convert(b.data() + (pp + p) * width + jj, panel.data() + p * columns, columns);
+      }
+      for (size_t i = first; i < last; ++i) {
+        ElementConverter<float, S>::convert(a.data() + i * depth + pp, a_row.data(), p_count);
+        float* c_row = c.data() + i * width + jj;
+        for (size_t p = 0; p < p_count; ++p) {
+          float factor = a_row[p];
+          if (factor == 0.0f) {
+            continue;
+          }
+          const float* b_row = panel.data() + p * columns;
+          for (size_t j = 0; j < columns; ++j) {
+            c_row[j] += factor * b_row[j];
+          }
+        }
+      }
+    }
+  }
+}
+
+// sum of a[i] * b[i] in int32_t. `b_sum` is the sum of b: VNNI multiplies unsigned by signed
+// bytes, so a is offset by 128 and 128 * b_sum taken back
+inline int32_t int8_dot(const int8_t* a, const int8_t* b, size_t n, int32_t b_sum) {
+#if defined(__AVX512VNNI__) && defined(__AVX512BW__)
+  __m512i acc = _mm512_setzero_si512();
+  __m512i offset = _mm512_set1_epi8(static_cast<char>(0x80));
+  for (size_t i = 0; i < n; i += 64) {
+    __mmask64 mask = n - i >= 64 ? ~__mmask64(0) : (__mmask64(1) << (n - i)) - 1;
+    // masked out bytes are 0 in b, so the offset adds nothing there
+    __m512i x = _mm512_xor_si512(_mm512_maskz_loadu_epi8(mask, a + i), offset);
+    __m512i y = _mm512_maskz_loadu_epi8(mask, b + i);
+    acc = _mm512_dpbusd_epi32(acc, x, y);
+  }
+  int32_t lanes[16];
+  _mm512_storeu_si512(lanes, acc);
+  int32_t res = 0;
+  for (int32_t lane : lanes) {
+    res += lane;
+  }
+  return res - 128 * b_sum;
+#else
+  (void)b_sum;
+  int32_t res = 0;
+  for (size_t i = 0; i < n; ++i) {
+    res += static_cast<int32_t>(a[i]) * static_cast<int32_t>(b[i]);
+  }
+  return res;
+#endif
+}
+
+// columns of B per block of the int8 kernel: their transposed rows stay in L2
+constexpr size_t int8_columns = 64;
+
+// A * B in int32_t: every element is a dot product of a row of A and a row of B^T
+inline Matrix<int32_t> int8_product(const Matrix<int8_t>& a, const Matrix<int8_t>& b) {
+  size_t length = a.GetLength();
+  size_t depth = a.GetWidth();
+  size_t width = b.GetWidth();
+  Matrix<int8_t> b_transposed = transposed(b);
+  std::vector<int32_t> sums(width);
+  for (size_t j = 0; j < width; ++j) {
+    const int8_t* row = b_transposed.data() + j * depth;
+    for (size_t p = 0; p < depth; ++p) {
+      sums[j] += row[p];
+    }
+  }
+  Matrix<int32_t> res = Matrix<int32_t>::uninitialized(length, width);
+  split_range(length, length * depth * width, [&] (size_t first, size_t last) {
+    for (size_t jj = 0; jj < width; jj += int8_columns) {
+      size_t j_end = std::min(width, jj + int8_columns);
+      for (size_t i = first; i < last; ++i) {
+        const int8_t* a_row = a.data() + i * depth;
+        for (size_t j = jj; j < j_end; ++j) {
+          res.data()[i * width + j] = int8_dot(a_row, b_transposed.data() + j * depth, depth, sums[j]);
+        }
+      }
+    }
+  });
+  return res;
+}
+
+}  // namespace detail
+
+
+// left * right with accumulation in accumulator_t<S>: float for half and bfloat16, int32_t
+// for int8_t. The result is row-major
+template<typename S>
+Matrix<accumulator_t<S>> widened_dot(const Matrix<S>& left, const Matrix<S>& right) {
+  static_assert(detail::is_low_precision_v<S>, "widened_dot takes half, bfloat16 or int8_t");
+  if (left.GetWidth() != right.GetLength()) {
+    throw std::length_error("Shapes do not match");
+  }
+  size_t length = left.GetLength();
+  size_t depth = left.GetWidth();
+  size_t width = right.GetWidth();
+  ProfileScope profile("widened_dot", 2 * length * depth * width,
+                       (length * depth + depth * width) * sizeof(S) + length * width * sizeof(accumulator_t<S>));
+  Matrix<S> left_copy, right_copy;
+  const Matrix<S>& a = detail::row_major(left, left_copy);
+  const Matrix<S>& b = detail::row_major(right, right_copy);
+  if constexpr (std::is_same_v<S, int8_t>) {
+    return detail::int8_product(a, b);
+  } else {
+    Matrix<float> res(length, width);
+    detail::split_range(length, length * depth * width, [&] (size_t first, size_t last) {
+      detail::widened_gemm_kernel(first, last, a, b, res);
+    });
+    return res;
+  }
+}
+
+// Symmetric quantization: every row (or column) is scaled so that its largest magnitude
+// becomes 127, and rounded. The error of an element is at most half its scale
+template<typename T>
+QuantizedMatrix quantize(const Matrix<T>& matrix, bool per_row = true) {
+  Matrix<T> copy;
+  const Matrix<T>& source = detail::row_major(matrix, copy);
+  size_t length = source.GetLength();
+  size_t width = source.GetWidth();
+  QuantizedMatrix res;
+  res.per_row = per_row;
+  res.values = Matrix<int8_t>::uninitialized(length, width);
+  res.scales.assign(per_row ? length : width, 0.0f);
+  for (size_t i = 0; i < length; ++i) {
+    for (size_t j = 0; j < width; ++j) {
+      float& scale = res.scales[per_row ? i : j];
+      scale = std::max(scale, static_cast<float>(std::abs(static_cast<float>(source(i, j)))));
+    }
+  }
+  for (float& scale : res.scales) {
+    scale /= 127.0f;
+  }
+  detail::split_range(length, length * width, [&] (size_t first, size_t last) {
+    for (size_t i = first; i < last; ++i) {
+      for (size_t j = 0; j < width; ++j) {
+        float scale = res.scales[per_row ? i : j];
+        float value = scale == 0.0f ? 0.0f : std::nearbyint(static_cast<float>(source(i, j)) / scale);
+        res.values.data()[i * width + j] = static_cast<int8_t>(std::clamp(value, -127.0f, 127.0f));
+      }
+    }
+  }, detail::vector_parallel_threshold);
+  return res;
+}
+
+inline Matrix<float> dequantize(const QuantizedMatrix& matrix) {
+  size_t length = matrix.values.GetLength();
+  size_t width = matrix.values.GetWidth();
+  Matrix<float> res = Matrix<float>::uninitialized(length, width);
+  for (size_t i = 0; i < length; ++i) {
+    for (size_t j = 0; j < width; ++j) {
+      res.data()[i * width + j] = matrix.values.data()[i * width + j] * matrix.scales[matrix.per_row ? i : j];
+    }
+  }
+  return res;
+}
+
+// left * right from int8_t values: `left` has to be scaled per row and `right` per column,
+// so that the scales factor out of the int32_t dot products
+inline Matrix<float> quantized_dot(const QuantizedMatrix& left, const QuantizedMatrix& right) {
+  if (!left.per_row || right.per_row) {
+    throw std::invalid_argument("The left matrix needs a scale per row and the right one a scale per column");
+  }
+  Matrix<int32_t> products = widened_dot(left.values, right.values);
+  size_t length = products.GetLength();
+  size_t width = products.GetWidth();
+  Matrix<float> res = Matrix<float>::uninitialized(length, width);
+  detail::split_range(length, length * width, [&] (size_t first, size_t last) {
+    for (size_t i = first; i < last; ++i) {
+      for (size_t j = 0; j < width; ++j) {
+        res.data()[i * width + j] = products.data()[i * width + j] * (left.scales[i] * right.scales[j]);
+      }
+    }
+  }, detail::vector_parallel_threshold);
+  return res;
+}
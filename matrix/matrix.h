@@ -12,6 +12,13 @@
 #include<random>
 #include<iomanip>
 
+#include "profiling.h"
+#include "numa.h"
+
+// Order of the elements in the buffer: row by row (the default) or column by column.
+// Kernels pick the loop order that walks the buffer contiguously.
+enum class Layout { RowMajor, ColumnMajor };
+
 template <typename T>
 class Matrix {
 public:
@@ -24,12 +31,13 @@ public:
     if (matrix.empty()) {
       width_ = 0;
       length_ = 0;
-      matrix_ = std::vector<T>();
+      matrix_ = Buffer();
     }
     else {
       width_ = matrix[0].size();
       length_ = matrix.size();
       matrix_.resize(width_ * length_);
+      profile_allocation(matrix_.size() * sizeof(T));
       for (size_t i = 0; i < length_; ++i) {
         for (size_t j = 0; j < width_; ++j) {
           matrix_[i*width_ + j] = matrix[i][j];
@@ -42,12 +50,13 @@ public:
     if (matrix.empty()) {
       width_ = 0;
       length_ = 0;
-      matrix_ = std::vector<T>();
+      matrix_ = Buffer();
     }
     else {
       width_ = matrix[0].size();
       length_ = matrix.size();
       matrix_.resize(width_ * length_);
+      profile_allocation(matrix_.size() * sizeof(T));
       for (size_t i = 0; i < length_; ++i) {
         for (size_t j = 0; j < width_; ++j) {
           matrix_[i * width_ + j] = matrix[i][j];
@@ -57,24 +66,64 @@ public:
   }
 
   explicit Matrix(const size_t& h, const size_t& w) {
-    T default_value = T();
     width_ = w;
     length_ = h;
-    matrix_ = std::vector<T>(h * w, default_value);
+    // allocated untouched, then zeroed by the threads that will work on each half
+    matrix_.resize(h * w);
+    profile_allocation(matrix_.size() * sizeof(T));
+    detail::parallel_fill(matrix_.data(), matrix_.size(), T());
   }
 
   explicit Matrix(const size_t& n) : Matrix(n, n) {}
 
+  explicit Matrix(const size_t& h, const size_t& w, Layout layout) : Matrix(h, w) {
+    layout_ = layout;
+  }
+
+  // h x w without the zero fill, for results whose every element is written next. Elements of
+  // a trivial type are indeterminate until then; the pages go to the nodes of the writing threads
+  static Matrix uninitialized(const size_t& h, const size_t& w, Layout layout = Layout::RowMajor) {
+    Matrix matrix;
+    matrix.width_ = w;
+    matrix.length_ = h;
+    matrix.layout_ = layout;
+    matrix.matrix_.resize(h * w);
+    profile_allocation(matrix.matrix_.size() * sizeof(T));
+    return matrix;
+  }
+
   Matrix(const Matrix& other) {
-    matrix_ = other.matrix_;
+    matrix_.resize(other.matrix_.size());
+    profile_allocation(matrix_.size() * sizeof(T));
+    detail::parallel_copy(matrix_.data(), other.matrix_.data(), matrix_.size());
     width_ = other.width_;
     length_ = other.length_;
+    layout_ = other.layout_;
   }
 
   Matrix(Matrix&& other) {
     matrix_ = std::move(other.matrix_);
     width_ = other.width_;
     length_ = other.length_;
+    layout_ = other.layout_;
+  }
+
+
+  // a copy of a buffer of h * w elements, e.g. column-major data from Fortran code. The
+  // buffer isn't adopted: the copy places the pages like those of any other matrix
+  static Matrix from_buffer(const size_t& h, const size_t& w, const std::vector<T>& values,
+                            Layout layout = Layout::RowMajor) {
+    if (values.size() != h * w) {
+      throw std::length_error("Buffer size doesn't match the shape");
+    }
+    Matrix matrix;
+    matrix.width_ = w;
+    matrix.length_ = h;
+    matrix.matrix_.resize(values.size());
+    profile_allocation(values.size() * sizeof(T));
+    detail::parallel_copy(matrix.matrix_.data(), values.data(), values.size());
+    matrix.layout_ = layout;
+    return matrix;
   }
 
 
@@ -90,25 +139,74 @@ public:
     return std::make_pair(length_, width_);
   }
 
+  Layout layout() const {
+    return layout_;
+  }
+
+  // distance in the buffer between (i, j) and (i + 1, j)
+  size_t row_stride() const {
+    return layout_ == Layout::RowMajor ? width_ : 1;
+  }
+
+  // distance in the buffer between (i, j) and (i, j + 1)
+  size_t column_stride() const {
+    return layout_ == Layout::RowMajor ? 1 : length_;
+  }
+
+  // reorders the buffer, the matrix stays the same
+  void set_layout(Layout layout) {
+    if (layout == layout_) {
+      return;
+    }
+    if (layout_ == Layout::RowMajor) {
+      transpose_buffer();
+      std::swap(length_, width_);
+    } else {
+      std::swap(length_, width_);
+      transpose_buffer();
+    }
+    layout_ = layout;
+  }
+
+  // Transposes in O(1): the buffer is read in the other layout. A column-major matrix
+  // becomes its row-major transpose and vice versa
+  void transpose_layout() {
+    std::swap(length_, width_);
+    layout_ = layout_ == Layout::RowMajor ? Layout::ColumnMajor : Layout::RowMajor;
+  }
+
+
+  T* data() {
+    return matrix_.data();
+  }
+
+  const T* data() const {
+    return matrix_.data();
+  }
+
 
   T operator()(const size_t& row, const size_t& column) const {
-    return matrix_[width_ * row + column];
+    return matrix_[index(row, column)];
   }
 
   T& operator()(const size_t& row, const size_t& column) {
-    return matrix_[width_ * row + column];
+    return matrix_[index(row, column)];
   }
 
   Matrix get_row(const size_t& row) const {
-    Matrix matrix(1, width_);
+    Matrix matrix = uninitialized(1, width_);
     for (size_t i = 0; i < width_; ++i) {
-      matrix(0, i) = matrix_[row * width_ + i];
+      matrix(0, i) = matrix_[index(row, i)];
     }
     return matrix;
   }
 
   Matrix get_column(const size_t& column) const {
-    Matrix matrix(length_, 1);
+    Matrix matrix = uninitialized(length_, 1);
+    if (layout_ == Layout::ColumnMajor) {
+      std::copy_n(matrix_.begin() + column * length_, length_, matrix.matrix_.begin());
+      return matrix;
+    }
     for (size_t i = 0; i < length_; ++i) {
       matrix(i, 0) = matrix_[column + i * width_];
     }
@@ -121,31 +219,41 @@ public:
       throw std::out_of_range("Specified submatrix doesn't exist");
     }
 
-    Matrix matrix(end_row - start_row + 1, end_column - start_column + 1);
+    Matrix matrix = uninitialized(end_row - start_row + 1, end_column - start_column + 1, layout_);
     size_t n_threads = 2;
-    size_t new_width = matrix.width_;
-    size_t new_length = matrix.length_;
+    // rows of a row-major submatrix (columns of a column-major one) are contiguous in both buffers
+    bool by_rows = layout_ == Layout::RowMajor;
+    size_t outer = by_rows ? matrix.length_ : matrix.width_;
+    size_t inner = by_rows ? matrix.width_ : matrix.length_;
     std::vector<std::thread> threads;
+    ProfilePhase spawn(ProfilePhase::Spawn, n_threads);
     for (size_t k = 0; k < n_threads; ++k) {
       threads.emplace_back([&] (const size_t& id) {
-        for (size_t i = id * new_length / n_threads; i < (id + 1) * new_length / n_threads; ++i) {
-          for (size_t j = 0; j < new_width; ++j) {
-            matrix(i, j) = matrix_[(i + start_row) * width_ + (j + start_column)];
-          }
+        for (size_t i = id * outer / n_threads; i < (id + 1) * outer / n_threads; ++i) {
+          size_t first = by_rows ? index(start_row + i, start_column) : index(start_row, start_column + i);
+          std::copy_n(matrix_.begin() + first, inner, matrix.matrix_.begin() + i * inner);
         }
       }, k);
     }
-    for (auto& t : threads) {
-      t.join();
-    }
+    spawn.finish();
+    join_threads(threads);
     return matrix;
   }
 
 
   Matrix& operator=(const Matrix& other) {
-    matrix_ = other.matrix_;
+    if (this == &other) {
+      return *this;
+    }
+    if (matrix_.capacity() < other.matrix_.size()) {
+      profile_allocation(other.matrix_.size() * sizeof(T));
+      matrix_ = Buffer();  // the new buffer is first touched by the copy below
+    }
+    matrix_.resize(other.matrix_.size());
+    detail::parallel_copy(matrix_.data(), other.matrix_.data(), matrix_.size());
     width_ = other.width_;
     length_ = other.length_;
+    layout_ = other.layout_;
     return *this;
   }
 
@@ -153,6 +261,7 @@ public:
     matrix_ = std::move(other.matrix_);
     width_ = other.width_;
     length_ = other.length_;
+    layout_ = other.layout_;
     return *this;
   }
 
@@ -160,18 +269,28 @@ public:
   bool operator==(const Matrix& other) const {
     if (width_ != other.width_ || length_ != other.length_)
       return false;
-    bool almost_equal = true;
+    // |a - b| <= eps * |b|: a zero in `other` has to be matched exactly
+    // (allclose in reductions.h takes an absolute tolerance as well)
     double eps = 1e-4;
-    for (size_t i = 0; i < length_ && almost_equal; ++i) {
+    auto close = [eps] (T a, T b) {
+      return !(double(1) * std::abs(a - b) > eps * std::abs(double(1) * b));
+    };
+    if (layout_ == other.layout_) {
+      for (size_t i = 0; i < matrix_.size(); ++i) {
+        if (!close(matrix_[i], other.matrix_[i])) {
+          return false;
+        }
+      }
+      return true;
+    }
+    for (size_t i = 0; i < length_; ++i) {
       for (size_t j = 0; j < width_; ++j) {
-        if (double(1) * std::abs(matrix_[i * width_ + j] - other.matrix_[i * width_ + j]) /
-            std::abs(other.matrix_[i * width_ + j]) > eps) {
-          almost_equal = false;
-          break;
+        if (!close(matrix_[index(i, j)], other.matrix_[other.index(i, j)])) {
+          return false;
         }
       }
     }
-    return almost_equal;
+    return true;
   }
 
   bool operator!=(const Matrix& other) const {
@@ -215,64 +334,150 @@ public:
   }
 
 
+  // axis=0 appends in place and grows the buffer geometrically, like std::vector,
+  // so appending row batches one by one is amortized linear
+  // A column-major matrix grows in place along axis=1 instead
   Matrix& concatenate(const Matrix& other, size_t axis=0) {
-    if (axis == 0) {
-      if (width_ != other.width_) {
-        throw std::length_error("Different shapes");
-      }
-      std::vector<T> new_matrix(length_ * width_ + other.length_ * other.width_);
-      for (size_t i = 0; i < length_ * width_; ++i) {
-        new_matrix[i] = matrix_[i];
-      }
-      for (size_t i = 0; i < other.length_ * other.width_; ++i) {
-        new_matrix[i + length_ * width_] = other.matrix_[i];
-      }
-      matrix_ = new_matrix;
-      length_ += other.length_;
+    if (this == &other) {
+      return concatenate(Matrix(other), axis);
     }
-    else {
-      if (length_ != other.length_) {
-        throw std::length_error("Different shapes");
-      }
-      std::vector<T> new_matrix(length_ * width_ + other.length_ * other.width_);
-      for (size_t i = 0; i < length_ * width_; ++i) {
-        new_matrix[(i / width_) * (width_ + other.width_) + i % width_] = matrix_[i];
-      }
-      for (size_t i = 0; i < other.length_ * other.width_; ++i) {
-        new_matrix[(i / other.width_) * (width_ + other.width_) + width_ + i % other.width_] = other.matrix_[i];
-      }
-      matrix_ = new_matrix;
-      width_ += other.width_;
+    if (axis == 0 ? width_ != other.width_ : length_ != other.length_) {
+      throw std::length_error("Different shapes");
+    }
+    if (other.layout_ != layout_) {
+      Matrix converted = other;
+      converted.set_layout(layout_);
+      return concatenate(converted, axis);
+    }
+    if (layout_ == Layout::ColumnMajor) {
+      // the buffers hold the row-major transposes, whose axes are swapped
+      std::swap(length_, width_);
+      append(other.matrix_, other.width_, other.length_, 1 - axis);
+      std::swap(length_, width_);
+    } else {
+      append(other.matrix_, other.length_, other.width_, axis);
     }
     return *this;
   }
 
+  // reserves the buffer for `rows` rows, so that appends up to that size don't reallocate
+  void reserve(const size_t& rows) {
+    if (matrix_.capacity() < rows * width_) {
+      profile_allocation(rows * width_ * sizeof(T));
+    }
+    matrix_.reserve(rows * width_);
+  }
+
+  size_t capacity() const {
+    return width_ == 0 ? 0 : matrix_.capacity() / width_;
+  }
+
   bool empty() const {
     return matrix_.empty();
   }
 
+  // Reuses the buffer if it is large enough. The elements of the old buffer that fit are kept in
+  // storage order (so a row-major matrix that only gains or loses rows keeps the others), the new
+  // ones are unspecified
+  void resize(const size_t& h, const size_t& w) {
+    if (matrix_.capacity() < h * w) {
+      profile_allocation(h * w * sizeof(T));
+    }
+    matrix_.resize(h * w);
+    length_ = h;
+    width_ = w;
+  }
+
+  void resize(const size_t& h, const size_t& w, Layout layout) {
+    resize(h, w);
+    layout_ = layout;
+  }
+
   Matrix& row_addition(size_t i, size_t j, T k) {
-    for (size_t x = 0; x < width_; ++x) {
-      matrix_[i * width_ + x] += k * matrix_[j * width_ + x];
+    return row_addition(i, j, k, 0, width_);
+  }
+
+  Matrix& row_multiplication(size_t i, T k) {
+    return row_multiplication(i, k, 0, width_);
+  }
+
+  Matrix& row_switching(size_t i, size_t j) {
+    return row_switching(i, j, 0, width_);
+  }
+
+  // The same operations on columns [column_begin, column_end) only. Elimination passes the
+  // columns right of the pivot: the ones to the left are zero in the pivot row already
+  Matrix& row_addition(size_t i, size_t j, T k, size_t column_begin, size_t column_end) {
+    if (layout_ == Layout::ColumnMajor) {
+      for (size_t x = column_begin; x < column_end; ++x) {
+        matrix_[i + x * length_] += k * matrix_[j + x * length_];
+      }
+      return *this;
     }
+    add_scaled(matrix_.data() + i * width_ + column_begin, matrix_.data() + j * width_ + column_begin, k,
+               column_end - column_begin);
     return *this;
   }
 
-  Matrix& row_multiplication(size_t i, T k) {
-    for (size_t x = 0; x < width_; ++x) {
-      matrix_[i*width_ + x] *= k;
+  Matrix& row_multiplication(size_t i, T k, size_t column_begin, size_t column_end) {
+    if (layout_ == Layout::ColumnMajor) {
+      for (size_t x = column_begin; x < column_end; ++x) {
+        matrix_[i + x * length_] *= k;
+      }
+      return *this;
+    }
+    T* row = matrix_.data() + i * width_;
+    for (size_t x = column_begin; x < column_end; ++x) {
+      row[x] *= k;
     }
     return *this;
   }
 
-  Matrix& row_switching(size_t i, size_t j) {
-    for (size_t x = 0; x < width_; ++x) {
-      std::swap(matrix_[i * width_ + x], matrix_[j * width_ + x]);
+  Matrix& row_switching(size_t i, size_t j, size_t column_begin, size_t column_end) {
+    if (layout_ == Layout::ColumnMajor) {
+      for (size_t x = column_begin; x < column_end; ++x) {
+        std::swap(matrix_[i + x * length_], matrix_[j + x * length_]);
+      }
+      return *this;
+    }
+    std::swap_ranges(matrix_.begin() + i * width_ + column_begin, matrix_.begin() + i * width_ + column_end,
+                     matrix_.begin() + j * width_ + column_begin);
+    return *this;
+  }
+
+  // Row r += factors[r - first] * row j for every r in [first, last), j outside of the range.
+  // One pass over the targets per block of columns, so the block of row j stays in L1
+  // instead of being reloaded for every target row
+  Matrix& rows_addition(size_t first, size_t last, size_t j, const T* factors,
+                        size_t column_begin, size_t column_end) {
+    if (layout_ == Layout::ColumnMajor) {
+      // the targets of one column are contiguous
+      for (size_t x = column_begin; x < column_end; ++x) {
+        T* column = matrix_.data() + x * length_;
+        T pivot = column[j];
+        for (size_t r = first; r < last; ++r) {
+          column[r] += factors[r - first] * pivot;
+        }
+      }
+      return *this;
+    }
+    const T* pivot = matrix_.data() + j * width_;
+    for (size_t block = column_begin; block < column_end; block += row_block) {
+      size_t count = std::min(row_block, column_end - block);
+      for (size_t r = first; r < last; ++r) {
+        add_scaled(matrix_.data() + r * width_ + block, pivot + block, factors[r - first], count);
+      }
     }
     return *this;
   }
 
   Matrix& column_addition(size_t i, size_t j, T k) {
+    if (layout_ == Layout::ColumnMajor) {
+      for (size_t x = 0; x < length_; ++x) {
+        matrix_[i * length_ + x] += k * matrix_[j * length_ + x];
+      }
+      return *this;
+    }
     for (size_t x = 0; x < length_; ++x) {
       matrix_[i + x * width_] += k * matrix_[j + x * width_];
     }
@@ -280,6 +485,12 @@ public:
   }
 
   Matrix& column_multiplication(size_t i, T k) {
+    if (layout_ == Layout::ColumnMajor) {
+      for (size_t x = 0; x < length_; ++x) {
+        matrix_[i * length_ + x] *= k;
+      }
+      return *this;
+    }
     for (size_t x = 0; x < length_; ++x) {
       matrix_[i + x * width_] *= k;
     }
@@ -287,6 +498,11 @@ public:
   }
 
   Matrix& column_switching(size_t i, size_t j) {
+    if (layout_ == Layout::ColumnMajor) {
+      std::swap_ranges(matrix_.begin() + i * length_, matrix_.begin() + (i + 1) * length_,
+                       matrix_.begin() + j * length_);
+      return *this;
+    }
     for (size_t x = 0; x < length_; ++x) {
       std::swap(matrix_[i + x * width_], matrix_[j + x * width_]);
     }
@@ -294,11 +510,57 @@ public:
   }
 
 
+  // keeps the layout
   void transpose() {
+    ProfileScope profile("transpose", 0, 2 * matrix_.size() * sizeof(T));
+    if (layout_ == Layout::ColumnMajor) {
+      // the buffer holds the row-major transpose
+      std::swap(length_, width_);
+      transpose_buffer();
+      std::swap(length_, width_);
+    } else {
+      transpose_buffer();
+    }
+  }
+
+
+  void fill_random(const T& range_low, const T& range_high) {
+    size_t n_threads = 2;
+    std::vector<std::thread> threads;
+
+    static std::random_device rd;
+    static std::mt19937 gen(rd());
+    std::uniform_real_distribution<> distrib(range_low, range_high);
+
+    size_t size = matrix_.size();
+    ProfilePhase spawn(ProfilePhase::Spawn, n_threads);
+    for (size_t k = 0; k < n_threads; ++k) {
+      threads.emplace_back([&] (size_t id) {
+        for (size_t i = id * size / n_threads; i < (id + 1) * size / n_threads; ++i) {
+          matrix_[i] = distrib(gen);
+        }
+      }, k);
+    }
+    spawn.finish();
+    join_threads(threads);
+  }
+
+
+private:
+  // value-initialization leaves the elements unwritten (see numa.h)
+  using Buffer = std::vector<T, detail::FirstTouchAllocator<T>>;
+
+  size_t index(const size_t& row, const size_t& column) const {
+    return layout_ == Layout::RowMajor ? row * width_ + column : column * length_ + row;
+  }
+
+  // transposes the buffer as a row-major length_ x width_ matrix and swaps the shape
+  void transpose_buffer() {
     size_t n_threads = 2;
     std::vector<std::thread> threads;
 
     if (length_ == width_) {  // интуитивный алгоритм для квадратных матриц
+      ProfilePhase spawn(ProfilePhase::Spawn, n_threads);
       for (size_t k = 0; k < n_threads; ++k) {
         threads.emplace_back([&] (size_t id) {
           for (size_t i = id * length_ / n_threads; i < (id + 1) * length_ / n_threads; ++i) {
@@ -310,9 +572,8 @@ public:
           }
         }, k);
       }
-      for (auto& t: threads) {
-        t.join();
-      }
+      spawn.finish();
+      join_threads(threads);
     } else if (length_ > 1 && width_ > 1) {  // эффективно для прямоугольных матриц
       std::vector<size_t> cycles;                        // не вышло сделать полностью in-place
       std::vector<bool> visited(matrix_.size(), false);  // вектор visited нужен, чтобы найти циклы в перестановке
@@ -331,6 +592,7 @@ public:
         used[i].store(false);
       }
 
+      ProfilePhase spawn(ProfilePhase::Spawn, n_threads);
       for (size_t k = 0; k < n_threads; ++k) {
         threads.emplace_back([&] (size_t id) {
           while (true) {
@@ -346,43 +608,78 @@ public:
           }
         }, k);
       }
-      for (auto& t: threads) {
-        t.join();
-      }
+      spawn.finish();
+      join_threads(threads);
     }
     std::swap(length_, width_);
   }
 
 
-  void fill_random(const T& range_low, const T& range_high) {
-    size_t n_threads = 2;
+  // axis=0 appends `other` below (in place), axis=1 appends it on the right, as a row-major buffer
+  void append(const Buffer& other, size_t other_length, size_t other_width, size_t axis) {
+    if (axis == 0) {
+      size_t capacity = matrix_.capacity();
+      matrix_.insert(matrix_.end(), other.begin(), other.end());
+      if (matrix_.capacity() != capacity) {
+        profile_allocation(matrix_.capacity() * sizeof(T));
+      }
+      length_ += other_length;
+      return;
+    }
+    size_t new_width = width_ + other_width;
+    Buffer new_matrix(length_ * new_width);
+    profile_allocation(new_matrix.size() * sizeof(T));
+    size_t n_threads = length_ * new_width > (1 << 16) ? 2 : 1;
     std::vector<std::thread> threads;
-
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    std::uniform_real_distribution<> distrib(range_low, range_high);
-
+    ProfilePhase spawn(ProfilePhase::Spawn, n_threads);
     for (size_t k = 0; k < n_threads; ++k) {
       threads.emplace_back([&] (size_t id) {
+        detail::pin_partition(id, n_threads);
         for (size_t i = id * length_ / n_threads; i < (id + 1) * length_ / n_threads; ++i) {
-          for (size_t j = 0; j < width_; ++j) {
-            matrix_[i * width_ + j] = distrib(gen);
-          }
+          auto row = new_matrix.begin() + i * new_width;
+          std::copy_n(matrix_.begin() + i * width_, width_, row);
+          std::copy_n(other.begin() + i * other_width, other_width, row + width_);
         }
       }, k);
     }
-    for (auto& t: threads) {
-      t.join();
-    }
+    spawn.finish();
+    join_threads(threads);
+    matrix_ = std::move(new_matrix);
+    width_ = new_width;
   }
 
-
-private:
-  std::vector<T> matrix_;
+  Buffer matrix_;
   size_t width_;
   size_t length_;
+  Layout layout_ = Layout::RowMajor;
+
+  // columns per block of rows_addition: 4 KiB of doubles
+  static constexpr size_t row_block = 512;
+
+  // y += k * x; a plain loop over two unit-stride arrays, the compiler vectorizes it
+  static void add_scaled(T* y, const T* x, T k, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      y[i] += k * x[i];
+    }
+  }
 };
 
+namespace detail {
+
+// `matrix` itself if it is row-major, otherwise its row-major copy in `copy`.
+// For the kernels that walk the buffer row by row
+template<typename T>
+const Matrix<T>& row_major(const Matrix<T>& matrix, Matrix<T>& copy) {
+  if (matrix.layout() == Layout::RowMajor) {
+    return matrix;
+  }
+  copy = matrix;
+  copy.set_layout(Layout::RowMajor);
+  return copy;
+}
+
+}  // namespace detail
+
 template<typename T>
 std::ostream& operator<<(std::ostream& out, const Matrix<T>& matrix) {
   if (matrix.empty()) {
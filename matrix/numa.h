@@ -0,0 +1,189 @@
+#pragma once
+
+#include<algorithm>
+#include<atomic>
+#include<fstream>
+#include<memory>
+#include<new>
+#include<string>
+#include<thread>
+#include<type_traits>
+#include<utility>
+#include<vector>
+
+#if defined(__linux__)
+#include<pthread.h>
+#include<sched.h>
+#endif
+
+#include "profiling.h"
+
+// NUMA placement without libnuma. Linux puts a page on the node of the thread that writes it
+// first, so Matrix buffers are allocated untouched and filled by the two parts the element-wise
+// kernels split their work into. With set_numa_affinity(true) part k of a parallel kernel (and of
+// the fill) runs on the cpus of node k * nodes / parts, so every thread reads the memory of its
+// own node. The nodes come from /sys/devices/system/node; elsewhere there is one node and
+// pinning does nothing.
+
+namespace detail {
+
+// below this many elements a buffer is filled by the calling thread
+constexpr size_t first_touch_threshold = 1 << 16;
+
+// "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}
+inline std::vector<int> parse_cpu_list(const std::string& list) {
+  std::vector<int> res;
+  size_t pos = 0;
+  while (pos < list.size()) {
+    size_t end = list.find(',', pos);
+    if (end == std::string::npos) {
+      end = list.size();
+    }
+    std::string range = list.substr(pos, end - pos);
+    size_t dash = range.find('-');
+    if (!range.empty() && range.find_first_not_of(" \n") != std::string::npos) {
+      int first = std::stoi(range.substr(0, dash));
+      int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+      for (int cpu = first; cpu <= last; ++cpu) {
+        res.push_back(cpu);
+      }
+    }
+    pos = end + 1;
+  }
+  return res;
+}
+
+// the cpus of every node that has any, read once
+inline const std::vector<std::vector<int>>& numa_node_cpus() {
+  static const std::vector<std::vector<int>> nodes = [] {
+    std::vector<std::vector<int>> res;
+    for (size_t node = 0;; ++node) {
+      std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+      if (!in) {
+        break;
+      }
+      std::string list;
+      std::getline(in, list);
+      std::vector<int> cpus = parse_cpu_list(list);
+      if (!cpus.empty()) {
+        res.push_back(std::move(cpus));
+      }
+    }
+    return res;
+  }();
+  return nodes;
+}
+
+inline std::atomic<bool>& numa_affinity_enabled() {
+  static std::atomic<bool> enabled{false};
+  return enabled;
+}
+
+// pins the calling thread to the cpus of `node`; false if that isn't possible here
+inline bool pin_to_node(size_t node) {
+#if defined(__linux__)
+  const auto& nodes = numa_node_cpus();
+  if (nodes.empty()) {
+    return false;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : nodes[node % nodes.size()]) {
+    if (cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  (void)node;
+  return false;
+#endif
+}
+
+// The first thing part `id` of `parts` of a parallel kernel does. Only spawned threads call it:
+// the caller's own thread is never pinned
+inline void pin_partition(size_t id, size_t parts) {
+  if (!numa_affinity_enabled().load(std::memory_order_relaxed)) {
+    return;
+  }
+  size_t nodes = std::max<size_t>(numa_node_cpus().size(), 1);
+  pin_to_node(id * nodes / parts);
+}
+
+// f(first, last) over the halves of [0, n) the element-wise operations use, each half on its
+// own thread if n is large enough
+template<typename F>
+void for_each_part(size_t n, F f) {
+  size_t n_threads = n >= first_touch_threshold ? 2 : 1;
+  if (n_threads == 1) {
+    f(size_t(0), n);
+    return;
+  }
+  size_t to_look_at = n / n_threads + (n % n_threads == 0 ? 0 : 1);
+  std::vector<std::thread> threads;
+  ProfilePhase spawn(ProfilePhase::Spawn, n_threads);
+  for (size_t k = 0; k < n_threads; ++k) {
+    threads.emplace_back([&] (size_t id) {
+      pin_partition(id, n_threads);
+      f(std::min(n, id * to_look_at), std::min(n, (id + 1) * to_look_at));
+    }, k);
+  }
+  spawn.finish();
+  join_threads(threads);
+}
+
+template<typename T>
+void parallel_fill(T* data, size_t n, const T& value) {
+  for_each_part(n, [&] (size_t first, size_t last) {
+    std::fill(data + first, data + last, value);
+  });
+}
+
+template<typename T>
+void parallel_copy(T* data, const T* source, size_t n) {
+  for_each_part(n, [&] (size_t first, size_t last) {
+    std::copy(source + first, source + last, data + first);
+  });
+}
+
+// std::allocator, except that value-initialization (vector(n), resize(n)) default-initializes:
+// a new buffer of a trivial type isn't written, so its pages are placed by whoever fills it
+template<typename T>
+struct FirstTouchAllocator : std::allocator<T> {
+  template<typename U>
+  struct rebind {
+    using other = FirstTouchAllocator<U>;
+  };
+
+  FirstTouchAllocator() = default;
+
+  template<typename U>
+  FirstTouchAllocator(const FirstTouchAllocator<U>&) noexcept {}
+
+  template<typename U>
+  void construct(U* p) noexcept(std::is_nothrow_default_constructible_v<U>) {
+    ::new(static_cast<void*>(p)) U;
+  }
+
+  template<typename U, typename... Args>
+  void construct(U* p, Args&&... args) {
+    ::new(static_cast<void*>(p)) U(std::forward<Args>(args)...);
+  }
+};
+
+}  // namespace detail
+
+// Pins the parts of the parallel kernels to NUMA nodes (off by default: on a shared machine
+// pinning can hurt more than remote reads)
+inline void set_numa_affinity(bool enabled) {
+  detail::numa_affinity_enabled().store(enabled);
+}
+
+inline bool numa_affinity() {
+  return detail::numa_affinity_enabled().load();
+}
+
+// nodes with cpus, at least 1
+inline size_t numa_nodes() {
+  return std::max<size_t>(detail::numa_node_cpus().size(), 1);
+}
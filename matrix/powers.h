@@ -0,0 +1,293 @@
+#pragma once
+
+#include<cmath>
+#include<iterator>
+#include<stdexcept>
+#include<type_traits>
+#include<utility>
+#include<vector>
+
+#include "functions.h"
+#include "reductions.h"
+
+// Powers, polynomials and the exponential of a square matrix. Every product is a gemm into a
+// buffer of a PowerWorkspace: the buffers are swapped rather than reallocated, so repeated calls
+// on matrices of the same size don't allocate. The results have the layout of the argument.
+
+// Scratch buffers for the functions below, reused between calls
+template<typename T>
+struct PowerWorkspace {
+  Matrix<T> base;
+  Matrix<T> product;
+  Matrix<T> u;
+  Matrix<T> v;
+  std::vector<Matrix<T>> powers;
+  SolverWorkspace<T> solver;
+};
+
+namespace detail {
+
+// Padé approximants of exp: the degrees and the largest 1-norm of A each one is accurate
+// for in double precision (Higham, "The scaling and squaring method for the matrix
+// exponential revisited", 2005)
+constexpr size_t pade_degrees[] = {3, 5, 7, 9, 13};
+constexpr double pade_theta[] = {1.495585217958292e-2, 2.539398330063230e-1, 9.504178996162932e-1,
+                                 2.097847961257068e0, 5.371920351148152e0};
+// numerator coefficients, b_0 first; the denominator is the same with odd terms negated
+constexpr double pade3[] = {120, 60, 12, 1};
+constexpr double pade5[] = {30240, 15120, 3360, 420, 30, 1};
+constexpr double pade7[] = {17297280, 8648640, 1995840, 277200, 25200, 1512, 56, 1};
+constexpr double pade9[] = {17643225600., 8821612800., 2075673600, 302702400, 30270240, 2162160, 110880,
+                            3960, 90, 1};
+constexpr double pade13[] = {64764752532480000., 32382376266240000., 7771770303897600., 1187353796428800.,
+                             129060195264000., 10559470521600., 670442572800., 33522128640., 1323241920.,
+                             40840800, 960960, 16380, 182, 1};
+
+template<typename T>
+void check_square(const Matrix<T>& matrix) {
+  if (matrix.GetLength() != matrix.GetWidth()) {
+    throw std::length_error("The matrix isn't a square");
+  }
+}
+
+// out = a * b + beta * out for n x n row-major matrices; `out` is resized if beta is 0
+template<typename T>
+void multiply_into(const Matrix<T>& a, const Matrix<T>& b, Matrix<T>& out, T beta = static_cast<T>(0)) {
+  if (beta == static_cast<T>(0)) {
+    out.resize(a.GetLength(), b.GetWidth(), Layout::RowMajor);
+  }
+  gemm<T>(static_cast<T>(1), a, b, beta, out);
+}
+
+// out = identity * I + sum of factor * term over the (factor, const Matrix<T>*) pairs of
+// `terms`, in one pass over the n x n buffers. `out` must not be one of the terms
+template<typename T, typename Terms>
+void combine(Matrix<T>& out, size_t n, T identity, const Terms& terms) {
+  out.resize(n, n, Layout::RowMajor);
+  split_range(n, n * n * (std::size(terms) + 1), [&] (size_t first, size_t last) {
+    for (size_t i = first; i < last; ++i) {
+      T* row = out.data() + i * n;
+      std::fill(row, row + n, static_cast<T>(0));
+      for (const auto& [factor, term] : terms) {
+        const T* term_row = term->data() + i * n;
+        for (size_t j = 0; j < n; ++j) {
+          row[j] += factor * term_row[j];
+        }
+      }
+      row[i] += identity;
+    }
+  }, vector_parallel_threshold);
+}
+
+// `matrix` in the layout of `like`
+template<typename T>
+Matrix<T>& restore_layout(Matrix<T>& matrix, const Matrix<T>& like) {
+  matrix.set_layout(like.layout());
+  return matrix;
+}
+
+// x = x * x, `scratch` gets the old buffer
+template<typename T>
+void square(Matrix<T>& x, Matrix<T>& scratch) {
+  multiply_into(x, x, scratch);
+  std::swap(x, scratch);
+}
+
+// U and V of the degree m Padé approximant of exp(A), A in workspace.base
+template<typename T>
+void pade(size_t m, PowerWorkspace<T>& workspace) {
+  size_t n = workspace.base.GetLength();
+  const Matrix<T>& a = workspace.base;
+  Matrix<T>& u = workspace.u;
+  Matrix<T>& v = workspace.v;
+  Matrix<T>& product = workspace.product;
+  std::vector<Matrix<T>>& powers = workspace.powers;
+  // powers[k] = A^(2k)
+  size_t even_powers = m == 13 ? 3 : (m - 1) / 2;
+  powers.resize(even_powers + 1);
+  multiply_into(a, a, powers[1]);
+  for (size_t k = 2; k <= even_powers; ++k) {
+    multiply_into(powers[k - 1], powers[1], powers[k]);
+  }
+  auto b = [m] (size_t i) {
+    const double* coefficients = m == 3 ? pade3 : m == 5 ? pade5 : m == 7 ? pade7 : m == 9 ? pade9 : pade13;
+    return static_cast<T>(coefficients[i]);
+  };
+  if (m == 13) {
+    // A^6 is factored out of the top terms: 6 products instead of 12
+    const Matrix<T>* a2 = &powers[1];
+    const Matrix<T>* a4 = &powers[2];
+    const Matrix<T>* a6 = &powers[3];
+    std::pair<T, const Matrix<T>*> odd_top[] = {{b(13), a6}, {b(11), a4}, {b(9), a2}};
+    std::pair<T, const Matrix<T>*> odd_low[] = {{b(7), a6}, {b(5), a4}, {b(3), a2}};
+    combine(product, n, static_cast<T>(0), odd_top);
+    combine(v, n, b(1), odd_low);
+    multiply_into(*a6, product, v, static_cast<T>(1));
+    multiply_into(a, v, u);
+    std::pair<T, const Matrix<T>*> even_top[] = {{b(12), a6}, {b(10), a4}, {b(8), a2}};
+    std::pair<T, const Matrix<T>*> even_low[] = {{b(6), a6}, {b(4), a4}, {b(2), a2}};
+    combine(product, n, static_cast<T>(0), even_top);
+    combine(v, n, b(0), even_low);
+    multiply_into(*a6, product, v, static_cast<T>(1));
+    return;
+  }
+  std::vector<std::pair<T, const Matrix<T>*>> odd, even;
+  for (size_t k = 1; k <= even_powers; ++k) {
+    odd.emplace_back(b(2 * k + 1), &powers[k]);
+    even.emplace_back(b(2 * k), &powers[k]);
+  }
+  combine(product, n, b(1), odd);
+  multiply_into(a, product, u);
+  combine(v, n, b(0), even);
+}
+
+}  // namespace detail
+
+
+// A^k by repeated squaring: about 2 log2(k) products. A negative k powers the inverse, which
+// throws std::invalid_argument if A is singular; A^0 is the identity
+template<typename T>
+void matrix_power(const Matrix<T>& matrix, long long k, Matrix<T>& out, PowerWorkspace<T>& workspace) {
+  detail::check_square(matrix);
+  size_t n = matrix.GetLength();
+  ProfileScope profile("matrix_power", 0, 0);
+  if (k < 0) {
+    inverse(matrix, workspace.base, workspace.solver);
+  } else {
+    workspace.base = matrix;
+    workspace.base.set_layout(Layout::RowMajor);
+  }
+  unsigned long long exponent = k < 0 ? 0ull - static_cast<unsigned long long>(k) : k;
+  if (exponent == 0) {
+    out = diag(static_cast<T>(1), n);
+    detail::restore_layout(out, matrix);
+    return;
+  }
+  // left to right over the bits of the exponent: out holds A^(the bits seen so far)
+  int bit = 63;
+  while (!((exponent >> bit) & 1)) {
+    --bit;
+  }
+  out = workspace.base;
+  for (--bit; bit >= 0; --bit) {
+    detail::square(out, workspace.product);
+    if ((exponent >> bit) & 1) {
+      detail::multiply_into(out, workspace.base, workspace.product);
+      std::swap(out, workspace.product);
+    }
+  }
+  detail::restore_layout(out, matrix);
+}
+
+template<typename T>
+Matrix<T> matrix_power(const Matrix<T>& matrix, long long k) {
+  PowerWorkspace<T> workspace;
+  Matrix<T> res;
+  matrix_power(matrix, k, res, workspace);
+  return res;
+}
+
+// coefficients[0] * I + coefficients[1] * A + ... by Paterson-Stockmeyer: with s about
+// sqrt(degree) it takes s - 1 products for A^2..A^s and degree / s for Horner's rule in A^s,
+// instead of one product per degree
+template<typename T>
+void polyvalm(const std::vector<T>& coefficients, const Matrix<T>& matrix, Matrix<T>& out,
+              PowerWorkspace<T>& workspace) {
+  detail::check_square(matrix);
+  size_t n = matrix.GetLength();
+  ProfileScope profile("polyvalm", 0, 0);
+  if (coefficients.empty()) {
+    out = Matrix<T>(n, n, matrix.layout());
+    return;
+  }
+  size_t degree = coefficients.size() - 1;
+  size_t s = std::max<size_t>(1, static_cast<size_t>(std::sqrt(static_cast<double>(degree))));
+  // powers[i] = A^i
+  std::vector<Matrix<T>>& powers = workspace.powers;
+  powers.resize(s + 1);
+  powers[1] = matrix;
+  powers[1].set_layout(Layout::RowMajor);
+  for (size_t i = 2; i <= s; ++i) {
+    detail::multiply_into(powers[i - 1], powers[1], powers[i]);
+  }
+  // blocks of s coefficients; the top one takes up to s + 1, so it never is c * I alone
+  size_t blocks = degree == 0 ? 1 : (degree - 1) / s + 1;
+  std::vector<std::pair<T, const Matrix<T>*>> terms;
+  terms.reserve(s);
+  auto block = [&] (size_t j, Matrix<T>& res) {
+    size_t first = j * s;
+    size_t last = j + 1 == blocks ? degree : first + s - 1;
+    terms.clear();
+    for (size_t i = first + 1; i <= last; ++i) {
+      terms.emplace_back(coefficients[i], &powers[i - first]);
+    }
+    detail::combine(res, n, coefficients[first], terms);
+  };
+  block(blocks - 1, out);
+  for (size_t j = blocks - 1; j-- > 0;) {
+    block(j, workspace.product);
+    detail::multiply_into(out, powers[s], workspace.product, static_cast<T>(1));
+    std::swap(out, workspace.product);
+  }
+  detail::restore_layout(out, matrix);
+}
+
+template<typename T>
+Matrix<T> polyvalm(const std::vector<T>& coefficients, const Matrix<T>& matrix) {
+  PowerWorkspace<T> workspace;
+  Matrix<T> res;
+  polyvalm(coefficients, matrix, res, workspace);
+  return res;
+}
+
+// exp(A) by scaling and squaring: the lowest Padé degree accurate for ||A||_1, or degree 13
+// for A / 2^s with s squarings afterwards. `out` gets a 0 x 0 matrix if the denominator of
+// the approximant is singular, which takes a badly overflowing A
+template<typename T>
+void expm(const Matrix<T>& matrix, Matrix<T>& out, PowerWorkspace<T>& workspace) {
+  static_assert(std::is_floating_point_v<T>, "expm needs a floating point matrix");
+  detail::check_square(matrix);
+  size_t n = matrix.GetLength();
+  ProfileScope profile("expm", 0, 0);
+  workspace.base = matrix;
+  workspace.base.set_layout(Layout::RowMajor);
+  double norm1 = static_cast<double>(norm(matrix, Norm::One));
+  size_t degree = 13;
+  for (size_t i = 0; i + 1 < std::size(detail::pade_degrees); ++i) {
+    if (norm1 <= detail::pade_theta[i]) {
+      degree = detail::pade_degrees[i];
+      break;
+    }
+  }
+  int squarings = 0;
+  if (degree == 13 && norm1 > detail::pade_theta[4]) {
+    squarings = static_cast<int>(std::ceil(std::log2(norm1 / detail::pade_theta[4])));
+    detail::scale<T>(workspace.base, static_cast<T>(std::ldexp(1.0, -squarings)));
+  }
+  detail::pade(degree, workspace);
+  // (V - U) X = V + U
+  T* u = workspace.u.data();
+  T* v = workspace.v.data();
+  detail::split_range(n * n, n * n, [&] (size_t first, size_t last) {
+    for (size_t i = first; i < last; ++i) {
+      T sum = v[i] + u[i];
+      v[i] -= u[i];
+      u[i] = sum;
+    }
+  }, detail::vector_parallel_threshold);
+  if (!sle_solution_in_place(workspace.v, workspace.u, out)) {
+    return;
+  }
+  for (int i = 0; i < squarings; ++i) {
+    detail::square(out, workspace.product);
+  }
+  detail::restore_layout(out, matrix);
+}
+
+template<typename T>
+Matrix<T> expm(const Matrix<T>& matrix) {
+  PowerWorkspace<T> workspace;
+  Matrix<T> res;
+  expm(matrix, res, workspace);
+  return res;
+}
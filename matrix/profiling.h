@@ -0,0 +1,283 @@
+#pragma once
+
+#include<atomic>
+#include<chrono>
+#include<cstdint>
+#include<fstream>
+#include<functional>
+#include<map>
+#include<mutex>
+#include<sstream>
+#include<stdexcept>
+#include<string>
+#include<thread>
+#include<vector>
+
+// Per-kernel counters. Profiling is compiled in and switched off until Profiler::enable();
+// a disabled kernel pays for one relaxed atomic load. Define LINALG_DISABLE_PROFILING
+// (in every translation unit) to compile all of it out.
+
+struct KernelStats {
+  uint64_t calls = 0;
+  uint64_t time_ns = 0;          // inclusive: nested kernels are counted in their callers too
+  uint64_t flops = 0;
+  uint64_t bytes = 0;            // estimated bytes read and written
+  uint64_t allocations = 0;      // matrix buffers allocated by the calling thread
+  uint64_t allocated_bytes = 0;
+  uint64_t threads = 0;          // worker threads started
+  uint64_t spawn_ns = 0;         // time spent starting them
+  uint64_t join_ns = 0;          // time spent waiting for them
+};
+
+struct TraceEvent {
+  const char* name;
+  uint64_t start_ns;
+  uint64_t duration_ns;
+  uint64_t thread;
+  uint64_t flops;
+  uint64_t bytes;
+};
+
+namespace detail {
+
+#ifdef LINALG_DISABLE_PROFILING
+constexpr bool profiling_compiled = false;
+#else
+constexpr bool profiling_compiled = true;
+#endif
+
+// the trace stops growing after this many events, the counters don't
+constexpr size_t max_trace_events = size_t(1) << 20;
+
+struct ProfilerState {
+  std::atomic<bool> enabled{ false };
+  std::mutex mutex;
+  std::map<std::string, KernelStats> kernels;
+  std::vector<TraceEvent> events;
+  std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+};
+
+inline ProfilerState& profiler_state() {
+  static ProfilerState state;
+  return state;
+}
+
+inline uint64_t profiler_now() {
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - profiler_state().origin).count());
+}
+
+inline uint64_t profiler_thread_id() {
+  return static_cast<uint64_t>(std::hash<std::thread::id>()(std::this_thread::get_id()) % 1000000);
+}
+
+inline void append_json_string(std::ostringstream& out, const std::string& value) {
+  out << '"';
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      out << '\\';
+    }
+    out << c;
+  }
+  out << '"';
+}
+
+}  // namespace detail
+
+
+class Profiler {
+public:
+  static bool enabled() {
+    return detail::profiling_compiled && detail::profiler_state().enabled.load(std::memory_order_relaxed);
+  }
+
+  static void enable() {
+    detail::profiler_state().enabled.store(detail::profiling_compiled);
+  }
+
+  static void disable() {
+    detail::profiler_state().enabled.store(false);
+  }
+
+  static void reset() {
+    auto& state = detail::profiler_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.kernels.clear();
+    state.events.clear();
+  }
+
+  static std::map<std::string, KernelStats> snapshot() {
+    auto& state = detail::profiler_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    return state.kernels;
+  }
+
+  static std::vector<TraceEvent> trace() {
+    auto& state = detail::profiler_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    return state.events;
+  }
+
+  // {"kernels": {"dot": {"calls": ..., "time_ns": ..., ...}, ...}}
+  static std::string to_json() {
+    std::ostringstream out;
+    out << "{\"kernels\": {";
+    bool first = true;
+    for (const auto& [name, stats] : snapshot()) {
+      out << (first ? "" : ", ");
+      first = false;
+      detail::append_json_string(out, name);
+      out << ": {\"calls\": " << stats.calls << ", \"time_ns\": " << stats.time_ns
+          << ", \"flops\": " << stats.flops << ", \"bytes\": " << stats.bytes
+          << ", \"allocations\": " << stats.allocations << ", \"allocated_bytes\": " << stats.allocated_bytes
+          << ", \"threads\": " << stats.threads << ", \"spawn_ns\": " << stats.spawn_ns
+          << ", \"join_ns\": " << stats.join_ns << "}";
+    }
+    out << "}}";
+    return out.str();
+  }
+
+  // Chrome trace-event format, opens in chrome://tracing and Perfetto
+  static std::string to_chrome_trace() {
+    std::ostringstream out;
+    out << "{\"traceEvents\": [";
+    bool first = true;
+    for (const auto& event : trace()) {
+      out << (first ? "" : ",\n");
+      first = false;
+      out << "{\"name\": ";
+      detail::append_json_string(out, event.name);
+      out << ", \"cat\": \"linalg\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << event.thread
+          << ", \"ts\": " << event.start_ns / 1000.0 << ", \"dur\": " << event.duration_ns / 1000.0
+          << ", \"args\": {\"flops\": " << event.flops << ", \"bytes\": " << event.bytes << "}}";
+    }
+    out << "], \"displayTimeUnit\": \"ns\"}";
+    return out.str();
+  }
+
+  static void write_json(const std::string& path) {
+    write_file(path, to_json());
+  }
+
+  static void write_chrome_trace(const std::string& path) {
+    write_file(path, to_chrome_trace());
+  }
+
+private:
+  static void write_file(const std::string& path, const std::string& contents) {
+    std::ofstream out(path);
+    if (!out || !(out << contents)) {
+      throw std::runtime_error("Can't write " + path);
+    }
+  }
+};
+
+
+// Times a kernel from construction to destruction. Allocations and thread phases on this
+// thread are charged to the innermost live scope.
+class ProfileScope {
+public:
+  ProfileScope(const char* name, uint64_t flops, uint64_t bytes) {
+    if (!Profiler::enabled()) {
+      return;
+    }
+    active_ = true;
+    name_ = name;
+    stats_.flops = flops;
+    stats_.bytes = bytes;
+    parent_ = current();
+    current() = this;
+    start_ = detail::profiler_now();
+  }
+
+  ProfileScope(const ProfileScope&) = delete;
+  ProfileScope& operator=(const ProfileScope&) = delete;
+
+  ~ProfileScope() {
+    if (!active_) {
+      return;
+    }
+    uint64_t duration = detail::profiler_now() - start_;
+    current() = parent_;
+    auto& state = detail::profiler_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    KernelStats& total = state.kernels[name_];
+    ++total.calls;
+    total.time_ns += duration;
+    total.flops += stats_.flops;
+    total.bytes += stats_.bytes;
+    total.allocations += stats_.allocations;
+    total.allocated_bytes += stats_.allocated_bytes;
+    total.threads += stats_.threads;
+    total.spawn_ns += stats_.spawn_ns;
+    total.join_ns += stats_.join_ns;
+    if (state.events.size() < detail::max_trace_events) {
+      state.events.push_back({name_, start_, duration, detail::profiler_thread_id(), stats_.flops, stats_.bytes});
+    }
+  }
+
+  static ProfileScope*& current() {
+    thread_local ProfileScope* scope = nullptr;
+    return scope;
+  }
+
+  KernelStats& stats() {
+    return stats_;
+  }
+
+private:
+  bool active_ = false;
+  const char* name_ = nullptr;
+  uint64_t start_ = 0;
+  KernelStats stats_;
+  ProfileScope* parent_ = nullptr;
+};
+
+// Times the thread creation (Spawn) or the joins (Join) of the enclosing kernel
+class ProfilePhase {
+public:
+  enum Kind { Spawn, Join };
+
+  explicit ProfilePhase(Kind kind, size_t threads = 0) : kind_(kind) {
+    if (Profiler::enabled() && ProfileScope::current() != nullptr) {
+      scope_ = ProfileScope::current();
+      scope_->stats().threads += threads;
+      start_ = detail::profiler_now();
+    }
+  }
+
+  ProfilePhase(const ProfilePhase&) = delete;
+  ProfilePhase& operator=(const ProfilePhase&) = delete;
+
+  ~ProfilePhase() {
+    finish();
+  }
+
+  // ends the phase before the end of the scope
+  void finish() {
+    if (scope_ != nullptr) {
+      uint64_t duration = detail::profiler_now() - start_;
+      (kind_ == Spawn ? scope_->stats().spawn_ns : scope_->stats().join_ns) += duration;
+      scope_ = nullptr;
+    }
+  }
+
+private:
+  Kind kind_;
+  ProfileScope* scope_ = nullptr;
+  uint64_t start_ = 0;
+};
+
+inline void profile_allocation(size_t bytes) {
+  if (Profiler::enabled() && ProfileScope::current() != nullptr && bytes > 0) {
+    ++ProfileScope::current()->stats().allocations;
+    ProfileScope::current()->stats().allocated_bytes += bytes;
+  }
+}
+
+inline void join_threads(std::vector<std::thread>& threads) {
+  ProfilePhase phase(ProfilePhase::Join);
+  for (auto& t : threads) {
+    t.join();
+  }
+}
@@ -0,0 +1,239 @@
+#pragma once
+
+#include<cmath>
+#include<limits>
+#include<stdexcept>
+#include<type_traits>
+#include<vector>
+
+#include "blas.h"
+
+// Reductions over all elements, the rows or the columns, in one pass over the buffer in its
+// own order. Contiguous runs are summed pairwise; where a running sum is kept per row or
+// column (the lines that cross the buffer) it is compensated. Either way the rounding error
+// doesn't grow linearly with the number of terms.
+
+enum class Norm { Frobenius, One, Inf, Max };
+
+namespace detail {
+
+// terms per leaf of the pairwise sum; a leaf is a plain loop the compiler vectorizes
+constexpr size_t pairwise_block = 128;
+// elements allclose checks between looking at the verdict
+constexpr size_t allclose_block = 1024;
+
+// norms of integer matrices are computed in double
+template<typename T>
+using real_t = std::conditional_t<std::is_floating_point_v<T>, T, double>;
+
+template<typename R, typename T, typename F>
+R pairwise_sum(const T* x, size_t n, F f) {
+  if (n <= pairwise_block) {
+    R res = static_cast<R>(0);
+    for (size_t i = 0; i < n; ++i) {
+      res += f(x[i]);
+    }
+    return res;
+  }
+  size_t half = n / 2;
+  return pairwise_sum<R>(x, half, f) + pairwise_sum<R>(x + half, n - half, f);
+}
+
+// Kahan summation; integers are exact already
+template<typename R>
+struct CompensatedSum {
+  R sum = static_cast<R>(0);
+  R compensation = static_cast<R>(0);
+
+  void add(R value) {
+    if constexpr (std::is_floating_point_v<R>) {
+      R y = value - compensation;
+      R t = sum + y;
+      compensation = (t - sum) - y;
+      sum = t;
+    } else {
+      sum += value;
+    }
+  }
+};
+
+// f summed over the whole buffer
+template<typename R, typename T, typename F>
+R reduce_sum(const Matrix<T>& matrix, F f) {
+  const T* data = matrix.data();
+  return split_reduce<R>(matrix.GetLength() * matrix.GetWidth(), [&] (size_t first, size_t last) {
+    return pairwise_sum<R>(data + first, last - first, f);
+  }, [] (R a, R b) { return a + b; });
+}
+
+// f summed over every row (rows == true) or every column, written to res[0..lines)
+template<typename R, typename T, typename F>
+void line_sums(const Matrix<T>& matrix, bool rows, F f, R* res) {
+  size_t lines = rows ? matrix.GetLength() : matrix.GetWidth();
+  size_t other = rows ? matrix.GetWidth() : matrix.GetLength();
+  // rows of a row-major buffer (columns of a column-major one) are contiguous
+  bool contiguous = (matrix.layout() == Layout::RowMajor) == rows;
+  split_range(lines, lines * other, [&] (size_t first, size_t last) {
+    if (contiguous) {
+      for (size_t i = first; i < last; ++i) {
+        res[i] = pairwise_sum<R>(matrix.data() + i * other, other, f);
+      }
+      return;
+    }
+    // the buffer is walked once, one running sum per line
+    std::vector<CompensatedSum<R>> sums(last - first);
+    for (size_t k = 0; k < other; ++k) {
+      const T* run = matrix.data() + k * lines;
+      for (size_t i = first; i < last; ++i) {
+        sums[i - first].add(f(run[i]));
+      }
+    }
+    for (size_t i = first; i < last; ++i) {
+      res[i] = sums[i - first].sum;
+    }
+  }, vector_parallel_threshold);
+}
+
+template<typename R, typename T, typename F>
+std::vector<R> line_sums(const Matrix<T>& matrix, bool rows, F f) {
+  std::vector<R> res(rows ? matrix.GetLength() : matrix.GetWidth());
+  line_sums<R>(matrix, rows, f, res.data());
+  return res;
+}
+
+template<typename T, typename Pick>
+T reduce_extremum(const Matrix<T>& matrix, Pick pick) {
+  if (matrix.empty()) {
+    throw std::invalid_argument("The matrix is empty");
+  }
+  const T* data = matrix.data();
+  return split_reduce<T>(matrix.GetLength() * matrix.GetWidth(), [&] (size_t first, size_t last) {
+    T res = data[first];
+    for (size_t i = first + 1; i < last; ++i) {
+      res = pick(res, data[i]);
+    }
+    return res;
+  }, pick);
+}
+
+template<typename T>
+real_t<T> abs_value(T value) {
+  return std::abs(static_cast<real_t<T>>(value));
+}
+
+}  // namespace detail
+
+
+template<typename T>
+T sum(const Matrix<T>& matrix) {
+  return detail::reduce_sum<T>(matrix, [] (T value) { return value; });
+}
+
+template<typename T>
+T min(const Matrix<T>& matrix) {
+  return detail::reduce_extremum(matrix, [] (T a, T b) { return b < a ? b : a; });
+}
+
+template<typename T>
+T max(const Matrix<T>& matrix) {
+  return detail::reduce_extremum(matrix, [] (T a, T b) { return a < b ? b : a; });
+}
+
+template<typename T>
+T trace(const Matrix<T>& matrix) {
+  if (matrix.GetLength() != matrix.GetWidth()) {
+    throw std::length_error("The matrix isn't a square");
+  }
+  detail::CompensatedSum<T> res;
+  for (size_t i = 0; i < matrix.GetLength(); ++i) {
+    res.add(matrix(i, i));
+  }
+  return res.sum;
+}
+
+// length x 1
+template<typename T>
+Matrix<T> row_sums(const Matrix<T>& matrix) {
+  Matrix<T> res = Matrix<T>::uninitialized(matrix.GetLength(), 1);
+  detail::line_sums<T>(matrix, true, [] (T value) { return value; }, res.data());
+  return res;
+}
+
+// 1 x width
+template<typename T>
+Matrix<T> column_sums(const Matrix<T>& matrix) {
+  Matrix<T> res = Matrix<T>::uninitialized(1, matrix.GetWidth());
+  detail::line_sums<T>(matrix, false, [] (T value) { return value; }, res.data());
+  return res;
+}
+
+// One is the largest column sum of |a_ij|, Inf the largest row sum, Max the largest |a_ij|
+template<typename T>
+detail::real_t<T> norm(const Matrix<T>& matrix, Norm type = Norm::Frobenius) {
+  using R = detail::real_t<T>;
+  auto absolute = [] (T value) { return detail::abs_value(value); };
+  switch (type) {
+    case Norm::Frobenius:
+      return std::sqrt(detail::reduce_sum<R>(matrix, [] (T value) {
+        R x = static_cast<R>(value);
+        return x * x;
+      }));
+    case Norm::One:
+    case Norm::Inf: {
+      std::vector<R> sums = detail::line_sums<R>(matrix, type == Norm::Inf, absolute);
+      R res = static_cast<R>(0);
+      for (R value : sums) {
+        res = std::max(res, value);
+      }
+      return res;
+    }
+    case Norm::Max: {
+      const T* data = matrix.data();
+      return detail::split_reduce<R>(matrix.GetLength() * matrix.GetWidth(), [&] (size_t first, size_t last) {
+        R res = static_cast<R>(0);
+        for (size_t i = first; i < last; ++i) {
+          res = std::max(res, detail::abs_value(data[i]));
+        }
+        return res;
+      }, [] (R a, R b) { return std::max(a, b); });
+    }
+  }
+  throw std::invalid_argument("Unknown norm");
+}
+
+// |a_ij - b_ij| <= atol + rtol * |b_ij| for every element (the numpy convention, not symmetric);
+// NaNs are never close. Unlike operator==, zeros in b are compared by atol
+template<typename T>
+bool allclose(const Matrix<T>& a, const Matrix<T>& b, double rtol = 1e-5, double atol = 1e-8) {
+  if (a.GetShape() != b.GetShape()) {
+    return false;
+  }
+  Matrix<T> copy;
+  const Matrix<T>* other = &b;
+  if (b.layout() != a.layout()) {
+    copy = b;
+    copy.set_layout(a.layout());
+    other = &copy;
+  }
+  using R = detail::real_t<T>;
+  R relative = static_cast<R>(rtol);
+  R absolute = static_cast<R>(atol);
+  const T* x = a.data();
+  const T* y = other->data();
+  // int rather than bool: the threads write their verdicts next to each other
+  return detail::split_reduce<int>(a.GetLength() * a.GetWidth(), [&] (size_t first, size_t last) {
+    for (size_t block = first; block < last; block += detail::allclose_block) {
+      size_t end = std::min(last, block + detail::allclose_block);
+      // no early exit inside a block, so the loop vectorizes
+      bool close = true;
+      for (size_t i = block; i < end; ++i) {
+        R difference = std::abs(static_cast<R>(x[i]) - static_cast<R>(y[i]));
+        close &= difference <= absolute + relative * detail::abs_value(y[i]);
+      }
+      if (!close) {
+        return 0;
+      }
+    }
+    return 1;
+  }, [] (int p, int q) { return p & q; }) != 0;
+}
@@ -12,11 +12,25 @@ Matrix<T> seq_dot(const Matrix<T>& left, const Matrix<T>& right) {
   size_t width = right.GetWidth();
   size_t length = left.GetLength();
   size_t count_iter = left.GetWidth();
-  Matrix<T> res(length, width);
-  for (size_t i = 0; i < width; ++i) {
-    for (size_t j = 0; j < length; ++j) {
+  Matrix<T> res(length, width, left.layout());
+  if (left.layout() == Layout::ColumnMajor) {
+    // the innermost loop goes down the columns of res and left
+    for (size_t i = 0; i < width; ++i) {
       for (size_t p = 0; p < count_iter; ++p) {
-        res(j, i) += left(j, p) * right(p, i);
+        T factor = right(p, i);
+        for (size_t j = 0; j < length; ++j) {
+          res(j, i) += left(j, p) * factor;
+        }
+      }
+    }
+    return res;
+  }
+  // ... and along the rows of res and right here
+  for (size_t j = 0; j < length; ++j) {
+    for (size_t p = 0; p < count_iter; ++p) {
+      T factor = left(j, p);
+      for (size_t i = 0; i < width; ++i) {
+        res(j, i) += factor * right(p, i);
       }
     }
   }
@@ -25,6 +39,9 @@ Matrix<T> seq_dot(const Matrix<T>& left, const Matrix<T>& right) {
 
 template<typename T>
 T seq_det(Matrix<T> matrix) {
+  if (matrix.layout() == Layout::ColumnMajor) {
+    matrix.transpose_layout();  // det(A^T) = det(A), with contiguous rows
+  }
   size_t width = matrix.GetWidth();
   size_t length = matrix.GetLength();
   if (width != length) {
@@ -34,7 +51,7 @@ T seq_det(Matrix<T> matrix) {
   for (size_t i = 0; i < width - 1; ++i) {
       if (matrix(i, i) == static_cast<T>(0)) {
           bool has_non_zero = false;
-          size_t index_non_zero;
+          size_t index_non_zero = i;
           for (size_t j = i; j < width; ++j) {
               if (matrix(j, i) != 0) {
                   has_non_zero = true;
@@ -47,9 +64,7 @@ T seq_det(Matrix<T> matrix) {
           matrix.row_switching(i, index_non_zero);
           res *= static_cast<T>(-1);
       }
-      for (size_t j = i + 1; j < width; ++j) {
-          matrix.row_addition(j, i, static_cast<T>(-1) * matrix(j, i) / matrix(i, i));
-      }
+      detail::eliminate_rows(matrix, i + 1, width, i, i, width);
   }
   for (size_t i = 0; i < width; ++i) {
       res *= matrix(i, i);
@@ -62,12 +77,19 @@ Matrix<T> seq_inverse(const Matrix<T>& matrix) {
   if (matrix.GetWidth() != matrix.GetLength()) {
     throw std::length_error("The matrix isn't a square");
   }
+  if (matrix.layout() == Layout::ColumnMajor) {
+    Matrix<T> res = matrix;
+    res.transpose_layout();
+    res = seq_inverse(res);
+    res.transpose_layout();
+    return res;
+  }
   size_t width = matrix.GetWidth();
   Matrix<T> sle = concatenate(matrix, diag(static_cast<T>(1.0), width), 1);
   for (size_t i = 0; i < width - 1; ++i) {
     if (sle(i, i) == static_cast<T>(0)) {
       bool has_non_zero = false;
-      size_t index_non_zero;
+      size_t index_non_zero = i;
       for (size_t j = i; j < width; ++j) {
         if (sle(j, i) != 0) {
           has_non_zero = true;
@@ -79,17 +101,16 @@ Matrix<T> seq_inverse(const Matrix<T>& matrix) {
       }
       sle.row_switching(i, index_non_zero);
     }
-    for (size_t j = i + 1; j < width; ++j) {
-      sle.row_addition(j, i, static_cast<T>(-1) * sle(j, i) / sle(i, i));
-    }
+    detail::eliminate_rows(sle, i + 1, width, i, i, 2 * width);
   }
   if (sle(width - 1, width - 1) == 0) {
     throw std::invalid_argument("Determinant equals 0, inverse matrix doesn't exist");
   }
   for (long long int i = static_cast<long long>(width) - 1; i >= 0; --i) {
-    sle.row_multiplication(i, 1 / sle(i, i));
+    // the pivot row is zero left of the diagonal and right of it in the left half
+    sle.row_multiplication(i, 1 / sle(i, i), i, 2 * width);
     for (long long int j = 0; j < i; ++j) {
-      sle.row_addition(j, i, -sle(j, i));
+      sle.row_addition(j, i, -sle(j, i), i, 2 * width);
     }
   }
   return sle.get_submatrix(0, width - 1, width, 2 * width - 1);
@@ -102,7 +123,7 @@ Matrix<T> seq_sle_solution(const Matrix<T>& left_part, const Matrix<T>& right_pa
   if (left_length != right_length) {
     throw std::length_error("Shapes do not match");
   }
-  Matrix<T> sle_matrix = concatenate(left_part, right_part, 1);
+  Matrix<T> sle_matrix = ConcatenationView<T>(left_part, right_part, 1).to_matrix();
   //size_t length = left_width;
   //size_t width = right_width;
 
@@ -120,11 +141,10 @@ Matrix<T> seq_sle_solution(const Matrix<T>& left_part, const Matrix<T>& right_pa
       --first_not_zero;
     }
 
-    for (size_t j = first_not_zero + 1; j < left_length; ++j) {
-      sle_matrix.row_addition(j, first_not_zero, -sle_matrix(j, i) / sle_matrix(first_not_zero, i));
-    }
+    detail::eliminate_rows(sle_matrix, first_not_zero + 1, left_length, first_not_zero, i,
+                           left_width + right_width);
 
-    sle_matrix.row_multiplication(first_not_zero, 1 / sle_matrix(first_not_zero, i));
+    sle_matrix.row_multiplication(first_not_zero, 1 / sle_matrix(first_not_zero, i), i, left_width + right_width);
   }
   if (left_length > left_width) {
     bool do_not_have_solution = false;
@@ -147,7 +167,7 @@ Matrix<T> seq_sle_solution(const Matrix<T>& left_part, const Matrix<T>& right_pa
   //reversed gauss
   for (int i = left_width - 1; i != -1; --i) {
     for (int j = i - 1; j != -1; --j) {
-      sle_matrix.row_addition(j, i, -sle_matrix(j, i));
+      sle_matrix.row_addition(j, i, -sle_matrix(j, i), i, left_width + right_width);
     }
   }
 
@@ -156,6 +176,9 @@ Matrix<T> seq_sle_solution(const Matrix<T>& left_part, const Matrix<T>& right_pa
 
 template <typename T>
 size_t seq_rank(Matrix<T> matrix) {
+  if (matrix.layout() == Layout::ColumnMajor) {
+    matrix.transpose_layout();
+  }
   auto [length, width] = matrix.GetShape();
   size_t row = 0;
   for (size_t column = 0; column < width; ++column) {
@@ -167,9 +190,7 @@ size_t seq_rank(Matrix<T> matrix) {
       continue;
     }
     matrix.row_switching(first_not_zero, row);
-    for (size_t i = row + 1; i < length; ++i) {
-      matrix.row_addition(i, row, -matrix(i, column) / matrix(row, column));
-    }
+    detail::eliminate_rows(matrix, row + 1, length, row, column, width);
     ++row;
   }
   return row;
@@ -182,14 +203,15 @@ Matrix<T> seq_add(const Matrix<T>& matrix1, const Matrix<T>& matrix2) {
   }
   size_t width = matrix1.GetWidth();
   size_t length = matrix1.GetLength();
-  Matrix<T> res(length, width);
+  Layout layout = matrix1.layout();
+  Matrix<T> res = Matrix<T>::uninitialized(length, width, layout);
   size_t n_threads = 2;
   size_t to_look_at = (length * width) / n_threads + ((length * width) % n_threads == 0 ? 0 : 1);
   std::vector<std::thread> threads;
   for (size_t k = 0; k < n_threads; ++k) {
     threads.emplace_back([&] (size_t id) {
       for (size_t i = to_look_at * id; i < length * width && i < to_look_at * (id + 1); ++i) {
-        res(i / width, i % width) = matrix1(i / width, i % width) + matrix2(i / width, i % width);
+        res.data()[i] = matrix1.data()[i] + detail::element_in_order(matrix2, layout, i);
       }
     }, k);
   }
@@ -206,11 +228,10 @@ Matrix<T> seq_sub(const Matrix<T>& matrix1, const Matrix<T>& matrix2) {
   }
   size_t width = matrix1.GetWidth();
   size_t length = matrix1.GetLength();
-  Matrix<T> res(length, width);
-  for (size_t i = 0; i < width; ++i) {
-    for (size_t j = 0; j < length; ++j) {
-      res(i, j) = matrix1(i, j) - matrix2(i, j);
-    }
+  Layout layout = matrix1.layout();
+  Matrix<T> res = Matrix<T>::uninitialized(length, width, layout);
+  for (size_t i = 0; i < length * width; ++i) {
+    res.data()[i] = matrix1.data()[i] - detail::element_in_order(matrix2, layout, i);
   }
   return res;
 }
@@ -222,11 +243,10 @@ Matrix<T> seq_mult(const Matrix<T>& matrix1, const Matrix<T>& matrix2) {
   }
   size_t width = matrix1.GetWidth();
   size_t length = matrix1.GetLength();
-  Matrix<T> res(length, width);
-  for (size_t i = 0; i < width; ++i) {
-    for (size_t j = 0; j < length; ++j) {
-      res(i, j) = matrix1(i, j) * matrix2(i, j);
-    }
+  Layout layout = matrix1.layout();
+  Matrix<T> res = Matrix<T>::uninitialized(length, width, layout);
+  for (size_t i = 0; i < length * width; ++i) {
+    res.data()[i] = matrix1.data()[i] * detail::element_in_order(matrix2, layout, i);
   }
   return res;
 }
@@ -238,11 +258,10 @@ Matrix<T> seq_div(const Matrix<T>& matrix1, const Matrix<T>& matrix2) {
   }
   size_t width = matrix1.GetWidth();
   size_t length = matrix1.GetLength();
-  Matrix<T> res(length, width);
-  for (size_t i = 0; i < width; ++i) {
-    for (size_t j = 0; j < length; ++j) {
-      res(i, j) = matrix1(i, j) / matrix2(i, j);
-    }
+  Layout layout = matrix1.layout();
+  Matrix<T> res = Matrix<T>::uninitialized(length, width, layout);
+  for (size_t i = 0; i < length * width; ++i) {
+    res.data()[i] = matrix1.data()[i] / detail::element_in_order(matrix2, layout, i);
   }
   return res;
 }
@@ -251,11 +270,9 @@ template<typename T>
 Matrix<T> seq_scale(T scale, const Matrix<T>& matrix) {
   size_t width = matrix.GetWidth();
   size_t length = matrix.GetLength();
-  Matrix<T> res(length, width);
-  for (size_t i = 0; i < width; ++i) {
-    for (size_t j = 0; j < length; ++j) {
-      res(i, j) = scale * matrix(i, j);
-    }
+  Matrix<T> res = Matrix<T>::uninitialized(length, width, matrix.layout());
+  for (size_t i = 0; i < length * width; ++i) {
+    res.data()[i] = scale * matrix.data()[i];
   }
   return res;
 }
@@ -266,7 +283,15 @@ Matrix<T> seq_transposed(const Matrix<T>& matrix) {
   // если у меня нет доступа к вектору matrix_
   // можно разобраться позже
   auto [length, width] = matrix.GetShape();
-  Matrix<T> res(width, length);
+  Matrix<T> res = Matrix<T>::uninitialized(width, length, matrix.layout());
+  if (matrix.layout() == Layout::ColumnMajor) {
+    for (size_t j = 0; j < length; ++j) {
+      for (size_t i = 0; i < width; ++i) {
+        res(i, j) = matrix(j, i);
+      }
+    }
+    return res;
+  }
   for (size_t i = 0; i < width; ++i) {
     for (size_t j = 0; j < length; ++j) {
       res(i, j) = matrix(j, i);
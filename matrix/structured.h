@@ -0,0 +1,674 @@
+#pragma once
+
+#include<algorithm>
+#include<cmath>
+#include<stdexcept>
+#include<type_traits>
+#include<utility>
+#include<vector>
+
+#include "functions.h"
+
+// Storage for structured square matrices: general band matrices, and symmetric and
+// triangular matrices packed by rows. Only the entries that can be nonzero are kept, and
+// det() and sle_solution() have overloads that work on the compact storage directly.
+
+
+// An n x n matrix with `lower` subdiagonals and `upper` superdiagonals. Row i of band()
+// holds a(i, i - lower) .. a(i, i + upper): the LAPACK band layout transposed, so that the
+// rows of the matrix stay contiguous. The corners outside of the matrix are never read.
+template<typename T>
+class BandMatrix {
+public:
+  BandMatrix() = default;
+
+  BandMatrix(size_t n, size_t lower, size_t upper) : lower_(lower), upper_(upper), band_(n, lower + upper + 1) {}
+
+  // the band of a dense matrix, everything outside of it is dropped
+  BandMatrix(const Matrix<T>& matrix, size_t lower, size_t upper) : BandMatrix(matrix.GetLength(), lower, upper) {
+    if (matrix.GetLength() != matrix.GetWidth()) {
+      throw std::length_error("The matrix isn't a square");
+    }
+    for (size_t i = 0; i < size(); ++i) {
+      for (size_t j = row_begin(i); j < row_end(i); ++j) {
+        band_(i, j + lower_ - i) = matrix(i, j);
+      }
+    }
+  }
+
+  size_t size() const {
+    return band_.GetLength();
+  }
+
+  size_t lower() const {
+    return lower_;
+  }
+
+  size_t upper() const {
+    return upper_;
+  }
+
+  bool in_band(size_t i, size_t j) const {
+    return j + lower_ >= i && j <= i + upper_;
+  }
+
+  // columns [row_begin(i), row_end(i)) of row i are inside the band
+  size_t row_begin(size_t i) const {
+    return i > lower_ ? i - lower_ : 0;
+  }
+
+  size_t row_end(size_t i) const {
+    return std::min(size(), i + upper_ + 1);
+  }
+
+  T operator()(size_t i, size_t j) const {
+    return in_band(i, j) ? band_(i, j + lower_ - i) : static_cast<T>(0);
+  }
+
+  T& operator()(size_t i, size_t j) {
+    if (i >= size() || j >= size() || !in_band(i, j)) {
+      throw std::out_of_range("The entry is outside of the band");
+    }
+    return band_(i, j + lower_ - i);
+  }
+
+  const Matrix<T>& band() const {
+    return band_;
+  }
+
+  Matrix<T>& band() {
+    return band_;
+  }
+
+  Matrix<T> to_dense() const {
+    Matrix<T> res(size(), size());
+    for (size_t i = 0; i < size(); ++i) {
+      for (size_t j = row_begin(i); j < row_end(i); ++j) {
+        res(i, j) = band_(i, j + lower_ - i);
+      }
+    }
+    return res;
+  }
+
+private:
+  size_t lower_ = 0;
+  size_t upper_ = 0;
+  Matrix<T> band_;
+};
+
+
+template<typename T>
+Matrix<T> dot(const BandMatrix<T>& left, const Matrix<T>& right) {
+  if (left.size() != right.GetLength()) {
+    throw std::length_error("Left width (" + std::to_string(left.size()) + ") and right length (" +
+                            std::to_string(right.GetLength()) + ") are not equal");
+  }
+  Matrix<T> copy;
+  const Matrix<T>& rows = detail::row_major(right, copy);
+  size_t n = left.size();
+  size_t m = right.GetWidth();
+  ProfileScope profile("band_dot", uint64_t(2) * n * (left.lower() + left.upper() + 1) * m,
+                       (uint64_t(n) * (left.lower() + left.upper() + 1) + 2 * n * m) * sizeof(T));
+  Matrix<T> res(n, m);
+  for (size_t i = 0; i < n; ++i) {
+    T* res_row = res.data() + i * m;
+    for (size_t j = left.row_begin(i); j < left.row_end(i); ++j) {
+      T a = left.band()(i, j + left.lower() - i);
+      const T* right_row = rows.data() + j * m;
+      for (size_t k = 0; k < m; ++k) {
+        res_row[k] += a * right_row[k];
+      }
+    }
+  }
+  return res;
+}
+
+
+// PA = LU of a band matrix with partial pivoting, O(n * lower * (lower + upper)).
+// Row swaps widen U to lower + upper superdiagonals, so the factors take
+// n * (2 * lower + upper + 1) entries plus n * lower multipliers of L. As in LAPACK's
+// gbtrf, L is kept as the sequence of eliminations and isn't permuted afterwards.
+template<typename T>
+class BandLUDecomposition {
+public:
+  explicit BandLUDecomposition(const BandMatrix<T>& matrix)
+      : lower_(matrix.lower()), upper_(matrix.upper()), rows_(matrix.size(), 2 * lower_ + upper_ + 1),
+        multipliers_(matrix.size(), lower_), pivots_(matrix.size()) {
+    for (size_t i = 0; i < size(); ++i) {
+      std::copy_n(matrix.band().data() + i * (lower_ + upper_ + 1), lower_ + upper_ + 1,
+                  rows_.data() + i * rows_.GetWidth());
+    }
+    factorize();
+  }
+
+  size_t size() const {
+    return rows_.GetLength();
+  }
+
+  bool singular() const {
+    return singular_;
+  }
+
+  // row i was swapped with pivots()[i] at step i
+  const std::vector<size_t>& pivots() const {
+    return pivots_;
+  }
+
+  T det() const {
+    if (singular_) {
+      return static_cast<T>(0);
+    }
+    T res = odd_swaps_ ? static_cast<T>(-1) : static_cast<T>(1);
+    for (size_t i = 0; i < size(); ++i) {
+      res *= rows_(i, lower_);
+    }
+    return res;
+  }
+
+  // returns a 0 x 0 matrix if the matrix is singular
+  Matrix<T> solve(const Matrix<T>& right_part) const {
+    if (right_part.GetLength() != size()) {
+      throw std::length_error("Shapes do not match");
+    }
+    if (singular_) {
+      return Matrix<T>(0, 0);
+    }
+    size_t n = size();
+    size_t m = right_part.GetWidth();
+    Matrix<T> x = right_part;
+    x.set_layout(Layout::RowMajor);
+    for (size_t k = 0; k < n; ++k) {
+      if (pivots_[k] != k) {
+        x.row_switching(k, pivots_[k]);
+      }
+      const T* row_k = x.data() + k * m;
+      for (size_t i = k + 1; i < std::min(n, k + lower_ + 1); ++i) {
+        T factor = multipliers_(k, i - k - 1);
+        T* row_i = x.data() + i * m;
+        for (size_t j = 0; j < m; ++j) {
+          row_i[j] -= factor * row_k[j];
+        }
+      }
+    }
+    for (size_t k = n; k-- > 0;) {
+      T* row_k = x.data() + k * m;
+      for (size_t c = k + 1; c < std::min(n, k + lower_ + upper_ + 1); ++c) {
+        T u = rows_(k, offset(k, c));
+        const T* row_c = x.data() + c * m;
+        for (size_t j = 0; j < m; ++j) {
+          row_k[j] -= u * row_c[j];
+        }
+      }
+      T pivot = rows_(k, lower_);
+      for (size_t j = 0; j < m; ++j) {
+        row_k[j] /= pivot;
+      }
+    }
+    return x;
+  }
+
+private:
+  // a(i, j) of the partly eliminated matrix is rows_(i, offset(i, j))
+  size_t offset(size_t i, size_t j) const {
+    return j + lower_ - i;
+  }
+
+  void factorize() {
+    size_t n = size();
+    ProfileScope profile("band_lu", uint64_t(2) * n * lower_ * (lower_ + upper_ + 1),
+                         uint64_t(n) * rows_.GetWidth() * sizeof(T));
+    // each step touches a (lower + 1) x (lower + upper + 1) window, too little to split between threads
+    for (size_t k = 0; k < n; ++k) {
+      size_t rows_end = std::min(n, k + lower_ + 1);
+      size_t columns_end = std::min(n, k + lower_ + upper_ + 1);
+      size_t pivot = k;
+      for (size_t i = k + 1; i < rows_end; ++i) {
+        if (std::abs(rows_(i, offset(i, k))) > std::abs(rows_(pivot, offset(pivot, k)))) {
+          pivot = i;
+        }
+      }
+      pivots_[k] = pivot;
+      if (rows_(pivot, offset(pivot, k)) == static_cast<T>(0)) {
+        singular_ = true;
+        return;
+      }
+      if (pivot != k) {
+        for (size_t c = k; c < columns_end; ++c) {
+          std::swap(rows_(k, offset(k, c)), rows_(pivot, offset(pivot, c)));
+        }
+        odd_swaps_ = !odd_swaps_;
+      }
+      T diagonal = rows_(k, lower_);
+      for (size_t i = k + 1; i < rows_end; ++i) {
+        T factor = rows_(i, offset(i, k)) / diagonal;
+        multipliers_(k, i - k - 1) = factor;
+        rows_(i, offset(i, k)) = static_cast<T>(0);
+        if (factor == static_cast<T>(0)) {
+          continue;
+        }
+        for (size_t c = k + 1; c < columns_end; ++c) {
+          rows_(i, offset(i, c)) -= factor * rows_(k, offset(k, c));
+        }
+      }
+    }
+  }
+
+  size_t lower_;
+  size_t upper_;
+  Matrix<T> rows_;
+  Matrix<T> multipliers_;
+  std::vector<size_t> pivots_;
+  bool singular_ = false;
+  bool odd_swaps_ = false;
+};
+
+
+namespace detail {
+
+// the Thomas algorithm: elimination without pivoting, 8n flops per column of x
+template<typename T>
+bool thomas_in_place(const BandMatrix<T>& matrix, Matrix<T>& x) {
+  size_t n = matrix.size();
+  size_t m = x.GetWidth();
+  ProfileScope profile("thomas", uint64_t(8) * n * m, uint64_t(n) * (3 + 2 * m) * sizeof(T));
+  std::vector<T> super(n);
+  for (size_t i = 0; i < n; ++i) {
+    T sub = i > 0 ? matrix(i, i - 1) : static_cast<T>(0);
+    T pivot = matrix(i, i) - (i > 0 ? sub * super[i - 1] : static_cast<T>(0));
+    if (pivot == static_cast<T>(0)) {
+      return false;
+    }
+    super[i] = i + 1 < n ? matrix(i, i + 1) / pivot : static_cast<T>(0);
+    T* row = x.data() + i * m;
+    const T* previous = i > 0 ? x.data() + (i - 1) * m : nullptr;
+    for (size_t j = 0; j < m; ++j) {
+      row[j] = (row[j] - (previous ? sub * previous[j] : static_cast<T>(0))) / pivot;
+    }
+  }
+  for (size_t i = n - 1; i-- > 0;) {
+    T* row = x.data() + i * m;
+    const T* next = x.data() + (i + 1) * m;
+    for (size_t j = 0; j < m; ++j) {
+      row[j] -= super[i] * next[j];
+    }
+  }
+  return true;
+}
+
+// no pivoting is needed for such matrices
+template<typename T>
+bool diagonally_dominant(const BandMatrix<T>& matrix) {
+  for (size_t i = 0; i < matrix.size(); ++i) {
+    T off_diagonal = static_cast<T>(0);
+    for (size_t j = matrix.row_begin(i); j < matrix.row_end(i); ++j) {
+      if (j != i) {
+        off_diagonal += std::abs(matrix(i, j));
+      }
+    }
+    if (std::abs(matrix(i, i)) < off_diagonal) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace detail
+
+// Solves a tridiagonal system without pivoting. Stable for diagonally dominant matrices,
+// returns a 0 x 0 matrix if a zero pivot turns up
+template<typename T>
+Matrix<T> thomas_solution(const BandMatrix<T>& matrix, const Matrix<T>& right_part) {
+  if (matrix.lower() > 1 || matrix.upper() > 1) {
+    throw std::invalid_argument("The matrix isn't tridiagonal");
+  }
+  if (matrix.size() != right_part.GetLength()) {
+    throw std::length_error("Shapes do not match");
+  }
+  Matrix<T> x = right_part;
+  x.set_layout(Layout::RowMajor);
+  if (matrix.size() == 0 || !detail::thomas_in_place(matrix, x)) {
+    return Matrix<T>(0, 0);
+  }
+  return x;
+}
+
+// Diagonally dominant tridiagonal systems go through the Thomas algorithm, the rest
+// through the banded LU. Returns a 0 x 0 matrix if the matrix is singular
+template<typename T>
+Matrix<T> sle_solution(const BandMatrix<T>& left_part, const Matrix<T>& right_part) {
+  if (left_part.size() != right_part.GetLength()) {
+    throw std::length_error("Shapes do not match");
+  }
+  if (left_part.size() > 0 && left_part.lower() <= 1 && left_part.upper() <= 1 &&
+      detail::diagonally_dominant(left_part)) {
+    Matrix<T> x = right_part;
+    x.set_layout(Layout::RowMajor);
+    if (detail::thomas_in_place(left_part, x)) {
+      return x;
+    }
+  }
+  return BandLUDecomposition<T>(left_part).solve(right_part);
+}
+
+// Integer matrices are copied to a dense one for the exact det
+template<typename T>
+T det(const BandMatrix<T>& matrix) {
+  if constexpr (std::is_integral_v<T>) {
+    return det(matrix.to_dense());
+  } else {
+    return BandLUDecomposition<T>(matrix).det();
+  }
+}
+
+
+namespace detail {
+
+// index of (i, j) in a triangle packed by rows: i >= j for Lower, i <= j for Upper
+inline size_t packed_index(Triangle triangle, size_t n, size_t i, size_t j) {
+  return triangle == Triangle::Lower ? i * (i + 1) / 2 + j : i * n - i * (i - 1) / 2 + (j - i);
+}
+
+}  // namespace detail
+
+// A symmetric n x n matrix that keeps only `triangle`, packed by rows: n (n + 1) / 2 entries
+template<typename T>
+class PackedSymmetricMatrix {
+public:
+  PackedSymmetricMatrix() = default;
+
+  explicit PackedSymmetricMatrix(size_t n, Triangle triangle = Triangle::Lower)
+      : n_(n), triangle_(triangle), packed_(n * (n + 1) / 2) {}
+
+  // `triangle` of a dense matrix, the other one is taken to mirror it
+  explicit PackedSymmetricMatrix(const Matrix<T>& matrix, Triangle triangle = Triangle::Lower)
+      : PackedSymmetricMatrix(matrix.GetLength(), triangle) {
+    if (matrix.GetLength() != matrix.GetWidth()) {
+      throw std::length_error("The matrix isn't a square");
+    }
+    for (size_t i = 0; i < n_; ++i) {
+      for (size_t j = (triangle_ == Triangle::Lower ? 0 : i); j < (triangle_ == Triangle::Lower ? i + 1 : n_); ++j) {
+        packed_[detail::packed_index(triangle_, n_, i, j)] = matrix(i, j);
+      }
+    }
+  }
+
+  size_t size() const {
+    return n_;
+  }
+
+  Triangle triangle() const {
+    return triangle_;
+  }
+
+  T operator()(size_t i, size_t j) const {
+    return packed_[index(i, j)];
+  }
+
+  // (i, j) and (j, i) are the same entry
+  T& operator()(size_t i, size_t j) {
+    return packed_[index(i, j)];
+  }
+
+  const std::vector<T>& packed() const {
+    return packed_;
+  }
+
+  std::vector<T>& packed() {
+    return packed_;
+  }
+
+  Matrix<T> to_dense() const {
+    Matrix<T> res(n_, n_);
+    for (size_t i = 0; i < n_; ++i) {
+      for (size_t j = 0; j < n_; ++j) {
+        res(i, j) = packed_[index(i, j)];
+      }
+    }
+    return res;
+  }
+
+private:
+  size_t index(size_t i, size_t j) const {
+    if ((triangle_ == Triangle::Lower) != (i >= j)) {
+      std::swap(i, j);
+    }
+    return detail::packed_index(triangle_, n_, i, j);
+  }
+
+  size_t n_ = 0;
+  Triangle triangle_ = Triangle::Lower;
+  std::vector<T> packed_;
+};
+
+// A triangular n x n matrix packed by rows, the other triangle is zero
+template<typename T>
+class PackedTriangularMatrix {
+public:
+  PackedTriangularMatrix() = default;
+
+  explicit PackedTriangularMatrix(size_t n, Triangle triangle = Triangle::Lower)
+      : n_(n), triangle_(triangle), packed_(n * (n + 1) / 2) {}
+
+  // `triangle` of a dense matrix, the other one is dropped
+  explicit PackedTriangularMatrix(const Matrix<T>& matrix, Triangle triangle = Triangle::Lower)
+      : PackedTriangularMatrix(matrix.GetLength(), triangle) {
+    if (matrix.GetLength() != matrix.GetWidth()) {
+      throw std::length_error("The matrix isn't a square");
+    }
+    for (size_t i = 0; i < n_; ++i) {
+      for (size_t j = row_begin(i); j < row_end(i); ++j) {
+        packed_[detail::packed_index(triangle_, n_, i, j)] = matrix(i, j);
+      }
+    }
+  }
+
+  size_t size() const {
+    return n_;
+  }
+
+  Triangle triangle() const {
+    return triangle_;
+  }
+
+  bool in_triangle(size_t i, size_t j) const {
+    return triangle_ == Triangle::Lower ? i >= j : i <= j;
+  }
+
+  // columns [row_begin(i), row_end(i)) of row i are stored
+  size_t row_begin(size_t i) const {
+    return triangle_ == Triangle::Lower ? 0 : i;
+  }
+
+  size_t row_end(size_t i) const {
+    return triangle_ == Triangle::Lower ? i + 1 : n_;
+  }
+
+  T operator()(size_t i, size_t j) const {
+    return in_triangle(i, j) ? packed_[detail::packed_index(triangle_, n_, i, j)] : static_cast<T>(0);
+  }
+
+  T& operator()(size_t i, size_t j) {
+    if (i >= n_ || j >= n_ || !in_triangle(i, j)) {
+      throw std::out_of_range("The entry is outside of the triangle");
+    }
+    return packed_[detail::packed_index(triangle_, n_, i, j)];
+  }
+
+  const std::vector<T>& packed() const {
+    return packed_;
+  }
+
+  std::vector<T>& packed() {
+    return packed_;
+  }
+
+  Matrix<T> to_dense() const {
+    Matrix<T> res(n_, n_);
+    for (size_t i = 0; i < n_; ++i) {
+      for (size_t j = row_begin(i); j < row_end(i); ++j) {
+        res(i, j) = packed_[detail::packed_index(triangle_, n_, i, j)];
+      }
+    }
+    return res;
+  }
+
+private:
+  size_t n_ = 0;
+  Triangle triangle_ = Triangle::Lower;
+  std::vector<T> packed_;
+};
+
+
+namespace detail {
+
+// x = L^-1 x for L packed by rows as a lower triangle
+template<typename T>
+void packed_lower_solve(const std::vector<T>& packed, size_t n, Matrix<T>& x) {
+  size_t m = x.GetWidth();
+  for (size_t i = 0; i < n; ++i) {
+    const T* l = packed.data() + i * (i + 1) / 2;
+    T* row = x.data() + i * m;
+    for (size_t k = 0; k < i; ++k) {
+      const T* row_k = x.data() + k * m;
+      for (size_t j = 0; j < m; ++j) {
+        row[j] -= l[k] * row_k[j];
+      }
+    }
+    for (size_t j = 0; j < m; ++j) {
+      row[j] /= l[i];
+    }
+  }
+}
+
+// x = L^-T x, L packed as above; goes over the rows of L, so the access stays contiguous
+template<typename T>
+void packed_lower_transposed_solve(const std::vector<T>& packed, size_t n, Matrix<T>& x) {
+  size_t m = x.GetWidth();
+  for (size_t i = n; i-- > 0;) {
+    const T* l = packed.data() + i * (i + 1) / 2;
+    T* row = x.data() + i * m;
+    for (size_t j = 0; j < m; ++j) {
+      row[j] /= l[i];
+    }
+    for (size_t k = 0; k < i; ++k) {
+      T* row_k = x.data() + k * m;
+      for (size_t j = 0; j < m; ++j) {
+        row_k[j] -= l[k] * row[j];
+      }
+    }
+  }
+}
+
+// x = U^-1 x for U packed by rows as an upper triangle
+template<typename T>
+void packed_upper_solve(const std::vector<T>& packed, size_t n, Matrix<T>& x) {
+  size_t m = x.GetWidth();
+  for (size_t i = n; i-- > 0;) {
+    const T* u = packed.data() + packed_index(Triangle::Upper, n, i, i);
+    T* row = x.data() + i * m;
+    for (size_t k = i + 1; k < n; ++k) {
+      const T* row_k = x.data() + k * m;
+      for (size_t j = 0; j < m; ++j) {
+        row[j] -= u[k - i] * row_k[j];
+      }
+    }
+    for (size_t j = 0; j < m; ++j) {
+      row[j] /= u[0];
+    }
+  }
+}
+
+// A = L L^T in packed lower storage; false if A isn't positive definite
+template<typename T>
+bool packed_cholesky(const PackedSymmetricMatrix<T>& matrix, std::vector<T>& l) {
+  size_t n = matrix.size();
+  ProfileScope profile("packed_cholesky", uint64_t(n) * n * n / 3, uint64_t(n) * (n + 1) * sizeof(T));
+  l.assign(n * (n + 1) / 2, static_cast<T>(0));
+  for (size_t i = 0; i < n; ++i) {
+    T* row_i = l.data() + i * (i + 1) / 2;
+    for (size_t j = 0; j <= i; ++j) {
+      const T* row_j = l.data() + j * (j + 1) / 2;
+      T sum = matrix(i, j);
+      for (size_t k = 0; k < j; ++k) {
+        sum -= row_i[k] * row_j[k];
+      }
+      if (i == j) {
+        if (!(sum > static_cast<T>(0))) {
+          return false;
+        }
+        row_i[i] = std::sqrt(sum);
+      } else {
+        row_i[j] = sum / row_j[j];
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace detail
+
+// Positive definite matrices are solved by a Cholesky factorization in packed storage,
+// the rest (and integer matrices) fall back to the dense solver on a copy
+template<typename T>
+Matrix<T> sle_solution(const PackedSymmetricMatrix<T>& left_part, const Matrix<T>& right_part) {
+  if (left_part.size() != right_part.GetLength()) {
+    throw std::length_error("Shapes do not match");
+  }
+  if constexpr (std::is_floating_point_v<T>) {
+    std::vector<T> l;
+    if (detail::packed_cholesky(left_part, l)) {
+      Matrix<T> x = right_part;
+      x.set_layout(Layout::RowMajor);
+      detail::packed_lower_solve(l, left_part.size(), x);
+      detail::packed_lower_transposed_solve(l, left_part.size(), x);
+      return x;
+    }
+  }
+  return sle_solution(left_part.to_dense(), right_part);
+}
+
+template<typename T>
+T det(const PackedSymmetricMatrix<T>& matrix) {
+  if constexpr (std::is_floating_point_v<T>) {
+    std::vector<T> l;
+    if (detail::packed_cholesky(matrix, l)) {
+      T res = static_cast<T>(1);
+      for (size_t i = 0; i < matrix.size(); ++i) {
+        T diagonal = l[i * (i + 1) / 2 + i];
+        res *= diagonal * diagonal;
+      }
+      return res;
+    }
+  }
+  return det(matrix.to_dense());
+}
+
+// returns a 0 x 0 matrix if there is a zero on the diagonal
+template<typename T>
+Matrix<T> sle_solution(const PackedTriangularMatrix<T>& left_part, const Matrix<T>& right_part) {
+  if (left_part.size() != right_part.GetLength()) {
+    throw std::length_error("Shapes do not match");
+  }
+  for (size_t i = 0; i < left_part.size(); ++i) {
+    if (left_part(i, i) == static_cast<T>(0)) {
+      return Matrix<T>(0, 0);
+    }
+  }
+  Matrix<T> x = right_part;
+  x.set_layout(Layout::RowMajor);
+  if (left_part.triangle() == Triangle::Lower) {
+    detail::packed_lower_solve(left_part.packed(), left_part.size(), x);
+  } else {
+    detail::packed_upper_solve(left_part.packed(), left_part.size(), x);
+  }
+  return x;
+}
+
+template<typename T>
+T det(const PackedTriangularMatrix<T>& matrix) {
+  T res = static_cast<T>(1);
+  for (size_t i = 0; i < matrix.size(); ++i) {
+    res *= matrix(i, i);
+  }
+  return res;
+}
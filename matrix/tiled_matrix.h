@@ -0,0 +1,743 @@
+#pragma once
+
+#include<cstdio>
+#include<filesystem>
+#include<fstream>
+#include<functional>
+#include<future>
+#include<list>
+#include<memory>
+#include<type_traits>
+#include<unordered_map>
+
+#if defined(__unix__)
+#include<stdlib.h>
+#include<unistd.h>
+#endif
+
+#include "functions.h"
+
+// I/O and cache counters of a TiledMatrix
+struct TileStats {
+  size_t tile_reads = 0;
+  size_t tile_writes = 0;
+  size_t cache_hits = 0;
+  size_t cache_misses = 0;
+  size_t prefetches = 0;
+  size_t bytes_read = 0;
+  size_t bytes_written = 0;
+};
+
+// called as progress(operation, done, total) by the tiled algorithms
+using TileProgress = std::function<void(const std::string&, size_t, size_t)>;
+
+
+// Out-of-core matrix: square tiles of tile_size x tile_size stored in a file on
+// local disk, at most cache_tiles of them are kept in memory (LRU, write-back).
+// Edge tiles are padded with zeros, so whole-tile kernels need no special cases.
+template<typename T>
+class TiledMatrix {
+  static_assert(std::is_trivially_copyable_v<T>, "Tiles are stored as raw bytes");
+
+public:
+  using Tile = std::shared_ptr<Matrix<T>>;
+
+  // an empty path means a temporary file that is removed together with the matrix
+  TiledMatrix(const size_t& h, const size_t& w, const size_t& tile_size = 256,
+              const size_t& cache_tiles = 64, const std::string& path = "")
+      : state_(new State) {
+    if (tile_size == 0 || cache_tiles < 4) {
+      throw std::invalid_argument("Tile size must be positive and the cache must hold at least 4 tiles");
+    }
+    state_->length = h;
+    state_->width = w;
+    state_->tile_size = tile_size;
+    state_->tile_rows = (h + tile_size - 1) / tile_size;
+    state_->tile_columns = (w + tile_size - 1) / tile_size;
+    state_->capacity = cache_tiles;
+    state_->written.assign(state_->tile_rows * state_->tile_columns, false);
+    state_->temporary = path.empty();
+    state_->path = path.empty() ? temporary_path() : path;
+    state_->file.open(state_->path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!state_->file) {
+      throw std::runtime_error("Can't open " + state_->path);
+    }
+  }
+
+  TiledMatrix(TiledMatrix&& other) = default;
+
+  // the current tiles are released as by the destructor before the other state is taken over
+  TiledMatrix& operator=(TiledMatrix&& other) {
+    if (this != &other) {
+      release();
+      state_ = std::move(other.state_);
+    }
+    return *this;
+  }
+
+  ~TiledMatrix() {
+    release();
+  }
+
+  static TiledMatrix from_matrix(const Matrix<T>& matrix, const size_t& tile_size = 256,
+                                 const size_t& cache_tiles = 64, const std::string& path = "") {
+    TiledMatrix res(matrix.GetLength(), matrix.GetWidth(), tile_size, cache_tiles, path);
+    for (size_t ti = 0; ti < res.tile_rows(); ++ti) {
+      for (size_t tj = 0; tj < res.tile_columns(); ++tj) {
+        Tile tile = res.get_tile(ti, tj, true);
+        for (size_t i = 0; i < res.tile_height(ti); ++i) {
+          for (size_t j = 0; j < res.tile_width(tj); ++j) {
+            (*tile)(i, j) = matrix(ti * tile_size + i, tj * tile_size + j);
+          }
+        }
+      }
+    }
+    return res;
+  }
+
+  Matrix<T> to_matrix() const {
+    Matrix<T> res(GetLength(), GetWidth());
+    for (size_t ti = 0; ti < tile_rows(); ++ti) {
+      for (size_t tj = 0; tj < tile_columns(); ++tj) {
+        prefetch(ti, tj + 1);
+        Tile tile = get_tile(ti, tj);
+        for (size_t i = 0; i < tile_height(ti); ++i) {
+          for (size_t j = 0; j < tile_width(tj); ++j) {
+            res(ti * tile_size() + i, tj * tile_size() + j) = (*tile)(i, j);
+          }
+        }
+      }
+    }
+    return res;
+  }
+
+  // streams the tiles into a new (temporary) matrix with the same tiling
+  TiledMatrix copy() const {
+    TiledMatrix res(GetLength(), GetWidth(), tile_size(), cache_capacity());
+    for_each_tile([&] (size_t ti, size_t tj) {
+      *res.get_tile(ti, tj, true) = *get_tile(ti, tj);
+    });
+    return res;
+  }
+
+
+  size_t GetWidth() const {
+    return state_->width;
+  }
+
+  size_t GetLength() const {
+    return state_->length;
+  }
+
+  std::pair<size_t, size_t> GetShape() const {
+    return std::make_pair(state_->length, state_->width);
+  }
+
+  size_t tile_size() const {
+    return state_->tile_size;
+  }
+
+  size_t tile_rows() const {
+    return state_->tile_rows;
+  }
+
+  size_t tile_columns() const {
+    return state_->tile_columns;
+  }
+
+  // number of real (not padding) rows / columns in a tile row / column
+  size_t tile_height(const size_t& ti) const {
+    return std::min(tile_size(), GetLength() - ti * tile_size());
+  }
+
+  size_t tile_width(const size_t& tj) const {
+    return std::min(tile_size(), GetWidth() - tj * tile_size());
+  }
+
+  size_t cache_capacity() const {
+    return state_->capacity;
+  }
+
+  const std::string& path() const {
+    return state_->path;
+  }
+
+
+  T operator()(const size_t& row, const size_t& column) const {
+    return (*get_tile(row / tile_size(), column / tile_size()))(row % tile_size(), column % tile_size());
+  }
+
+  void set(const size_t& row, const size_t& column, const T& value) {
+    (*get_tile(row / tile_size(), column / tile_size(), true))(row % tile_size(), column % tile_size()) = value;
+  }
+
+
+  // Returns the tile pinned in memory: it isn't evicted while the pointer is held.
+  // Tiles requested for writing are written back to disk on eviction or flush().
+  Tile get_tile(const size_t& ti, const size_t& tj, bool for_write = false) const {
+    size_t key = ti * tile_columns() + tj;
+    std::unique_lock lock(state_->cache_mutex);
+    auto it = state_->cache.find(key);
+    if (it != state_->cache.end()) {
+      state_->count([] (TileStats& stats) { ++stats.cache_hits; });
+      state_->order.splice(state_->order.begin(), state_->order, it->second.position);
+      it->second.dirty = it->second.dirty || for_write;
+      return it->second.tile;
+    }
+    state_->count([] (TileStats& stats) { ++stats.cache_misses; });
+    Tile tile;
+    auto pending = state_->pending.find(key);
+    if (pending != state_->pending.end()) {
+      std::shared_future<Tile> future = pending->second;
+      state_->pending.erase(pending);
+      lock.unlock();
+      tile = future.get();
+      lock.lock();
+      it = state_->cache.find(key);
+      if (it != state_->cache.end()) {  // someone else waited for the same prefetch
+        it->second.dirty = it->second.dirty || for_write;
+        return it->second.tile;
+      }
+    } else {
+      tile = read_tile(key);
+    }
+    state_->order.push_front(key);
+    state_->cache.emplace(key, Entry{ tile, for_write, state_->order.begin() });
+    evict();
+    return tile;
+  }
+
+  // starts loading a tile in the background, out-of-range requests are ignored
+  void prefetch(const size_t& ti, const size_t& tj) const {
+    if (ti >= tile_rows() || tj >= tile_columns()) {
+      return;
+    }
+    size_t key = ti * tile_columns() + tj;
+    std::lock_guard lock(state_->cache_mutex);
+    if (state_->cache.count(key) || state_->pending.count(key)) {
+      return;
+    }
+    state_->count([] (TileStats& stats) { ++stats.prefetches; });
+    State* state = state_.get();
+    state_->pending.emplace(key, std::async(std::launch::async, [state, key] {
+      return read_tile(state, key);
+    }).share());
+  }
+
+  // writes every dirty tile back to disk
+  void flush() const {
+    std::lock_guard lock(state_->cache_mutex);
+    for (auto& [key, entry] : state_->cache) {
+      if (entry.dirty) {
+        write_tile(key, *entry.tile);
+        entry.dirty = false;
+      }
+    }
+    state_->file.flush();
+  }
+
+
+  TileStats stats() const {
+    std::lock_guard lock(state_->stats_mutex);
+    return state_->stats;
+  }
+
+  void reset_stats() {
+    std::lock_guard lock(state_->stats_mutex);
+    state_->stats = TileStats();
+  }
+
+  void set_progress_callback(TileProgress progress) {
+    state_->progress = std::move(progress);
+  }
+
+  void report_progress(const std::string& operation, size_t done, size_t total) const {
+    if (state_->progress) {
+      state_->progress(operation, done, total);
+    }
+  }
+
+  template<typename F>
+  void for_each_tile(F func) const {
+    for (size_t ti = 0; ti < tile_rows(); ++ti) {
+      for (size_t tj = 0; tj < tile_columns(); ++tj) {
+        prefetch(ti, tj + 1);
+        func(ti, tj);
+      }
+    }
+  }
+
+  // a new empty file no other thread or process got the same name for
+  static std::string temporary_path() {
+#if defined(__unix__)
+    std::string path = (std::filesystem::temp_directory_path() / "linalg_tiles_XXXXXX").string();
+    int descriptor = ::mkstemp(path.data());
+    if (descriptor < 0) {
+      throw std::runtime_error("Can't create a temporary file in " + std::filesystem::temp_directory_path().string());
+    }
+    ::close(descriptor);
+    return path;
+#else
+    static std::atomic<size_t> counter{0};
+    auto name = "linalg_tiles_" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) +
+                "_" + std::to_string(counter.fetch_add(1)) + ".bin";
+    return (std::filesystem::temp_directory_path() / name).string();
+#endif
+  }
+
+private:
+  // removes a temporary file, writes the dirty tiles of a named one back
+  void release() {
+    if (!state_) {
+      return;
+    }
+    state_->pending.clear();
+    if (state_->temporary) {
+      state_->file.close();
+      std::remove(state_->path.c_str());
+    } else {
+      try {
+        flush();
+      } catch (...) {
+      }
+    }
+    state_.reset();
+  }
+
+  struct Entry {
+    Tile tile;
+    bool dirty;
+    std::list<size_t>::iterator position;
+  };
+
+  struct State {
+    size_t length = 0;
+    size_t width = 0;
+    size_t tile_size = 0;
+    size_t tile_rows = 0;
+    size_t tile_columns = 0;
+    size_t capacity = 0;
+    std::string path;
+    bool temporary = false;
+    std::fstream file;
+    std::mutex io_mutex;
+    std::vector<bool> written;
+    std::mutex cache_mutex;
+    std::unordered_map<size_t, Entry> cache;
+    std::list<size_t> order;  // most recently used first
+    std::unordered_map<size_t, std::shared_future<Tile>> pending;
+    std::mutex stats_mutex;  // always taken last
+    TileStats stats;
+    TileProgress progress;
+
+    template<typename F>
+    void count(F update) {
+      std::lock_guard lock(stats_mutex);
+      update(stats);
+    }
+  };
+
+  static Tile read_tile(State* state, size_t key) {
+    size_t tile_size = state->tile_size;
+    Tile tile = std::make_shared<Matrix<T>>(tile_size, tile_size);
+    std::lock_guard lock(state->io_mutex);
+    if (!state->written[key]) {
+      return tile;
+    }
+    size_t bytes = tile_size * tile_size * sizeof(T);
+    state->file.seekg(static_cast<std::streamoff>(key * bytes));
+    state->file.read(reinterpret_cast<char*>(tile->data()), static_cast<std::streamsize>(bytes));
+    if (!state->file) {
+      throw std::runtime_error("Failed to read a tile from " + state->path);
+    }
+    state->count([bytes] (TileStats& stats) {
+      ++stats.tile_reads;
+      stats.bytes_read += bytes;
+    });
+    return tile;
+  }
+
+  Tile read_tile(size_t key) const {
+    return read_tile(state_.get(), key);
+  }
+
+  void write_tile(size_t key, const Matrix<T>& tile) const {
+    size_t bytes = tile_size() * tile_size() * sizeof(T);
+    std::lock_guard lock(state_->io_mutex);
+    state_->file.seekp(static_cast<std::streamoff>(key * bytes));
+    state_->file.write(reinterpret_cast<const char*>(tile.data()), static_cast<std::streamsize>(bytes));
+    if (!state_->file) {
+      throw std::runtime_error("Failed to write a tile to " + state_->path);
+    }
+    state_->written[key] = true;
+    state_->count([bytes] (TileStats& stats) {
+      ++stats.tile_writes;
+      stats.bytes_written += bytes;
+    });
+  }
+
+  // called with cache_mutex held; pinned tiles are skipped
+  void evict() const {
+    auto it = state_->order.end();
+    while (state_->cache.size() > state_->capacity && it != state_->order.begin()) {
+      --it;
+      auto entry = state_->cache.find(*it);
+      if (entry->second.tile.use_count() > 1) {
+        continue;
+      }
+      if (entry->second.dirty) {
+        write_tile(entry->first, *entry->second.tile);
+      }
+      state_->cache.erase(entry);
+      it = state_->order.erase(it);
+    }
+  }
+
+  std::unique_ptr<State> state_;
+};
+
+
+namespace detail {
+
+// c += sign * a * b for whole tiles
+template<typename T>
+void tile_multiply_add(Matrix<T>& c, const Matrix<T>& a, const Matrix<T>& b, const T& sign) {
+  size_t n_threads = 2;
+  size_t size = c.GetLength();
+  std::vector<std::thread> threads;
+  for (size_t k = 0; k < n_threads; ++k) {
+    threads.emplace_back([&] (size_t id) {
+      for (size_t i = id * size / n_threads; i < (id + 1) * size / n_threads; ++i) {
+        for (size_t p = 0; p < size; ++p) {
+          T factor = sign * a(i, p);
+          if (factor == static_cast<T>(0)) {
+            continue;
+          }
+          for (size_t j = 0; j < size; ++j) {
+            c(i, j) += factor * b(p, j);
+          }
+        }
+      }
+    }, k);
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
+// x = L^{-1} x, L is the unit lower triangle of the first `count` rows of `lu`
+template<typename T>
+void tile_lower_solve(const Matrix<T>& lu, size_t lu_row, Matrix<T>& x, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    for (size_t p = 0; p < i; ++p) {
+      T factor = lu(lu_row + i, p);
+      for (size_t j = 0; j < x.GetWidth(); ++j) {
+        x(i, j) -= factor * x(p, j);
+      }
+    }
+  }
+}
+
+// x = U^{-1} x, U is the upper triangle of the first `count` rows of `u`
+template<typename T>
+void tile_upper_solve(const Matrix<T>& u, Matrix<T>& x, size_t count) {
+  for (size_t i = count; i-- > 0;) {
+    for (size_t p = i + 1; p < count; ++p) {
+      T factor = u(i, p);
+      for (size_t j = 0; j < x.GetWidth(); ++j) {
+        x(i, j) -= factor * x(p, j);
+      }
+    }
+    T pivot = u(i, i);
+    for (size_t j = 0; j < x.GetWidth(); ++j) {
+      x(i, j) /= pivot;
+    }
+  }
+}
+
+template<typename T>
+void check_same_tiling(const TiledMatrix<T>& matrix1, const TiledMatrix<T>& matrix2) {
+  if (matrix1.GetShape() != matrix2.GetShape()) {
+    throw std::length_error("Different shapes");
+  }
+  if (matrix1.tile_size() != matrix2.tile_size()) {
+    throw std::invalid_argument("Different tile sizes");
+  }
+}
+
+template<typename T, typename F>
+TiledMatrix<T> tiled_elementwise(const TiledMatrix<T>& matrix1, const TiledMatrix<T>& matrix2,
+                                 const std::string& operation, F op) {
+  check_same_tiling(matrix1, matrix2);
+  TiledMatrix<T> res(matrix1.GetLength(), matrix1.GetWidth(), matrix1.tile_size(), matrix1.cache_capacity());
+  size_t total = matrix1.tile_rows() * matrix1.tile_columns();
+  size_t done = 0;
+  matrix1.for_each_tile([&] (size_t ti, size_t tj) {
+    matrix2.prefetch(ti, tj + 1);
+    auto tile1 = matrix1.get_tile(ti, tj);
+    auto tile2 = matrix2.get_tile(ti, tj);
+    auto tile = res.get_tile(ti, tj, true);
+    for (size_t i = 0; i < matrix1.tile_height(ti); ++i) {
+      for (size_t j = 0; j < matrix1.tile_width(tj); ++j) {
+        (*tile)(i, j) = op((*tile1)(i, j), (*tile2)(i, j));
+      }
+    }
+    matrix1.report_progress(operation, ++done, total);
+  });
+  return res;
+}
+
+// Right-looking blocked LU with partial pivoting, in place.
+// Only the current column panel (n x tile_size) and three tiles are held in memory.
+// Row i was swapped with pivots[i]; returns false if the matrix is singular.
+template<typename T>
+bool tiled_lu(TiledMatrix<T>& matrix, std::vector<size_t>& pivots, bool& odd_swaps) {
+  size_t n = matrix.GetLength();
+  size_t ts = matrix.tile_size();
+  size_t nt = matrix.tile_rows();
+  pivots.resize(n);
+  odd_swaps = false;
+  for (size_t k = 0; k < nt; ++k) {
+    size_t row0 = k * ts;
+    size_t panel_width = matrix.tile_width(k);
+    Matrix<T> panel(n - row0, panel_width);
+    for (size_t ti = k; ti < nt; ++ti) {
+      matrix.prefetch(ti + 1, k);
+      auto tile = matrix.get_tile(ti, k);
+      for (size_t i = 0; i < matrix.tile_height(ti); ++i) {
+        for (size_t j = 0; j < panel_width; ++j) {
+          panel(ti * ts + i - row0, j) = (*tile)(i, j);
+        }
+      }
+    }
+    for (size_t c = 0; c < panel_width; ++c) {
+      size_t pivot = c;
+      for (size_t r = c + 1; r < panel.GetLength(); ++r) {
+        if (std::abs(panel(r, c)) > std::abs(panel(pivot, c))) {
+          pivot = r;
+        }
+      }
+      if (panel(pivot, c) == static_cast<T>(0)) {
+        return false;
+      }
+      pivots[row0 + c] = row0 + pivot;
+      if (pivot != c) {
+        panel.row_switching(pivot, c);
+        odd_swaps = !odd_swaps;
+      }
+      for (size_t r = c + 1; r < panel.GetLength(); ++r) {
+        T factor = panel(r, c) / panel(c, c);
+        panel(r, c) = factor;
+        for (size_t j = c + 1; j < panel_width; ++j) {
+          panel(r, j) -= factor * panel(c, j);
+        }
+      }
+    }
+    for (size_t ti = k; ti < nt; ++ti) {
+      auto tile = matrix.get_tile(ti, k, true);
+      for (size_t i = 0; i < matrix.tile_height(ti); ++i) {
+        for (size_t j = 0; j < panel_width; ++j) {
+          (*tile)(i, j) = panel(ti * ts + i - row0, j);
+        }
+      }
+    }
+    // the same row swaps for all the other tile columns
+    for (size_t tj = 0; tj < matrix.tile_columns(); ++tj) {
+      if (tj == k) {
+        continue;
+      }
+      for (size_t c = 0; c < panel_width; ++c) {
+        size_t row1 = row0 + c;
+        size_t row2 = pivots[row1];
+        if (row1 == row2) {
+          continue;
+        }
+        auto tile1 = matrix.get_tile(row1 / ts, tj, true);
+        auto tile2 = matrix.get_tile(row2 / ts, tj, true);
+        for (size_t j = 0; j < ts; ++j) {
+          std::swap((*tile1)(row1 % ts, j), (*tile2)(row2 % ts, j));
+        }
+      }
+    }
+    // U row block, then the trailing update
+    for (size_t tj = k + 1; tj < matrix.tile_columns(); ++tj) {
+      tile_lower_solve(panel, 0, *matrix.get_tile(k, tj, true), panel_width);
+    }
+    Matrix<T> l(ts, ts);
+    for (size_t ti = k + 1; ti < nt; ++ti) {
+      // the rows below a partial last tile row are zeroed, so the padding of its tiles stays zero
+      for (size_t i = 0; i < ts; ++i) {
+        for (size_t j = 0; j < panel_width; ++j) {
+          l(i, j) = i < matrix.tile_height(ti) ? panel(ti * ts + i - row0, j) : static_cast<T>(0);
+        }
+      }
+      for (size_t tj = k + 1; tj < matrix.tile_columns(); ++tj) {
+        matrix.prefetch(ti, tj + 1);
+        tile_multiply_add(*matrix.get_tile(ti, tj, true), l, *matrix.get_tile(k, tj), static_cast<T>(-1));
+      }
+    }
+    matrix.report_progress("lu", k + 1, nt);
+  }
+  return true;
+}
+
+}  // namespace detail
+
+
+template<typename T>
+TiledMatrix<T> operator+(const TiledMatrix<T>& matrix1, const TiledMatrix<T>& matrix2) {
+  return detail::tiled_elementwise(matrix1, matrix2, "add", [] (const T& a, const T& b) { return a + b; });
+}
+
+template<typename T>
+TiledMatrix<T> operator-(const TiledMatrix<T>& matrix1, const TiledMatrix<T>& matrix2) {
+  return detail::tiled_elementwise(matrix1, matrix2, "sub", [] (const T& a, const T& b) { return a - b; });
+}
+
+template<typename T>
+TiledMatrix<T> operator*(const TiledMatrix<T>& matrix1, const TiledMatrix<T>& matrix2) {
+  return detail::tiled_elementwise(matrix1, matrix2, "mult", [] (const T& a, const T& b) { return a * b; });
+}
+
+template<typename T>
+TiledMatrix<T> operator/(const TiledMatrix<T>& matrix1, const TiledMatrix<T>& matrix2) {
+  return detail::tiled_elementwise(matrix1, matrix2, "div", [] (const T& a, const T& b) { return a / b; });
+}
+
+
+template<typename T>
+TiledMatrix<T> dot(const TiledMatrix<T>& left, const TiledMatrix<T>& right) {
+  if (left.GetWidth() != right.GetLength()) {
+    throw std::length_error("Left width (" + std::to_string(left.GetWidth()) + ") and right length (" +
+                                             std::to_string(right.GetLength()) + ") are not equal");
+  }
+  if (left.tile_size() != right.tile_size()) {
+    throw std::invalid_argument("Different tile sizes");
+  }
+  TiledMatrix<T> res(left.GetLength(), right.GetWidth(), left.tile_size(), left.cache_capacity());
+  size_t inner = left.tile_columns();
+  size_t total = res.tile_rows() * res.tile_columns();
+  size_t done = 0;
+  for (size_t ti = 0; ti < res.tile_rows(); ++ti) {
+    for (size_t tj = 0; tj < res.tile_columns(); ++tj) {
+      auto tile = res.get_tile(ti, tj, true);
+      for (size_t p = 0; p < inner; ++p) {
+        left.prefetch(ti, p + 1);
+        right.prefetch(p + 1, tj);
+        detail::tile_multiply_add(*tile, *left.get_tile(ti, p), *right.get_tile(p, tj), static_cast<T>(1));
+      }
+      left.report_progress("dot", ++done, total);
+    }
+  }
+  return res;
+}
+
+template<typename T>
+TiledMatrix<T> transposed(const TiledMatrix<T>& matrix) {
+  TiledMatrix<T> res(matrix.GetWidth(), matrix.GetLength(), matrix.tile_size(), matrix.cache_capacity());
+  size_t total = matrix.tile_rows() * matrix.tile_columns();
+  size_t done = 0;
+  matrix.for_each_tile([&] (size_t ti, size_t tj) {
+    *res.get_tile(tj, ti, true) = transposed(*matrix.get_tile(ti, tj));
+    matrix.report_progress("transpose", ++done, total);
+  });
+  return res;
+}
+
+
+template<typename T>
+T det(const TiledMatrix<T>& matrix) {
+  if (matrix.GetWidth() != matrix.GetLength()) {
+    throw std::length_error("The matrix isn't a square");
+  }
+  TiledMatrix<T> lu = matrix.copy();
+  std::vector<size_t> pivots;
+  bool odd_swaps;
+  if (!detail::tiled_lu(lu, pivots, odd_swaps)) {
+    return static_cast<T>(0);
+  }
+  T res = odd_swaps ? static_cast<T>(-1) : static_cast<T>(1);
+  for (size_t k = 0; k < lu.tile_rows(); ++k) {
+    auto tile = lu.get_tile(k, k);
+    for (size_t i = 0; i < lu.tile_height(k); ++i) {
+      res *= (*tile)(i, i);
+    }
+  }
+  return res;
+}
+
+// returns a 0 x 0 matrix if there is no unique solution
+template<typename T>
+TiledMatrix<T> sle_solution(const TiledMatrix<T>& left_part, const TiledMatrix<T>& right_part) {
+  if (left_part.GetLength() != right_part.GetLength()) {
+    throw std::length_error("Shapes do not match");
+  }
+  if (left_part.GetLength() != left_part.GetWidth()) {
+    throw std::length_error("Tiled solver requires a square system");
+  }
+  if (left_part.tile_size() != right_part.tile_size()) {
+    throw std::invalid_argument("Different tile sizes");
+  }
+  TiledMatrix<T> lu = left_part.copy();
+  std::vector<size_t> pivots;
+  bool odd_swaps;
+  if (!detail::tiled_lu(lu, pivots, odd_swaps)) {
+    return TiledMatrix<T>(0, 0, left_part.tile_size(), left_part.cache_capacity());
+  }
+  TiledMatrix<T> x = right_part.copy();
+  size_t n = lu.GetLength();
+  size_t ts = lu.tile_size();
+  size_t nt = lu.tile_rows();
+  for (size_t i = 0; i < n; ++i) {
+    if (pivots[i] == i) {
+      continue;
+    }
+    for (size_t tj = 0; tj < x.tile_columns(); ++tj) {
+      auto tile1 = x.get_tile(i / ts, tj, true);
+      auto tile2 = x.get_tile(pivots[i] / ts, tj, true);
+      for (size_t j = 0; j < ts; ++j) {
+        std::swap((*tile1)(i % ts, j), (*tile2)(pivots[i] % ts, j));
+      }
+    }
+  }
+  for (size_t tj = 0; tj < x.tile_columns(); ++tj) {
+    for (size_t k = 0; k < nt; ++k) {
+      auto xk = x.get_tile(k, tj, true);
+      detail::tile_lower_solve(*lu.get_tile(k, k), 0, *xk, lu.tile_height(k));
+      for (size_t ti = k + 1; ti < nt; ++ti) {
+        lu.prefetch(ti + 1, k);
+        detail::tile_multiply_add(*x.get_tile(ti, tj, true), *lu.get_tile(ti, k), *xk, static_cast<T>(-1));
+      }
+    }
+    for (size_t k = nt; k-- > 0;) {
+      auto xk = x.get_tile(k, tj, true);
+      detail::tile_upper_solve(*lu.get_tile(k, k), *xk, lu.tile_height(k));
+      for (size_t ti = 0; ti < k; ++ti) {
+        lu.prefetch(ti + 1, k);
+        detail::tile_multiply_add(*x.get_tile(ti, tj, true), *lu.get_tile(ti, k), *xk, static_cast<T>(-1));
+      }
+    }
+    left_part.report_progress("sle_solution", tj + 1, x.tile_columns());
+  }
+  return x;
+}
+
+template<typename T>
+TiledMatrix<T> inverse(const TiledMatrix<T>& matrix) {
+  if (matrix.GetWidth() != matrix.GetLength()) {
+    throw std::length_error("The matrix isn't a square");
+  }
+  size_t n = matrix.GetLength();
+  TiledMatrix<T> identity(n, n, matrix.tile_size(), matrix.cache_capacity());
+  for (size_t k = 0; k < identity.tile_rows(); ++k) {
+    auto tile = identity.get_tile(k, k, true);
+    for (size_t i = 0; i < identity.tile_height(k); ++i) {
+      (*tile)(i, i) = static_cast<T>(1);
+    }
+  }
+  TiledMatrix<T> res = sle_solution(matrix, identity);
+  if (res.GetLength() == 0) {
+    throw std::invalid_argument("Determinant equals 0, inverse matrix doesn't exist");
+  }
+  return res;
+}
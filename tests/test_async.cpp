@@ -0,0 +1,57 @@
+#include "util/timeout_guard.h"
+#include <gtest/gtest.h>
+
+#include "../matrix/async.h"
+
+TEST(Async, ChainedOperations) {
+  TimeoutGuard guard(5s);
+  Matrix<double> a = random_matrix(60, 60, -1.0, 1.0) + diag(60.0, 60);
+  Matrix<double> b = random_matrix(60, 4, -1.0, 1.0);
+
+  // x = A^-1 b and y = solve(A, b) run side by side, then are compared
+  Future<Matrix<double>> x = async_dot(async_inverse(a), make_ready_future(b));
+  Future<Matrix<double>> y = async_sle_solution(a, b);
+  Future<double> difference = when_all(x, y).then([] (const std::tuple<Matrix<double>, Matrix<double>>& pair) {
+    Matrix<double> delta = std::get<0>(pair) - std::get<1>(pair);
+    return std::sqrt(vdot(transposed(delta.get_column(0)), delta.get_column(0)));
+  });
+  ASSERT_LT(difference.get(), 1e-9);
+  ASSERT_EQ(dot(a, y.get()), b);
+
+  Future<double> determinant = async_det(a).then([] (double value) {
+    return 2 * value;
+  });
+  ASSERT_NEAR(determinant.get() / det(a), 2.0, 1e-9);
+}
+
+TEST(Async, ErrorsPropagate) {
+  ThreadPool pool(2);
+  Matrix<double> a(3, 4);
+  auto product = async_dot(a, a, pool);
+  bool called = false;
+  auto next = product.then([&called] (const Matrix<double>& m) {
+    called = true;
+    return m.GetLength();
+  });
+  ASSERT_THROW(next.get(), std::length_error);
+  ASSERT_FALSE(called);
+  ASSERT_THROW(when_all(product, make_ready_future(1, pool)).get(), std::length_error);
+  ASSERT_THROW(async_inverse(Matrix<double>(2, 2), pool).get(), std::invalid_argument);
+}
+
+TEST(Async, ManyTasks) {
+  ThreadPool pool(3);
+  ASSERT_EQ(pool.size(), 3u);
+  std::vector<Future<Matrix<int>>> futures;
+  for (int i = 0; i < 20; ++i) {
+    futures.push_back(submit(pool, [] (int k) {
+      return diag(k, 3);
+    }, i));
+  }
+  std::vector<Matrix<int>> results = when_all(futures, pool).get();
+  ASSERT_EQ(results.size(), 20u);
+  for (int i = 0; i < 20; ++i) {
+    ASSERT_EQ(results[i], diag(i, 3));
+  }
+  ASSERT_TRUE(when_all(std::vector<Future<int>>(), pool).get().empty());
+}
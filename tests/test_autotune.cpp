@@ -0,0 +1,121 @@
+#include "util/timeout_guard.h"
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <filesystem>
+
+#include "../matrix/autotune.h"
+
+namespace {
+
+bool same_table(const Autotuner& tuner, const std::map<Operation, std::vector<Autotuner::Crossover>>& table) {
+  for (const auto& [operation, expected] : table) {
+    auto crossovers = tuner.crossovers(operation);
+    if (crossovers.size() != expected.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < crossovers.size(); ++i) {
+      if (crossovers[i].from != expected[i].from || crossovers[i].variant != expected[i].variant) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+// runs first: nothing has loaded a table yet
+TEST(Autotune, DefaultsWithoutTable) {
+  TimeoutGuard guard(5s);
+  unsetenv("LINALG_AUTOTUNE_FILE");
+  bool had_file = std::filesystem::exists("linalg_autotune.txt");
+  Autotuner& tuner = Autotuner::instance();
+  ASSERT_EQ(tuner.choose(Operation::Dot, 8), Variant::Sequential);
+  ASSERT_EQ(tuner.choose(Operation::Det, 1000), Variant::Parallel);
+  ASSERT_TRUE(same_table(tuner, Autotuner::defaults()));
+  ASSERT_EQ(std::filesystem::exists("linalg_autotune.txt"), had_file);
+}
+
+TEST(Autotune, BrokenFileIsLeftAlone) {
+  std::string path = testing::TempDir() + "linalg_autotune_broken.txt";
+  {
+    std::ofstream out(path);
+    out << "not a table\n";
+  }
+  setenv("LINALG_AUTOTUNE_FILE", path.c_str(), 1);
+  Autotuner& tuner = Autotuner::instance();
+  tuner.set(Operation::Det, {{0, Variant::Sequential}});
+  tuner.load_default();
+  unsetenv("LINALG_AUTOTUNE_FILE");
+  ASSERT_TRUE(same_table(tuner, Autotuner::defaults()));
+  std::ifstream in(path);
+  std::string line;
+  std::getline(in, line);
+  ASSERT_EQ(line, "not a table");
+  std::remove(path.c_str());
+}
+
+TEST(Autotune, TuneSaveLoad) {
+  Autotuner& tuner = Autotuner::instance();
+  tuner.tune({4, 16, 48}, 1);
+  for (Operation operation : {Operation::Dot, Operation::Det, Operation::SleSolution, Operation::Rank}) {
+    auto crossovers = tuner.crossovers(operation);
+    ASSERT_FALSE(crossovers.empty());
+    ASSERT_EQ(crossovers.front().from, 0u);
+  }
+  ASSERT_LE(tuner.crossovers(Operation::Dot).size(), 3u);
+
+  std::string path = testing::TempDir() + "linalg_autotune_test.txt";
+  std::string table = tuner.to_string();
+  tuner.save(path);
+  tuner.set(Operation::Det, {{0, Variant::Sequential}});
+  ASSERT_TRUE(tuner.load(path));
+  ASSERT_EQ(tuner.to_string(), table);
+
+  // a table measured with another number of threads is ignored
+  {
+    std::ofstream out(path);
+    out << "linalg-autotune 1\nthreads 0\ndet 0 sequential\n";
+  }
+  ASSERT_FALSE(tuner.load(path));
+  ASSERT_FALSE(tuner.load(path + ".missing"));
+  {
+    std::ofstream out(path);
+    out << "linalg-autotune 1\nthreads " << std::thread::hardware_concurrency() << "\ndet 0 blocked\n";
+  }
+  ASSERT_THROW(tuner.load(path), std::invalid_argument);
+  {
+    std::ofstream out(path);
+    out << "something else\n";
+  }
+  ASSERT_THROW(tuner.load(path), std::invalid_argument);
+  std::remove(path.c_str());
+  ASSERT_EQ(tuner.to_string(), table);
+}
+
+TEST(Autotune, DispatchFollowsTable) {
+  Autotuner& tuner = Autotuner::instance();
+  tuner.set(Operation::Dot, {{0, Variant::Sequential}, {32, Variant::Parallel}});
+  ASSERT_EQ(tuner.choose(Operation::Dot, 31), Variant::Sequential);
+  ASSERT_EQ(tuner.choose(Operation::Dot, 32), Variant::Parallel);
+  ASSERT_EQ(tuner.choose(Operation::Dot, 1000), Variant::Parallel);
+
+  Matrix<double> a = random_matrix(40, 40, -1.0, 1.0) + diag(40.0, 40);
+  Matrix<double> b = random_matrix(40, 3, -1.0, 1.0);
+  for (Variant variant : {Variant::Sequential, Variant::Parallel, Variant::Fast}) {
+    tuner.set(Operation::SleSolution, {{0, variant}});
+    tuner.set(Operation::Rank, {{0, variant}});
+    ASSERT_EQ(dot(a, auto_sle_solution(a, b)), b);
+    ASSERT_EQ(auto_rank(a), 40u);
+  }
+  for (Variant variant : {Variant::Sequential, Variant::Parallel}) {
+    tuner.set(Operation::Dot, {{0, variant}});
+    tuner.set(Operation::Det, {{0, variant}});
+    ASSERT_EQ(auto_dot(a, b), seq_dot(a, b));
+    ASSERT_NEAR(auto_det(a) / det(a), 1.0, 1e-9);
+  }
+  // integers stay exact whatever the table says
+  tuner.set(Operation::Det, {{0, Variant::Sequential}});
+  ASSERT_EQ(auto_det(Matrix<int>({{2, 3, 1}, {4, 1, -3}, {-1, 5, 2}})), 40);
+}
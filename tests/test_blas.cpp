@@ -0,0 +1,145 @@
+#include "util/timeout_guard.h"
+#include <gtest/gtest.h>
+
+#include "../matrix/functions.h"
+#include "../matrix/sequential_functions.h"
+
+// keeps only the `triangle` half of `matrix`, with ones on the diagonal for Diagonal::Unit
+static Matrix<double> triangular_part(const Matrix<double>& matrix, Triangle triangle, Diagonal diagonal) {
+  Matrix<double> res = matrix;
+  for (size_t i = 0; i < res.GetLength(); ++i) {
+    for (size_t j = 0; j < res.GetWidth(); ++j) {
+      if ((triangle == Triangle::Upper && j < i) || (triangle == Triangle::Lower && j > i)) {
+        res(i, j) = 0;
+      }
+    }
+    if (diagonal == Diagonal::Unit) {
+      res(i, i) = 1;
+    }
+  }
+  return res;
+}
+
+TEST(Blas, GemmOnViews) {
+  TimeoutGuard guard(5s);
+  Matrix<double> a = random_matrix(150, 300, -1.0, 1.0);
+  Matrix<double> b = random_matrix(300, 270, -1.0, 1.0);
+  Matrix<double> c = random_matrix(150, 270, -1.0, 1.0);
+  Matrix<double> expected = 2.0 * seq_dot(a, b) - c;
+  gemm<double>(2.0, a, b, -1.0, c);
+  ASSERT_EQ(c, expected);
+
+  // C[1:3, 2:4] = A[0:2, 1:4] * B[3:6, 0:2], the rest of C stays untouched
+  Matrix<double> small(4, 5);
+  MatrixView<const double> a_block = MatrixView<const double>(a).block(0, 1, 2, 3);
+  MatrixView<const double> b_block = MatrixView<const double>(b).block(3, 0, 3, 2);
+  gemm<double>(1.0, a_block, b_block, 0.0, MatrixView<double>(small).block(1, 2, 2, 2));
+  ASSERT_EQ(small.get_submatrix(1, 2, 2, 3), seq_dot(a_block.to_matrix(), b_block.to_matrix()));
+  ASSERT_EQ(small(0, 0), 0);
+  ASSERT_EQ(small(3, 4), 0);
+}
+
+TEST(Blas, TriangularSolveAllCases) {
+  size_t n = 150;
+  // small off-diagonal entries: with Diagonal::Unit the large diagonal is ignored, and a unit
+  // triangular matrix with O(1) entries is too ill-conditioned to check the round trip
+  Matrix<double> a = (1.0 / n) * random_matrix(n, n, -1.0, 1.0) + diag(2.0, n);
+  for (Side side : {Side::Left, Side::Right}) {
+    for (Triangle triangle : {Triangle::Upper, Triangle::Lower}) {
+      for (Diagonal diagonal : {Diagonal::NonUnit, Diagonal::Unit}) {
+        Matrix<double> b = side == Side::Left ? random_matrix(n, 7) : random_matrix(7, n);
+        Matrix<double> x = b;
+        trsm<double>(side, triangle, diagonal, a, x, 3.0);
+        Matrix<double> t = triangular_part(a, triangle, diagonal);
+        Matrix<double> product = side == Side::Left ? seq_dot(t, x) : seq_dot(x, t);
+        ASSERT_EQ(product, 3.0 * b);
+
+        Matrix<double> y = x;
+        trmm<double>(side, triangle, diagonal, a, y);
+        ASSERT_EQ(y, 3.0 * b);
+      }
+    }
+  }
+}
+
+TEST(Blas, TriangularVector) {
+  Matrix<double> a({{2, 0, 0}, {1, 4, 0}, {3, 5, 1}});
+  Matrix<double> x(std::vector<std::vector<double>>{{2}, {9}, {20}});
+  trsv<double>(Triangle::Lower, Diagonal::NonUnit, a, x);
+  ASSERT_EQ(x, Matrix<double>(std::vector<std::vector<double>>{{1}, {2}, {7}}));
+  ASSERT_THROW(trsv<double>(Triangle::Lower, Diagonal::NonUnit, a, MatrixView<double>(a)), std::length_error);
+  Matrix<double> wrong(2, 1);
+  ASSERT_THROW(trsv<double>(Triangle::Upper, Diagonal::Unit, a, wrong), std::length_error);
+}
+
+TEST(Blas, VectorKernels) {
+  size_t n = 301;
+  Matrix<double> a = random_matrix(n, n + 2, -1.0, 1.0);
+  Matrix<double> x = random_matrix(n + 2, 1, -1.0, 1.0);
+  Matrix<double> y = random_matrix(n, 1, -1.0, 1.0);
+  Matrix<double> expected = 2.0 * seq_dot(a, x) + 0.5 * y;
+  gemv<double>(2.0, a, x, 0.5, y);
+  ASSERT_EQ(y, expected);
+  ASSERT_EQ(dot(a, x), seq_dot(a, x));
+
+  Matrix<double> row = transposed(x);
+  ASSERT_NEAR(vdot(row, x), seq_dot(row, x)(0, 0), 1e-12);
+  ASSERT_EQ(dot(row, x), seq_dot(row, x));
+  ASSERT_EQ(dot(x, row), seq_dot(x, row));
+  ASSERT_EQ(dot(row, transposed(a)), seq_dot(row, transposed(a)));
+
+  Matrix<double> b = a;
+  ger<double>(-1.0, y, x, b);
+  ASSERT_EQ(b, a - seq_dot(y, row));
+
+  Matrix<double> z = row;
+  axpy<double>(3.0, x, z);
+  ASSERT_EQ(z, 4.0 * row);
+  scal(0.25, z);
+  ASSERT_EQ(z, row);
+
+  Matrix<double> big({{3e200, 4e200}});
+  ASSERT_NEAR(nrm2(big) / 5e200, 1.0, 1e-12);
+  ASSERT_EQ(nrm2(Matrix<double>(3, 1)), 0);
+  // the second column of a, read through the row stride
+  ASSERT_NEAR(nrm2<double>(MatrixView<const double>(a).block(0, 1, n, 1)),
+              std::sqrt(seq_dot(transposed(a.get_column(1)), a.get_column(1))(0, 0)), 1e-12);
+  ASSERT_THROW(vdot(a, x), std::length_error);
+}
+
+TEST(Blas, SymmetricRankK) {
+  Matrix<double> a = random_matrix(90, 140, -1.0, 1.0);
+  Matrix<double> b = random_matrix(90, 140, -1.0, 1.0);
+  for (Transpose trans : {Transpose::NoTrans, Transpose::Trans}) {
+    Matrix<double> at = transposed(a);
+    Matrix<double> bt = transposed(b);
+    Matrix<double> product = trans == Transpose::Trans ? seq_dot(at, a) : seq_dot(a, at);
+    Matrix<double> product2 = trans == Transpose::Trans ? seq_dot(at, b) + seq_dot(bt, a)
+                                                        : seq_dot(a, bt) + seq_dot(b, at);
+    size_t n = product.GetLength();
+    ASSERT_EQ(gram(a, trans), product);
+    for (Triangle triangle : {Triangle::Upper, Triangle::Lower}) {
+      Matrix<double> c = random_matrix(n, n, -1.0, 1.0);
+      Matrix<double> c2 = c;
+      Matrix<double> original = c;
+      Matrix<double> expected = 2.0 * product + 0.5 * c;
+      Matrix<double> expected2 = 2.0 * product2 + 0.5 * c;
+      syrk<double>(triangle, trans, 2.0, a, 0.5, c);
+      syr2k<double>(triangle, trans, 2.0, a, b, 0.5, c2);
+      for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+          bool inside = triangle == Triangle::Upper ? j >= i : j <= i;
+          if (inside) {
+            ASSERT_NEAR(c(i, j), expected(i, j), 1e-9);
+            ASSERT_NEAR(c2(i, j), expected2(i, j), 1e-9);
+          } else {
+            ASSERT_EQ(c(i, j), original(i, j));
+            ASSERT_EQ(c2(i, j), original(i, j));
+          }
+        }
+      }
+    }
+  }
+  Matrix<double> wrong(3, 3);
+  ASSERT_THROW(syrk<double>(Triangle::Upper, Transpose::Trans, 1.0, a, 0.0, wrong), std::length_error);
+}
@@ -0,0 +1,41 @@
+#include "util/timeout_guard.h"
+#include <gtest/gtest.h>
+
+#include "../matrix/chain.h"
+#include "../matrix/sequential_functions.h"
+
+TEST(Chain, MultiDot) {
+  TimeoutGuard guard(5s);
+  std::vector<size_t> dims = {30, 2, 80, 5, 60, 1, 40};
+  std::vector<Matrix<double>> matrices;
+  for (size_t i = 0; i + 1 < dims.size(); ++i) {
+    matrices.push_back(random_matrix(dims[i], dims[i + 1], -1.0, 1.0));
+  }
+  Matrix<double> expected = matrices[0];
+  for (size_t i = 1; i < matrices.size(); ++i) {
+    expected = seq_dot(expected, matrices[i]);
+  }
+  std::vector<const Matrix<double>*> pointers;
+  for (const auto& matrix : matrices) {
+    pointers.push_back(&matrix);
+  }
+  ASSERT_EQ(multi_dot(pointers), expected);
+  ASSERT_EQ(multi_dot(matrices[0], matrices[1], matrices[2], matrices[3], matrices[4], matrices[5]), expected);
+  ASSERT_EQ(multi_dot({matrices[0], matrices[1]}), seq_dot(matrices[0], matrices[1]));
+  ASSERT_EQ(multi_dot({matrices[2]}), matrices[2]);
+  ASSERT_THROW(multi_dot(matrices[0], matrices[2]), std::length_error);
+}
+
+TEST(Chain, Order) {
+  ASSERT_EQ(multi_dot_order({{10, 100}, {100, 5}, {5, 50}}), "((0 1) 2)");
+  ASSERT_EQ(multi_dot_order({{50, 5}, {5, 100}, {100, 10}}), "(0 (1 2))");
+  // a column vector at the end: every product should be a matrix-vector one
+  ASSERT_EQ(multi_dot_order({{300, 300}, {300, 300}, {300, 300}, {300, 1}}), "(0 (1 (2 3)))");
+  // same flops and memory, but the kernel's inner loop runs over two columns only
+  ChainCostModel model;
+  ASSERT_LT(model.product_cost(2, 100, 100), model.product_cost(100, 100, 2));
+  // no order fits into one byte, the cheapest is taken anyway
+  model.max_intermediate_bytes = 1;
+  ASSERT_EQ(multi_dot_order({{10, 100}, {100, 5}, {5, 50}}, model), "((0 1) 2)");
+  ASSERT_THROW(multi_dot_order({{10, 100}, {10, 5}}), std::length_error);
+}
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+
+#include "../matrix/distributed.h"
+#include "../matrix/reductions.h"
+
+// every process runs in its own address space, so the checks throw
+// and the parent only sees whether all of them exited cleanly
+
+static void check(bool condition) {
+  if (!condition) {
+    throw std::runtime_error("Check failed");
+  }
+}
+
+TEST(Distributed, ScatterGather) {
+  Matrix<double> matrix = random_matrix(11, 7);
+  ASSERT_TRUE(run_local_processes(4, [&] (Communicator& comm) {
+    auto distributed = DistributedMatrix<double>::scatter(comm, {2, 2}, matrix, 2);
+    size_t local_elements = distributed.local().GetLength() * distributed.local().GetWidth();
+    comm.allreduce(&local_elements, 1, std::plus<size_t>());
+    check(local_elements == 11 * 7);
+    size_t column_elements = distributed.local().GetLength() * distributed.local().GetWidth();
+    comm.allreduce(&column_elements, 1, std::plus<size_t>(), distributed.column_group());
+    check(column_elements == 11 * (distributed.process_column() == 0 ? 4 : 3));
+    Matrix<double> gathered = distributed.gather(0);
+    check(comm.rank() != 0 || gathered == matrix);
+  }));
+}
+
+TEST(Distributed, Summa) {
+  Matrix<double> left = random_matrix(13, 9, 1.0, 2.0);
+  Matrix<double> right = random_matrix(9, 10, 1.0, 2.0);
+  Matrix<double> expected = dot(left, right);
+  ASSERT_TRUE(run_local_processes(6, [&] (Communicator& comm) {
+    auto distributed_left = DistributedMatrix<double>::scatter(comm, {2, 3}, left, 2);
+    auto distributed_right = DistributedMatrix<double>::scatter(comm, {2, 3}, right, 2);
+    Matrix<double> product = dot(distributed_left, distributed_right).gather(0);
+    check(comm.rank() != 0 || product == expected);
+  }));
+}
+
+TEST(Distributed, Transpose) {
+  Matrix<int> matrix({{1, 2, 3, 4, 5}, {6, 7, 8, 9, 10}, {11, 12, 13, 14, 15}});
+  ASSERT_TRUE(run_local_processes(3, [&] (Communicator& comm) {
+    auto distributed = DistributedMatrix<int>::scatter(comm, {1, 3}, matrix, 1);
+    Matrix<int> result = transposed(distributed).gather(0);
+    check(comm.rank() != 0 || result == transposed(matrix));
+  }));
+}
+
+TEST(Distributed, SolveAndDeterminant) {
+  Matrix<double> left({ {1, 1, 4, 4, 9}, {2, 2, 17, 17, 82}, {2, 0, 3, -1, 4}, {0, 1, 4, 12, 27}, {1, 2, 2, 10, 0} });
+  Matrix<double> right({ {-9}, {-146}, {-10}, {-26}, {37} });
+  Matrix<double> expected({ {5}, {4}, {-3}, {3}, {-2} });
+  double expected_det = det(left);
+  ASSERT_TRUE(run_local_processes(4, [&] (Communicator& comm) {
+    auto distributed_left = DistributedMatrix<double>::scatter(comm, {2, 2}, left, 2);
+    auto distributed_right = DistributedMatrix<double>::scatter(comm, {2, 2}, right, 2);
+    Matrix<double> result = sle_solution(distributed_left, distributed_right).gather(0);
+    check(comm.rank() != 0 || result == expected);
+    check(std::abs(det(distributed_left) - expected_det) < 1e-8);
+  }));
+}
+
+TEST(Distributed, BlockedLu) {
+  // blocks of 1, of 4 with a partial last one and a single block, on grids of different shapes
+  Matrix<double> left = random_matrix(23, 23, -1.0, 1.0);
+  Matrix<double> right = random_matrix(23, 3, -1.0, 1.0);
+  double expected_det = det(left);
+  for (size_t block_size : {1, 4, 30}) {
+    for (ProcessGrid grid : {ProcessGrid{2, 3}, ProcessGrid{3, 1}, ProcessGrid{1, 2}}) {
+      ASSERT_TRUE(run_local_processes(grid.rows * grid.columns, [&] (Communicator& comm) {
+        auto distributed_left = DistributedMatrix<double>::scatter(comm, grid, left, block_size);
+        auto distributed_right = DistributedMatrix<double>::scatter(comm, grid, right, block_size);
+        Matrix<double> result = sle_solution(distributed_left, distributed_right).gather(0);
+        check(comm.rank() != 0 || allclose(dot(left, result), right, 1e-9, 1e-9));
+        check(std::abs(det(distributed_left) - expected_det) < 1e-9 * std::abs(expected_det));
+      }));
+    }
+  }
+}
+
+TEST(Distributed, SingularSystem) {
+  Matrix<double> left({{1, 2}, {2, 4}});
+  Matrix<double> right(std::vector<std::vector<double>>{{1}, {2}});
+  ASSERT_TRUE(run_local_processes(2, [&] (Communicator& comm) {
+    auto distributed_left = DistributedMatrix<double>::scatter(comm, {2, 1}, left, 1);
+    auto distributed_right = DistributedMatrix<double>::scatter(comm, {2, 1}, right, 1);
+    check(sle_solution(distributed_left, distributed_right).GetShape() == std::make_pair<size_t, size_t>(0, 0));
+  }));
+  ASSERT_FALSE(run_local_processes(2, [] (Communicator& comm) {
+    check(comm.rank() == 0);
+  }));
+}
@@ -0,0 +1,56 @@
+#include "util/timeout_guard.h"
+#include <gtest/gtest.h>
+
+#include "../matrix/factorizations.h"
+#include "../matrix/functions.h"
+
+TEST(Exact, IntegerDeterminantAndRank) {
+  TimeoutGuard guard(5s);
+  Matrix<int> matrix({{2, 3, 1}, {4, 1, -3}, {-1, 5, 2}});
+  ASSERT_EQ(det(matrix), 40);
+  ASSERT_EQ(modular_det(matrix), 40);
+  // integer division would have made the old elimination return garbage here
+  Matrix<long long> symmetric({{6, 4, 3}, {4, 3, 12}, {3, 12, 10}});
+  ASSERT_EQ(det(symmetric), -583);
+  ASSERT_EQ(rank(Matrix<int>({{1, 2, 3}, {2, 4, 6}, {1, 0, 1}})), 2u);
+  ASSERT_EQ(modular_rank(Matrix<int>({{1, 2, 3}, {2, 4, 6}, {1, 0, 1}})), 2u);
+  ASSERT_EQ(det(Matrix<int>({{1, 2}, {2, 4}})), 0);
+  ASSERT_EQ(det(Matrix<int>({{0, 1}, {1, 0}})), -1);
+}
+
+TEST(Exact, LargeEntriesGoModular) {
+  // Bareiss intermediates would overflow here, the determinant itself is small
+  long long big = 3037000493LL;
+  Matrix<long long> matrix({{big, big - 1, 0}, {big - 2, big - 3, 0}, {0, 0, 5}});
+  ASSERT_EQ(det(matrix), -10);
+  ASSERT_EQ(modular_det(matrix), -10);
+  ASSERT_EQ(rank(matrix), 3u);
+  ASSERT_EQ(rank(Matrix<long long>({{big, big, 1}, {big, big, 1}})), 1u);
+
+  Matrix<double> random = random_matrix(12, 12, -3.0, 3.0);
+  Matrix<long long> rounded(12, 12);
+  for (size_t i = 0; i < 12; ++i) {
+    for (size_t j = 0; j < 12; ++j) {
+      rounded(i, j) = std::llround(random(i, j));
+      random(i, j) = static_cast<double>(rounded(i, j));
+    }
+  }
+  // the reference pivots by magnitude: the zero test of det can pick a rounding residue as pivot
+  ASSERT_EQ(det(rounded), std::llround(LUDecomposition<double>(random).det()));
+
+  Matrix<int> overflowing({{1 << 30, 1}, {-(1 << 30), 1 << 30}});
+  ASSERT_THROW(det(overflowing), std::overflow_error);
+}
+
+TEST(Exact, Adjugate) {
+  Matrix<int> matrix({{2, 3, 1}, {4, 1, -3}, {-1, 5, 2}});
+  Matrix<int> adj = adjugate(matrix);
+  ASSERT_EQ(dot(matrix, adj), diag(40, 3));
+  ASSERT_EQ(dot(adj, matrix), diag(40, 3));
+
+  // rank n - 1: the adjugate is the rank one matrix of cofactors
+  Matrix<int> singular({{1, 2, 3}, {4, 5, 6}, {7, 8, 9}});
+  Matrix<int> singular_adj = adjugate(singular);
+  ASSERT_EQ(singular_adj, Matrix<int>({{-3, 6, -3}, {6, -12, 6}, {-3, 6, -3}}));
+  ASSERT_EQ(adjugate(Matrix<int>({{1, 1, 1}, {1, 1, 1}, {1, 1, 1}})), Matrix<int>(3, 3));
+}
@@ -0,0 +1,237 @@
+#include "util/timeout_guard.h"
+#include <gtest/gtest.h>
+
+#include "../matrix/factorizations.h"
+
+TEST(Factorizations, LUSolveAndDeterminant) {
+  TimeoutGuard guard(1s);
+  Matrix<double> matrix({ {1, 1, 4, 4, 9}, {2, 2, 17, 17, 82}, {2, 0, 3, -1, 4}, {0, 1, 4, 12, 27}, {1, 2, 2, 10, 0} });
+  Matrix<double> right({ {-9}, {-146}, {-10}, {-26}, {37} });
+  Matrix<double> expected({ {5}, {4}, {-3}, {3}, {-2} });
+  LUDecomposition<double> lu(matrix);
+  ASSERT_FALSE(lu.singular());
+  ASSERT_EQ(lu.solve(right), expected);
+  ASSERT_NEAR(lu.det(), det(matrix), 1e-8);
+}
+
+TEST(Factorizations, LUSingular) {
+  LUDecomposition<double> lu(Matrix<double>({{1, 2}, {2, 4}}));
+  ASSERT_TRUE(lu.singular());
+  ASSERT_EQ(lu.det(), 0);
+  ASSERT_TRUE(lu.solve(Matrix<double>(2, 1)).empty());
+}
+
+TEST(Factorizations, MixedPrecisionReachesDoubleAccuracy) {
+  size_t size = 100;
+  Matrix<double> matrix = random_matrix(size, size, -1.0, 1.0) + diag(static_cast<double>(size), size);
+  Matrix<double> right = random_matrix(size, 3, -1.0, 1.0);
+  MixedPrecisionInfo info;
+  Matrix<double> x = mixed_sle_solution(matrix, right, &info);
+  ASSERT_FALSE(info.fell_back);
+  ASSERT_GT(info.iterations, 0u);
+  ASSERT_LT(info.residual_norm, 1e-12);
+  Matrix<double> residual = right - dot(matrix, x);
+  for (size_t i = 0; i < size; ++i) {
+    for (size_t j = 0; j < 3; ++j) {
+      ASSERT_LT(std::abs(residual(i, j)), 1e-12);
+    }
+  }
+}
+
+TEST(Factorizations, MixedPrecisionFallsBack) {
+  size_t size = 12;
+  Matrix<double> hilbert(size, size);
+  Matrix<double> right(size, 1);
+  for (size_t i = 0; i < size; ++i) {
+    for (size_t j = 0; j < size; ++j) {
+      hilbert(i, j) = 1.0 / static_cast<double>(i + j + 1);
+      right(i, 0) += hilbert(i, j);
+    }
+  }
+  MixedPrecisionInfo info;
+  Matrix<double> x = mixed_sle_solution(hilbert, right, &info);
+  ASSERT_TRUE(info.fell_back);
+  ASSERT_EQ(x.GetLength(), size);
+  ASSERT_TRUE(mixed_sle_solution(Matrix<double>({{1, 2}, {2, 4}}),
+                                 Matrix<double>(std::vector<std::vector<double>>{{1}, {2}})).empty());
+}
+
+TEST(Factorizations, LUConditionEstimate) {
+  size_t size = 60;
+  Matrix<double> matrix = random_matrix(size, size, -1.0, 1.0) + diag(4.0, size);
+  LUDecomposition<double> lu(matrix);
+  Matrix<double> right = random_matrix(size, 2, -1.0, 1.0);
+  ASSERT_EQ(dot(transposed(matrix), lu.solve_transposed(right)), right);
+
+  Matrix<double> inv = inverse(matrix);
+  double exact = norm(matrix, Norm::One) * norm(inv, Norm::One);
+  double estimate = lu.cond_estimate();
+  // a lower bound, rarely off by more than a factor of 3
+  ASSERT_LE(estimate, exact * (1 + 1e-10));
+  ASSERT_GE(estimate, exact / 3);
+  ASSERT_EQ(cond_estimate(matrix), estimate);
+
+  // the Hilbert matrix: kappa_1 of the 8 x 8 one is about 3.4e10
+  Matrix<double> hilbert(8, 8);
+  for (size_t i = 0; i < 8; ++i) {
+    for (size_t j = 0; j < 8; ++j) {
+      hilbert(i, j) = 1.0 / static_cast<double>(i + j + 1);
+    }
+  }
+  ASSERT_NEAR(std::log10(cond_estimate(hilbert)), std::log10(3.387e10), 0.5);
+  ASSERT_EQ(LUDecomposition<double>(Matrix<double>({{1, 2}, {2, 4}})).cond_estimate(),
+            std::numeric_limits<double>::infinity());
+
+  // diag(1..5) scaled by an orthogonal permutation: sigma = 5 and 1
+  Matrix<double> scaled({{0, 2, 0}, {5, 0, 0}, {0, 0, 1}});
+  ASSERT_NEAR(norm2_estimate(scaled), 5.0, 1e-5);
+  ASSERT_NEAR(LUDecomposition<double>(scaled).cond2_estimate(), 5.0, 1e-4);
+}
+
+TEST(Factorizations, Cholesky) {
+  size_t size = 50;
+  Matrix<double> a = random_matrix(size, size, -1.0, 1.0);
+  Matrix<double> spd = dot(a, transposed(a)) + diag(1.0, size);
+  CholeskyDecomposition<double> cholesky(spd);
+  ASSERT_TRUE(cholesky.positive_definite());
+  Matrix<double> right = random_matrix(size, 3, -1.0, 1.0);
+  ASSERT_EQ(dot(spd, cholesky.solve(right)), right);
+  ASSERT_NEAR(cholesky.det() / det(spd), 1.0, 1e-8);
+
+  double exact = norm(spd, Norm::One) * norm(inverse(spd), Norm::One);
+  ASSERT_LE(cholesky.cond_estimate(), exact * (1 + 1e-10));
+  ASSERT_GE(cholesky.cond_estimate(), exact / 3);
+  ASSERT_NEAR(cholesky.cond2_estimate() / LUDecomposition<double>(spd).cond2_estimate(), 1.0, 1e-3);
+
+  // only the lower triangle is read
+  Matrix<double> lower({{4, 100}, {2, 3}});
+  ASSERT_EQ(CholeskyDecomposition<double>(lower).solve(Matrix<double>(std::vector<std::vector<double>>{{6}, {5}})),
+            Matrix<double>(std::vector<std::vector<double>>{{1}, {1}}));
+  CholeskyDecomposition<double> indefinite(Matrix<double>({{1, 2}, {2, 1}}));
+  ASSERT_FALSE(indefinite.positive_definite());
+  ASSERT_TRUE(indefinite.solve(Matrix<double>(2, 1)).empty());
+  ASSERT_THROW(indefinite.det(), std::invalid_argument);
+}
+
+TEST(Factorizations, WoodburyUpdate) {
+  size_t size = 40;
+  Matrix<double> matrix = random_matrix(size, size, -1.0, 1.0) + diag(8.0, size);
+  Matrix<double> u = random_matrix(size, 3, -1.0, 1.0);
+  Matrix<double> v = random_matrix(size, 3, -1.0, 1.0);
+  Matrix<double> updated = woodbury_update(inverse(matrix), u, v);
+  ASSERT_TRUE(allclose(updated, inverse(matrix + dot(u, transposed(v))), 1e-9, 1e-12));
+
+  // E - e1 e1^T is singular
+  Matrix<double> e1(std::vector<std::vector<double>>{{1}, {0}});
+  ASSERT_TRUE(woodbury_update(diag(1.0, 2), e1, -1.0 * e1).empty());
+  ASSERT_THROW(woodbury_update(diag(1.0, 2), e1, Matrix<double>(2, 2)), std::length_error);
+}
+
+TEST(Factorizations, CholeskyUpdates) {
+  size_t size = 30;
+  Matrix<double> a = random_matrix(size, size, -1.0, 1.0);
+  Matrix<double> spd = dot(a, transposed(a)) + diag(1.0, size);
+  Matrix<double> x = random_matrix(size, 2, -1.0, 1.0);
+  Matrix<double> right = random_matrix(size, 1, -1.0, 1.0);
+
+  CholeskyDecomposition<double> cholesky(spd);
+  cholesky.update(x);
+  Matrix<double> updated = spd + dot(x, transposed(x));
+  ASSERT_TRUE(allclose(cholesky.factor(), CholeskyDecomposition<double>(updated).factor(), 1e-9, 1e-12));
+  ASSERT_TRUE(cholesky.downdate(x));
+  ASSERT_TRUE(allclose(cholesky.solve(right), CholeskyDecomposition<double>(spd).solve(right), 1e-8, 1e-12));
+  // the downdate by a huge x would break positive definiteness
+  ASSERT_FALSE(cholesky.downdate(100.0 * x));
+  ASSERT_TRUE(allclose(cholesky.solve(right), CholeskyDecomposition<double>(spd).solve(right), 1e-8, 1e-12));
+
+  // bordering and removing a row and column
+  Matrix<double> b = random_matrix(size + 1, size + 1, -1.0, 1.0);
+  Matrix<double> bigger = dot(b, transposed(b)) + diag(1.0, size + 1);
+  CholeskyDecomposition<double> grown(bigger.get_submatrix(0, size - 1, 0, size - 1));
+  ASSERT_TRUE(grown.append(bigger.get_column(size)));
+  ASSERT_TRUE(allclose(grown.factor(), CholeskyDecomposition<double>(bigger).factor(), 1e-9, 1e-12));
+  // a zero diagonal entry
+  ASSERT_FALSE(grown.append(concatenate(bigger.get_column(size), Matrix<double>(1, 1))));
+
+  size_t k = 7;
+  grown.remove(k);
+  Matrix<double> without = concatenate(bigger.get_submatrix(0, size, 0, k - 1), bigger.get_submatrix(0, size, k + 1, size), 1);
+  without = concatenate(without.get_submatrix(0, k - 1, 0, size - 1), without.get_submatrix(k + 1, size, 0, size - 1));
+  ASSERT_TRUE(allclose(grown.factor(), CholeskyDecomposition<double>(without).factor(), 1e-9, 1e-12));
+  ASSERT_GE(grown.cond_estimate(), CholeskyDecomposition<double>(without).cond_estimate() / 3);
+}
+
+TEST(Factorizations, LUAppend) {
+  size_t size = 30;
+  Matrix<double> matrix = random_matrix(size + 1, size + 1, -1.0, 1.0) + diag(4.0, size + 1);
+  LUDecomposition<double> lu(matrix.get_submatrix(0, size - 1, 0, size - 1));
+  lu.append(matrix.get_column(size), matrix.get_submatrix(size, size, 0, size - 1));
+  ASSERT_EQ(lu.size(), size + 1);
+  Matrix<double> right = random_matrix(size + 1, 2, -1.0, 1.0);
+  ASSERT_TRUE(allclose(lu.solve(right), sle_solution(matrix, right), 1e-9, 1e-12));
+  ASSERT_NEAR(lu.det() / det(matrix), 1.0, 1e-9);
+  double exact = norm(matrix, Norm::One) * norm(inverse(matrix), Norm::One);
+  ASSERT_LE(lu.cond_estimate(), exact * (1 + 1e-9));
+  ASSERT_GE(lu.cond_estimate(), exact / 3);
+
+  // [2 4; 1 2]
+  LUDecomposition<double> one(diag(2.0, 1));
+  one.append(Matrix<double>(std::vector<std::vector<double>>{{4}, {2}}), diag(1.0, 1));
+  ASSERT_TRUE(one.singular());
+  ASSERT_THROW(one.append(Matrix<double>(3, 1), Matrix<double>(1, 2)), std::invalid_argument);
+}
+
+TEST(Factorizations, LUUpdate) {
+  size_t size = 30;
+  Matrix<double> matrix = random_matrix(size, size, -1.0, 1.0) + diag(4.0, size);
+  Matrix<double> x = random_matrix(size, 3, -1.0, 1.0);
+  Matrix<double> y = random_matrix(size, 3, -1.0, 1.0);
+  Matrix<double> right = random_matrix(size, 2, -1.0, 1.0);
+  Matrix<double> updated = matrix + dot(x, transposed(y));
+
+  LUDecomposition<double> lu(matrix);
+  ASSERT_TRUE(lu.update(x, y));
+  ASSERT_TRUE(allclose(lu.solve(right), sle_solution(updated, right), 1e-9, 1e-12));
+  ASSERT_NEAR(lu.det() / det(updated), 1.0, 1e-9);
+  double exact = norm(updated, Norm::One) * norm(inverse(updated), Norm::One);
+  ASSERT_LE(lu.cond_estimate(), exact * (1 + 1e-9));
+  ASSERT_GE(lu.cond_estimate(), exact / 3);
+
+  // I - e1 e1^T is singular: the first pivot vanishes and nothing changes
+  LUDecomposition<double> identity(diag(1.0, 2));
+  Matrix<double> e1(std::vector<std::vector<double>>{{1}, {0}});
+  ASSERT_FALSE(identity.update(-1.0 * e1, e1));
+  ASSERT_EQ(identity.factors(), diag(1.0, 2));
+  ASSERT_THROW(identity.update(e1, Matrix<double>(3, 1)), std::length_error);
+}
+
+TEST(Factorizations, BuiltByAppends) {
+  size_t size = 12;
+  Matrix<double> matrix = random_matrix(size, size, -1.0, 1.0) + diag(4.0, size);
+  Matrix<double> a = random_matrix(size, size, -1.0, 1.0);
+  Matrix<double> spd = dot(a, transposed(a)) + diag(1.0, size);
+  LUDecomposition<double> lu(Matrix<double>(0, 0));
+  CholeskyDecomposition<double> cholesky(Matrix<double>(0, 0));
+  ASSERT_EQ(lu.cond_estimate(), 0.0);
+  ASSERT_EQ(cholesky.cond_estimate(), 0.0);
+  for (size_t n = 0; n < size; ++n) {
+    Matrix<double> row = n == 0 ? Matrix<double>(1, 0) : matrix.get_submatrix(n, n, 0, n - 1);
+    lu.append(matrix.get_submatrix(0, n, n, n), row);
+    ASSERT_TRUE(cholesky.append(spd.get_submatrix(0, n, n, n)));
+  }
+  ASSERT_EQ(lu.size(), size);
+  ASSERT_EQ(cholesky.size(), size);
+  Matrix<double> right = random_matrix(size, 2, -1.0, 1.0);
+  ASSERT_TRUE(allclose(lu.solve(right), sle_solution(matrix, right), 1e-9, 1e-12));
+  ASSERT_NEAR(lu.det() / det(matrix), 1.0, 1e-9);
+  ASSERT_TRUE(allclose(cholesky.factor(), CholeskyDecomposition<double>(spd).factor(), 1e-9, 1e-12));
+  ASSERT_TRUE(allclose(cholesky.solve(right), sle_solution(spd, right), 1e-8, 1e-12));
+
+  // the first pivot is checked as well
+  LUDecomposition<double> zero(Matrix<double>(0, 0));
+  zero.append(Matrix<double>(1, 1), Matrix<double>(1, 0));
+  ASSERT_TRUE(zero.singular());
+  CholeskyDecomposition<double> negative(Matrix<double>(0, 0));
+  ASSERT_FALSE(negative.append(diag(-1.0, 1)));
+  ASSERT_EQ(negative.size(), 0u);
+}
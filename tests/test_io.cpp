@@ -0,0 +1,90 @@
+#include "util/timeout_guard.h"
+#include <gtest/gtest.h>
+
+#include "../matrix/io.h"
+#include "../matrix/functions.h"
+
+TEST(IO, ReadCsv) {
+  TimeoutGuard guard(1s);
+  std::istringstream in("1,2,3\n4, 5 ,6\r\n\n7,8,-9\n");
+  Matrix<int> expected({{1, 2, 3}, {4, 5, 6}, {7, 8, -9}});
+  ASSERT_EQ(read_delimited<int>(in), expected);
+}
+
+TEST(IO, ReadTsvMalformed) {
+  std::istringstream in("1\t2\n3\tx\n");
+  ASSERT_THROW(read_delimited<double>(in, '\t'), std::invalid_argument);
+  std::istringstream ragged("1\t2\n3\n");
+  ASSERT_THROW(read_delimited<double>(ragged, '\t'), std::invalid_argument);
+}
+
+TEST(IO, CsvRoundTripIsExact) {
+  Matrix<double> matrix = random_matrix(300, 17, -1e3, 1e3);
+  matrix(0, 0) = 1e-300;
+  matrix(1, 1) = 0.1;
+  std::stringstream stream;
+  write_delimited(stream, matrix);
+  Matrix<double> read = read_delimited<double>(stream);
+  ASSERT_EQ(read.GetShape(), matrix.GetShape());
+  for (size_t i = 0; i < matrix.GetLength(); ++i) {
+    for (size_t j = 0; j < matrix.GetWidth(); ++j) {
+      ASSERT_EQ(read(i, j), matrix(i, j));
+    }
+  }
+}
+
+TEST(IO, CsvSpanningChunks) {
+  // more than one io_chunk_size, so the result grows while it is parsed into
+  size_t length = 2 * detail::io_chunk_size / 40 + 7;
+  std::string text;
+  for (size_t i = 0; i < length; ++i) {
+    text += std::to_string(i) + ",1234567.5,-2.25,3,4,5,6,7\n";
+  }
+  std::istringstream in(text);
+  Matrix<double> read = read_delimited<double>(in);
+  ASSERT_EQ(read.GetShape(), std::make_pair(length, size_t(8)));
+  for (size_t i = 0; i < length; i += 997) {
+    ASSERT_EQ(read(i, 0), static_cast<double>(i));
+    ASSERT_EQ(read(i, 1), 1234567.5);
+  }
+  ASSERT_EQ(read(length - 1, 0), static_cast<double>(length - 1));
+  ASSERT_EQ(read(length - 1, 7), 7.0);
+}
+
+TEST(IO, MatrixMarketArrayRoundTrip) {
+  Matrix<double> matrix({{1.5, -2, 0}, {4, 5.25, 6}});
+  std::stringstream stream;
+  write_matrix_market(stream, matrix);
+  Matrix<double> read = read_matrix_market<double>(stream);
+  ASSERT_EQ(read.GetShape(), matrix.GetShape());
+  for (size_t i = 0; i < matrix.GetLength(); ++i) {
+    for (size_t j = 0; j < matrix.GetWidth(); ++j) {
+      ASSERT_EQ(read(i, j), matrix(i, j));
+    }
+  }
+}
+
+TEST(IO, MatrixMarketCoordinate) {
+  std::istringstream in("%%MatrixMarket matrix coordinate real symmetric\n"
+                        "% comment\n"
+                        "3 3 4\n"
+                        "1 1 2.0\n"
+                        "2 1 -1\n"
+                        "3 2 -1\n"
+                        "3 3 2\n");
+  Matrix<double> expected({{2, -1, 0}, {-1, 0, -1}, {0, -1, 2}});
+  Matrix<double> read = read_matrix_market<double>(in);
+  ASSERT_EQ(read.GetShape(), expected.GetShape());
+  for (size_t i = 0; i < 3; ++i) {
+    for (size_t j = 0; j < 3; ++j) {
+      ASSERT_EQ(read(i, j), expected(i, j));
+    }
+  }
+}
+
+TEST(IO, MatrixMarketPatternOutOfRange) {
+  std::istringstream in("%%MatrixMarket matrix coordinate pattern general\n"
+                        "2 2 1\n"
+                        "3 1\n");
+  ASSERT_THROW(read_matrix_market<int>(in), std::out_of_range);
+}
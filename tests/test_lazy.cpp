@@ -0,0 +1,78 @@
+#include "util/timeout_guard.h"
+#include <gtest/gtest.h>
+
+#include "../matrix/lazy.h"
+#include "../matrix/sequential_functions.h"
+
+TEST(Lazy, Rewrites) {
+  TimeoutGuard guard(5s);
+  Matrix<double> a = random_matrix(40, 30, -1.0, 1.0);
+  Lazy<double> gram = transposed(lazy(a)) ^ lazy(a);
+  ASSERT_EQ(gram.plan(), "gram(m0)");
+  ASSERT_EQ(gram.eval(), seq_dot(transposed(a), a));
+  ASSERT_EQ((lazy(a) ^ transposed(lazy(a))).plan(), "row_gram(m0)");
+  ASSERT_EQ((lazy(a) ^ transposed(lazy(a))).eval(), seq_dot(a, transposed(a)));
+
+  Matrix<double> square = random_matrix(30, 30, -1.0, 1.0) + diag(30.0, 30);
+  Matrix<double> b = random_matrix(30, 2, -1.0, 1.0);
+  Lazy<double> solve = inverse(lazy(square)) ^ lazy(b);
+  ASSERT_EQ(solve.plan(), "solve(m0, m1)");
+  ASSERT_EQ(solve.eval(), sle_solution(square, b));
+  ASSERT_EQ((lazy(a) ^ inverse(lazy(square)) ^ lazy(b)).plan(), "dot(m0, solve(m1, m2))");
+  ASSERT_EQ(transposed(transposed(lazy(a))).plan(), "m0");
+  ASSERT_THROW(inverse(lazy(Matrix<double>(3, 3))).eval(), std::invalid_argument);
+  ASSERT_THROW((inverse(lazy(Matrix<double>(3, 3))) ^ lazy(Matrix<double>(3, 1))).eval(), std::invalid_argument);
+}
+
+TEST(Lazy, FailingNodeWaitsForItsSiblings) {
+  // a singular solve fails at once, the product next to it is still running on the pool
+  Matrix<double> singular(3, 3);
+  Matrix<double> b = random_matrix(3, 300, -1.0, 1.0);
+  Matrix<double> a = random_matrix(3, 300, -1.0, 1.0);
+  Matrix<double> c = random_matrix(300, 300, -1.0, 1.0);
+  Lazy<double> expression = (inverse(lazy(singular)) ^ lazy(b)) + (lazy(a) ^ lazy(c));
+  ASSERT_EQ(expression.plan(), "fused(solve(m0, m1) dot(m2, m3) +)");
+  ThreadPool pool(2);
+  for (size_t k = 0; k < 5; ++k) {
+    ASSERT_THROW(expression.eval(pool), std::invalid_argument);
+  }
+  ASSERT_EQ(submit(pool, [] { return 7; }).get(), 7);
+}
+
+TEST(Lazy, ChainOrder) {
+  Matrix<double> a = random_matrix(10, 100, -1.0, 1.0);
+  Matrix<double> b = random_matrix(100, 5, -1.0, 1.0);
+  Matrix<double> c = random_matrix(5, 50, -1.0, 1.0);
+  Lazy<double> left_first = lazy(a) ^ lazy(b) ^ lazy(c);
+  ASSERT_EQ(left_first.plan(), "dot(dot(m0, m1), m2)");
+  ASSERT_EQ(left_first.eval(), seq_dot(seq_dot(a, b), c));
+
+  Matrix<double> d = random_matrix(50, 5, -1.0, 1.0);
+  Matrix<double> e = random_matrix(5, 100, -1.0, 1.0);
+  Matrix<double> f = random_matrix(100, 10, -1.0, 1.0);
+  Lazy<double> right_first = (lazy(d) ^ lazy(e)) ^ lazy(f);
+  ASSERT_EQ(right_first.plan(), "dot(m0, dot(m1, m2))");
+  ASSERT_EQ(right_first.eval(), seq_dot(seq_dot(d, e), f));
+  ASSERT_THROW(lazy(a) ^ lazy(c), std::length_error);
+}
+
+TEST(Lazy, FusionAndSharing) {
+  Matrix<double> a = random_matrix(70, 90, -1.0, 1.0);
+  Matrix<double> b = random_matrix(70, 90, -1.0, 1.0);
+  Matrix<double> c = random_matrix(70, 90, 1.0, 2.0);
+  Lazy<double> expression = lazy(a) + lazy(b) * lazy(c) - 2.0 * lazy(a) / lazy(c);
+  ASSERT_EQ(expression.plan(), "fused(m0 m1 m2 * + m0 *2 m2 / -)");
+  ASSERT_EQ(expression.eval(), a + b * c - (2.0 * a) / c);
+  ASSERT_THROW(lazy(a) + transposed(lazy(b)), std::length_error);
+
+  // both products are the same node, so dot runs once
+  Matrix<double> bt = transposed(b);
+  Lazy<double> twice = (lazy(a) ^ lazy(bt)) + (lazy(a) ^ lazy(bt));
+  Profiler::reset();
+  Profiler::enable();
+  Matrix<double> res = twice.eval();
+  Profiler::disable();
+  ASSERT_EQ(Profiler::snapshot()["dot"].calls, 1u);
+  Profiler::reset();
+  ASSERT_EQ(res, 2.0 * seq_dot(a, bt));
+}
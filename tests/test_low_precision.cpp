@@ -0,0 +1,129 @@
+#include "util/timeout_guard.h"
+#include <gtest/gtest.h>
+
+#include "../matrix/low_precision.h"
+#include "../matrix/reductions.h"
+
+TEST(LowPrecision, Half) {
+  TimeoutGuard guard(5s);
+  ASSERT_EQ(half(1.0f).bits, 0x3c00);
+  ASSERT_EQ(half(-2.0f).bits, 0xc000);
+  ASSERT_EQ(half(65504.0f).bits, 0x7bff);
+  ASSERT_EQ(half(65519.0f).bits, 0x7bff);
+  ASSERT_EQ(half(65520.0f).bits, 0x7c00);  // the tie goes to the even infinity
+  ASSERT_EQ(half(std::ldexp(1.0f, -24)).bits, 0x0001);
+  ASSERT_EQ(half(std::ldexp(1.0f, -25)).bits, 0x0000);
+  ASSERT_EQ(half(std::ldexp(3.0f, -26)).bits, 0x0001);
+  ASSERT_EQ(half(std::ldexp(1.0f, -14)).bits, 0x0400);
+  ASSERT_EQ(half(1.0f + std::ldexp(1.0f, -11)).bits, 0x3c00);  // halfway, to even
+  ASSERT_EQ(half(1.0f + std::ldexp(3.0f, -11)).bits, 0x3c02);
+  ASSERT_EQ(half(-0.0f).bits, 0x8000);
+  ASSERT_TRUE(std::isnan(static_cast<float>(half(std::nanf("")))));
+  ASSERT_EQ(static_cast<float>(half::from_bits(0x7c00)), std::numeric_limits<float>::infinity());
+
+  // every half survives the round trip, in hardware (if enabled) and in software
+  for (uint32_t bits = 0; bits < 0x10000; ++bits) {
+    half value = half::from_bits(static_cast<uint16_t>(bits));
+    float widened = value;
+    ASSERT_EQ(detail::float_bits(widened), detail::float_bits(detail::half_bits_to_float(value.bits)));
+    if (!std::isnan(widened)) {
+      ASSERT_EQ(half(widened).bits, bits);
+      ASSERT_EQ(detail::float_to_half_bits(widened), bits);
+    }
+  }
+  // and rounding agrees between the two on values between halves
+  std::mt19937 gen(7);
+  std::uniform_real_distribution<float> distribution(-70000.0f, 70000.0f);
+  for (size_t i = 0; i < 100000; ++i) {
+    float value = distribution(gen) * (i % 2 == 0 ? 1.0f : 1e-6f);
+    ASSERT_EQ(half(value).bits, detail::float_to_half_bits(value));
+  }
+}
+
+TEST(LowPrecision, Bfloat16) {
+  ASSERT_EQ(bfloat16(1.0f).bits, 0x3f80);
+  ASSERT_EQ(bfloat16(1.0f + std::ldexp(1.0f, -8)).bits, 0x3f80);  // halfway, to even
+  ASSERT_EQ(bfloat16(1.0f + std::ldexp(3.0f, -8)).bits, 0x3f82);
+  ASSERT_NEAR(static_cast<float>(bfloat16(3.0e38f)), 3.0e38f, 3.0e38f * std::ldexp(1.0f, -8));
+  ASSERT_EQ(static_cast<float>(bfloat16(3.4e38f)), std::numeric_limits<float>::infinity());
+  ASSERT_TRUE(std::isnan(static_cast<float>(bfloat16(std::nanf("")))));
+
+  Matrix<float> values = random_matrix<float>(37, 41, -100.0f, 100.0f);
+  Matrix<bfloat16> narrow = matrix_cast<bfloat16>(values);
+  Matrix<float> wide = matrix_cast<float>(narrow);
+  for (size_t i = 0; i < 37; ++i) {
+    for (size_t j = 0; j < 41; ++j) {
+      ASSERT_EQ(narrow(i, j).bits, bfloat16(values(i, j)).bits);
+      ASSERT_NEAR(wide(i, j), values(i, j), std::abs(values(i, j)) * std::ldexp(1.0f, -8));
+    }
+  }
+}
+
+TEST(LowPrecision, Matrices) {
+  Matrix<float> a = random_matrix<float>(90, 70, -1.0f, 1.0f);
+  Matrix<float> b = random_matrix<float>(70, 50, -1.0f, 1.0f);
+  Matrix<half> a_half = matrix_cast<half>(a);
+  Matrix<half> b_half = matrix_cast<half>(b);
+  ASSERT_TRUE(allclose(matrix_cast<float>(a_half), a, 1e-3, 1e-4));
+  Matrix<half> zeros(3, 3);
+  ASSERT_EQ(static_cast<float>(zeros(2, 2)), 0.0f);
+  Matrix<half> doubled = a_half + a_half;
+  ASSERT_EQ(static_cast<float>(doubled(5, 6)), 2.0f * static_cast<float>(a_half(5, 6)));
+
+  // the product of the rounded inputs, exactly as float would compute it
+  Matrix<float> expected = dot(matrix_cast<float>(a_half), matrix_cast<float>(b_half));
+  ASSERT_TRUE(allclose(widened_dot(a_half, b_half), expected, 1e-5, 1e-5));
+  Matrix<half> columns = a_half;
+  columns.set_layout(Layout::ColumnMajor);
+  ASSERT_TRUE(allclose(widened_dot(columns, b_half), expected, 1e-5, 1e-5));
+  Matrix<bfloat16> a_bf = matrix_cast<bfloat16>(a);
+  Matrix<bfloat16> b_bf = matrix_cast<bfloat16>(b);
+  ASSERT_TRUE(allclose(widened_dot(a_bf, b_bf), dot(matrix_cast<float>(a_bf), matrix_cast<float>(b_bf)),
+                       1e-5, 1e-5));
+  ASSERT_THROW(widened_dot(a_half, a_half), std::length_error);
+
+  // int8: exact, including the tails of the 64-byte vectors
+  Matrix<int8_t> x(3, 67), y(67, 5);
+  for (size_t p = 0; p < 67; ++p) {
+    for (size_t i = 0; i < 3; ++i) {
+      x(i, p) = static_cast<int8_t>(int(p * 7 + i * 31) % 255 - 127);
+    }
+    for (size_t j = 0; j < 5; ++j) {
+      y(p, j) = static_cast<int8_t>(int(p * 13 + j * 17) % 255 - 127);
+    }
+  }
+  Matrix<int32_t> products = widened_dot(x, y);
+  for (size_t i = 0; i < 3; ++i) {
+    for (size_t j = 0; j < 5; ++j) {
+      int32_t sum = 0;
+      for (size_t p = 0; p < 67; ++p) {
+        sum += int32_t(x(i, p)) * int32_t(y(p, j));
+      }
+      ASSERT_EQ(products(i, j), sum);
+    }
+  }
+}
+
+TEST(LowPrecision, Quantization) {
+  Matrix<float> a = random_matrix<float>(64, 200, -3.0f, 3.0f);
+  Matrix<float> b = random_matrix<float>(200, 48, -0.5f, 0.5f);
+  for (size_t j = 0; j < 200; ++j) {
+    a(7, j) = 0.0f;  // a zero row keeps a zero scale
+  }
+  QuantizedMatrix rows = quantize(a);
+  ASSERT_EQ(rows.scales.size(), 64u);
+  ASSERT_EQ(rows.scales[7], 0.0f);
+  Matrix<float> restored = dequantize(rows);
+  for (size_t i = 0; i < 64; ++i) {
+    for (size_t j = 0; j < 200; ++j) {
+      ASSERT_LE(std::abs(restored(i, j) - a(i, j)), rows.scales[i] * 0.5f + 1e-6f);
+    }
+  }
+  QuantizedMatrix columns = quantize(b, false);
+  ASSERT_EQ(columns.scales.size(), 48u);
+  Matrix<float> product = quantized_dot(rows, columns);
+  // the exact product of the quantized values
+  ASSERT_TRUE(allclose(product, dot(restored, dequantize(columns)), 1e-4, 1e-4));
+  ASSERT_LE(norm(product - dot(a, b)) / norm(dot(a, b)), 0.02);
+  ASSERT_THROW(quantized_dot(columns, rows), std::invalid_argument);
+}
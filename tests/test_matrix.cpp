@@ -374,3 +374,205 @@ TEST(Matrix, FastRank_big) {
   Matrix<double> matrix = diag(1., size);
   ASSERT_EQ(fast_rank(matrix), size);
 }
+
+TEST(Matrix, WorkspaceSolvers) {
+  Matrix<double> matrix_1({ {1, 1, 4, 4, 9}, {2, 2, 17, 17, 82}, {2, 0, 3, -1, 4}, {0, 1, 4, 12, 27}, {1, 2, 2, 10, 0}, {2, 2, 8, 8, 18} });
+  Matrix<double> matrix_2({ {-9}, {-146}, {-10}, {-26}, {37}, {-18} });
+  Matrix<double> expected({ {5}, {4}, {-3}, {3}, {-2} });
+  SolverWorkspace<double> workspace;
+  Matrix<double> res;
+  ASSERT_TRUE(sle_solution(matrix_1, matrix_2, res, workspace));
+  ASSERT_EQ(res, expected);
+  const double* buffer = workspace.left.data();
+  const double* res_buffer = res.data();
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(sle_solution(matrix_1, matrix_2, res, workspace));
+  }
+  ASSERT_EQ(workspace.left.data(), buffer);
+  ASSERT_EQ(res.data(), res_buffer);
+  ASSERT_EQ(res, expected);
+
+  Matrix<double> matrix({{1.0, 2.0, 3.0, 4.0},
+                         {4.0, 3.0, 2.0, 1.0},
+                         {2.0, 3.0, 4.0, 6.0},
+                         {4.0, 2.0, 1.0, 3.0}});
+  inverse(matrix, res, workspace);
+  ASSERT_EQ(res, inverse(matrix));
+  ASSERT_NEAR(det(matrix, workspace), 5, 1e-9);
+  ASSERT_EQ(rank(matrix, workspace), 4u);
+  ASSERT_THROW(inverse(Matrix<double>(3, 3), res, workspace), std::invalid_argument);
+}
+
+TEST(Matrix, SleSolutionInPlace) {
+  Matrix<double> matrix_1({{5, -6, 1}, {3, -5, -2}, {2, -1, 3}});
+  Matrix<double> matrix_2({{4}, {3}, {5}});
+  ASSERT_FALSE(sle_solution_in_place(matrix_1, matrix_2, matrix_2));
+  ASSERT_TRUE(matrix_2.empty());
+  Matrix<double> left({{2, 3, 5}, {3, 7, 4}, {1, 2, 2}});
+  Matrix<double> right({{10}, {3}, {3}});
+  ASSERT_TRUE(sle_solution_in_place(left, right, right));
+  ASSERT_EQ(right, Matrix<double>({{3}, {-2}, {2}}));
+}
+
+TEST(Matrix, ConcatenateAppendsInPlace) {
+  Matrix<int> matrix({{1, 2}});
+  matrix.reserve(8);
+  const int* buffer = matrix.data();
+  for (int i = 0; i < 7; ++i) {
+    matrix.concatenate(Matrix<int>({{i, -i}}));
+  }
+  ASSERT_EQ(matrix.data(), buffer);
+  ASSERT_EQ(matrix.GetLength(), 8u);
+  ASSERT_GE(matrix.capacity(), 8u);
+  ASSERT_EQ(matrix(7, 1), -6);
+  matrix.concatenate(matrix);
+  ASSERT_EQ(matrix.GetLength(), 16u);
+  ASSERT_EQ(matrix(15, 0), 6);
+
+  Matrix<int> left({{1, 2}, {3, 4}});
+  Matrix<int> right(std::vector<std::vector<int>>{{5}, {6}});
+  ASSERT_EQ(concatenate(left, right, 1), Matrix<int>({{1, 2, 5}, {3, 4, 6}}));
+  ASSERT_EQ(concatenate(left, left), Matrix<int>({{1, 2}, {3, 4}, {1, 2}, {3, 4}}));
+  ASSERT_THROW(concatenate(left, right), std::length_error);
+}
+
+TEST(Matrix, ConcatenationView) {
+  Matrix<double> left({ {1, 1, 4}, {2, 2, 17}, {2, 0, 3}, {0, 1, 4}, {1, 2, 2} });
+  Matrix<double> middle({ {4, 9}, {17, 82}, {-1, 4}, {12, 27}, {10, 0} });
+  Matrix<double> right({ {-9}, {-146}, {-10}, {-26}, {37} });
+  ConcatenationView<double> view(left, middle, 1);
+  ASSERT_EQ(view.GetShape(), std::make_pair(size_t(5), size_t(5)));
+  ASSERT_EQ(view(1, 3), 17);
+  ASSERT_EQ(view.to_matrix(), concatenate(left, middle, 1));
+  ASSERT_EQ(sle_solution(view, right), Matrix<double>({ {5}, {4}, {-3}, {3}, {-2} }));
+  Matrix<double> x = random_matrix(5, 2);
+  ASSERT_EQ(dot(view, x), dot(view.to_matrix(), x));
+
+  ConcatenationView<double> stacked(left, left, 0);
+  ASSERT_EQ(stacked(6, 2), 17);
+  ASSERT_EQ(dot(stacked, transposed(left)), dot(stacked.to_matrix(), transposed(left)));
+  SolverWorkspace<double> workspace;
+  ASSERT_EQ(rank(stacked, workspace), 3u);
+}
+
+TEST(Matrix, ColumnMajorLayout) {
+  Matrix<double> rows = random_matrix(7, 5, 1.0, 2.0);
+  Matrix<double> columns = rows;
+  columns.set_layout(Layout::ColumnMajor);
+  ASSERT_EQ(columns, rows);
+  ASSERT_EQ(columns.data()[1], rows(1, 0));
+  ASSERT_EQ(columns.row_stride(), 1u);
+  ASSERT_EQ(columns.column_stride(), 7u);
+  ASSERT_EQ(Matrix<double>::from_buffer(7, 5, std::vector<double>(columns.data(), columns.data() + 35),
+                                        Layout::ColumnMajor), rows);
+
+  // the same buffer read by rows is the transpose
+  Matrix<double> flipped = columns;
+  flipped.transpose_layout();
+  ASSERT_EQ(flipped.layout(), Layout::RowMajor);
+  ASSERT_EQ(flipped, transposed(rows));
+  ASSERT_EQ(transposed(columns), transposed(rows));
+  ASSERT_EQ(transposed(columns).layout(), Layout::ColumnMajor);
+
+  Matrix<double> expected = rows;
+  expected.column_addition(1, 3, 2.0).column_switching(0, 4).row_addition(2, 6, -1.5).row_switching(0, 3);
+  Matrix<double> changed = columns;
+  changed.column_addition(1, 3, 2.0).column_switching(0, 4).row_addition(2, 6, -1.5).row_switching(0, 3);
+  ASSERT_EQ(changed, expected);
+  ASSERT_EQ(columns.get_column(2), rows.get_column(2));
+  ASSERT_EQ(columns.get_row(4), rows.get_row(4));
+  ASSERT_EQ(columns.get_submatrix(1, 4, 2, 4), rows.get_submatrix(1, 4, 2, 4));
+
+  Matrix<double> stacked = columns;
+  stacked.concatenate(rows);
+  ASSERT_EQ(stacked, concatenate(rows, rows));
+  Matrix<double> wide = columns;
+  wide.concatenate(rows, 1);
+  ASSERT_EQ(wide, concatenate(rows, rows, 1));
+  ASSERT_EQ(wide.layout(), Layout::ColumnMajor);
+
+  ASSERT_EQ(columns + rows, 2.0 * rows);
+  ASSERT_EQ(rows * columns, rows * rows);
+  ASSERT_EQ((columns - 0.5 * rows).layout(), Layout::ColumnMajor);
+  ASSERT_THROW(MatrixView<double>{columns}, std::invalid_argument);
+}
+
+TEST(Matrix, ColumnMajorAlgorithms) {
+  Matrix<double> a = random_matrix(30, 30, -1.0, 1.0) + diag(30.0, 30);
+  Matrix<double> b = random_matrix(30, 4, -1.0, 1.0);
+  Matrix<double> a_columns = a;
+  a_columns.set_layout(Layout::ColumnMajor);
+  Matrix<double> b_columns = b;
+  b_columns.set_layout(Layout::ColumnMajor);
+
+  Matrix<double> product = dot(a, b);
+  ASSERT_EQ(dot(a_columns, b_columns), product);
+  ASSERT_EQ(dot(a_columns, b_columns).layout(), Layout::ColumnMajor);
+  ASSERT_EQ(dot(a, b_columns), product);
+  ASSERT_EQ(dot(a_columns, b), product);
+  ASSERT_NEAR(det(a_columns) / det(a), 1.0, 1e-9);
+  ASSERT_EQ(inverse(a_columns), inverse(a));
+  ASSERT_EQ(sle_solution(a_columns, b_columns), sle_solution(a, b));
+  ASSERT_EQ(rank(b_columns), 4u);
+}
+
+TEST(Matrix, RowOperationsOnColumnRange) {
+  for (Layout layout : {Layout::RowMajor, Layout::ColumnMajor}) {
+    Matrix<double> matrix = random_matrix(9, 1100, 1.0, 2.0);
+    matrix.set_layout(layout);
+    Matrix<double> expected = matrix;
+    std::vector<double> factors = {0.5, -1.0, 2.0, 0.25};
+    for (size_t r = 2; r < 6; ++r) {
+      for (size_t x = 3; x < 1050; ++x) {
+        expected(r, x) += factors[r - 2] * expected(7, x);
+      }
+    }
+    // wider than one column block
+    matrix.rows_addition(2, 6, 7, factors.data(), 3, 1050);
+    ASSERT_EQ(matrix, expected);
+
+    expected(0, 4) *= 3.0;
+    expected(0, 5) *= 3.0;
+    matrix.row_multiplication(0, 3.0, 4, 6);
+    std::swap(expected(1, 10), expected(8, 10));
+    matrix.row_switching(1, 8, 10, 11);
+    expected(1, 0) += 2.0 * expected(8, 0);
+    matrix.row_addition(1, 8, 2.0, 0, 1);
+    ASSERT_EQ(matrix, expected);
+  }
+}
+
+TEST(Matrix, UninitializedResults) {
+  Matrix<double> matrix = Matrix<double>::uninitialized(3, 4, Layout::ColumnMajor);
+  ASSERT_EQ(matrix.GetShape(), std::make_pair(size_t(3), size_t(4)));
+  ASSERT_EQ(matrix.layout(), Layout::ColumnMajor);
+  ASSERT_TRUE(Matrix<double>::uninitialized(0, 0).empty());
+
+  // the kernels that now skip the zero fill write every element
+  for (Layout layout : {Layout::RowMajor, Layout::ColumnMajor}) {
+    for (auto [h, w] : {std::pair<size_t, size_t>{70, 45}, {600, 700}}) {
+      Matrix<double> a = random_matrix(h, w, 1.0, 2.0);
+      Matrix<double> b = random_matrix(h, w, 1.0, 2.0);
+      a.set_layout(layout);
+      Matrix<double> expected_t(w, h), expected_sum(h, w);
+      for (size_t i = 0; i < h; ++i) {
+        for (size_t j = 0; j < w; ++j) {
+          expected_t(j, i) = a(i, j);
+          expected_sum(i, j) = a(i, j) + b(i, j);
+        }
+      }
+      Matrix<double> t = transposed(a);
+      ASSERT_EQ(t.layout(), layout);
+      ASSERT_EQ(t, expected_t);
+      ASSERT_EQ(transposed(t), a);
+      ASSERT_EQ(a + b, expected_sum);
+      ASSERT_EQ((a + b) - b, a);
+      ASSERT_EQ(((2.0 * a) / a)(h - 1, w - 1), 2.0);
+      ASSERT_EQ((a * b)(0, 0), a(0, 0) * b(0, 0));
+      ASSERT_EQ(a.get_submatrix(1, h - 2, 3, w - 1)(0, 0), a(1, 3));
+      ASSERT_EQ(a.get_row(h - 1)(0, w - 1), a(h - 1, w - 1));
+      ASSERT_EQ(a.get_column(w - 1)(h - 1, 0), a(h - 1, w - 1));
+      ASSERT_EQ(matrix_cast<float>(a)(h - 1, w - 1), float(a(h - 1, w - 1)));
+    }
+  }
+}
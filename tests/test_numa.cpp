@@ -0,0 +1,85 @@
+#include "util/timeout_guard.h"
+#include <gtest/gtest.h>
+
+#include "../matrix/async.h"
+#include "../matrix/reductions.h"
+
+TEST(Numa, CpuList) {
+  TimeoutGuard guard(5s);
+  ASSERT_EQ(detail::parse_cpu_list("0-3,8,10-11\n"), std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+  ASSERT_EQ(detail::parse_cpu_list("5"), std::vector<int>({5}));
+  ASSERT_TRUE(detail::parse_cpu_list("\n").empty());
+  ASSERT_GE(numa_nodes(), 1u);
+}
+
+TEST(Numa, FirstTouch) {
+  // large enough to be filled by two threads
+  Matrix<double> zeros(600, 500);
+  ASSERT_EQ(norm(zeros, Norm::Max), 0.0);
+  Matrix<double> matrix = random_matrix(600, 500, -1.0, 1.0);
+  Matrix<double> copy = matrix;
+  ASSERT_TRUE(allclose(copy, matrix, 0, 0));
+  Matrix<double> assigned(3, 3);
+  assigned = matrix;
+  ASSERT_TRUE(allclose(assigned, matrix, 0, 0));
+  Matrix<double> smaller = random_matrix(10, 10, -1.0, 1.0);
+  assigned = smaller;
+  ASSERT_TRUE(allclose(assigned, smaller, 0, 0));
+
+  std::vector<double> values(600 * 500, 2.0);
+  Matrix<double> from_buffer = Matrix<double>::from_buffer(600, 500, values);
+  ASSERT_EQ(sum(from_buffer), 600000.0);
+  ASSERT_EQ(concatenate(zeros, matrix, 1).GetWidth(), 1000u);
+}
+
+TEST(Numa, Affinity) {
+  Matrix<double> a = random_matrix(400, 400, -1.0, 1.0);
+  Matrix<double> b = random_matrix(400, 400, -1.0, 1.0);
+  Matrix<double> expected_sum = a + b;
+  Matrix<double> expected_product = dot(a, b);
+  double expected_norm = norm(a);
+
+  set_numa_affinity(true);
+  ASSERT_TRUE(numa_affinity());
+  Matrix<double> fresh(600, 500);
+  ASSERT_EQ(norm(fresh, Norm::Max), 0.0);
+  ASSERT_TRUE(allclose(a + b, expected_sum, 0, 0));
+  ASSERT_TRUE(allclose(dot(a, b), expected_product));
+  ASSERT_EQ(norm(a), expected_norm);
+  set_numa_affinity(false);
+  ASSERT_FALSE(numa_affinity());
+}
+
+#if defined(__linux__)
+TEST(Numa, PinnedPool) {
+  const auto& nodes = detail::numa_node_cpus();
+  if (nodes.empty()) {
+    GTEST_SKIP() << "no NUMA topology in /sys";
+  }
+  ThreadPool pool(2 * nodes.size(), true);
+  std::vector<Future<bool>> inside;
+  for (size_t k = 0; k < 4 * nodes.size(); ++k) {
+    inside.push_back(submit(pool, [&nodes] {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      sched_getaffinity(0, sizeof(set), &set);
+      // the cpus of a worker are those of one node
+      for (const auto& cpus : nodes) {
+        bool all = true;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+          if (CPU_ISSET(cpu, &set) && std::find(cpus.begin(), cpus.end(), cpu) == cpus.end()) {
+            all = false;
+          }
+        }
+        if (all) {
+          return true;
+        }
+      }
+      return false;
+    }));
+  }
+  for (auto& future : inside) {
+    ASSERT_TRUE(future.get());
+  }
+}
+#endif
@@ -0,0 +1,92 @@
+#include "util/timeout_guard.h"
+#include <gtest/gtest.h>
+
+#include "../matrix/powers.h"
+
+namespace {
+
+// A^k by k - 1 products, the loop matrix_power replaces
+Matrix<double> naive_power(const Matrix<double>& matrix, size_t k) {
+  Matrix<double> res = diag(1.0, matrix.GetLength());
+  for (size_t i = 0; i < k; ++i) {
+    res = dot(res, matrix);
+  }
+  return res;
+}
+
+// exp(A) by its Taylor series, for small ||A||
+Matrix<double> taylor_exp(const Matrix<double>& matrix) {
+  Matrix<double> res = diag(1.0, matrix.GetLength());
+  Matrix<double> term = res;
+  for (size_t i = 1; i < 40; ++i) {
+    term = (1.0 / i) * dot(term, matrix);
+    res += term;
+  }
+  return res;
+}
+
+}  // namespace
+
+TEST(Powers, MatrixPower) {
+  TimeoutGuard guard(5s);
+  Matrix<double> matrix = random_matrix(20, 20, -0.2, 0.2);
+  for (size_t k : {0, 1, 2, 5, 8, 13}) {
+    ASSERT_TRUE(allclose(matrix_power(matrix, k), naive_power(matrix, k), 1e-10, 1e-14));
+  }
+  Matrix<double> fibonacci({{1, 1}, {1, 0}});
+  ASSERT_EQ(matrix_power(fibonacci, 30)(0, 1), 832040.0);
+  Matrix<int> integers({{1, 1}, {1, 0}});
+  ASSERT_EQ(matrix_power(integers, 10)(0, 0), 89);
+
+  Matrix<double> regular = matrix + diag(2.0, 20);
+  ASSERT_TRUE(allclose(dot(matrix_power(regular, -3), matrix_power(regular, 3)), diag(1.0, 20), 1e-9, 1e-9));
+  ASSERT_THROW(matrix_power(Matrix<double>(3, 3), -1), std::invalid_argument);
+  ASSERT_THROW(matrix_power(Matrix<double>(2, 3), 2), std::length_error);
+
+  // one workspace for a column-major argument and repeated calls
+  Matrix<double> columns = matrix;
+  columns.set_layout(Layout::ColumnMajor);
+  PowerWorkspace<double> workspace;
+  Matrix<double> res;
+  for (size_t k : {7, 9}) {
+    matrix_power(columns, k, res, workspace);
+    ASSERT_EQ(res.layout(), Layout::ColumnMajor);
+    ASSERT_TRUE(allclose(res, naive_power(matrix, k), 1e-10, 1e-14));
+  }
+}
+
+TEST(Powers, Polynomial) {
+  Matrix<double> matrix = random_matrix(15, 15, -0.3, 0.3);
+  for (size_t degree : {0, 1, 2, 3, 4, 9, 10, 17}) {
+    std::vector<double> coefficients;
+    Matrix<double> expected(15, 15);
+    for (size_t i = 0; i <= degree; ++i) {
+      coefficients.push_back(1.0 + 0.5 * i);
+      expected += coefficients.back() * naive_power(matrix, i);
+    }
+    ASSERT_TRUE(allclose(polyvalm(coefficients, matrix), expected, 1e-10, 1e-12)) << degree;
+  }
+  ASSERT_TRUE(allclose(polyvalm(std::vector<double>{}, matrix), Matrix<double>(15, 15)));
+}
+
+TEST(Powers, Exponential) {
+  // every Padé degree, the last with squarings
+  for (double scale : {0.001, 0.05, 0.3, 0.7, 1.5, 4.0, 40.0}) {
+    Matrix<double> matrix = random_matrix(12, 12, -1.0, 1.0);
+    matrix = (scale / norm(matrix, Norm::One)) * matrix;
+    Matrix<double> expected = scale <= 1.5 ? taylor_exp(matrix) : matrix_power(taylor_exp((1.0 / 64) * matrix), 64);
+    ASSERT_TRUE(allclose(expm(matrix), expected, 1e-9, 1e-12)) << scale;
+  }
+  // exp of a diagonal matrix and of a nilpotent one are known exactly
+  Matrix<double> diagonal = diag_from_vector(std::vector<double>{-50.0, 0.0, 3.0});
+  ASSERT_TRUE(allclose(expm(diagonal), diag_from_vector(std::vector<double>{std::exp(-50.0), 1.0, std::exp(3.0)}),
+                       1e-12, 1e-30));
+  Matrix<double> nilpotent({{0, 6, 0}, {0, 0, 6}, {0, 0, 0}});
+  ASSERT_TRUE(allclose(expm(nilpotent), Matrix<double>({{1, 6, 18}, {0, 1, 6}, {0, 0, 1}}), 1e-12, 1e-12));
+  // a rotation generator: exp is a rotation by 100 radians
+  Matrix<double> rotation({{0, -100}, {100, 0}});
+  Matrix<double> expected({{std::cos(100.0), -std::sin(100.0)}, {std::sin(100.0), std::cos(100.0)}});
+  ASSERT_TRUE(allclose(expm(rotation), expected, 1e-8, 1e-10));
+  rotation.set_layout(Layout::ColumnMajor);
+  ASSERT_TRUE(allclose(expm(rotation), expected, 1e-8, 1e-10));
+}
@@ -0,0 +1,76 @@
+#include "util/timeout_guard.h"
+#include <gtest/gtest.h>
+
+#include "../matrix/functions.h"
+
+// the profiler is global, every test leaves it disabled and empty for the others
+
+TEST(Profiling, CountsKernels) {
+  TimeoutGuard guard(5s);
+  Profiler::reset();
+  Profiler::enable();
+  Matrix<double> a = random_matrix(200, 200, -1.0, 1.0);
+  Matrix<double> b = random_matrix(200, 200, -1.0, 1.0);
+  Matrix<double> c = dot(a, b);
+  c = dot(a, b);
+  det(a);
+  Matrix<double> sum = a + b;
+  transposed(sum);
+  Profiler::disable();
+
+  auto stats = Profiler::snapshot();
+  ASSERT_EQ(stats["dot"].calls, 2u);
+  ASSERT_EQ(stats["dot"].flops, 2u * 2 * 200 * 200 * 200);
+  ASSERT_EQ(stats["gemm"].calls, 2u);
+  ASSERT_GT(stats["dot"].time_ns, 0u);
+  // the result buffer of every dot
+  ASSERT_EQ(stats["dot"].allocations, 2u);
+  ASSERT_EQ(stats["dot"].allocated_bytes, 2u * 200 * 200 * sizeof(double));
+  // gemm of 200^3 is large enough for the two threads
+  ASSERT_EQ(stats["gemm"].threads, 4u);
+  ASSERT_EQ(stats["det"].calls, 1u);
+  ASSERT_GT(stats["det"].threads, 0u);
+  ASSERT_EQ(stats["add"].calls, 1u);
+  ASSERT_EQ(stats["add"].flops, 200u * 200);
+  ASSERT_EQ(stats["transpose"].calls, 1u);
+  Profiler::reset();
+}
+
+TEST(Profiling, Export) {
+  Profiler::reset();
+  Profiler::enable();
+  Matrix<double> a = random_matrix(20, 30, -1.0, 1.0);
+  dot(a, transposed(a));
+  Profiler::disable();
+
+  std::string json = Profiler::to_json();
+  ASSERT_NE(json.find("\"dot\": {\"calls\": 1"), std::string::npos);
+  ASSERT_NE(json.find("\"join_ns\""), std::string::npos);
+  std::string trace = Profiler::to_chrome_trace();
+  ASSERT_EQ(trace.find("{\"traceEvents\": ["), 0u);
+  ASSERT_NE(trace.find("\"ph\": \"X\""), std::string::npos);
+  // gemm is nested in dot, so it ends first and comes first
+  auto events = Profiler::trace();
+  ASSERT_GE(events.size(), 2u);
+  ASSERT_EQ(std::string(events.back().name), "dot");
+  ASSERT_LE(events.back().start_ns, events[events.size() - 2].start_ns);
+  ASSERT_THROW(Profiler::write_json("/nonexistent/dir/profile.json"), std::runtime_error);
+  Profiler::reset();
+}
+
+TEST(Profiling, DisabledRecordsNothing) {
+  Profiler::reset();
+  Matrix<double> a = random_matrix(50, 50, -1.0, 1.0);
+  inverse(a);
+  sle_solution(a, a);
+  ASSERT_TRUE(Profiler::snapshot().empty());
+  ASSERT_EQ(Profiler::to_json(), "{\"kernels\": {}}");
+  ASSERT_EQ(ProfileScope::current(), nullptr);
+
+  Profiler::enable();
+  inverse(a);
+  Profiler::disable();
+  ASSERT_EQ(Profiler::snapshot()["inverse"].calls, 1u);
+  Profiler::reset();
+  ASSERT_TRUE(Profiler::trace().empty());
+}
@@ -0,0 +1,83 @@
+#include "util/timeout_guard.h"
+#include <gtest/gtest.h>
+
+#include "../matrix/functions.h"
+#include "../matrix/reductions.h"
+
+TEST(Reductions, Sums) {
+  TimeoutGuard guard(5s);
+  Matrix<int> small({{1, -2, 3}, {4, 5, -6}});
+  ASSERT_EQ(sum(small), 5);
+  ASSERT_EQ(min(small), -6);
+  ASSERT_EQ(max(small), 5);
+  ASSERT_EQ(row_sums(small), Matrix<int>(std::vector<std::vector<int>>{{2}, {3}}));
+  ASSERT_EQ(column_sums(small), Matrix<int>({{5, 3, -3}}));
+  ASSERT_EQ(trace(Matrix<int>({{1, 2}, {3, 4}})), 5);
+  ASSERT_THROW(trace(small), std::length_error);
+  ASSERT_THROW(min(Matrix<int>()), std::invalid_argument);
+
+  // long enough for two threads and for both summation orders
+  Matrix<double> matrix = random_matrix(700, 600, -1.0, 1.0);
+  Matrix<double> columns = matrix;
+  columns.set_layout(Layout::ColumnMajor);
+  long double total = 0;
+  for (size_t i = 0; i < 700; ++i) {
+    for (size_t j = 0; j < 600; ++j) {
+      total += matrix(i, j);
+    }
+  }
+  ASSERT_NEAR(sum(matrix), static_cast<double>(total), 1e-10);
+  ASSERT_NEAR(sum(columns), static_cast<double>(total), 1e-10);
+  ASSERT_TRUE(allclose(row_sums(columns), row_sums(matrix), 1e-12, 1e-12));
+  ASSERT_TRUE(allclose(column_sums(columns), column_sums(matrix), 1e-12, 1e-12));
+  ASSERT_EQ(max(columns), max(matrix));
+}
+
+TEST(Reductions, Compensated) {
+  // 1 + 1e6 terms of 1e-16: naive summation in double returns exactly 1
+  size_t n = 1000000;
+  Matrix<double> column(n + 1, 1);
+  column(0, 0) = 1;
+  for (size_t i = 1; i <= n; ++i) {
+    column(i, 0) = 1e-16;
+  }
+  ASSERT_NEAR(sum(column), 1 + 1e-10, 1e-13);
+  ASSERT_NEAR(column_sums(column)(0, 0), 1 + 1e-10, 1e-15);
+  column.set_layout(Layout::ColumnMajor);
+  column.transpose_layout();  // a row-major row
+  ASSERT_EQ(column_sums(column)(0, 0), 1.0);
+  ASSERT_NEAR(row_sums(column)(0, 0), 1 + 1e-10, 1e-13);
+}
+
+TEST(Reductions, Norms) {
+  Matrix<double> matrix({{1, -2}, {-3, 4}});
+  ASSERT_NEAR(norm(matrix), std::sqrt(30.0), 1e-12);
+  ASSERT_EQ(norm(matrix, Norm::One), 6.0);
+  ASSERT_EQ(norm(matrix, Norm::Inf), 7.0);
+  ASSERT_EQ(norm(matrix, Norm::Max), 4.0);
+  matrix.set_layout(Layout::ColumnMajor);
+  ASSERT_EQ(norm(matrix, Norm::One), 6.0);
+  ASSERT_EQ(norm(matrix, Norm::Inf), 7.0);
+  ASSERT_NEAR(norm(Matrix<int>({{3, 4}})), 5.0, 1e-12);
+}
+
+TEST(Reductions, Allclose) {
+  Matrix<double> a({{1, 0}, {1e6, -2}});
+  Matrix<double> b({{1 + 1e-7, 1e-9}, {1e6 + 1, -2}});
+  ASSERT_TRUE(allclose(a, b));
+  ASSERT_FALSE(a == b);  // the zero is compared relatively
+  ASSERT_FALSE(allclose(a, b, 1e-9, 1e-12));
+  ASSERT_FALSE(allclose(a, Matrix<double>(2, 3)));
+  Matrix<double> columns = b;
+  columns.set_layout(Layout::ColumnMajor);
+  ASSERT_TRUE(allclose(a, columns));
+  b(0, 0) = std::nan("");
+  ASSERT_FALSE(allclose(a, b));
+  ASSERT_TRUE(allclose(Matrix<int>({{1, 2}}), Matrix<int>({{1, 2}}), 0, 0));
+
+  Matrix<double> big = random_matrix(600, 600, -1.0, 1.0);
+  Matrix<double> perturbed = big;
+  ASSERT_TRUE(allclose(big, perturbed, 0, 0));
+  perturbed(599, 599) += 1e-3;
+  ASSERT_FALSE(allclose(big, perturbed));
+}
@@ -0,0 +1,93 @@
+#include "util/timeout_guard.h"
+#include <gtest/gtest.h>
+
+#include "../matrix/structured.h"
+
+TEST(Structured, BandLU) {
+  TimeoutGuard guard(5s);
+  size_t n = 60;
+  Matrix<double> dense = random_matrix(n, n, -1.0, 1.0);
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0; j < n; ++j) {
+      if (j + 2 < i || j > i + 3) {
+        dense(i, j) = 0;
+      }
+    }
+  }
+  BandMatrix<double> band(dense, 2, 3);
+  ASSERT_EQ(band.to_dense(), dense);
+  ASSERT_EQ(static_cast<const BandMatrix<double>&>(band)(10, 0), 0.0);
+  ASSERT_THROW(band(10, 0) = 1.0, std::out_of_range);
+
+  // small diagonal entries make the LU pivot
+  Matrix<double> right = random_matrix(n, 3, -1.0, 1.0);
+  Matrix<double> x = sle_solution(band, right);
+  ASSERT_EQ(dot(band, x), right);
+  ASSERT_EQ(dot(dense, x), right);
+  ASSERT_NEAR(det(band) / det(dense), 1.0, 1e-9);
+
+  BandMatrix<double> singular(4, 1, 1);
+  singular(0, 0) = 1;
+  singular(1, 0) = 1;
+  ASSERT_TRUE(sle_solution(singular, Matrix<double>(4, 1)).empty());
+  ASSERT_EQ(det(singular), 0.0);
+  ASSERT_EQ(det(BandMatrix<int>(Matrix<int>({{2, 1, 0}, {1, 3, 1}, {0, 1, 4}}), 1, 1)), 18);
+}
+
+TEST(Structured, Tridiagonal) {
+  size_t n = 100000;
+  BandMatrix<double> band(n, 1, 1);
+  Matrix<double> right(n, 1);
+  for (size_t i = 0; i < n; ++i) {
+    band(i, i) = 4;
+    if (i > 0) {
+      band(i, i - 1) = -1;
+    }
+    if (i + 1 < n) {
+      band(i, i + 1) = -1.5;
+    }
+    right(i, 0) = static_cast<double>(i % 7) + 1;
+  }
+  Matrix<double> x = thomas_solution(band, right);
+  ASSERT_EQ(dot(band, x), right);
+  ASSERT_EQ(sle_solution(band, right), x);
+
+  // a zero leading pivot stops the Thomas algorithm, the banded LU pivots past it
+  BandMatrix<double> swap(Matrix<double>({{0, 1, 0}, {1, 0, 1}, {0, 1, 1}}), 1, 1);
+  Matrix<double> b(std::vector<std::vector<double>>{{1}, {2}, {3}});
+  ASSERT_TRUE(thomas_solution(swap, b).empty());
+  ASSERT_EQ(dot(swap, sle_solution(swap, b)), b);
+  ASSERT_THROW(thomas_solution(BandMatrix<double>(3, 2, 1), b), std::invalid_argument);
+}
+
+TEST(Structured, Packed) {
+  size_t n = 40;
+  Matrix<double> a = random_matrix(n, n, -1.0, 1.0);
+  Matrix<double> spd = dot(a, transposed(a)) + diag(1.0, n);
+  Matrix<double> right = random_matrix(n, 2, -1.0, 1.0);
+  for (Triangle triangle : {Triangle::Lower, Triangle::Upper}) {
+    PackedSymmetricMatrix<double> symmetric(spd, triangle);
+    ASSERT_EQ(symmetric.packed().size(), n * (n + 1) / 2);
+    ASSERT_EQ(symmetric.to_dense(), spd);
+    ASSERT_EQ(dot(spd, sle_solution(symmetric, right)), right);
+    ASSERT_NEAR(det(symmetric) / det(spd), 1.0, 1e-9);
+
+    PackedTriangularMatrix<double> triangular(a + diag(4.0, n), triangle);
+    Matrix<double> dense = triangular.to_dense();
+    ASSERT_EQ(dot(dense, sle_solution(triangular, right)), right);
+    ASSERT_NEAR(det(triangular) / det(dense), 1.0, 1e-9);
+  }
+
+  // indefinite: no Cholesky, the dense solver takes over
+  PackedSymmetricMatrix<double> indefinite(Matrix<double>({{1, 2}, {2, 1}}));
+  ASSERT_NEAR(det(indefinite), -3.0, 1e-12);
+  ASSERT_EQ(sle_solution(indefinite, Matrix<double>(std::vector<std::vector<double>>{{3}, {3}})),
+            Matrix<double>(std::vector<std::vector<double>>{{1}, {1}}));
+  indefinite(0, 1) = 5;
+  ASSERT_EQ(indefinite(1, 0), 5.0);
+
+  PackedTriangularMatrix<double> zero_diagonal(2, Triangle::Upper);
+  zero_diagonal(0, 0) = 1;
+  ASSERT_THROW(zero_diagonal(1, 0) = 1.0, std::out_of_range);
+  ASSERT_TRUE(sle_solution(zero_diagonal, Matrix<double>(2, 1)).empty());
+}
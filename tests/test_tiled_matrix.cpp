@@ -0,0 +1,104 @@
+#include "util/timeout_guard.h"
+#include <gtest/gtest.h>
+
+#include "../matrix/tiled_matrix.h"
+
+TEST(TiledMatrix, RoundTripThroughSmallCache) {
+  TimeoutGuard guard(5s);
+  Matrix<double> matrix = random_matrix(23, 17);
+  TiledMatrix<double> tiled = TiledMatrix<double>::from_matrix(matrix, 4, 4);
+  ASSERT_EQ(tiled.to_matrix(), matrix);
+  TileStats stats = tiled.stats();
+  ASSERT_GT(stats.tile_writes, 0u);
+  ASSERT_GT(stats.tile_reads, 0u);
+  ASSERT_EQ(stats.bytes_written, stats.tile_writes * 4 * 4 * sizeof(double));
+}
+
+TEST(TiledMatrix, ElementwiseAndTranspose) {
+  Matrix<double> matrix_1 = random_matrix(10, 13, 1.0, 2.0);
+  Matrix<double> matrix_2 = random_matrix(10, 13, 1.0, 2.0);
+  auto tiled_1 = TiledMatrix<double>::from_matrix(matrix_1, 4, 6);
+  auto tiled_2 = TiledMatrix<double>::from_matrix(matrix_2, 4, 6);
+  ASSERT_EQ((tiled_1 + tiled_2).to_matrix(), matrix_1 + matrix_2);
+  ASSERT_EQ((tiled_1 - tiled_2).to_matrix(), matrix_1 - matrix_2);
+  ASSERT_EQ((tiled_1 * tiled_2).to_matrix(), matrix_1 * matrix_2);
+  ASSERT_EQ((tiled_1 / tiled_2).to_matrix(), matrix_1 / matrix_2);
+  ASSERT_EQ(transposed(tiled_1).to_matrix(), transposed(matrix_1));
+}
+
+TEST(TiledMatrix, Multiplication) {
+  Matrix<double> left = random_matrix(18, 11, 1.0, 2.0);
+  Matrix<double> right = random_matrix(11, 9, 1.0, 2.0);
+  auto tiled_left = TiledMatrix<double>::from_matrix(left, 4, 4);
+  auto tiled_right = TiledMatrix<double>::from_matrix(right, 4, 4);
+  size_t reported = 0;
+  tiled_left.set_progress_callback([&] (const std::string& operation, size_t done, size_t total) {
+    ASSERT_EQ(operation, "dot");
+    ASSERT_LE(done, total);
+    ++reported;
+  });
+  ASSERT_EQ(dot(tiled_left, tiled_right).to_matrix(), dot(left, right));
+  ASSERT_EQ(reported, 5u * 3u);
+}
+
+TEST(TiledMatrix, DeterminantAndSolve) {
+  Matrix<double> matrix({ {1, 1, 4, 4, 9}, {2, 2, 17, 17, 82}, {2, 0, 3, -1, 4}, {0, 1, 4, 12, 27}, {1, 2, 2, 10, 0} });
+  Matrix<double> right({ {-9}, {-146}, {-10}, {-26}, {37} });
+  Matrix<double> expected({ {5}, {4}, {-3}, {3}, {-2} });
+  auto tiled = TiledMatrix<double>::from_matrix(matrix, 2, 4);
+  auto tiled_right = TiledMatrix<double>::from_matrix(right, 2, 4);
+  ASSERT_NEAR(det(tiled), det(matrix), 1e-8);
+  ASSERT_EQ(sle_solution(tiled, tiled_right).to_matrix(), expected);
+}
+
+TEST(TiledMatrix, Inverse) {
+  Matrix<double> matrix = random_matrix(20, 20) + diag(5.0, 20);
+  auto tiled = TiledMatrix<double>::from_matrix(matrix, 6, 8);
+  ASSERT_EQ(inverse(tiled).to_matrix(), inverse(matrix));
+  Matrix<double> singular(7, 7);
+  ASSERT_THROW(inverse(TiledMatrix<double>::from_matrix(singular, 3, 4)), std::invalid_argument);
+  ASSERT_EQ(det(TiledMatrix<double>::from_matrix(singular, 3, 4)), 0);
+}
+
+TEST(TiledMatrix, MoveAssignmentReleasesTheTarget) {
+  Matrix<double> matrix = random_matrix(9, 7);
+  auto temporary = TiledMatrix<double>::from_matrix(random_matrix(5, 5), 4, 4);
+  std::string temporary_path = temporary.path();
+  ASSERT_TRUE(std::filesystem::exists(temporary_path));
+  temporary = TiledMatrix<double>::from_matrix(matrix, 4, 4);
+  ASSERT_FALSE(std::filesystem::exists(temporary_path));
+  ASSERT_EQ(temporary.to_matrix(), matrix);
+
+  // the dirty tile of a named file is written back, not dropped
+  std::string path = TiledMatrix<double>::temporary_path();
+  {
+    TiledMatrix<double> named(4, 4, 4, 4, path);
+    named.set(1, 2, 7.5);
+    named = TiledMatrix<double>::from_matrix(matrix, 4, 4);
+    ASSERT_EQ(named.to_matrix(), matrix);
+    std::ifstream in(path, std::ios::binary);
+    double values[16];
+    in.read(reinterpret_cast<char*>(values), sizeof(values));
+    ASSERT_TRUE(in);
+    ASSERT_EQ(values[1 * 4 + 2], 7.5);
+  }
+  ASSERT_TRUE(std::filesystem::exists(path));
+  std::filesystem::remove(path);
+}
+
+TEST(TiledMatrix, LuKeepsPaddingZero) {
+  // 10 = 4 + 4 + 2: the last tile row is partial
+  Matrix<double> matrix = random_matrix(10, 10, -1.0, 1.0);
+  auto tiled = TiledMatrix<double>::from_matrix(matrix, 4, 4);
+  std::vector<size_t> pivots;
+  bool odd_swaps;
+  ASSERT_TRUE(detail::tiled_lu(tiled, pivots, odd_swaps));
+  for (size_t tj = 0; tj < tiled.tile_columns(); ++tj) {
+    auto tile = tiled.get_tile(2, tj);
+    for (size_t i = 2; i < 4; ++i) {
+      for (size_t j = 0; j < 4; ++j) {
+        ASSERT_EQ((*tile)(i, j), 0.0);
+      }
+    }
+  }
+}